@@ -0,0 +1,182 @@
+// Receive audio sampling for the TM4C123
+//
+// Timer3A triggers one ADC0 SS3 conversion per sample period.
+// uDMA moves each result into one of two sample blocks (ping-pong)
+// so the CPU only sees one interrupt per block; the block is then
+// run through the AFSK demodulator inside that interrupt.
+//
+// Uses Timer3A as the ADC trigger
+// Uses ADC0 SS3: PE2 (AIN1)
+// Uses uDMA channel 17 (ping-pong into two sample blocks)
+
+#include "adc-audio.h"
+#include "afsk.h"
+#include "clock.h"
+#include "profile.h"
+#include "tm4c123gh6pm.h"
+
+// 10 ms of audio per block
+#define ADC_AUDIO_BLOCK_SAMPLES ( AFSK_SAMPLE_RATE / 100 )
+
+#define ADC_AUDIO_DMA_CHANNEL 17
+#define ADC_AUDIO_DMA_PRIMARY ( ADC_AUDIO_DMA_CHANNEL * 4 )
+#define ADC_AUDIO_DMA_ALTERNATE ( ( 32 + ADC_AUDIO_DMA_CHANNEL ) * 4 )
+
+// 16-bit destination increment and size, no source increment,
+// 16-bit source size, arbitrate every transfer, ping-pong mode
+#define ADC_AUDIO_DMA_CONTROL ( 0x40000000 | 0x10000000 | 0x0C000000 | 0x01000000 | \
+	( ( ADC_AUDIO_BLOCK_SAMPLES - 1 ) << 4 ) | 0x3 )
+
+// The control table must be 1024 byte aligned
+#pragma data_alignment=1024
+static uint32_t udmaControlTable[256];
+
+static uint16_t sampleBlocks[2][ADC_AUDIO_BLOCK_SAMPLES];
+
+static uint32_t cyclesThisSecond = 0;
+static uint32_t cyclesPerSecond = 0;
+static uint16_t blocksThisSecond = 0;
+
+void _ADC_Audio_Arm_Block( uint8_t block ) {
+	uint16_t entry = block ? ADC_AUDIO_DMA_ALTERNATE : ADC_AUDIO_DMA_PRIMARY;
+
+	udmaControlTable[entry] = (uint32_t) &ADC0_SSFIFO3_R;
+	udmaControlTable[entry + 1] = (uint32_t) &sampleBlocks[block][ADC_AUDIO_BLOCK_SAMPLES - 1];
+	udmaControlTable[entry + 2] = ADC_AUDIO_DMA_CONTROL;
+}
+
+void _ADC_Audio_DMA_Init() {
+	SYSCTL_RCGCDMA_R |= 0x01;			// Activate uDMA
+	while ( ( SYSCTL_PRDMA_R & 0x01 ) == 0 ) {};
+
+	UDMA_CFG_R = 0x01;					// Enable the controller
+	UDMA_CTLBASE_R = (uint32_t) udmaControlTable;
+
+	// Channel 17 defaults to ADC0 SS3 (encoding 0)
+	UDMA_CHMAP2_R &= ~0x000000F0;
+
+	UDMA_PRIOCLR_R = 1 << ADC_AUDIO_DMA_CHANNEL;
+	UDMA_ALTCLR_R = 1 << ADC_AUDIO_DMA_CHANNEL;
+	UDMA_USEBURSTCLR_R = 1 << ADC_AUDIO_DMA_CHANNEL;
+	UDMA_REQMASKCLR_R = 1 << ADC_AUDIO_DMA_CHANNEL;
+
+	_ADC_Audio_Arm_Block( 0 );
+	_ADC_Audio_Arm_Block( 1 );
+
+	UDMA_ENASET_R = 1 << ADC_AUDIO_DMA_CHANNEL;
+}
+
+/*
+ * Timer 3A period for AFSK_SAMPLE_RATE at the system clock, to the
+ * nearest clock
+ */
+void _ADC_Audio_Clock_Changed( uint32_t hz ) {
+	TIMER3_TAILR_R = ( hz + AFSK_SAMPLE_RATE / 2 ) / AFSK_SAMPLE_RATE - 1;
+}
+
+void _ADC_Audio_Timer3A_Init() {
+	volatile unsigned long delay;
+
+	// Activate timer 3
+	SYSCTL_RCGCTIMER_R |= 0x08;
+
+	// Wait for the timer to settle
+	delay = SYSCTL_RCGCTIMER_R;
+
+	// Disable timer during setup
+	TIMER3_CTL_R &= ~TIMER_CTL_TAEN;
+
+	// Configure for 32-bit periodic timer mode
+	TIMER3_CFG_R = TIMER_CFG_32_BIT_TIMER;
+	TIMER3_TAMR_R = TIMER_TAMR_TAMR_PERIOD;
+
+	// No prescaling
+	TIMER3_TAPR_R = 0;
+
+	// e.g. 1666 ticks at 16 MHz is 9604 Hz, close enough for
+	// the demodulator's clock recovery
+	_ADC_Audio_Clock_Changed( Clock_Get_Hz() );
+	Clock_Register_Change_Callback( _ADC_Audio_Clock_Changed );
+
+	// No timer interrupt, the timeout only triggers the ADC
+	TIMER3_IMR_R = 0;
+	TIMER3_CTL_R |= TIMER_CTL_TAOTE;
+
+	// Enable the timer
+	TIMER3_CTL_R |= TIMER_CTL_TAEN;
+}
+
+void ADC_Audio_Init() {
+	AFSK_Init();
+
+	Profile_Enable_Cycle_Counter();
+
+	SYSCTL_RCGCADC_R |= 0x01;			// Activate ADC0
+	SYSCTL_RCGCGPIO_R |= 0x10;			// Activate Port E
+	while ( ( SYSCTL_PRGPIO_R & 0x10 ) == 0 ) {};
+
+	GPIO_PORTE_DIR_R &= ~0x04;			// PE2 input
+	GPIO_PORTE_AFSEL_R |= 0x04;			// Alternate function on PE2
+	GPIO_PORTE_DEN_R &= ~0x04;			// No digital on PE2
+	GPIO_PORTE_AMSEL_R |= 0x04;			// Analog on PE2
+
+	while ( ( SYSCTL_PRADC_R & 0x01 ) == 0 ) {};
+
+	ADC0_PC_R = 0x01;					// 125 ksps is plenty
+	ADC0_ACTSS_R &= ~0x08;				// Disable SS3 during setup
+	ADC0_EMUX_R = ( ADC0_EMUX_R & 0xFFFF0FFF ) | 0x5000;	// SS3 timer triggered
+	ADC0_SSMUX3_R = 1;					// AIN1
+	ADC0_SSCTL3_R = 0x06;				// One sample: IE0 (DMA request), END0
+
+	_ADC_Audio_DMA_Init();
+
+	// Interrupt only on uDMA completion (DMAMASK3), not per sample
+	ADC0_IM_R = ( ADC0_IM_R & ~0x08 ) | 0x800;
+	ADC0_ISC_R = 0x808;
+
+	ADC0_ACTSS_R |= 0x08;				// Enable SS3
+
+	// ADC0 SS3 / IRQ17 / NVIC_PRI4_R / b15-13 / Priority 2
+	NVIC_PRI4_R = ( NVIC_PRI4_R & 0xFFFF00FF ) | 0x00004000;
+	NVIC_EN0_R = 1 << 17;
+
+	_ADC_Audio_Timer3A_Init();
+}
+
+/*
+ * A sample block is full - rearm it and demodulate it
+ */
+void ADC_Audio_ADC0Seq3_Handler() {
+	uint32_t start = Profile_Get_Cycles();
+
+	PROFILE_ENTER( PROFILE_AUDIO );
+
+	// Acknowledge the uDMA completion
+	ADC0_ISC_R = 0x808;
+
+	// A stopped (mode 0) control word marks the block that completed
+	for ( uint8_t block=0; block < 2; block++ ) {
+		uint16_t entry = block ? ADC_AUDIO_DMA_ALTERNATE : ADC_AUDIO_DMA_PRIMARY;
+		if ( 0 == ( udmaControlTable[entry + 2] & 0x7 ) ) {
+			_ADC_Audio_Arm_Block( block );
+			AFSK_Process_Samples( sampleBlocks[block], ADC_AUDIO_BLOCK_SAMPLES );
+		}
+	}
+
+	cyclesThisSecond += Profile_Get_Cycles() - start;
+	blocksThisSecond++;
+	if ( blocksThisSecond >= AFSK_SAMPLE_RATE / ADC_AUDIO_BLOCK_SAMPLES ) {
+		cyclesPerSecond = cyclesThisSecond;
+		cyclesThisSecond = 0;
+		blocksThisSecond = 0;
+	}
+
+	PROFILE_EXIT( PROFILE_AUDIO );
+}
+
+/*
+ * CPU cycles spent demodulating the last second of audio
+ */
+uint32_t ADC_Audio_Get_Cycles_Per_Second() {
+	return cyclesPerSecond;
+}
@@ -0,0 +1,19 @@
+// Receive audio sampling for the TM4C123
+//
+// Samples the RDA1846 audio output at AFSK_SAMPLE_RATE and hands
+// blocks of samples to the AFSK demodulator
+//
+// Uses Timer3A as the ADC trigger
+// Uses ADC0 SS3: PE2 (AIN1)
+// Uses uDMA channel 17 (ping-pong into two sample blocks)
+
+#ifndef __ADC_AUDIO_H
+#define __ADC_AUDIO_H
+
+#include "stdint.h"
+
+void ADC_Audio_Init();
+void ADC_Audio_ADC0Seq3_Handler();
+uint32_t ADC_Audio_Get_Cycles_Per_Second();
+
+#endif // __ADC_AUDIO_H
@@ -0,0 +1,161 @@
+// Supply voltage monitoring for the TM4C123
+//
+// The tick starts one ADC1 SS1 sequence a second: battery, solar
+// and the internal temperature sensor, in that order. The ADC
+// averages 64 conversions of each step in hardware before it
+// writes the step's result to the FIFO, and only the last step
+// interrupts, so the CPU sees one interrupt per sequence and
+// three results already filtered of the switching noise from
+// a charge controller.
+//
+// ADC0 SS3 samples the receiver audio off Timer3A. Averaging is
+// set per ADC module, so these inputs get ADC1 to themselves.
+// The timer trigger is one signal shared by every timer with its
+// ADC trigger enabled, so a timer here would also trigger the
+// audio sequence - the tick triggers this one from software.
+//
+// Uses ADC1 SS1: PE1 (AIN2) battery, PE0 (AIN3) solar, and the
+// internal temperature sensor
+
+#include "adc-supply.h"
+#include "profile.h"
+#include "tm4c123gh6pm.h"
+
+// The 3.3 V reference reads as 4095
+#define ADC_SUPPLY_REFERENCE_MV 3300
+#define ADC_SUPPLY_FULL_SCALE_CODE 4095
+
+// Millivolts at the top of each divider for a full scale reading
+#define ADC_SUPPLY_FULL_SCALE_MV( top, bottom ) \
+	( ADC_SUPPLY_REFERENCE_MV * ( (top) + (bottom) ) / (bottom) )
+
+// 64x hardware averaging (ADCSAC)
+#define ADC_SUPPLY_AVERAGING 0x6
+
+static volatile uint8_t sequencePending = 0;
+static uint8_t adcSupplyDataValid = 0;
+
+static uint16_t batteryMV = 0;
+static uint16_t solarMV = 0;
+
+// Tenths of a degree C
+static int16_t chipTemperature = 0;
+
+static uint32_t adcSupplySequences = 0;
+static uint32_t adcSupplySequencesMissed = 0;
+
+/*
+ * Millivolts at the top of a divider for an averaged conversion,
+ * rounded - fits 16 bits for dividers up to 19:1 (62 V)
+ */
+uint16_t _ADC_Supply_Millivolts( uint32_t code, uint32_t fullScaleMV ) {
+	return ( code * fullScaleMV + ADC_SUPPLY_FULL_SCALE_CODE / 2 ) / ADC_SUPPLY_FULL_SCALE_CODE;
+}
+
+/*
+ * Tenths of a degree C from the temperature sensor, from the
+ * datasheet's TEMP = 147.5 - ( 75 * 3.3 * ADCCODE / 4096 )
+ */
+int16_t _ADC_Supply_Chip_Temperature( uint32_t code ) {
+	return 1475 - (int16_t) ( ( 2475 * code + 2048 ) / 4096 );
+}
+
+void ADC_Supply_Init() {
+	SYSCTL_RCGCADC_R |= 0x02;			// Activate ADC1
+	SYSCTL_RCGCGPIO_R |= 0x10;			// Activate Port E
+	while ( ( SYSCTL_PRGPIO_R & 0x10 ) == 0 ) {};
+
+	GPIO_PORTE_DIR_R &= ~0x03;			// PE0, PE1 input
+	GPIO_PORTE_AFSEL_R |= 0x03;			// Alternate function on PE0, PE1
+	GPIO_PORTE_DEN_R &= ~0x03;			// No digital on PE0, PE1
+	GPIO_PORTE_AMSEL_R |= 0x03;			// Analog on PE0, PE1
+
+	while ( ( SYSCTL_PRADC_R & 0x02 ) == 0 ) {};
+
+	ADC1_PC_R = 0x01;					// 125 ksps - 64 x 3 conversions in 1.5 ms
+	ADC1_ACTSS_R &= ~0x02;				// Disable SS1 during setup
+	ADC1_EMUX_R &= ~0x00F0;				// SS1 processor triggered
+	ADC1_SAC_R = ADC_SUPPLY_AVERAGING;
+	ADC1_SSMUX1_R = 0x032;				// AIN2, AIN3, then the sensor
+	ADC1_SSCTL1_R = 0x0E00;				// Step 2: TS2, IE2, END2
+
+	ADC1_IM_R |= 0x02;
+	ADC1_ISC_R = 0x02;
+
+	ADC1_ACTSS_R |= 0x02;				// Enable SS1
+
+	// ADC1 SS1 / IRQ49 / NVIC_PRI12_R / b15-13 / Priority 3,
+	// the same as the tick that reads the results
+	NVIC_PRI12_R = ( NVIC_PRI12_R & 0xFFFF1FFF ) | 0x00006000;
+	NVIC_EN1_R = 1 << ( 49 - 32 );
+}
+
+/*
+ * Call once a second, from an interrupt at the sequence's
+ * priority - the results are ready a couple of milliseconds later
+ */
+void ADC_Supply_Start_Sequence() {
+	if ( sequencePending ) {
+		// Still converting the last one
+		adcSupplySequencesMissed++;
+		return;
+	}
+
+	sequencePending = 1;
+	ADC1_PSSI_R = 0x02;
+}
+
+// Handles ADC1 SS1 sequence completion, IRQ49
+void ADC_Supply_ADC1Seq1_Handler() {
+	PROFILE_ENTER( PROFILE_SUPPLY );
+
+	ADC1_ISC_R = 0x02;
+
+	// One averaged result per step, in step order
+	uint32_t battery = ADC1_SSFIFO1_R & 0xFFF;
+	uint32_t solar = ADC1_SSFIFO1_R & 0xFFF;
+	uint32_t sensor = ADC1_SSFIFO1_R & 0xFFF;
+
+	batteryMV = _ADC_Supply_Millivolts( battery,
+		ADC_SUPPLY_FULL_SCALE_MV( ADC_SUPPLY_BATTERY_TOP_KOHMS, ADC_SUPPLY_BATTERY_BOTTOM_KOHMS ) );
+	solarMV = _ADC_Supply_Millivolts( solar,
+		ADC_SUPPLY_FULL_SCALE_MV( ADC_SUPPLY_SOLAR_TOP_KOHMS, ADC_SUPPLY_SOLAR_BOTTOM_KOHMS ) );
+	chipTemperature = _ADC_Supply_Chip_Temperature( sensor );
+
+	adcSupplyDataValid = 1;
+	adcSupplySequences++;
+	sequencePending = 0;
+
+	PROFILE_EXIT( PROFILE_SUPPLY );
+}
+
+uint8_t ADC_Supply_Data_Valid() {
+	return adcSupplyDataValid;
+}
+
+uint16_t ADC_Supply_Get_Battery_MV() {
+	return batteryMV;
+}
+
+uint16_t ADC_Supply_Get_Solar_MV() {
+	return solarMV;
+}
+
+/*
+ * Die temperature in tenths of a degree C
+ */
+int16_t ADC_Supply_Get_Chip_Temperature() {
+	if ( ! adcSupplyDataValid ) {
+		return ADC_SUPPLY_NO_READING;
+	}
+	return chipTemperature;
+}
+
+void ADC_Supply_Get_Stats( uint32_t *sequences, uint32_t *sequencesMissed ) {
+	if ( sequences ) {
+		*sequences = adcSupplySequences;
+	}
+	if ( sequencesMissed ) {
+		*sequencesMissed = adcSupplySequencesMissed;
+	}
+}
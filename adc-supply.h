@@ -0,0 +1,35 @@
+// Supply voltage monitoring for the TM4C123
+//
+// Measures the battery and solar panel voltages and the chip's
+// own temperature once a second with one ADC1 sample sequence
+//
+// Uses ADC1 SS1: PE1 (AIN2) battery, PE0 (AIN3) solar, and the
+// internal temperature sensor
+//
+// Each input comes through a resistor divider to bring it under
+// the 3.3 V reference
+
+#ifndef __ADC_SUPPLY_H
+#define __ADC_SUPPLY_H
+
+#include "stdint.h"
+
+// Divider resistors in kilohms - 100k / 15k reads to 25.3 V,
+// enough for a 12 V panel's open circuit voltage
+#define ADC_SUPPLY_BATTERY_TOP_KOHMS 100
+#define ADC_SUPPLY_BATTERY_BOTTOM_KOHMS 15
+#define ADC_SUPPLY_SOLAR_TOP_KOHMS 100
+#define ADC_SUPPLY_SOLAR_BOTTOM_KOHMS 15
+
+#define ADC_SUPPLY_NO_READING -9999
+
+void ADC_Supply_Init();
+void ADC_Supply_Start_Sequence();
+void ADC_Supply_ADC1Seq1_Handler();
+uint8_t ADC_Supply_Data_Valid();
+uint16_t ADC_Supply_Get_Battery_MV();
+uint16_t ADC_Supply_Get_Solar_MV();
+int16_t ADC_Supply_Get_Chip_Temperature();
+void ADC_Supply_Get_Stats( uint32_t *sequences, uint32_t *sequencesMissed );
+
+#endif // __ADC_SUPPLY_H
@@ -0,0 +1,325 @@
+// Bell 202 AFSK 1200 baud demodulator and HDLC receiver
+//
+// Mark (1200 Hz) and space (2200 Hz) energies come from sliding one
+// bit long quadrature correlators. A DPLL recovers the bit clock
+// from the discriminator transitions, then NRZI decoding, HDLC flag
+// detection, bit de-stuffing and the FCS check produce frames.
+//
+// All arithmetic is integer; the largest intermediate is well
+// inside 32 bits for 12-bit input.
+//
+// The modulator walks a line bit by bit, NRZI encoding it (a zero
+// switches tones), and steps a phase accumulator through a sine
+// table so the tone changes without a phase jump.
+
+#include "afsk.h"
+#include "ax25.h"
+
+#define AFSK_SPACE_TABLE_LENGTH 48
+#define AFSK_MIN_FRAME_LENGTH 17
+#define AFSK_MAX_FRAME_LENGTH ( AX25_MAX_FRAME_LENGTH + 2 )
+
+// Correlator sums are scaled down before squaring to stay in 32 bits
+#define AFSK_ENERGY_SHIFT 7
+
+// DPLL: 2^32 / samples per bit, pulled 1/4 toward zero on each transition
+#define AFSK_PLL_STEP ( 0x100000000ULL / AFSK_SAMPLES_PER_BIT )
+
+// A bit is taken on the first sample at or past this point, on
+// average half a step past it - so start half a step before mid bit
+#define AFSK_PLL_SAMPLE_POINT ( 0x80000000UL - AFSK_PLL_STEP / 2 )
+
+// One cycle of 1200 Hz is 8 samples, 11 cycles of 2200 Hz are 48 samples
+static const int8_t afskMarkCos[8] = {
+	127, 90, 0, -90, -127, -90, 0, 90,
+};
+
+static const int8_t afskMarkSin[8] = {
+	0, 90, 127, 90, 0, -90, -127, -90,
+};
+
+static const int8_t afskSpaceCos[48] = {
+	127, 17, -123, -49, 110, 77, -90, -101, 63, 117, -33, -126,
+	0, 126, 33, -117, -64, 101, 90, -77, -110, 49, 123, -17,
+	-127, -17, 123, 49, -110, -77, 90, 101, -63, -117, 33, 126,
+	0, -126, -33, 117, 64, -101, -90, 77, 110, -49, -123, 17,
+};
+
+static const int8_t afskSpaceSin[48] = {
+	0, 126, 33, -117, -64, 101, 90, -77, -110, 49, 123, -17,
+	-127, -17, 123, 49, -110, -77, 90, 101, -63, -117, 33, 126,
+	0, -126, -33, 117, 64, -101, -90, 77, 110, -49, -123, 17,
+	127, 17, -123, -49, 110, 77, -90, -101, 63, 117, -33, -126,
+};
+
+// Modulator phase steps, 2^16 per cycle at AFSK_TX_SAMPLE_RATE
+#define AFSK_TX_MARK_STEP 2048
+#define AFSK_TX_SPACE_STEP 3755
+#define AFSK_TX_SAMPLES_PER_BIT ( AFSK_TX_SAMPLE_RATE / AFSK_BAUD )
+
+// One sine cycle, 1 to 255 around 128
+static const uint8_t afskSine[64] = {
+	128, 140, 153, 165, 177, 188, 199, 209, 218, 226, 234, 240, 245, 250, 253, 254,
+	255, 254, 253, 250, 245, 240, 234, 226, 218, 209, 199, 188, 177, 165, 153, 140,
+	128, 116, 103, 91, 79, 68, 57, 47, 38, 30, 22, 16, 11, 6, 3, 2,
+	1, 2, 3, 6, 11, 16, 22, 30, 38, 47, 57, 68, 79, 91, 103, 116,
+};
+
+static void (*AFSK_Frame_Callback)(uint8_t *frame, uint16_t length);
+
+// Demodulator state
+static int32_t dcAverage = 0;
+static int32_t markIProducts[AFSK_SAMPLES_PER_BIT];
+static int32_t markQProducts[AFSK_SAMPLES_PER_BIT];
+static int32_t spaceIProducts[AFSK_SAMPLES_PER_BIT];
+static int32_t spaceQProducts[AFSK_SAMPLES_PER_BIT];
+static int32_t markISum, markQSum, spaceISum, spaceQSum;
+static uint8_t windowIndex = 0;
+static uint8_t spacePhase = 0;
+
+static uint32_t pll = 0;
+static uint8_t lastLevel = 0;
+static uint8_t lastBitLevel = 0;
+
+// HDLC receiver state
+static uint8_t frame[AFSK_MAX_FRAME_LENGTH];
+static uint16_t frameLength = 0;
+static uint8_t frameActive = 0;
+static uint8_t currentByte = 0;
+static uint8_t byteBits = 0;
+static uint8_t hdlcOnes = 0;
+
+// Modulator state
+static const uint8_t *txLine;
+static uint16_t txBits = 0;
+static uint16_t txBit = 0;
+static uint8_t txSample = 0;
+static uint16_t txPhase = 0;
+static uint16_t txStep = AFSK_TX_MARK_STEP;
+
+static uint32_t afskFramesDecoded = 0;
+static uint32_t afskFCSErrors = 0;
+static uint32_t afskSamplesProcessed = 0;
+
+void _AFSK_End_Frame() {
+	if ( frameLength < AFSK_MIN_FRAME_LENGTH ) {
+		return;
+	}
+
+	uint16_t length = frameLength - 2;
+	uint16_t fcs = frame[length] | ( frame[length + 1] << 8 );
+
+	if ( AX25_Compute_FCS( frame, length ) != fcs ) {
+		afskFCSErrors++;
+		return;
+	}
+
+	afskFramesDecoded++;
+	if ( AFSK_Frame_Callback ) {
+		AFSK_Frame_Callback( frame, length );
+	}
+}
+
+void _AFSK_Data_Bit( uint8_t bit ) {
+	if ( ! frameActive ) {
+		return;
+	}
+
+	currentByte = ( currentByte >> 1 ) | ( bit << 7 );
+	byteBits++;
+
+	if ( 8 == byteBits ) {
+		if ( frameLength >= AFSK_MAX_FRAME_LENGTH ) {
+			// Too long to be ours, wait for the next flag
+			frameActive = 0;
+			return;
+		}
+		frame[frameLength] = currentByte;
+		frameLength++;
+		byteBits = 0;
+	}
+}
+
+/*
+ * Takes one NRZI decoded bit
+ * The first seven bits of a closing flag have already gone into
+ * the byte accumulator, so a byte aligned frame ends with 7 bits
+ */
+void _AFSK_HDLC_Bit( uint8_t bit ) {
+	if ( bit ) {
+		hdlcOnes++;
+		if ( hdlcOnes > 6 ) {
+			// Abort or idle channel
+			frameActive = 0;
+			return;
+		}
+		_AFSK_Data_Bit( 1 );
+		return;
+	}
+
+	if ( 6 == hdlcOnes ) {
+		// Flag - closes the frame in progress and opens the next
+		if ( frameActive && ( 7 == byteBits ) ) {
+			_AFSK_End_Frame();
+		}
+		frameActive = 1;
+		frameLength = 0;
+		currentByte = 0;
+		byteBits = 0;
+		hdlcOnes = 0;
+		return;
+	}
+
+	if ( 5 == hdlcOnes ) {
+		// Stuffed zero
+		hdlcOnes = 0;
+		return;
+	}
+
+	hdlcOnes = 0;
+	_AFSK_Data_Bit( 0 );
+}
+
+void _AFSK_Process_Sample( uint16_t sample ) {
+	// Remove DC (ADC bias) - the average is kept with 4 fraction bits
+	dcAverage += ( ( (int32_t) sample << 4 ) - dcAverage ) >> 6;
+	int32_t x = (int32_t) sample - ( dcAverage >> 4 );
+
+	// Slide each correlator window by one sample
+	int32_t product;
+
+	product = x * afskMarkCos[windowIndex];
+	markISum += product - markIProducts[windowIndex];
+	markIProducts[windowIndex] = product;
+
+	product = x * afskMarkSin[windowIndex];
+	markQSum += product - markQProducts[windowIndex];
+	markQProducts[windowIndex] = product;
+
+	product = x * afskSpaceCos[spacePhase];
+	spaceISum += product - spaceIProducts[windowIndex];
+	spaceIProducts[windowIndex] = product;
+
+	product = x * afskSpaceSin[spacePhase];
+	spaceQSum += product - spaceQProducts[windowIndex];
+	spaceQProducts[windowIndex] = product;
+
+	windowIndex++;
+	if ( windowIndex >= AFSK_SAMPLES_PER_BIT ) {
+		windowIndex = 0;
+	}
+	spacePhase++;
+	if ( spacePhase >= AFSK_SPACE_TABLE_LENGTH ) {
+		spacePhase = 0;
+	}
+
+	int32_t mI = markISum >> AFSK_ENERGY_SHIFT;
+	int32_t mQ = markQSum >> AFSK_ENERGY_SHIFT;
+	int32_t sI = spaceISum >> AFSK_ENERGY_SHIFT;
+	int32_t sQ = spaceQSum >> AFSK_ENERGY_SHIFT;
+
+	uint8_t level = ( mI * mI + mQ * mQ ) > ( sI * sI + sQ * sQ );
+
+	// Bit clock recovery - sample as the PLL passes mid bit
+	pll += (uint32_t) AFSK_PLL_STEP;
+
+	if ( (uint32_t) ( pll - AFSK_PLL_SAMPLE_POINT ) < (uint32_t) AFSK_PLL_STEP ) {
+		// NRZI: no change is a one, a change is a zero
+		_AFSK_HDLC_Bit( level == lastBitLevel );
+		lastBitLevel = level;
+	}
+
+	// Transitions should line up with a PLL of zero
+	if ( level != lastLevel ) {
+		int32_t error = (int32_t) pll;
+		pll = (uint32_t) ( error - ( error >> 2 ) );
+		lastLevel = level;
+	}
+
+	afskSamplesProcessed++;
+}
+
+void AFSK_Init() {
+	dcAverage = 2048 << 4;
+	markISum = markQSum = spaceISum = spaceQSum = 0;
+	for ( uint8_t i=0; i < AFSK_SAMPLES_PER_BIT; i++ ) {
+		markIProducts[i] = 0;
+		markQProducts[i] = 0;
+		spaceIProducts[i] = 0;
+		spaceQProducts[i] = 0;
+	}
+	windowIndex = 0;
+	spacePhase = 0;
+	pll = 0;
+	lastLevel = 0;
+	lastBitLevel = 0;
+	frameActive = 0;
+	frameLength = 0;
+	hdlcOnes = 0;
+	afskFramesDecoded = 0;
+	afskFCSErrors = 0;
+	afskSamplesProcessed = 0;
+}
+
+void AFSK_Register_Frame_Callback( void (*callback)(uint8_t *frame, uint16_t length) ) {
+	AFSK_Frame_Callback = callback;
+}
+
+void AFSK_Process_Samples( const uint16_t *samples, uint16_t count ) {
+	for ( uint16_t i=0; i < count; i++ ) {
+		_AFSK_Process_Sample( samples[i] & 0x0FFF );
+	}
+}
+
+void AFSK_Get_Stats( uint32_t *framesDecoded, uint32_t *fcsErrors, uint32_t *samplesProcessed ) {
+	if ( framesDecoded ) {
+		*framesDecoded = afskFramesDecoded;
+	}
+	if ( fcsErrors ) {
+		*fcsErrors = afskFCSErrors;
+	}
+	if ( samplesProcessed ) {
+		*samplesProcessed = afskSamplesProcessed;
+	}
+}
+
+/*
+ * Sets up to send bits of line (LSB of each byte first), starting
+ * on the mark tone - AFSK_Modulate then produces the samples
+ */
+void AFSK_Start_Modulator( const uint8_t *line, uint16_t bits ) {
+	txLine = line;
+	txBits = bits;
+	txBit = 0;
+	txSample = 0;
+	txPhase = 0;
+	txStep = AFSK_TX_MARK_STEP;
+}
+
+/*
+ * Writes the next output level (1 to 255, 128 is zero)
+ * Returns 0 once the line has been sent
+ */
+uint8_t AFSK_Modulate( uint8_t *level ) {
+	if ( 0 == txSample ) {
+		if ( txBit >= txBits ) {
+			return 0;
+		}
+
+		// NRZI - a zero switches tones, a one keeps the tone
+		if ( 0 == ( ( txLine[txBit >> 3] >> ( txBit & 0x7 ) ) & 0x01 ) ) {
+			txStep = ( AFSK_TX_MARK_STEP == txStep ) ? AFSK_TX_SPACE_STEP : AFSK_TX_MARK_STEP;
+		}
+		txBit++;
+	}
+
+	*level = afskSine[txPhase >> 10];
+	txPhase += txStep;
+
+	txSample++;
+	if ( txSample >= AFSK_TX_SAMPLES_PER_BIT ) {
+		txSample = 0;
+	}
+
+	return 1;
+}
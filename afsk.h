@@ -0,0 +1,33 @@
+// Bell 202 AFSK 1200 baud demodulator and HDLC receiver, and the
+// matching modulator
+//
+// Plain C with no register access, so the same code runs on the
+// TM4C123 (fed by adc-audio.c, feeding pwm-i2c.c) and on a PC
+// against recordings
+//
+// Receive input: unsigned 12-bit audio samples at AFSK_SAMPLE_RATE
+// Receive output: AX.25 frames with a good FCS (FCS stripped)
+// Transmit input: an on air bit stream from AX25_Encode_Line
+// Transmit output: 8-bit levels at AFSK_TX_SAMPLE_RATE
+
+#ifndef __AFSK_H
+#define __AFSK_H
+
+#include "stdint.h"
+
+#define AFSK_SAMPLE_RATE 9600
+#define AFSK_BAUD 1200
+#define AFSK_SAMPLES_PER_BIT ( AFSK_SAMPLE_RATE / AFSK_BAUD )
+
+// 32 levels a bit - the PWM carrier sits well above the audio
+#define AFSK_TX_SAMPLE_RATE ( AFSK_BAUD * 32 )
+
+void AFSK_Init();
+void AFSK_Register_Frame_Callback( void (*callback)(uint8_t *frame, uint16_t length) );
+void AFSK_Process_Samples( const uint16_t *samples, uint16_t count );
+void AFSK_Get_Stats( uint32_t *framesDecoded, uint32_t *fcsErrors, uint32_t *samplesProcessed );
+
+void AFSK_Start_Modulator( const uint8_t *line, uint16_t bits );
+uint8_t AFSK_Modulate( uint8_t *level );
+
+#endif // __AFSK_H
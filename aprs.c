@@ -0,0 +1,412 @@
+// APRS weather reports for the TM4C123-WX station
+//
+// Positioned report with timestamp (APRS 1.01 ch. 12):
+//   @DDHHMMzDDMM.hhN/DDDMM.hhW_.../...g...t072
+// Positionless report:
+//   _MMDDHHMMc...s...g...t072
+//
+// Compressed positioned report with Base91 telemetry (ch. 9, 13):
+//   @DDHHMMz/YYYYXXXX_  !g...t072|ss112233|
+//
+// Wind speed is the last minute's mean and the gust the fastest
+// three seconds of the last five minutes (wind-rain.c). Without a
+// wind vane the direction stays "...", and the compressed report
+// leaves its course/speed bytes blank, so only carries the gust.
+
+#include "aprs.h"
+#include "ax25.h"
+#include "gps.h"
+#include "ds18b20.h"
+#include "rda1846.h"
+#include "tdma.h"
+#include "format.h"
+#include "history.h"
+#include "wind-rain.h"
+#include "adc-supply.h"
+
+#define APRS_MAX_INFO_LENGTH 48
+#define APRS_FIELD_UNKNOWN 0xFFFF
+#define APRS_TEMPERATURE_UNKNOWN -9999
+
+#define APRS_POSITIONED_TEMPLATE "@000000z0000.00N/00000.00W_.../...g...t..."
+#define APRS_POSITIONED_DAY 1
+#define APRS_POSITIONED_HOUR 3
+#define APRS_POSITIONED_MINUTE 5
+#define APRS_POSITIONED_LAT_DEGREES 8
+#define APRS_POSITIONED_LAT_MINUTES 10
+#define APRS_POSITIONED_LAT_HUNDREDTHS 13
+#define APRS_POSITIONED_LAT_HEMISPHERE 15
+#define APRS_POSITIONED_LONG_DEGREES 17
+#define APRS_POSITIONED_LONG_MINUTES 20
+#define APRS_POSITIONED_LONG_HUNDREDTHS 23
+#define APRS_POSITIONED_LONG_HEMISPHERE 25
+#define APRS_POSITIONED_WIND_SPEED 31
+#define APRS_POSITIONED_GUST 35
+#define APRS_POSITIONED_TEMPERATURE 39
+
+#define APRS_POSITIONLESS_TEMPLATE "_00000000c...s...g...t..."
+#define APRS_POSITIONLESS_MONTH 1
+#define APRS_POSITIONLESS_DAY 3
+#define APRS_POSITIONLESS_HOUR 5
+#define APRS_POSITIONLESS_MINUTE 7
+#define APRS_POSITIONLESS_WIND_SPEED 14
+#define APRS_POSITIONLESS_GUST 18
+#define APRS_POSITIONLESS_TEMPERATURE 22
+
+#define APRS_COMPRESSED_TEMPLATE "@000000z/!!!!!!!!_  !g...t...|!!!!!!!!|"
+#define APRS_COMPRESSED_DAY 1
+#define APRS_COMPRESSED_HOUR 3
+#define APRS_COMPRESSED_MINUTE 5
+#define APRS_COMPRESSED_LATITUDE 9
+#define APRS_COMPRESSED_LONGITUDE 13
+#define APRS_COMPRESSED_GUST 22
+#define APRS_COMPRESSED_TEMPERATURE 26
+#define APRS_COMPRESSED_SEQUENCE 30
+#define APRS_COMPRESSED_CHANNELS 32
+
+// Telemetry channel 1 carries degrees F + 100 (EQNS 0,1,-100),
+// 2 and 3 the battery and solar volts (EQNS 0,0.01,0)
+#define APRS_TELEMETRY_CHANNELS 3
+#define APRS_TELEMETRY_TEMPERATURE_OFFSET 100
+#define APRS_TELEMETRY_MV_PER_COUNT 10
+#define APRS_TELEMETRY_MAX_VALUE 8280
+
+// 380926 / 6000 and 190463 / 6000 rounded up in 28.36 fixed point,
+// for positions in hundredths of a minute - exact over the whole globe
+#define APRS_LATITUDE_SCALE 4362839232523ULL
+#define APRS_LONGITUDE_SCALE 2181419616262ULL
+#define APRS_SCALE_SHIFT 36
+
+#define APRS_GUST_MINUTES 5
+
+#define APRS_BAUD 1200
+
+typedef struct APRS_Templates {
+	uint8_t frame[AX25_MAX_HEADER_LENGTH + APRS_MAX_INFO_LENGTH];
+	char *info;
+	uint16_t length;
+
+	// Last values patched in, so unchanged fields are left alone
+	uint16_t month;
+	uint16_t day;
+	uint16_t hour;
+	uint16_t minute;
+	uint32_t latitude;
+	uint32_t longitude;
+	char latHemisphere;
+	char longHemisphere;
+	int16_t temperature;
+	uint16_t windSpeed;
+	uint16_t gust;
+} APRS_Template;
+
+static APRS_Template positioned;
+static APRS_Template positionless;
+static APRS_Template compressed;
+
+static uint8_t aprsCompressed = 1;
+static uint16_t telemetrySequence = 0;
+
+// Bytes on air and transmit time of the last report in each mode
+static uint16_t airtimeBytes[2];
+static uint16_t airtimeMilliseconds[2];
+
+/*
+ * APRS temperature is three characters, e.g. "072", "-05", "..."
+ */
+void _APRS_Put_Temperature( char *dest, int16_t degreesF ) {
+	if ( APRS_TEMPERATURE_UNKNOWN == degreesF ) {
+		dest[0] = '.';
+		dest[1] = '.';
+		dest[2] = '.';
+	} else {
+		if ( degreesF < -99 ) {
+			degreesF = -99;
+		} else if ( degreesF > 999 ) {
+			degreesF = 999;
+		}
+		Format_Signed( dest, degreesF, 3, '0' );
+	}
+}
+
+void _APRS_Init_Template( APRS_Template *template, char *text ) {
+	uint16_t headerLength = AX25_Encode_Header( template->frame, APRS_DESTINATION, APRS_CALLSIGN, APRS_PATH );
+
+	template->info = (char *) &template->frame[headerLength];
+	template->length = headerLength;
+	while ( *text ) {
+		template->frame[template->length] = *text;
+		template->length++;
+		text++;
+	}
+
+	template->month = APRS_FIELD_UNKNOWN;
+	template->day = APRS_FIELD_UNKNOWN;
+	template->hour = APRS_FIELD_UNKNOWN;
+	template->minute = APRS_FIELD_UNKNOWN;
+	template->latitude = 0xFFFFFFFF;
+	template->longitude = 0xFFFFFFFF;
+	template->latHemisphere = 0;
+	template->longHemisphere = 0;
+	template->temperature = APRS_TEMPERATURE_UNKNOWN;
+	template->windSpeed = APRS_FIELD_UNKNOWN;
+	template->gust = APRS_FIELD_UNKNOWN;
+}
+
+/*
+ * Patches a decimal field only if it changed since the last report
+ */
+void _APRS_Patch_Field( char *dest, uint16_t *last, uint16_t value, uint8_t width ) {
+	if ( *last != value ) {
+		Format_Unsigned( dest, value, width, '0' );
+		*last = value;
+	}
+}
+
+/*
+ * Reports the last minute's mean temperature, so one noisy
+ * reading doesn't go out on the air
+ */
+void _APRS_Patch_Temperature( APRS_Template *template, uint8_t offset ) {
+	int16_t temperature = APRS_TEMPERATURE_UNKNOWN;
+	History_Stats minute;
+	if ( History_Get_Stats( HISTORY_TEMPERATURE, HISTORY_1_MINUTE, GPS_Get_Seconds(), &minute ) ) {
+		temperature = minute.mean;
+	} else if ( DS18B20_Data_Valid() ) {
+		temperature = DS18B20_Get_Temperature_F();
+	}
+
+	if ( template->temperature != temperature ) {
+		_APRS_Put_Temperature( &template->info[offset], temperature );
+		template->temperature = temperature;
+	}
+}
+
+/*
+ * Wind in whole mph for the three character fields
+ */
+uint16_t _APRS_Wind_MPH( uint16_t tenths ) {
+	uint16_t mph = ( tenths + 5 ) / 10;
+	return ( mph > 999 ) ? 999 : mph;
+}
+
+void APRS_Init() {
+	_APRS_Init_Template( &positioned, APRS_POSITIONED_TEMPLATE );
+	_APRS_Init_Template( &positionless, APRS_POSITIONLESS_TEMPLATE );
+	_APRS_Init_Template( &compressed, APRS_COMPRESSED_TEMPLATE );
+}
+
+/*
+ * Chooses between compressed (Base91) and plain text reports
+ */
+void APRS_Set_Compressed( uint8_t on ) {
+	aprsCompressed = on ? 1 : 0;
+}
+
+/*
+ * Bytes on air (frame + FCS + flags, after stuffing) and transmit
+ * time of the last report sent compressed (1) or uncompressed (0)
+ */
+void APRS_Get_Airtime( uint8_t compressed, uint16_t *bytes, uint16_t *milliseconds ) {
+	compressed = compressed ? 1 : 0;
+	if ( bytes ) {
+		*bytes = airtimeBytes[compressed];
+	}
+	if ( milliseconds ) {
+		*milliseconds = airtimeMilliseconds[compressed];
+	}
+}
+
+/*
+ * Brings the positioned (@...z...) report up to date
+ * Returns the frame length (without FCS) and points frame at it
+ */
+uint16_t APRS_Build_Positioned_Report( uint8_t **frame ) {
+	APRS_Template *template = &positioned;
+	char *info = template->info;
+
+	uint16_t year;
+	uint8_t month, day, hour, minute;
+	uint8_t latDeg, latMin, latHundredths, longDeg, longMin, longHundredths;
+	char latHem, longHem;
+
+	GPS_Get_Date( &year, &month, &day );
+	GPS_Get_Time( &hour, &minute, 0 );
+	GPS_Get_Latitude( &latDeg, &latMin, 0, &latHem );
+	GPS_Get_Longitude( &longDeg, &longMin, 0, &longHem );
+	GPS_Get_Position_Hundredths( &latHundredths, &longHundredths );
+
+	_APRS_Patch_Field( &info[APRS_POSITIONED_DAY], &template->day, day, 2 );
+	_APRS_Patch_Field( &info[APRS_POSITIONED_HOUR], &template->hour, hour, 2 );
+	_APRS_Patch_Field( &info[APRS_POSITIONED_MINUTE], &template->minute, minute, 2 );
+
+	// Positions in hundredths of a minute for the comparison
+	uint32_t latitude = ( latDeg * 60 + latMin ) * 100 + latHundredths;
+	if ( template->latitude != latitude ) {
+		Format_Unsigned( &info[APRS_POSITIONED_LAT_DEGREES], latDeg, 2, '0' );
+		Format_Unsigned( &info[APRS_POSITIONED_LAT_MINUTES], latMin, 2, '0' );
+		Format_Unsigned( &info[APRS_POSITIONED_LAT_HUNDREDTHS], latHundredths, 2, '0' );
+		template->latitude = latitude;
+	}
+
+	uint32_t longitude = ( longDeg * 60 + longMin ) * 100 + longHundredths;
+	if ( template->longitude != longitude ) {
+		Format_Unsigned( &info[APRS_POSITIONED_LONG_DEGREES], longDeg, 3, '0' );
+		Format_Unsigned( &info[APRS_POSITIONED_LONG_MINUTES], longMin, 2, '0' );
+		Format_Unsigned( &info[APRS_POSITIONED_LONG_HUNDREDTHS], longHundredths, 2, '0' );
+		template->longitude = longitude;
+	}
+
+	if ( template->latHemisphere != latHem ) {
+		info[APRS_POSITIONED_LAT_HEMISPHERE] = latHem;
+		template->latHemisphere = latHem;
+	}
+	if ( template->longHemisphere != longHem ) {
+		info[APRS_POSITIONED_LONG_HEMISPHERE] = longHem;
+		template->longHemisphere = longHem;
+	}
+
+	_APRS_Patch_Field( &info[APRS_POSITIONED_WIND_SPEED], &template->windSpeed, _APRS_Wind_MPH( Wind_Rain_Get_Speed( WIND_RAIN_SPEED_SECONDS ) ), 3 );
+	_APRS_Patch_Field( &info[APRS_POSITIONED_GUST], &template->gust, _APRS_Wind_MPH( Wind_Rain_Get_Gust( APRS_GUST_MINUTES ) ), 3 );
+	_APRS_Patch_Temperature( template, APRS_POSITIONED_TEMPERATURE );
+
+	*frame = template->frame;
+	return template->length;
+}
+
+/*
+ * Brings the positionless (_MMDDHHMM...) report up to date
+ * Returns the frame length (without FCS) and points frame at it
+ */
+uint16_t APRS_Build_Positionless_Report( uint8_t **frame ) {
+	APRS_Template *template = &positionless;
+	char *info = template->info;
+
+	uint16_t year;
+	uint8_t month, day, hour, minute;
+
+	GPS_Get_Date( &year, &month, &day );
+	GPS_Get_Time( &hour, &minute, 0 );
+
+	_APRS_Patch_Field( &info[APRS_POSITIONLESS_MONTH], &template->month, month, 2 );
+	_APRS_Patch_Field( &info[APRS_POSITIONLESS_DAY], &template->day, day, 2 );
+	_APRS_Patch_Field( &info[APRS_POSITIONLESS_HOUR], &template->hour, hour, 2 );
+	_APRS_Patch_Field( &info[APRS_POSITIONLESS_MINUTE], &template->minute, minute, 2 );
+
+	_APRS_Patch_Field( &info[APRS_POSITIONLESS_WIND_SPEED], &template->windSpeed, _APRS_Wind_MPH( Wind_Rain_Get_Speed( WIND_RAIN_SPEED_SECONDS ) ), 3 );
+	_APRS_Patch_Field( &info[APRS_POSITIONLESS_GUST], &template->gust, _APRS_Wind_MPH( Wind_Rain_Get_Gust( APRS_GUST_MINUTES ) ), 3 );
+	_APRS_Patch_Temperature( template, APRS_POSITIONLESS_TEMPERATURE );
+
+	*frame = template->frame;
+	return template->length;
+}
+
+/*
+ * Brings the compressed (@...z/YYYYXXXX_...|ss11|) report up to date
+ * Returns the frame length (without FCS) and points frame at it
+ */
+uint16_t APRS_Build_Compressed_Report( uint8_t **frame ) {
+	APRS_Template *template = &compressed;
+	char *info = template->info;
+
+	uint16_t year;
+	uint8_t month, day, hour, minute;
+	uint8_t latDeg, latMin, latHundredths, longDeg, longMin, longHundredths;
+	char latHem, longHem;
+
+	GPS_Get_Date( &year, &month, &day );
+	GPS_Get_Time( &hour, &minute, 0 );
+	GPS_Get_Latitude( &latDeg, &latMin, 0, &latHem );
+	GPS_Get_Longitude( &longDeg, &longMin, 0, &longHem );
+	GPS_Get_Position_Hundredths( &latHundredths, &longHundredths );
+
+	_APRS_Patch_Field( &info[APRS_COMPRESSED_DAY], &template->day, day, 2 );
+	_APRS_Patch_Field( &info[APRS_COMPRESSED_HOUR], &template->hour, hour, 2 );
+	_APRS_Patch_Field( &info[APRS_COMPRESSED_MINUTE], &template->minute, minute, 2 );
+
+	// Hundredths of a minute, north and east positive
+	uint32_t latitude = ( latDeg * 60 + latMin ) * 100 + latHundredths;
+	uint32_t longitude = ( longDeg * 60 + longMin ) * 100 + longHundredths;
+
+	if ( ( template->latitude != latitude ) || ( template->latHemisphere != latHem ) ) {
+		// y = 380926 * ( 90 - lat )
+		uint32_t fromNorthPole = ( 'S' == latHem ) ? 540000 + latitude : 540000 - latitude;
+		uint32_t y = (uint32_t) ( ( fromNorthPole * APRS_LATITUDE_SCALE ) >> APRS_SCALE_SHIFT );
+		Format_Base91( &info[APRS_COMPRESSED_LATITUDE], y, 4 );
+		template->latitude = latitude;
+		template->latHemisphere = latHem;
+	}
+
+	if ( ( template->longitude != longitude ) || ( template->longHemisphere != longHem ) ) {
+		// x = 190463 * ( 180 + long )
+		uint32_t fromDateLine = ( 'W' == longHem ) ? 1080000 - longitude : 1080000 + longitude;
+		uint32_t x = (uint32_t) ( ( fromDateLine * APRS_LONGITUDE_SCALE ) >> APRS_SCALE_SHIFT );
+		Format_Base91( &info[APRS_COMPRESSED_LONGITUDE], x, 4 );
+		template->longitude = longitude;
+		template->longHemisphere = longHem;
+	}
+
+	_APRS_Patch_Field( &info[APRS_COMPRESSED_GUST], &template->gust, _APRS_Wind_MPH( Wind_Rain_Get_Gust( APRS_GUST_MINUTES ) ), 3 );
+	_APRS_Patch_Temperature( template, APRS_COMPRESSED_TEMPERATURE );
+
+	// Base91 telemetry - always changes, sequence counts 0 to 8280
+	// and moves on once the report is queued
+	Format_Base91( &info[APRS_COMPRESSED_SEQUENCE], telemetrySequence, 2 );
+
+	uint16_t channels[APRS_TELEMETRY_CHANNELS];
+	channels[0] = 0;
+	if ( APRS_TEMPERATURE_UNKNOWN != template->temperature ) {
+		int16_t value = template->temperature + APRS_TELEMETRY_TEMPERATURE_OFFSET;
+		channels[0] = ( value < 0 ) ? 0 : value;
+	}
+	channels[1] = ( ADC_Supply_Get_Battery_MV() + APRS_TELEMETRY_MV_PER_COUNT / 2 ) / APRS_TELEMETRY_MV_PER_COUNT;
+	channels[2] = ( ADC_Supply_Get_Solar_MV() + APRS_TELEMETRY_MV_PER_COUNT / 2 ) / APRS_TELEMETRY_MV_PER_COUNT;
+
+	for ( uint8_t i=0; i < APRS_TELEMETRY_CHANNELS; i++ ) {
+		if ( channels[i] > APRS_TELEMETRY_MAX_VALUE ) {
+			channels[i] = APRS_TELEMETRY_MAX_VALUE;
+		}
+		Format_Base91( &info[APRS_COMPRESSED_CHANNELS + 2 * i], channels[i], 2 );
+	}
+
+	*frame = template->frame;
+	return template->length;
+}
+
+/*
+ * Hands the current weather report to the radio
+ * Returns 0 if there was nothing worth sending (no GPS time yet)
+ * or the transmit queue is full
+ */
+uint8_t APRS_Send_Weather_Report() {
+	uint8_t *frame;
+	uint16_t length;
+
+	if ( ! GPS_Data_Valid() ) {
+		return 0;
+	}
+
+	if ( aprsCompressed ) {
+		length = APRS_Build_Compressed_Report( &frame );
+	} else {
+		length = APRS_Build_Positioned_Report( &frame );
+	}
+
+	uint16_t bits = RDA1846_Get_Airtime_Bits( frame, length );
+
+	airtimeBytes[aprsCompressed] = ( bits + 7 ) >> 3;
+	airtimeMilliseconds[aprsCompressed] = ( (uint32_t) bits * 1000 ) / APRS_BAUD;
+
+	if ( ! TDMA_Send_Packet( frame, length ) ) {
+		return 0;
+	}
+
+	if ( aprsCompressed ) {
+		telemetrySequence++;
+		if ( telemetrySequence > APRS_TELEMETRY_MAX_VALUE ) {
+			telemetrySequence = 0;
+		}
+	}
+
+	return 1;
+}
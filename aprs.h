@@ -0,0 +1,27 @@
+// APRS weather reports for the TM4C123-WX station
+//
+// The AX.25 header and the report text are rendered once into
+// a frame template; each report only patches the fixed width
+// fields (time, position, temperature) that changed
+//
+// Reports are sent compressed (Base91 position and telemetry)
+// by default to keep airtime on the shared channel down
+
+#ifndef __APRS_H
+#define __APRS_H
+
+#include "stdint.h"
+
+#define APRS_CALLSIGN "N0CALL-13"
+#define APRS_DESTINATION "APRS"
+#define APRS_PATH "WIDE2-1"
+
+void APRS_Init();
+uint16_t APRS_Build_Positioned_Report( uint8_t **frame );
+uint16_t APRS_Build_Positionless_Report( uint8_t **frame );
+uint16_t APRS_Build_Compressed_Report( uint8_t **frame );
+void APRS_Set_Compressed( uint8_t on );
+void APRS_Get_Airtime( uint8_t compressed, uint16_t *bytes, uint16_t *milliseconds );
+uint8_t APRS_Send_Weather_Report();
+
+#endif // __APRS_H
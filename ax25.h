@@ -0,0 +1,40 @@
+// AX.25 UI frame encoder for packet radio
+//
+// Builds the address / control / PID header once, appends the
+// CRC-16-CCITT frame check sequence and produces the HDLC bit
+// stream (flags, bit stuffing) that the modulator sends on air
+//
+// Bits in the line buffer are packed LSB first, in the order they
+// are sent. NRZI is left to the modulator.
+
+#ifndef __AX25_H
+#define __AX25_H
+
+#include "stdint.h"
+
+#define AX25_ADDRESS_LENGTH 7
+#define AX25_MAX_DIGIPEATERS 8
+#define AX25_MAX_HEADER_LENGTH ( AX25_ADDRESS_LENGTH * ( 2 + AX25_MAX_DIGIPEATERS ) + 2 )
+#define AX25_MAX_INFO_LENGTH 256
+#define AX25_MAX_FRAME_LENGTH ( AX25_MAX_HEADER_LENGTH + AX25_MAX_INFO_LENGTH )
+
+#define AX25_FLAG 0x7E
+#define AX25_CONTROL_UI 0x03
+#define AX25_PID_NO_LAYER_3 0xF0
+
+// Worst case: every fifth bit stuffed, plus the FCS and the flags
+#define AX25_MAX_PREAMBLE_FLAGS 32
+#define AX25_MAX_LINE_LENGTH ( ( ( AX25_MAX_FRAME_LENGTH + 2 ) * 6 ) / 5 + AX25_MAX_PREAMBLE_FLAGS + 2 )
+
+#define AX25_SSID_MASK 0x1E
+#define AX25_H_BIT 0x80
+#define AX25_LAST_ADDRESS_BIT 0x01
+
+uint8_t AX25_Encode_Address( uint8_t *field, char *text );
+uint16_t AX25_Encode_Header( uint8_t *frame, char *destination, char *source, char *path );
+uint16_t AX25_Update_CRC( uint16_t crc, const uint8_t *data, uint16_t length );
+uint16_t AX25_Compute_FCS( uint8_t *data, uint16_t length );
+uint16_t AX25_Count_Stuffed_Bits( uint8_t *frame, uint16_t length );
+uint16_t AX25_Encode_Line( uint8_t *frame, uint16_t length, uint8_t preambleFlags, uint8_t *line, uint16_t maxLine );
+
+#endif // __AX25_H
@@ -0,0 +1,310 @@
+// Cycle counts for the station's hot paths
+//
+// Every benchmark runs the same canned NMEA sentences and the same
+// pseudo-random bytes (from a fixed seed) on every build, so the
+// minimum of a path only moves when the code does. Device
+// interrupts are held off with BASEPRI while the benchmarks run -
+// the OneWire and I2C queues arm their timers as they would in
+// service, but the handlers never start on the bus, and the
+// drivers throw the queued work away once they have been timed.
+// The LCD's bytes do go out, as text the start up clears again.
+
+#include "bench.h"
+#include "gps.h"
+#include "ds18b20.h"
+#include "onewire.h"
+#include "pwm-i2c.h"
+#include "lcd.h"
+#include "format.h"
+#include "profile.h"
+#include "intrinsics.h"
+
+// Holds off every handler at priority 1 and below
+#define BENCH_BASEPRI 0x20
+
+#define BENCH_SEED 0x2545F491
+
+// Queued benchmarks start over from an empty queue this often, so
+// the minimum is an append to a running queue and the maximum one
+// that also starts it
+#define BENCH_QUEUE_BATCH 8
+
+// As many calls of a batch as fit in a queue between restarts
+#define BENCH_QUEUE_CALLS ( ( BENCH_BATCH < BENCH_QUEUE_BATCH ) ? BENCH_BATCH : BENCH_QUEUE_BATCH )
+
+#define BENCH_OVERHEAD_SAMPLES 16
+
+#define BENCH_GPS_LINES 4
+
+#ifdef BENCH_ENABLED
+
+// The parser's insides, which gps.h doesn't need to show
+void GPS_ProcessLine( char *data );
+uint8_t _GPS_Value_From_Scratchpad_Entry( uint8_t entry, uint8_t offset, uint8_t length );
+
+static char gpsLines[BENCH_GPS_LINES][67] = {
+	"$GPRMC,172814.00,A,4740.51234,N,12219.84321,W,0.012,,230220,,,A*6A",
+	"$GPRMC,235959.00,A,0107.00917,S,07745.98410,E,1.204,,311219,,,A*6E",
+	"$GPRMC,000000.00,V,,,,,,,010120,,,N*7F",
+	"$GPRMC,120130.00,A,6012.99999,N,17959.00001,W,12.50,,150620,,,D*6E"
+};
+
+// The fields GPS_ProcessLine pulls out: entry, offset, length
+static const uint8_t scratchpadFields[][3] = {
+	{ 9, 4, 2 }, { 9, 2, 2 }, { 9, 0, 2 },
+	{ 1, 0, 2 }, { 1, 2, 2 }, { 1, 4, 2 },
+	{ 3, 0, 2 }, { 3, 2, 2 }, { 3, 5, 2 },
+	{ 5, 0, 3 }, { 5, 3, 2 }, { 5, 6, 2 }
+};
+
+static Bench_Result results[BENCHES];
+static uint8_t benchRun = 0;
+static uint32_t overhead = 0;
+static uint32_t seed = BENCH_SEED;
+
+static char line1[LCD_COLUMNS + 1];
+static char line2[LCD_COLUMNS + 1];
+
+/*
+ * Next pseudo-random number (xorshift32)
+ */
+uint32_t _Bench_Random() {
+	seed ^= seed << 13;
+	seed ^= seed >> 17;
+	seed ^= seed << 5;
+	return seed;
+}
+
+/*
+ * Adds the cycles since start, over calls calls, to a result
+ */
+void _Bench_Add( Bench_Result *result, uint32_t start, uint16_t calls ) {
+	uint32_t elapsed = Profile_Get_Cycles() - start;
+
+	elapsed = ( elapsed > overhead ) ? elapsed - overhead : 0;
+	elapsed = ( elapsed + calls / 2 ) / calls;
+	if ( elapsed < result->minimum ) {
+		result->minimum = elapsed;
+	}
+	if ( elapsed > result->maximum ) {
+		result->maximum = elapsed;
+	}
+	result->total += elapsed;
+	result->iterations++;
+}
+
+/*
+ * The two display lines the tick shows with a fix, from random
+ * values: MM/DD/YYYY HH:MM and DD H DDD H TTT F
+ */
+void _Bench_Format_Lines( uint32_t value ) {
+	Format_Unsigned( &line1[0], 1 + value % 12, 2, '0' );
+	line1[2] = '/';
+	Format_Unsigned( &line1[3], 1 + ( value >> 4 ) % 28, 2, '0' );
+	line1[5] = '/';
+	Format_Unsigned( &line1[6], 2020 + ( value >> 9 ) % 10, 4, '0' );
+	line1[10] = ' ';
+	Format_Unsigned( &line1[11], ( value >> 13 ) % 24, 2, '0' );
+	line1[13] = ':';
+	Format_Unsigned( &line1[14], ( value >> 18 ) % 60, 2, '0' );
+	line1[16] = 0;
+
+	Format_Unsigned( &line2[0], ( value >> 7 ) % 90, 2, '0' );
+	line2[2] = ' ';
+	line2[3] = ( value & 0x01 ) ? 'N' : 'S';
+	line2[4] = ' ';
+	Format_Unsigned( &line2[5], ( value >> 11 ) % 180, 3, '0' );
+	line2[8] = ' ';
+	line2[9] = ( value & 0x02 ) ? 'E' : 'W';
+	line2[10] = ' ';
+	Format_Signed( &line2[11], (int32_t) ( ( value >> 24 ) % 150 ) - 40, 3, ' ' );
+	Format_String( &line2[14], " F", 2 );
+	line2[16] = 0;
+}
+
+void _Bench_OneWire_Callback( uint8_t data ) {
+}
+
+void _Bench_GPS_Process_Line( Bench_Result *result, uint16_t iteration ) {
+	uint32_t start = Profile_Get_Cycles();
+	for ( uint16_t i=0; i < BENCH_BATCH; i++ ) {
+		GPS_ProcessLine( gpsLines[( iteration + i ) % BENCH_GPS_LINES] );
+	}
+	_Bench_Add( result, start, BENCH_BATCH );
+}
+
+void _Bench_GPS_Scratchpad_Value( Bench_Result *result, uint16_t iteration ) {
+	const uint8_t fields = sizeof( scratchpadFields ) / sizeof( scratchpadFields[0] );
+
+	if ( 0 == iteration ) {
+		// Something to pick apart
+		GPS_ProcessLine( gpsLines[0] );
+	}
+
+	uint32_t start = Profile_Get_Cycles();
+	for ( uint16_t i=0; i < BENCH_BATCH; i++ ) {
+		const uint8_t *field = scratchpadFields[( iteration + i ) % fields];
+		_GPS_Value_From_Scratchpad_Entry( field[0], field[1], field[2] );
+	}
+	_Bench_Add( result, start, BENCH_BATCH );
+}
+
+void _Bench_DS18B20_Temperature( Bench_Result *result, uint16_t iteration ) {
+	uint32_t start = Profile_Get_Cycles();
+	for ( uint16_t i=0; i < BENCH_BATCH; i++ ) {
+		DS18B20_Get_Temperature_F();
+	}
+	_Bench_Add( result, start, BENCH_BATCH );
+}
+
+void _Bench_OneWire_Write_Byte( Bench_Result *result, uint16_t iteration ) {
+	uint8_t data[BENCH_QUEUE_CALLS];
+
+	for ( uint16_t i=0; i < BENCH_QUEUE_CALLS; i++ ) {
+		data[i] = _Bench_Random() & 0xFF;
+	}
+	if ( 0 == ( iteration * BENCH_QUEUE_CALLS ) % BENCH_QUEUE_BATCH ) {
+		OneWire_Bench_Reset();
+	}
+
+	uint32_t start = Profile_Get_Cycles();
+	for ( uint16_t i=0; i < BENCH_QUEUE_CALLS; i++ ) {
+		OneWire_WriteByte( data[i] );
+	}
+	_Bench_Add( result, start, BENCH_QUEUE_CALLS );
+}
+
+void _Bench_OneWire_Read_Byte( Bench_Result *result, uint16_t iteration ) {
+	if ( 0 == ( iteration * BENCH_QUEUE_CALLS ) % BENCH_QUEUE_BATCH ) {
+		OneWire_Bench_Reset();
+	}
+
+	uint32_t start = Profile_Get_Cycles();
+	for ( uint16_t i=0; i < BENCH_QUEUE_CALLS; i++ ) {
+		OneWire_ReadByte( _Bench_OneWire_Callback );
+	}
+	_Bench_Add( result, start, BENCH_QUEUE_CALLS );
+}
+
+void _Bench_I2C_Queue_Command( Bench_Result *result, uint16_t iteration ) {
+	uint32_t values[BENCH_QUEUE_CALLS];
+
+	for ( uint16_t i=0; i < BENCH_QUEUE_CALLS; i++ ) {
+		values[i] = _Bench_Random();
+	}
+	if ( 0 == ( iteration * BENCH_QUEUE_CALLS ) % BENCH_QUEUE_BATCH ) {
+		PWM_I2C_Bench_Reset();
+	}
+
+	uint32_t start = Profile_Get_Cycles();
+	for ( uint16_t i=0; i < BENCH_QUEUE_CALLS; i++ ) {
+		PWM_I2C_Queue_Command( values[i] & 0x7F, values[i] >> 16, 0xFFFF, 0 );
+	}
+	_Bench_Add( result, start, BENCH_QUEUE_CALLS );
+}
+
+/*
+ * One call a sample whatever the batch - an update's bytes have to
+ * go out before the next would fit in the LCD's ring
+ */
+void _Bench_LCD_Write( Bench_Result *result, uint16_t iteration ) {
+	_Bench_Format_Lines( _Bench_Random() );
+
+	uint32_t start = Profile_Get_Cycles();
+	LCD_Write( line1, line2 );
+	_Bench_Add( result, start, 1 );
+
+	LCD_Bench_Reset();
+}
+
+void _Bench_LCD_Format( Bench_Result *result, uint16_t iteration ) {
+	uint32_t values[BENCH_BATCH];
+
+	for ( uint16_t i=0; i < BENCH_BATCH; i++ ) {
+		values[i] = _Bench_Random();
+	}
+
+	uint32_t start = Profile_Get_Cycles();
+	for ( uint16_t i=0; i < BENCH_BATCH; i++ ) {
+		_Bench_Format_Lines( values[i] );
+	}
+	_Bench_Add( result, start, BENCH_BATCH );
+}
+
+static void (* const benches[BENCHES])( Bench_Result *result, uint16_t iteration ) = {
+	_Bench_GPS_Process_Line,
+	_Bench_GPS_Scratchpad_Value,
+	_Bench_DS18B20_Temperature,
+	_Bench_OneWire_Write_Byte,
+	_Bench_OneWire_Read_Byte,
+	_Bench_I2C_Queue_Command,
+	_Bench_LCD_Write,
+	_Bench_LCD_Format
+};
+
+/*
+ * Times every benchmark - call once, after LCD_Init and before
+ * the OneWire, I2C and GPS drivers are started
+ */
+void Bench_Run() {
+	Profile_Enable_Cycle_Counter();
+
+	uint32_t basePriority = __get_BASEPRI();
+	__set_BASEPRI( BENCH_BASEPRI );
+
+	// What reading the counter and adding up costs by itself
+	Bench_Result empty = { 0, 0xFFFFFFFF, 0, 0 };
+	overhead = 0;
+	for ( uint8_t i=0; i < BENCH_OVERHEAD_SAMPLES; i++ ) {
+		uint32_t start = Profile_Get_Cycles();
+		_Bench_Add( &empty, start, 1 );
+	}
+	overhead = empty.minimum;
+
+	for ( uint8_t bench=0; bench < BENCHES; bench++ ) {
+		Bench_Result *result = &results[bench];
+		result->iterations = 0;
+		result->minimum = 0xFFFFFFFF;
+		result->maximum = 0;
+		result->total = 0;
+
+		seed = BENCH_SEED;
+		for ( uint16_t iteration=0; iteration < BENCH_ITERATIONS; iteration++ ) {
+			benches[bench]( result, iteration );
+		}
+	}
+
+	// Leave the drivers as they were
+	OneWire_Bench_Reset();
+	PWM_I2C_Bench_Reset();
+	LCD_Bench_Reset();
+
+	benchRun = 1;
+	__set_BASEPRI( basePriority );
+}
+
+/*
+ * Copies out a benchmark's result
+ * Returns 0 if the benchmarks haven't run
+ */
+uint8_t Bench_Get_Result( uint8_t bench, Bench_Result *result ) {
+	if ( ! benchRun || ( bench >= BENCHES ) || ! result ) {
+		return 0;
+	}
+
+	*result = results[bench];
+	return 1;
+}
+
+#else
+
+// Compiled out - nothing runs, so there are no results
+
+void Bench_Run() {
+}
+
+uint8_t Bench_Get_Result( uint8_t bench, Bench_Result *result ) {
+	return 0;
+}
+
+#endif // BENCH_ENABLED
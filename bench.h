@@ -0,0 +1,50 @@
+// Cycle counts for the station's hot paths
+//
+// Built only when BENCH_ENABLED is defined. Bench_Run then times
+// fixed workloads through the GPS parser, the thermometer
+// conversion, the OneWire and I2C enqueue paths and the LCD
+// update with the DWT cycle counter, once at start up before the
+// drivers have anything queued. Telemetry sends the results on
+// request (TELEMETRY_REQUEST_BENCH) and tools/bench.py keeps them
+// as JSON and checks them against a baseline.
+//
+// The tracing and profiling hooks are part of the paths they sit
+// in, so only compare runs of builds with the same defines.
+
+#ifndef __BENCH_H
+#define __BENCH_H
+
+#include "stdint.h"
+
+#define BENCH_GPS_PROCESS_LINE 0
+#define BENCH_GPS_SCRATCHPAD_VALUE 1
+#define BENCH_DS18B20_TEMPERATURE 2
+#define BENCH_ONEWIRE_WRITE_BYTE 3
+#define BENCH_ONEWIRE_READ_BYTE 4
+#define BENCH_I2C_QUEUE_COMMAND 5
+#define BENCH_LCD_WRITE 6
+#define BENCH_LCD_FORMAT 7
+#define BENCHES 8
+
+// Samples taken of each path
+#define BENCH_ITERATIONS 64
+
+// Calls timed together in a sample, the count divided back down
+// to one call. The cycle counter resolves a single call, but a
+// host clock needs a batch (tests/bench-runner.c builds with 64)
+#ifndef BENCH_BATCH
+#define BENCH_BATCH 1
+#endif
+
+// Cycles per call, less the cost of reading the counter
+typedef struct Bench_Results {
+	uint16_t iterations;
+	uint32_t minimum;
+	uint32_t maximum;
+	uint32_t total;
+} Bench_Result;
+
+void Bench_Run();
+uint8_t Bench_Get_Result( uint8_t bench, Bench_Result *result );
+
+#endif // __BENCH_H
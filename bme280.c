@@ -0,0 +1,266 @@
+// An interface to a Bosch BME280 humidity, pressure and
+// temperature sensor, on the I2C bus the radio shares
+//
+// Runs in forced mode: each measurement is started with a write
+// of ctrl_meas, takes under 10 ms at 1x oversampling, and is then
+// fetched with a single burst read of all eight data registers
+// (press_msb to hum_lsb), so the three values always come from
+// the same measurement. Compensation is the integer arithmetic
+// from the Bosch datasheet (section 4.2.3, 8.2).
+
+#include "bme280.h"
+#include "pwm-i2c.h"
+
+#define BME280_ID_R 0xD0
+#define BME280_CALIBRATION_R 0x88
+#define BME280_HUMIDITY_CALIBRATION_R 0xE1
+#define BME280_CTRL_HUM_R 0xF2
+#define BME280_CTRL_MEAS_R 0xF4
+#define BME280_CONFIG_R 0xF5
+#define BME280_DATA_R 0xF7
+
+#define BME280_CHIP_ID 0x60
+
+#define BME280_CALIBRATION_LENGTH 26
+#define BME280_HUMIDITY_CALIBRATION_LENGTH 7
+#define BME280_DATA_LENGTH 8
+
+// Humidity 1x oversampling
+#define BME280_CTRL_HUM 0x01
+// Temperature and pressure 1x oversampling, forced mode
+#define BME280_CTRL_MEAS 0x25
+// No IIR filter - the history averages
+#define BME280_CONFIG 0x00
+
+// Reads back while a channel was skipped
+#define BME280_SKIPPED 0x80000
+
+typedef struct BME280_Calibrations {
+	uint16_t t1;
+	int16_t t2;
+	int16_t t3;
+	uint16_t p1;
+	int16_t p2;
+	int16_t p3;
+	int16_t p4;
+	int16_t p5;
+	int16_t p6;
+	int16_t p7;
+	int16_t p8;
+	int16_t p9;
+	uint8_t h1;
+	int16_t h2;
+	uint8_t h3;
+	int16_t h4;
+	int16_t h5;
+	int8_t h6;
+} BME280_Calibration;
+
+static const PWM_I2C_Device bme280Device = { BME280_I2C_ADDRESS, PWM_I2C_PRIORITY_SENSOR };
+
+static BME280_Calibration calibration;
+static uint8_t calibrationData[BME280_CALIBRATION_LENGTH];
+static uint8_t humidityCalibrationData[BME280_HUMIDITY_CALIBRATION_LENGTH];
+static uint8_t chipID = 0;
+static uint8_t data[BME280_DATA_LENGTH];
+
+static uint8_t bme280Present = 0;
+static uint8_t bme280DataValid = 0;
+
+// Hundredths of a degree C, 1/1024ths of a percent and pascals
+static int32_t temperature = 0;
+static uint32_t humidity = 0;
+static uint32_t pressure = 0;
+
+/*
+ * Little endian calibration words
+ */
+uint16_t _BME280_Word( const uint8_t *bytes ) {
+	return bytes[0] | ( bytes[1] << 8 );
+}
+
+void _BME280_ID_Callback( uint8_t status, uint8_t *bytes, uint8_t length ) {
+	bme280Present = ( PWM_I2C_OK == status ) && ( BME280_CHIP_ID == chipID );
+}
+
+void _BME280_Calibration_Callback( uint8_t status, uint8_t *bytes, uint8_t length ) {
+	if ( PWM_I2C_OK != status ) {
+		bme280Present = 0;
+		return;
+	}
+
+	calibration.t1 = _BME280_Word( &calibrationData[0] );
+	calibration.t2 = _BME280_Word( &calibrationData[2] );
+	calibration.t3 = _BME280_Word( &calibrationData[4] );
+	calibration.p1 = _BME280_Word( &calibrationData[6] );
+	calibration.p2 = _BME280_Word( &calibrationData[8] );
+	calibration.p3 = _BME280_Word( &calibrationData[10] );
+	calibration.p4 = _BME280_Word( &calibrationData[12] );
+	calibration.p5 = _BME280_Word( &calibrationData[14] );
+	calibration.p6 = _BME280_Word( &calibrationData[16] );
+	calibration.p7 = _BME280_Word( &calibrationData[18] );
+	calibration.p8 = _BME280_Word( &calibrationData[20] );
+	calibration.p9 = _BME280_Word( &calibrationData[22] );
+	calibration.h1 = calibrationData[25];
+}
+
+void _BME280_Humidity_Calibration_Callback( uint8_t status, uint8_t *bytes, uint8_t length ) {
+	if ( PWM_I2C_OK != status ) {
+		bme280Present = 0;
+		return;
+	}
+
+	// H4 and H5 are 12 bits each, sharing 0xE5
+	calibration.h2 = _BME280_Word( &humidityCalibrationData[0] );
+	calibration.h3 = humidityCalibrationData[2];
+	calibration.h4 = ( (int8_t) humidityCalibrationData[3] * 16 ) | ( humidityCalibrationData[4] & 0x0F );
+	calibration.h5 = ( (int8_t) humidityCalibrationData[5] * 16 ) | ( humidityCalibrationData[4] >> 4 );
+	calibration.h6 = (int8_t) humidityCalibrationData[6];
+}
+
+/*
+ * Returns t_fine, and the temperature in hundredths of a degree C
+ */
+int32_t _BME280_Compensate_Temperature( int32_t adc, int32_t *hundredthsC ) {
+	int32_t var1 = ( ( ( adc >> 3 ) - ( (int32_t) calibration.t1 << 1 ) ) * (int32_t) calibration.t2 ) >> 11;
+	int32_t var2 = ( ( ( ( ( adc >> 4 ) - (int32_t) calibration.t1 ) * ( ( adc >> 4 ) - (int32_t) calibration.t1 ) ) >> 12 ) *
+		(int32_t) calibration.t3 ) >> 14;
+	int32_t fine = var1 + var2;
+
+	*hundredthsC = ( fine * 5 + 128 ) >> 8;
+	return fine;
+}
+
+/*
+ * Pressure in pascals, 32-bit version
+ */
+uint32_t _BME280_Compensate_Pressure( int32_t adc, int32_t fine ) {
+	int32_t var1 = ( fine >> 1 ) - 64000;
+	int32_t var2 = ( ( ( var1 >> 2 ) * ( var1 >> 2 ) ) >> 11 ) * (int32_t) calibration.p6;
+	var2 = var2 + ( ( var1 * (int32_t) calibration.p5 ) << 1 );
+	var2 = ( var2 >> 2 ) + ( (int32_t) calibration.p4 << 16 );
+	var1 = ( ( ( calibration.p3 * ( ( ( var1 >> 2 ) * ( var1 >> 2 ) ) >> 13 ) ) >> 3 ) + ( ( (int32_t) calibration.p2 * var1 ) >> 1 ) ) >> 18;
+	var1 = ( ( 32768 + var1 ) * (int32_t) calibration.p1 ) >> 15;
+	if ( 0 == var1 ) {
+		// Avoid dividing by zero
+		return 0;
+	}
+
+	uint32_t p = ( (uint32_t) ( 1048576 - adc ) - ( var2 >> 12 ) ) * 3125;
+	if ( p < 0x80000000 ) {
+		p = ( p << 1 ) / (uint32_t) var1;
+	} else {
+		p = ( p / (uint32_t) var1 ) * 2;
+	}
+
+	var1 = ( (int32_t) calibration.p9 * (int32_t) ( ( ( p >> 3 ) * ( p >> 3 ) ) >> 13 ) ) >> 12;
+	var2 = ( (int32_t) ( p >> 2 ) * (int32_t) calibration.p8 ) >> 13;
+	return (uint32_t) ( (int32_t) p + ( ( var1 + var2 + calibration.p7 ) >> 4 ) );
+}
+
+/*
+ * Relative humidity in 1/1024ths of a percent
+ */
+uint32_t _BME280_Compensate_Humidity( int32_t adc, int32_t fine ) {
+	int32_t x = fine - 76800;
+
+	x = ( ( ( ( adc << 14 ) - ( (int32_t) calibration.h4 << 20 ) - ( (int32_t) calibration.h5 * x ) ) + 16384 ) >> 15 ) *
+		( ( ( ( ( ( ( x * (int32_t) calibration.h6 ) >> 10 ) * ( ( ( x * (int32_t) calibration.h3 ) >> 11 ) + 32768 ) ) >> 10 ) +
+		2097152 ) * (int32_t) calibration.h2 + 8192 ) >> 14 );
+	x = x - ( ( ( ( ( x >> 15 ) * ( x >> 15 ) ) >> 7 ) * (int32_t) calibration.h1 ) >> 4 );
+	x = ( x < 0 ) ? 0 : x;
+	x = ( x > 419430400 ) ? 419430400 : x;
+	return (uint32_t) ( x >> 12 );
+}
+
+void _BME280_Data_Callback( uint8_t status, uint8_t *bytes, uint8_t length ) {
+	if ( PWM_I2C_OK != status ) {
+		bme280DataValid = 0;
+		return;
+	}
+
+	int32_t adcP = ( (uint32_t) bytes[0] << 12 ) | ( bytes[1] << 4 ) | ( bytes[2] >> 4 );
+	int32_t adcT = ( (uint32_t) bytes[3] << 12 ) | ( bytes[4] << 4 ) | ( bytes[5] >> 4 );
+	int32_t adcH = ( bytes[6] << 8 ) | bytes[7];
+
+	// Nothing measured yet since power up
+	if ( BME280_SKIPPED == adcT ) {
+		bme280DataValid = 0;
+		return;
+	}
+
+	int32_t fine = _BME280_Compensate_Temperature( adcT, &temperature );
+	pressure = _BME280_Compensate_Pressure( adcP, fine );
+	humidity = _BME280_Compensate_Humidity( adcH, fine );
+	bme280DataValid = ( 0 != pressure );
+}
+
+/*
+ * Call after RDA1846_Init, which sets up the bus - queues the
+ * identification, calibration and configuration transactions
+ */
+void BME280_Init() {
+	uint8_t value;
+
+	bme280Present = 0;
+	bme280DataValid = 0;
+
+	PWM_I2C_Queue_Burst_Read( &bme280Device, BME280_ID_R, &chipID, 1, _BME280_ID_Callback );
+	PWM_I2C_Queue_Burst_Read( &bme280Device, BME280_CALIBRATION_R, calibrationData, BME280_CALIBRATION_LENGTH,
+		_BME280_Calibration_Callback );
+	PWM_I2C_Queue_Burst_Read( &bme280Device, BME280_HUMIDITY_CALIBRATION_R, humidityCalibrationData,
+		BME280_HUMIDITY_CALIBRATION_LENGTH, _BME280_Humidity_Calibration_Callback );
+
+	// Humidity oversampling only takes effect with the next ctrl_meas write
+	value = BME280_CTRL_HUM;
+	PWM_I2C_Queue_Write( &bme280Device, BME280_CTRL_HUM_R, &value, 1, 0 );
+	value = BME280_CONFIG;
+	PWM_I2C_Queue_Write( &bme280Device, BME280_CONFIG_R, &value, 1, 0 );
+}
+
+void BME280_Initiate_Measurement() {
+	uint8_t value = BME280_CTRL_MEAS;
+
+	if ( ! bme280Present ) {
+		return;
+	}
+	PWM_I2C_Queue_Write( &bme280Device, BME280_CTRL_MEAS_R, &value, 1, 0 );
+}
+
+/*
+ * Fetches the last measurement - give it 10 ms after initiating
+ */
+void BME280_Read_Measurement() {
+	if ( ! bme280Present ) {
+		return;
+	}
+	PWM_I2C_Queue_Burst_Read( &bme280Device, BME280_DATA_R, data, BME280_DATA_LENGTH, _BME280_Data_Callback );
+}
+
+uint8_t BME280_Data_Valid() {
+	return bme280DataValid;
+}
+
+int16_t BME280_Get_Temperature_F() {
+	if ( ! bme280DataValid ) {
+		return BME280_NO_READING;
+	}
+
+	// Rounded to the nearest degree
+	int32_t hundredthsF = temperature * 9 / 5 + 3200;
+	return ( hundredthsF + ( ( hundredthsF < 0 ) ? -50 : 50 ) ) / 100;
+}
+
+/*
+ * Relative humidity in whole percent
+ */
+uint8_t BME280_Get_Humidity() {
+	return ( humidity + 512 ) >> 10;
+}
+
+/*
+ * Pressure in tenths of a hectopascal (millibar)
+ */
+uint16_t BME280_Get_Pressure() {
+	return ( pressure + 5 ) / 10;
+}
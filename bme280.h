@@ -0,0 +1,25 @@
+// An interface to a Bosch BME280 humidity, pressure and
+// temperature sensor, on the I2C bus the radio shares
+//
+// Uses I2C0 through pwm-i2c.c, at sensor priority
+
+#ifndef __BME280_H
+#define __BME280_H
+
+#include "stdint.h"
+
+// SDO tied to ground, 0x77 when tied high
+#define BME280_I2C_ADDRESS 0x76
+
+#define BME280_NO_READING -9999
+
+void BME280_Init();
+
+void BME280_Initiate_Measurement();
+void BME280_Read_Measurement();
+uint8_t BME280_Data_Valid();
+int16_t BME280_Get_Temperature_F();
+uint8_t BME280_Get_Humidity();
+uint16_t BME280_Get_Pressure();
+
+#endif // __BME280_H
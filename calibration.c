@@ -0,0 +1,179 @@
+// GPS disciplined calibration of the system clock
+//
+// The DWT cycle counter runs free at the system clock. Each
+// $GPRMC carries the UTC second it was sent for, so the cycles
+// counted between two GPS time stamps give the oscillator's real
+// rate.
+//
+// The system clock is the PLL locked to the 16 MHz crystal, good
+// to a few tens of ppm, while NMEA sentences leave the receiver
+// with up to CALIBRATION_JITTER_MS of jitter - about 667 ppm
+// across a 30 s window, far above the error being measured. So
+// the windows are chained into one baseline: consecutive windows
+// share their end stamps, the jitter of the stamps in between
+// cancels, and the error of the whole baseline is only that of
+// its first and last stamp. The noise floor falls as the baseline
+// grows, and the clock module only gets a correction once the
+// floor is below CALIBRATION_APPLY_PPM.
+//
+// A PPS capture would get there in seconds rather than an hour,
+// but the Neo6's PPS output isn't wired to the TM4C123 on this
+// board.
+
+#include "calibration.h"
+#include "clock.h"
+#include "gps.h"
+#include "profile.h"
+
+// Each window stays well inside the 53 s the cycle counter takes
+// to wrap at 80 MHz
+#define CALIBRATION_WINDOW_SECONDS 30
+#define CALIBRATION_SECONDS_PER_DAY 86400
+
+// Worst case NMEA time stamp jitter, either side
+#define CALIBRATION_JITTER_MS 20
+
+// A window further off is a glitch (missed or repeated sentence)
+// and starts the baseline again
+#define CALIBRATION_MAX_ERROR_PPM 50000
+
+// Only retune the drivers once the noise floor is below this, and
+// then for a change bigger than this
+#define CALIBRATION_APPLY_PPM 10
+
+// Start a fresh baseline after a day so temperature drift is followed
+#define CALIBRATION_MAX_BASELINE_SECONDS CALIBRATION_SECONDS_PER_DAY
+
+static uint8_t windowOpen = 0;
+static uint32_t windowStartCycles = 0;
+static uint32_t windowStartSecond = 0;
+static uint32_t windowNominalHz = 0;
+
+// Totals over the chained windows since the baseline started
+static uint64_t baselineCycles = 0;
+static uint32_t baselineSeconds = 0;
+
+static uint8_t calibrationValid = 0;
+static int32_t calibrationPPM = 0;
+
+static uint32_t calibrationWindows = 0;
+static uint32_t calibrationRejected = 0;
+static int32_t calibrationLastPPM = 0;
+
+void _Calibration_Open_Window( uint32_t cycles, uint32_t second ) {
+	windowStartCycles = cycles;
+	windowStartSecond = second;
+	windowNominalHz = Clock_Get_Nominal_Hz();
+	windowOpen = 1;
+}
+
+void _Calibration_Restart_Baseline( uint32_t cycles, uint32_t second ) {
+	baselineCycles = 0;
+	baselineSeconds = 0;
+	_Calibration_Open_Window( cycles, second );
+}
+
+/*
+ * Worst case error of the baseline in ppm - the jitter of its
+ * first and last stamp over its length
+ */
+uint32_t _Calibration_Noise_Floor_PPM( uint32_t seconds ) {
+	if ( 0 == seconds ) {
+		return 0xFFFFFFFF;
+	}
+	return ( 2 * CALIBRATION_JITTER_MS * 1000 + seconds - 1 ) / seconds;
+}
+
+/*
+ * Called from the UART interrupt for each valid fix
+ */
+void _Calibration_GPS_Second() {
+	uint32_t cycles = Profile_Get_Cycles();
+
+	uint8_t hour, minute, seconds;
+	GPS_Get_Time( &hour, &minute, &seconds );
+	uint32_t second = ( (uint32_t) hour * 60 + minute ) * 60 + seconds;
+
+	if ( ! windowOpen ) {
+		_Calibration_Restart_Baseline( cycles, second );
+		return;
+	}
+
+	uint32_t elapsed = ( second + CALIBRATION_SECONDS_PER_DAY - windowStartSecond ) % CALIBRATION_SECONDS_PER_DAY;
+	if ( elapsed < CALIBRATION_WINDOW_SECONDS ) {
+		return;
+	}
+
+	uint64_t expected = (uint64_t) windowNominalHz * elapsed;
+	uint32_t counted = cycles - windowStartCycles;
+
+	// Lost the GPS long enough for the counter to wrap, or the
+	// clock was switched mid-window
+	if ( ( expected > 0xF0000000 ) || ( Clock_Get_Nominal_Hz() != windowNominalHz ) ) {
+		_Calibration_Restart_Baseline( cycles, second );
+		return;
+	}
+
+	int32_t ppm = (int32_t) ( ( ( (int64_t) counted - (int64_t) expected ) * 1000000 ) / (int64_t) expected );
+	calibrationWindows++;
+
+	if ( ( ppm > CALIBRATION_MAX_ERROR_PPM ) || ( ppm < -CALIBRATION_MAX_ERROR_PPM ) ) {
+		calibrationRejected++;
+		_Calibration_Restart_Baseline( cycles, second );
+		return;
+	}
+
+	// This window's end stamp is the next one's start
+	baselineCycles += counted;
+	baselineSeconds += elapsed;
+	_Calibration_Open_Window( cycles, second );
+
+	expected = (uint64_t) windowNominalHz * baselineSeconds;
+	calibrationLastPPM = (int32_t) ( ( ( (int64_t) baselineCycles - (int64_t) expected ) * 1000000 ) / (int64_t) expected );
+
+	if ( _Calibration_Noise_Floor_PPM( baselineSeconds ) <= CALIBRATION_APPLY_PPM ) {
+		calibrationPPM = calibrationLastPPM;
+		calibrationValid = 1;
+
+		int32_t change = calibrationPPM - Clock_Get_Correction_PPM();
+		if ( ( change > CALIBRATION_APPLY_PPM ) || ( change < -CALIBRATION_APPLY_PPM ) ) {
+			Clock_Set_Correction_PPM( calibrationPPM );
+		}
+	}
+
+	if ( baselineSeconds >= CALIBRATION_MAX_BASELINE_SECONDS ) {
+		_Calibration_Restart_Baseline( cycles, second );
+	}
+}
+
+void Calibration_Init() {
+	Profile_Enable_Cycle_Counter();
+
+	windowOpen = 0;
+	calibrationValid = 0;
+	GPS_Register_Second_Callback( _Calibration_GPS_Second );
+}
+
+uint8_t Calibration_Valid() {
+	return calibrationValid;
+}
+
+/*
+ * Measured oscillator error, e.g. +1500 if the clock runs
+ * 0.15% fast
+ */
+int32_t Calibration_Get_PPM() {
+	return calibrationPPM;
+}
+
+void Calibration_Get_Stats( uint32_t *windows, uint32_t *rejected, int32_t *lastPPM ) {
+	if ( windows ) {
+		*windows = calibrationWindows;
+	}
+	if ( rejected ) {
+		*rejected = calibrationRejected;
+	}
+	if ( lastPPM ) {
+		*lastPPM = calibrationLastPPM;
+	}
+}
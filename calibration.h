@@ -0,0 +1,16 @@
+// GPS disciplined calibration of the system clock
+//
+// Counts CPU cycles between GPS time stamps and feeds the
+// oscillator's measured error back into the clock module
+
+#ifndef __CALIBRATION_H
+#define __CALIBRATION_H
+
+#include "stdint.h"
+
+void Calibration_Init();
+uint8_t Calibration_Valid();
+int32_t Calibration_Get_PPM();
+void Calibration_Get_Stats( uint32_t *windows, uint32_t *rejected, int32_t *lastPPM );
+
+#endif // __CALIBRATION_H
@@ -0,0 +1,297 @@
+// Record and replay of what the station's drivers saw
+//
+// Records go into a byte ring that telemetry drains. The drivers
+// record from their interrupt handlers and telemetry reads from
+// its own, so the ring has one writer side and one reader side:
+// a record only becomes visible once the head moves past all of
+// it, and a full ring drops records (noting how many) rather than
+// overwriting ones the host hasn't seen.
+
+#include "capture.h"
+#include "profile.h"
+#include "intrinsics.h"
+
+// Must be a power of two
+#define CAPTURE_BUFFER_LENGTH 2048
+
+#ifdef CAPTURE_ENABLED
+
+static uint8_t ring[CAPTURE_BUFFER_LENGTH];
+static volatile uint32_t captureHead = 0;
+static volatile uint32_t captureTail = 0;
+static volatile uint8_t capturing = 0;
+static uint16_t recordsLost = 0;
+
+static uint32_t captureBytesCaptured = 0;
+static uint32_t captureRecordsDropped = 0;
+
+uint8_t _Capture_Append( uint8_t source, uint32_t cycles, const uint8_t *data, uint8_t length ) {
+	if ( CAPTURE_BUFFER_LENGTH - ( captureHead - captureTail ) < (uint32_t) ( CAPTURE_HEADER_LENGTH + length ) ) {
+		return 0;
+	}
+
+	uint32_t position = captureHead;
+	ring[position++ & ( CAPTURE_BUFFER_LENGTH - 1 )] = source;
+	ring[position++ & ( CAPTURE_BUFFER_LENGTH - 1 )] = length;
+	for ( uint8_t i=0; i < 4; i++ ) {
+		ring[position++ & ( CAPTURE_BUFFER_LENGTH - 1 )] = ( cycles >> ( 8 * i ) ) & 0xFF;
+	}
+	for ( uint8_t i=0; i < length; i++ ) {
+		ring[position++ & ( CAPTURE_BUFFER_LENGTH - 1 )] = data[i];
+	}
+
+	// Publish the whole record at once
+	captureHead = position;
+	captureBytesCaptured += CAPTURE_HEADER_LENGTH + length;
+	return 1;
+}
+
+void _Capture_Record( uint8_t source, const uint8_t *data, uint8_t length ) {
+	if ( ! capturing ) {
+		return;
+	}
+
+	uint32_t cycles = Profile_Get_Cycles();
+
+	__istate_t state = __get_interrupt_state();
+	__disable_interrupt();
+
+	// Own up to any gap before carrying on
+	if ( recordsLost ) {
+		uint8_t lost[2] = { recordsLost & 0xFF, recordsLost >> 8 };
+		if ( _Capture_Append( CAPTURE_LOST, cycles, lost, sizeof( lost ) ) ) {
+			recordsLost = 0;
+		}
+	}
+
+	if ( recordsLost || ! _Capture_Append( source, cycles, data, length ) ) {
+		if ( recordsLost < 0xFFFF ) {
+			recordsLost++;
+		}
+		captureRecordsDropped++;
+	}
+
+	__set_interrupt_state( state );
+}
+
+void Capture_Start() {
+	Profile_Enable_Cycle_Counter();
+
+	__istate_t state = __get_interrupt_state();
+	__disable_interrupt();
+	captureHead = 0;
+	captureTail = 0;
+	recordsLost = 0;
+	capturing = 1;
+	__set_interrupt_state( state );
+}
+
+/*
+ * Stops recording - what's in the ring can still be read
+ */
+void Capture_Stop() {
+	capturing = 0;
+}
+
+uint8_t Capture_Running() {
+	return capturing;
+}
+
+void Capture_UART( const uint8_t *data, uint8_t length ) {
+	if ( length > CAPTURE_MAX_DATA ) {
+		length = CAPTURE_MAX_DATA;
+	}
+	_Capture_Record( CAPTURE_UART, data, length );
+}
+
+void Capture_OneWire( uint8_t sample ) {
+	_Capture_Record( CAPTURE_ONEWIRE, &sample, 1 );
+}
+
+void Capture_I2C( uint8_t address, uint8_t reg, const uint8_t *data, uint8_t length ) {
+	uint8_t record[2 + CAPTURE_I2C_MAX_READ];
+
+	if ( length > CAPTURE_I2C_MAX_READ ) {
+		length = CAPTURE_I2C_MAX_READ;
+	}
+
+	record[0] = address;
+	record[1] = reg;
+	for ( uint8_t i=0; i < length; i++ ) {
+		record[2 + i] = data[i];
+	}
+	_Capture_Record( CAPTURE_I2C, record, 2 + length );
+}
+
+/*
+ * Copies out (and frees) up to length bytes of the capture
+ * stream, along with where in the stream they start
+ * Returns the number of bytes copied
+ */
+uint16_t Capture_Read( uint8_t *dest, uint16_t length, uint32_t *offset ) {
+	uint32_t tail = captureTail;
+	uint32_t available = captureHead - tail;
+
+	if ( offset ) {
+		*offset = tail;
+	}
+	if ( length > available ) {
+		length = available;
+	}
+
+	for ( uint16_t i=0; i < length; i++ ) {
+		dest[i] = ring[( tail + i ) & ( CAPTURE_BUFFER_LENGTH - 1 )];
+	}
+	captureTail = tail + length;
+
+	return length;
+}
+
+void Capture_Get_Stats( uint32_t *bytesCaptured, uint32_t *recordsDropped ) {
+	if ( bytesCaptured ) {
+		*bytesCaptured = captureBytesCaptured;
+	}
+	if ( recordsDropped ) {
+		*recordsDropped = captureRecordsDropped;
+	}
+}
+
+#else
+
+// Compiled out - nothing ever records
+
+void Capture_Start() {
+}
+
+void Capture_Stop() {
+}
+
+uint8_t Capture_Running() {
+	return 0;
+}
+
+void Capture_UART( const uint8_t *data, uint8_t length ) {
+}
+
+void Capture_OneWire( uint8_t sample ) {
+}
+
+void Capture_I2C( uint8_t address, uint8_t reg, const uint8_t *data, uint8_t length ) {
+}
+
+uint16_t Capture_Read( uint8_t *dest, uint16_t length, uint32_t *offset ) {
+	return 0;
+}
+
+void Capture_Get_Stats( uint32_t *bytesCaptured, uint32_t *recordsDropped ) {
+	if ( bytesCaptured ) {
+		*bytesCaptured = 0;
+	}
+	if ( recordsDropped ) {
+		*recordsDropped = 0;
+	}
+}
+
+#endif // CAPTURE_ENABLED
+
+#ifdef CAPTURE_REPLAY
+
+static const uint8_t *replayCapture = 0;
+static uint32_t replayLength = 0;
+
+// The runner and each driver hook walk the capture separately
+static uint32_t replayNext = 0;
+static uint32_t replayOneWireNext = 0;
+static uint32_t replayI2CNext = 0;
+static uint32_t replayMismatches = 0;
+
+/*
+ * Finds the next record from source (0 for any) at or after
+ * position, and moves position past it
+ */
+uint8_t _Capture_Replay_Find( uint32_t *position, uint8_t source, Capture_Event *event ) {
+	while ( *position + CAPTURE_HEADER_LENGTH <= replayLength ) {
+		const uint8_t *record = replayCapture + *position;
+		uint8_t length = record[1];
+
+		if ( *position + CAPTURE_HEADER_LENGTH + length > replayLength ) {
+			// Cut off mid-record
+			break;
+		}
+		*position += CAPTURE_HEADER_LENGTH + length;
+
+		if ( ! source || ( source == record[0] ) ) {
+			event->source = record[0];
+			event->length = length;
+			event->cycles = record[2] | ( record[3] << 8 ) | ( record[4] << 16 ) | ( (uint32_t) record[5] << 24 );
+			event->data = record + CAPTURE_HEADER_LENGTH;
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+void Capture_Replay_Load( const uint8_t *capture, uint32_t length ) {
+	replayCapture = capture;
+	replayLength = length;
+	replayNext = 0;
+	replayOneWireNext = 0;
+	replayI2CNext = 0;
+	replayMismatches = 0;
+}
+
+/*
+ * Hands the runner every record in order
+ * Returns 0 at the end of the capture
+ */
+uint8_t Capture_Replay_Next( Capture_Event *event ) {
+	return _Capture_Replay_Find( &replayNext, 0, event );
+}
+
+/*
+ * The next recorded OneWire sample - an idle (high) bus once
+ * the capture runs out
+ */
+uint8_t Capture_Replay_OneWire() {
+	Capture_Event event;
+
+	if ( _Capture_Replay_Find( &replayOneWireNext, CAPTURE_ONEWIRE, &event ) && event.length ) {
+		return event.data[0];
+	}
+
+	replayMismatches++;
+	return 1;
+}
+
+/*
+ * The next recorded I2C read, which should be the same length
+ * from the same device and register the driver is reading now
+ */
+void Capture_Replay_I2C( uint8_t address, uint8_t reg, uint8_t *data, uint8_t length ) {
+	Capture_Event event;
+	uint8_t found = 0;
+
+	if ( _Capture_Replay_Find( &replayI2CNext, CAPTURE_I2C, &event ) && ( event.length >= 2 ) ) {
+		found = event.length - 2;
+		if ( ( event.data[0] != address ) || ( event.data[1] != reg ) || ( found != length ) ) {
+			replayMismatches++;
+		}
+	} else {
+		replayMismatches++;
+	}
+
+	for ( uint8_t i=0; i < length; i++ ) {
+		data[i] = ( i < found ) ? event.data[2 + i] : 0;
+	}
+}
+
+/*
+ * Driver reads the capture couldn't answer, or answered for a
+ * different register - either means the replay has diverged
+ */
+uint32_t Capture_Replay_Get_Mismatches() {
+	return replayMismatches;
+}
+
+#endif // CAPTURE_REPLAY
@@ -0,0 +1,71 @@
+// Record and replay of what the station's drivers saw
+//
+// With CAPTURE_ENABLED the GPS UART's received bytes, OneWire bus
+// samples and I2C read values are recorded at the driver boundary
+// with their cycle counter timestamps, once telemetry asks for it
+// (TELEMETRY_REQUEST_CAPTURE), and streamed to the host.
+//
+// With CAPTURE_REPLAY (host builds) the OneWire and I2C drivers
+// take their samples and reads from a loaded capture instead of
+// the hardware, so a runner can push the UART bytes back through
+// uart.c and fire the timer handlers to re-run the same traffic
+// through unmodified driver and parser code.
+//
+// Each record is the source, its data length, the cycle counter
+// (LSB first) and the data:
+//   CAPTURE_UART - received bytes
+//   CAPTURE_ONEWIRE - the bus sample, 0 or 1
+//   CAPTURE_I2C - device address, register, the bytes read
+//   CAPTURE_LOST - records dropped on a full buffer (LSB first)
+
+#ifndef __CAPTURE_H
+#define __CAPTURE_H
+
+#include "stdint.h"
+
+#define CAPTURE_UART 1
+#define CAPTURE_ONEWIRE 2
+#define CAPTURE_I2C 3
+#define CAPTURE_LOST 0xFF
+
+#define CAPTURE_HEADER_LENGTH 6
+#define CAPTURE_MAX_DATA 16
+
+// Longer I2C reads keep their first bytes
+#define CAPTURE_I2C_MAX_READ 32
+
+#ifdef CAPTURE_ENABLED
+#define CAPTURE_UART_BYTES( data, length ) Capture_UART( data, length )
+#define CAPTURE_ONEWIRE_SAMPLE( sample ) Capture_OneWire( sample )
+#define CAPTURE_I2C_READ( address, reg, data, length ) Capture_I2C( address, reg, data, length )
+#else
+#define CAPTURE_UART_BYTES( data, length )
+#define CAPTURE_ONEWIRE_SAMPLE( sample )
+#define CAPTURE_I2C_READ( address, reg, data, length )
+#endif
+
+typedef struct Capture_Events {
+	uint8_t source;
+	uint8_t length;
+	uint32_t cycles;
+	const uint8_t *data;
+} Capture_Event;
+
+void Capture_Start();
+void Capture_Stop();
+uint8_t Capture_Running();
+void Capture_UART( const uint8_t *data, uint8_t length );
+void Capture_OneWire( uint8_t sample );
+void Capture_I2C( uint8_t address, uint8_t reg, const uint8_t *data, uint8_t length );
+uint16_t Capture_Read( uint8_t *dest, uint16_t length, uint32_t *offset );
+void Capture_Get_Stats( uint32_t *bytesCaptured, uint32_t *recordsDropped );
+
+#ifdef CAPTURE_REPLAY
+void Capture_Replay_Load( const uint8_t *capture, uint32_t length );
+uint8_t Capture_Replay_Next( Capture_Event *event );
+uint8_t Capture_Replay_OneWire();
+void Capture_Replay_I2C( uint8_t address, uint8_t reg, uint8_t *data, uint8_t length );
+uint32_t Capture_Replay_Get_Mismatches();
+#endif
+
+#endif // __CAPTURE_H
@@ -0,0 +1,216 @@
+// System clock manager for the TM4C123
+//
+// Runs from the PLL (locked to the 16 MHz crystal) or straight
+// from the crystal for low power, and tells drivers when the
+// frequency changes so they can recompute their divisors
+//
+// Drivers that only need the frequency now and then (one-shot
+// timers) convert their delays with Clock_Microseconds_To_Ticks
+// and friends each time. Drivers with divisors programmed once
+// (baud rates, periodic timers) register a change callback.
+//
+// A correction in ppm (from GPS calibration) is folded into the
+// published frequency, so every divisor follows the oscillator's
+// real rate rather than its nominal one.
+
+#include "clock.h"
+#include "tm4c123gh6pm.h"
+#include "intrinsics.h"
+
+#define CLOCK_MAX_CALLBACKS 8
+
+// Crystal frequency on the LaunchPad, and the PLL output after
+// the fixed divide by 2 (DIV400 passes it through undivided)
+#define CLOCK_CRYSTAL_HZ 16000000
+#define CLOCK_PLL_HZ 400000000
+
+#define CLOCK_RCC2_USERCC2 0x80000000
+#define CLOCK_RCC2_DIV400 0x40000000
+#define CLOCK_RCC2_SYSDIV2_MASK 0x1FC00000
+#define CLOCK_RCC2_SYSDIV2_SHIFT 22
+#define CLOCK_RCC2_PWRDN2 0x00002000
+#define CLOCK_RCC2_BYPASS2 0x00000800
+#define CLOCK_RCC2_OSCSRC2_MASK 0x00000070
+#define CLOCK_RCC_XTAL_MASK 0x000007C0
+#define CLOCK_RCC_XTAL_16MHZ 0x00000540
+#define CLOCK_RCC_MOSCDIS 0x00000001
+#define CLOCK_RIS_PLLLRIS 0x00000040
+#define CLOCK_RIS_MOSCPUPRIS 0x00000100
+
+// Starts at the reset clock (16 MHz PIOSC)
+static uint32_t nominalHz = CLOCK_16_MHZ;
+static int32_t correctionPPM = 0;
+static uint32_t clockHz = CLOCK_16_MHZ;
+static uint32_t clockMHz = CLOCK_16_MHZ / 1000000;
+
+// Corrected ticks per microsecond (16.16) and millisecond (24.8)
+static uint32_t ticksPerMicrosecond = ( CLOCK_16_MHZ / 1000000 ) << 16;
+static uint32_t ticksPerMillisecond = ( CLOCK_16_MHZ / 1000 ) << 8;
+
+static void (*changeCallbacks[CLOCK_MAX_CALLBACKS])( uint32_t hz );
+static uint8_t changeCallbackCount = 0;
+
+/*
+ * Bypasses the PLL and makes sure the 16 MHz crystal is running
+ * and selected as its source
+ */
+void _Clock_Bypass_PLL() {
+	// Use RCC2 for its wider divider, run from the oscillator
+	SYSCTL_RCC2_R |= CLOCK_RCC2_USERCC2;
+	SYSCTL_RCC2_R |= CLOCK_RCC2_BYPASS2;
+
+	// Main oscillator on and settled, 16 MHz crystal, selected
+	if ( SYSCTL_RCC_R & CLOCK_RCC_MOSCDIS ) {
+		SYSCTL_RCC_R &= ~CLOCK_RCC_MOSCDIS;
+		while ( ( SYSCTL_RIS_R & CLOCK_RIS_MOSCPUPRIS ) == 0 ) {};
+	}
+	SYSCTL_RCC_R = ( SYSCTL_RCC_R & ~CLOCK_RCC_XTAL_MASK ) | CLOCK_RCC_XTAL_16MHZ;
+	SYSCTL_RCC2_R &= ~CLOCK_RCC2_OSCSRC2_MASK;
+}
+
+/*
+ * Runs from the crystal with the PLL powered down
+ */
+void _Clock_Use_Crystal() {
+	_Clock_Bypass_PLL();
+	SYSCTL_RCC2_R |= CLOCK_RCC2_PWRDN2;
+}
+
+/*
+ * Locks the PLL and divides 400 MHz by sysdiv + 1
+ */
+void _Clock_Use_PLL( uint8_t sysdiv ) {
+	_Clock_Bypass_PLL();
+
+	// Power up the PLL, 400 MHz output, system divider
+	SYSCTL_MISC_R = CLOCK_RIS_PLLLRIS;
+	SYSCTL_RCC2_R &= ~CLOCK_RCC2_PWRDN2;
+	SYSCTL_RCC2_R |= CLOCK_RCC2_DIV400;
+	SYSCTL_RCC2_R = ( SYSCTL_RCC2_R & ~CLOCK_RCC2_SYSDIV2_MASK ) | ( (uint32_t) sysdiv << CLOCK_RCC2_SYSDIV2_SHIFT );
+
+	// Wait for the PLL to lock, then switch over to it
+	while ( ( SYSCTL_RIS_R & CLOCK_RIS_PLLLRIS ) == 0 ) {};
+	SYSCTL_RCC2_R &= ~CLOCK_RCC2_BYPASS2;
+}
+
+/*
+ * Publishes nominalHz with the correction applied and lets the
+ * drivers know. Call with interrupts off.
+ */
+void _Clock_Publish() {
+	clockHz = nominalHz + (int32_t) ( ( (int64_t) nominalHz * correctionPPM ) / 1000000 );
+	clockMHz = nominalHz / 1000000;
+	ticksPerMicrosecond = ( ( (uint64_t) clockHz << 16 ) + 500000 ) / 1000000;
+	ticksPerMillisecond = ( ( (uint64_t) clockHz << 8 ) + 500 ) / 1000;
+
+	for ( uint8_t i=0; i < changeCallbackCount; i++ ) {
+		changeCallbacks[i]( clockHz );
+	}
+}
+
+/*
+ * Switches the system clock
+ * hz: CLOCK_16_MHZ, CLOCK_40_MHZ, CLOCK_50_MHZ or CLOCK_80_MHZ
+ * Returns 0 for an unsupported frequency
+ *
+ * Change callbacks run with interrupts off, right after the
+ * switch, so no interrupt sees the old divisors at the new clock
+ */
+uint8_t Clock_Set_Hz( uint32_t hz ) {
+	if ( ( CLOCK_16_MHZ != hz ) && ( CLOCK_40_MHZ != hz ) &&
+		( CLOCK_50_MHZ != hz ) && ( CLOCK_80_MHZ != hz ) ) {
+		return 0;
+	}
+
+	__istate_t state = __get_interrupt_state();
+	__disable_interrupt();
+
+	if ( CLOCK_16_MHZ == hz ) {
+		_Clock_Use_Crystal();
+	} else {
+		_Clock_Use_PLL( CLOCK_PLL_HZ / hz - 1 );
+	}
+
+	nominalHz = hz;
+	_Clock_Publish();
+
+	__set_interrupt_state( state );
+
+	return 1;
+}
+
+/*
+ * ppm: how fast the oscillator really runs, e.g. +120 if it
+ * gains 120 us every second. Carries over frequency switches,
+ * since the PLL is locked to the same crystal.
+ */
+void Clock_Set_Correction_PPM( int32_t ppm ) {
+	__istate_t state = __get_interrupt_state();
+	__disable_interrupt();
+	correctionPPM = ppm;
+	_Clock_Publish();
+	__set_interrupt_state( state );
+}
+
+int32_t Clock_Get_Correction_PPM() {
+	return correctionPPM;
+}
+
+/*
+ * Frequency the clock was set to, without the correction
+ */
+uint32_t Clock_Get_Nominal_Hz() {
+	return nominalHz;
+}
+
+/*
+ * Call before any other driver's init, so they start out with
+ * the right divisors
+ */
+void Clock_Init( uint32_t hz ) {
+	Clock_Set_Hz( hz );
+}
+
+uint32_t Clock_Get_Hz() {
+	return clockHz;
+}
+
+uint32_t Clock_Get_MHz() {
+	return clockMHz;
+}
+
+/*
+ * Timer ticks for a delay, saturating at 32 bits
+ */
+uint32_t Clock_Microseconds_To_Ticks( uint32_t microseconds ) {
+	uint64_t ticks = ( (uint64_t) microseconds * ticksPerMicrosecond ) >> 16;
+	return ( ticks > 0xFFFFFFFF ) ? 0xFFFFFFFF : (uint32_t) ticks;
+}
+
+uint32_t Clock_Milliseconds_To_Ticks( uint32_t milliseconds ) {
+	uint64_t ticks = ( (uint64_t) milliseconds * ticksPerMillisecond ) >> 8;
+	return ( ticks > 0xFFFFFFFF ) ? 0xFFFFFFFF : (uint32_t) ticks;
+}
+
+/*
+ * UART baud rate divisor in 1/64ths, rounded to nearest
+ * IBRD is the result >> 6, FBRD the low 6 bits
+ */
+uint32_t Clock_Get_UART_Divisor( uint32_t baud ) {
+	// 64 * hz / ( 16 * baud ) = 4 * hz / baud
+	return ( (uint64_t) clockHz * 4 + baud / 2 ) / baud;
+}
+
+/*
+ * Accepts a callback that is called with the new frequency
+ * each time the system clock changes
+ * Returns 0 if there is no room for another
+ */
+uint8_t Clock_Register_Change_Callback( void (*callback)( uint32_t hz ) ) {
+	if ( changeCallbackCount >= CLOCK_MAX_CALLBACKS ) {
+		return 0;
+	}
+	changeCallbacks[changeCallbackCount] = callback;
+	changeCallbackCount++;
+	return 1;
+}
@@ -0,0 +1,29 @@
+// System clock manager for the TM4C123
+//
+// Runs from the PLL (locked to the 16 MHz crystal) or straight
+// from the crystal for low power, and tells drivers when the
+// frequency changes so they can recompute their divisors
+
+#ifndef __CLOCK_H
+#define __CLOCK_H
+
+#include "stdint.h"
+
+#define CLOCK_16_MHZ 16000000
+#define CLOCK_40_MHZ 40000000
+#define CLOCK_50_MHZ 50000000
+#define CLOCK_80_MHZ 80000000
+
+void Clock_Init( uint32_t hz );
+uint8_t Clock_Set_Hz( uint32_t hz );
+uint32_t Clock_Get_Hz();
+uint32_t Clock_Get_MHz();
+uint32_t Clock_Get_Nominal_Hz();
+void Clock_Set_Correction_PPM( int32_t ppm );
+int32_t Clock_Get_Correction_PPM();
+uint32_t Clock_Microseconds_To_Ticks( uint32_t microseconds );
+uint32_t Clock_Milliseconds_To_Ticks( uint32_t milliseconds );
+uint32_t Clock_Get_UART_Divisor( uint32_t baud );
+uint8_t Clock_Register_Change_Callback( void (*callback)( uint32_t hz ) );
+
+#endif // __CLOCK_H
@@ -0,0 +1,349 @@
+// p-persistent CSMA channel access for the packet transmitter
+//
+// Frames wait in a small pool of buffers, sent in the order they
+// were committed. Producers can reserve a buffer and fill it in
+// place (the KISS port decodes straight into one) or have a frame
+// copied in. At every slot boundary, if the
+// channel (RDA1846 RSSI / squelch) is clear, the head frame goes
+// out with probability (persistence + 1) / 256. A busy channel
+// holds off slot counting until the radio reports it clear again.
+// Frames still waiting after the maximum defer time are dropped
+// rather than keyed over other stations.
+//
+// Each source (the station's own reports, digipeated frames and
+// the KISS host) keeps its own slot time, persistence and defer
+// limit, and the head frame is sent with those of its source -
+// the host retuning P doesn't touch slotted beacons.
+//
+// Uses SysTick as the slot clock while frames are waiting
+
+#include "csma.h"
+#include "ax25.h"
+#include "rda1846.h"
+#include "clock.h"
+#include "profile.h"
+#include "trace.h"
+#include "tm4c123gh6pm.h"
+#include "intrinsics.h"
+
+#define CSMA_QUEUE_LENGTH 6
+#define CSMA_ORDER_LENGTH ( CSMA_QUEUE_LENGTH + 1 )
+#define CSMA_TICK_MS 10
+
+// KISS style defaults: 100 ms slots, p = 64/256
+#define CSMA_DEFAULT_SLOT_TIME_MS 100
+#define CSMA_DEFAULT_PERSISTENCE 63
+#define CSMA_DEFAULT_MAX_DEFER_MS 10000
+
+static uint8_t queueFrames[CSMA_QUEUE_LENGTH][AX25_MAX_FRAME_LENGTH];
+static uint16_t queueLengths[CSMA_QUEUE_LENGTH];
+static volatile uint8_t buffersInUse = 0;
+
+// Ring of committed buffer indices, sent from head
+static uint8_t queueOrder[CSMA_ORDER_LENGTH];
+static volatile uint8_t queueHead = 0;
+static volatile uint8_t queueTail = 0;
+
+typedef struct CSMA_Parameters {
+	uint16_t slotTimeMS;
+	uint8_t persistence;
+	uint16_t maxDeferMS;
+} CSMA_Parameter;
+
+static CSMA_Parameter parameters[CSMA_SOURCES] = {
+	{ CSMA_DEFAULT_SLOT_TIME_MS, CSMA_DEFAULT_PERSISTENCE, CSMA_DEFAULT_MAX_DEFER_MS },
+	{ CSMA_DEFAULT_SLOT_TIME_MS, CSMA_DEFAULT_PERSISTENCE, CSMA_DEFAULT_MAX_DEFER_MS },
+	{ CSMA_DEFAULT_SLOT_TIME_MS, CSMA_DEFAULT_PERSISTENCE, CSMA_DEFAULT_MAX_DEFER_MS }
+};
+
+// Source of each buffer, set when it is reserved
+static uint8_t queueSources[CSMA_QUEUE_LENGTH];
+
+static uint16_t slotElapsedMS = 0;
+static uint32_t deferredMS = 0;
+static volatile uint8_t transmitting = 0;
+static volatile uint8_t ticking = 0;
+static volatile uint8_t waitingForChannel = 0;
+
+static uint32_t randomState = 0x2545F491;
+
+static uint32_t csmaFramesSent = 0;
+static uint32_t csmaFramesDropped = 0;
+static uint32_t csmaBusySlots = 0;
+
+/*
+ * xorshift32, stirred with the RSSI so that stations
+ * powered up together don't draw the same sequence
+ */
+uint8_t _CSMA_Random() {
+	randomState ^= (uint16_t) RDA1846_Get_RSSI();
+	randomState ^= randomState << 13;
+	randomState ^= randomState >> 17;
+	randomState ^= randomState << 5;
+	return randomState & 0xFF;
+}
+
+void _CSMA_Start_Ticking() {
+	slotElapsedMS = 0;
+	ticking = 1;
+
+	// Slot decisions need an up to date channel state
+	RDA1846_Watch_Channel( 1 );
+
+	NVIC_ST_CTRL_R = 0;
+	NVIC_ST_RELOAD_R = Clock_Milliseconds_To_Ticks( CSMA_TICK_MS ) - 1;
+	NVIC_ST_CURRENT_R = 0;
+
+	// SysTick priority 2, same as the I2C queue so neither preempts the other
+	NVIC_SYS_PRI3_R = ( NVIC_SYS_PRI3_R & 0x00FFFFFF ) | 0x40000000;
+
+	// Core clock, interrupt, enable
+	NVIC_ST_CTRL_R = 0x07;
+}
+
+void _CSMA_Clock_Changed( uint32_t hz ) {
+	// Takes effect from the next tick
+	NVIC_ST_RELOAD_R = Clock_Milliseconds_To_Ticks( CSMA_TICK_MS ) - 1;
+}
+
+void _CSMA_Stop_Ticking() {
+	NVIC_ST_CTRL_R = 0;
+	ticking = 0;
+
+	if ( queueHead == queueTail ) {
+		RDA1846_Watch_Channel( 0 );
+	}
+}
+
+void _CSMA_Drop_Head() {
+	__istate_t state = __get_interrupt_state();
+	__disable_interrupt();
+	buffersInUse &= ~( 1 << queueOrder[queueHead] );
+	queueHead = ( queueHead + 1 ) % CSMA_ORDER_LENGTH;
+	__set_interrupt_state( state );
+	deferredMS = 0;
+}
+
+void _CSMA_Channel_Clear() {
+	// Start a fresh slot now that the channel is free
+	waitingForChannel = 0;
+	slotElapsedMS = 0;
+}
+
+void _CSMA_Transmit_Complete() {
+	transmitting = 0;
+	csmaFramesSent++;
+	_CSMA_Drop_Head();
+
+	if ( queueHead != queueTail ) {
+		_CSMA_Start_Ticking();
+	} else {
+		RDA1846_Watch_Channel( 0 );
+	}
+}
+
+void _CSMA_Tick() {
+	deferredMS += CSMA_TICK_MS;
+
+	if ( transmitting || ( queueHead == queueTail ) ) {
+		_CSMA_Stop_Ticking();
+		return;
+	}
+
+	uint8_t buffer = queueOrder[queueHead];
+	CSMA_Parameter *head = &parameters[queueSources[buffer]];
+
+	if ( deferredMS > head->maxDeferMS ) {
+		csmaFramesDropped++;
+		TRACE( TRACE_CSMA_DROP, 0, ( queueTail + CSMA_ORDER_LENGTH - queueHead ) % CSMA_ORDER_LENGTH );
+		_CSMA_Drop_Head();
+		if ( queueHead == queueTail ) {
+			_CSMA_Stop_Ticking();
+			RDA1846_Wait_For_Channel( 0 );
+			waitingForChannel = 0;
+		}
+		return;
+	}
+
+	// Busy channel - slots only count once the radio sees it clear
+	if ( waitingForChannel ) {
+		return;
+	}
+
+	slotElapsedMS += CSMA_TICK_MS;
+	if ( slotElapsedMS < head->slotTimeMS ) {
+		return;
+	}
+	slotElapsedMS = 0;
+
+	if ( RDA1846_Channel_Busy() ) {
+		csmaBusySlots++;
+		waitingForChannel = 1;
+		RDA1846_Wait_For_Channel( _CSMA_Channel_Clear );
+		return;
+	}
+
+	if ( _CSMA_Random() > head->persistence ) {
+		// Wait another slot
+		return;
+	}
+
+	_CSMA_Stop_Ticking();
+	transmitting = 1;
+	TRACE( TRACE_CSMA_TRANSMIT, 0, ( queueTail + CSMA_ORDER_LENGTH - queueHead ) % CSMA_ORDER_LENGTH );
+	RDA1846_Transmit( queueFrames[buffer], queueLengths[buffer], _CSMA_Transmit_Complete );
+}
+
+/*
+ * Counts off the slot time while frames wait
+ */
+void CSMA_SysTick_Handler() {
+	// SysTick reloaded when it fired and has been counting down since
+	PROFILE_ENTER_LATE( PROFILE_CSMA, NVIC_ST_RELOAD_R - NVIC_ST_CURRENT_R );
+	_CSMA_Tick();
+	PROFILE_EXIT( PROFILE_CSMA );
+}
+
+void CSMA_Init() {
+	Clock_Register_Change_Callback( _CSMA_Clock_Changed );
+	queueHead = 0;
+	queueTail = 0;
+	buffersInUse = 0;
+	transmitting = 0;
+	waitingForChannel = 0;
+	deferredMS = 0;
+	_CSMA_Stop_Ticking();
+}
+
+/*
+ * Sets the channel access for frames from one source
+ * slotTimeMS: time between transmit attempts (multiple of 10 ms)
+ * persistence: chance of sending in a clear slot, ( p + 1 ) / 256
+ * maxDeferMS: give up on a frame after waiting this long
+ */
+void CSMA_Set_Parameters( uint8_t source, uint16_t newSlotTimeMS, uint8_t newPersistence, uint16_t newMaxDeferMS ) {
+	if ( source >= CSMA_SOURCES ) {
+		return;
+	}
+
+	CSMA_Parameter next;
+	next.slotTimeMS = ( newSlotTimeMS < CSMA_TICK_MS ) ? CSMA_TICK_MS : newSlotTimeMS;
+	next.persistence = newPersistence;
+	next.maxDeferMS = newMaxDeferMS;
+
+	// The tick may be reading the set for the head frame
+	__istate_t state = __get_interrupt_state();
+	__disable_interrupt();
+	parameters[source] = next;
+	__set_interrupt_state( state );
+}
+
+/*
+ * Hands out a free frame buffer to fill in place, to be sent
+ * with the channel access parameters of source
+ * Returns CSMA_NO_BUFFER if all are in use
+ */
+uint8_t CSMA_Reserve_Frame( uint8_t source, uint8_t **frame ) {
+	uint8_t buffer = CSMA_NO_BUFFER;
+
+	if ( source >= CSMA_SOURCES ) {
+		return CSMA_NO_BUFFER;
+	}
+
+	// Frames come from the application tick, the receive path and
+	// the KISS port, which can preempt each other
+	__istate_t state = __get_interrupt_state();
+	__disable_interrupt();
+	for ( uint8_t i=0; i < CSMA_QUEUE_LENGTH; i++ ) {
+		if ( 0 == ( buffersInUse & ( 1 << i ) ) ) {
+			buffersInUse |= 1 << i;
+			queueSources[i] = source;
+			buffer = i;
+			break;
+		}
+	}
+	__set_interrupt_state( state );
+
+	if ( ( CSMA_NO_BUFFER != buffer ) && frame ) {
+		*frame = queueFrames[buffer];
+	}
+	return buffer;
+}
+
+/*
+ * Gives back a reserved buffer without sending it
+ */
+void CSMA_Release_Frame( uint8_t buffer ) {
+	if ( buffer >= CSMA_QUEUE_LENGTH ) {
+		return;
+	}
+	__istate_t state = __get_interrupt_state();
+	__disable_interrupt();
+	buffersInUse &= ~( 1 << buffer );
+	__set_interrupt_state( state );
+}
+
+/*
+ * Queues a filled, reserved buffer holding length bytes of
+ * frame (without FCS) for transmission
+ */
+void CSMA_Commit_Frame( uint8_t buffer, uint16_t length ) {
+	if ( ( buffer >= CSMA_QUEUE_LENGTH ) || ( length > AX25_MAX_FRAME_LENGTH ) ) {
+		CSMA_Release_Frame( buffer );
+		return;
+	}
+
+	queueLengths[buffer] = length;
+
+	__istate_t state = __get_interrupt_state();
+	__disable_interrupt();
+
+	// Deferral is timed from when a frame reaches the head
+	if ( queueHead == queueTail ) {
+		deferredMS = 0;
+	}
+	queueOrder[queueTail] = buffer;
+	queueTail = ( queueTail + 1 ) % CSMA_ORDER_LENGTH;
+
+	if ( ! ticking && ! transmitting ) {
+		_CSMA_Start_Ticking();
+	}
+
+	__set_interrupt_state( state );
+}
+
+/*
+ * Copies a frame (without FCS) from source into the transmit queue
+ * Returns 0 if the queue is full or the frame is too long
+ */
+uint8_t CSMA_Queue_Frame( uint8_t source, uint8_t *frame, uint16_t length ) {
+	uint8_t *queued;
+
+	if ( length > AX25_MAX_FRAME_LENGTH ) {
+		return 0;
+	}
+
+	uint8_t buffer = CSMA_Reserve_Frame( source, &queued );
+	if ( CSMA_NO_BUFFER == buffer ) {
+		return 0;
+	}
+
+	for ( uint16_t i=0; i < length; i++ ) {
+		queued[i] = frame[i];
+	}
+
+	CSMA_Commit_Frame( buffer, length );
+	return 1;
+}
+
+void CSMA_Get_Stats( uint32_t *framesSent, uint32_t *framesDropped, uint32_t *busySlots ) {
+	if ( framesSent ) {
+		*framesSent = csmaFramesSent;
+	}
+	if ( framesDropped ) {
+		*framesDropped = csmaFramesDropped;
+	}
+	if ( busySlots ) {
+		*busySlots = csmaBusySlots;
+	}
+}
@@ -0,0 +1,27 @@
+// p-persistent CSMA channel access for the packet transmitter
+//
+// Uses SysTick as the slot clock while frames are waiting
+
+#ifndef __CSMA_H
+#define __CSMA_H
+
+#include "stdint.h"
+
+#define CSMA_NO_BUFFER 0xFF
+
+// Frame sources, each with its own channel access parameters
+#define CSMA_SOURCE_STATION 0
+#define CSMA_SOURCE_DIGI 1
+#define CSMA_SOURCE_KISS 2
+#define CSMA_SOURCES 3
+
+void CSMA_Init();
+void CSMA_SysTick_Handler();
+void CSMA_Set_Parameters( uint8_t source, uint16_t slotTimeMS, uint8_t persistence, uint16_t maxDeferMS );
+uint8_t CSMA_Queue_Frame( uint8_t source, uint8_t *frame, uint16_t length );
+uint8_t CSMA_Reserve_Frame( uint8_t source, uint8_t **frame );
+void CSMA_Release_Frame( uint8_t buffer );
+void CSMA_Commit_Frame( uint8_t buffer, uint16_t length );
+void CSMA_Get_Stats( uint32_t *framesSent, uint32_t *framesDropped, uint32_t *busySlots );
+
+#endif // __CSMA_H
@@ -22,11 +22,20 @@ extern void UsageFault_Handler( void );
 extern void SVC_Handler( void );
 extern void DebugMon_Handler( void );
 extern void PendSV_Handler( void );
-extern void SysTick_Handler( void );
+extern void CSMA_SysTick_Handler( void ); // Added
 extern void OneWire_Timer0A_Handler( void ); // Added
 extern void Timer1A_Handler( void ); // Added
+extern void KISS_UART0_Handler( void ); // Added
 extern void UART1_Handler( void ); // Added
+extern void LCD_SSI0_Handler( void ); // Added
 extern void PWM_I2C_Timer2A_Handler( void); // Added
+extern void PWM_I2C_I2C0_Handler( void ); // Added
+extern void PWM_I2C_PWM0Gen0_Handler( void ); // Added
+extern void ADC_Audio_ADC0Seq3_Handler( void ); // Added
+extern void Telemetry_UART5_Handler( void ); // Added
+extern void Wind_Rain_WTimer3A_Handler( void ); // Added
+extern void Wind_Rain_WTimer3B_Handler( void ); // Added
+extern void ADC_Supply_ADC1Seq1_Handler( void ); // Added
 
 typedef void( *intfunc )( void );
 typedef union { intfunc __fun; void * __ptr; } intvec_elem;
@@ -60,25 +69,25 @@ const intvec_elem __vector_table[] =
   DebugMon_Handler,
   0,
   PendSV_Handler,
-  SysTick_Handler, // IRQ -1
+  CSMA_SysTick_Handler, // IRQ -1
   0, // IRQ 0
   0, // IRQ 1
   0,
   0,
   0,
-  0, // IRQ 5
+  KISS_UART0_Handler, // IRQ 5
   UART1_Handler,
+  LCD_SSI0_Handler, // IRQ 7
+  PWM_I2C_I2C0_Handler, // IRQ 8
   0,
-  0,
-  0,
-  0, // IRQ 10
+  PWM_I2C_PWM0Gen0_Handler, // IRQ 10
   0,
   0,
   0,
   0,
   0, // IRQ 15
   0,
-  0,
+  ADC_Audio_ADC0Seq3_Handler, // IRQ 17
   0,
   OneWire_Timer0A_Handler, // IRQ 19
   0,
@@ -92,6 +101,77 @@ const intvec_elem __vector_table[] =
   0,
   0,
   0, // IRQ 30
+  0,
+  0,
+  0,
+  0,
+  0, // IRQ 35
+  0,
+  0,
+  0,
+  0,
+  0, // IRQ 40
+  0,
+  0,
+  0,
+  0,
+  0, // IRQ 45
+  0,
+  0,
+  0,
+  ADC_Supply_ADC1Seq1_Handler, // IRQ 49
+  0, // IRQ 50
+  0,
+  0,
+  0,
+  0,
+  0, // IRQ 55
+  0,
+  0,
+  0,
+  0,
+  0, // IRQ 60
+  Telemetry_UART5_Handler, // IRQ 61
+  0,
+  0,
+  0,
+  0, // IRQ 65
+  0,
+  0,
+  0,
+  0,
+  0, // IRQ 70
+  0,
+  0,
+  0,
+  0,
+  0, // IRQ 75
+  0,
+  0,
+  0,
+  0,
+  0, // IRQ 80
+  0,
+  0,
+  0,
+  0,
+  0, // IRQ 85
+  0,
+  0,
+  0,
+  0,
+  0, // IRQ 90
+  0,
+  0,
+  0,
+  0,
+  0, // IRQ 95
+  0,
+  0,
+  0,
+  0,
+  Wind_Rain_WTimer3A_Handler, // IRQ 100
+  Wind_Rain_WTimer3B_Handler, // IRQ 101
 };
 
 #pragma call_graph_root = "interrupt"
@@ -111,15 +191,32 @@ __weak void DebugMon_Handler( void ) { while (1) {} }
 #pragma call_graph_root = "interrupt"
 __weak void PendSV_Handler( void ) { while (1) {} }
 #pragma call_graph_root = "interrupt"
-__weak void SysTick_Handler( void ) { while (1) {} }
+__weak void CSMA_SysTick_Handler( void ) { while (1) {} } // Added
 #pragma call_graph_root = "interrupt"
 __weak void OneWire_Timer0A_Handler( void ) { while (1) {} } // Added
 #pragma call_graph_root = "interrupt"
 __weak void Timer1A_Handler( void ) { while (1) {} } // Added
 #pragma call_graph_root = "interrupt"
+__weak void KISS_UART0_Handler( void ) { while (1) {} } // Added
+#pragma call_graph_root = "interrupt"
 __weak void UART1_Handler( void ) { while (1) {} } // Added
 #pragma call_graph_root = "interrupt"
+__weak void LCD_SSI0_Handler( void ) { while (1) {} } // Added
+#pragma call_graph_root = "interrupt"
 __weak void PWM_I2C_Timer2A_Handler( void ) { while (1) {} } // Added
+#pragma call_graph_root = "interrupt"
+__weak void PWM_I2C_I2C0_Handler( void ) { while (1) {} } // Added
+#pragma call_graph_root = "interrupt"
+__weak void PWM_I2C_PWM0Gen0_Handler( void ) { while (1) {} } // Added
+#pragma call_graph_root = "interrupt"
+__weak void ADC_Audio_ADC0Seq3_Handler( void ) { while (1) {} } // Added
+#pragma call_graph_root = "interrupt"
+__weak void Telemetry_UART5_Handler( void ) { while (1) {} } // Added
+#pragma call_graph_root = "interrupt"
+__weak void Wind_Rain_WTimer3A_Handler( void ) { while (1) {} } // Added
+__weak void Wind_Rain_WTimer3B_Handler( void ) { while (1) {} } // Added
+#pragma call_graph_root = "interrupt"
+__weak void ADC_Supply_ADC1Seq1_Handler( void ) { while (1) {} } // Added
 
 void __cmain( void );
 __weak void __iar_init_core( void );
@@ -0,0 +1,232 @@
+// APRS WIDEn-N digipeater
+//
+// Follows the New-N paradigm: a UI frame is relayed if the first
+// unused path entry is our callsign or WIDEn-N with N > 0 and n
+// no more than DIGI_MAX_HOPS. We decrement N (marking the hop used
+// at zero) and insert our callsign as a used hop ahead of it.
+//
+// Duplicates are found in a fixed size open addressing hash table
+// keyed by CRCs of the source / destination and the information
+// field (the path changes hop to hop so it is left out). Entries
+// expire after DIGI_DUPLICATE_SECONDS; probing is bounded so each
+// lookup touches at most DIGI_MAX_PROBES entries.
+
+#include "digi.h"
+#include "aprs.h"
+#include "ax25.h"
+#include "csma.h"
+#include "rda1846.h"
+
+// Power of two, so the hash folds with a mask
+#define DIGI_TABLE_SIZE 64
+#define DIGI_TABLE_MASK ( DIGI_TABLE_SIZE - 1 )
+#define DIGI_MAX_PROBES 8
+
+#define DIGI_MAX_HOPS 2
+
+typedef struct Digi_Entries {
+	uint32_t digest;
+	uint32_t seconds;
+} Digi_Entry;
+
+static Digi_Entry table[DIGI_TABLE_SIZE];
+static volatile uint32_t digiSeconds = 0;
+
+static uint8_t ourAddress[AX25_ADDRESS_LENGTH];
+static uint8_t relayFrame[AX25_MAX_FRAME_LENGTH];
+
+static uint32_t digiFramesRelayed = 0;
+static uint32_t digiDuplicatesDropped = 0;
+static uint32_t digiLookups = 0;
+static uint32_t digiProbes = 0;
+
+uint8_t _Digi_Same_Station( uint8_t *a, uint8_t *b ) {
+	for ( uint8_t i=0; i < 6; i++ ) {
+		if ( a[i] != b[i] ) {
+			return 0;
+		}
+	}
+	return ( a[6] & AX25_SSID_MASK ) == ( b[6] & AX25_SSID_MASK );
+}
+
+/*
+ * Looks the digest up and records it
+ * Returns 1 if it was already seen inside the duplicate window
+ */
+uint8_t _Digi_Check_And_Insert( uint32_t digest ) {
+	uint32_t now = digiSeconds;
+	uint8_t index = ( digest ^ ( digest >> 16 ) ) & DIGI_TABLE_MASK;
+	uint8_t replace = index;
+	uint32_t oldest = 0;
+
+	digiLookups++;
+
+	for ( uint8_t probe=0; probe < DIGI_MAX_PROBES; probe++ ) {
+		Digi_Entry *entry = &table[( index + probe ) & DIGI_TABLE_MASK];
+		uint32_t age = now - entry->seconds;
+
+		digiProbes++;
+
+		if ( ( entry->digest == digest ) && ( age < DIGI_DUPLICATE_SECONDS ) ) {
+			return 1;
+		}
+
+		// Remember the stalest slot to reuse
+		if ( age > oldest ) {
+			oldest = age;
+			replace = ( index + probe ) & DIGI_TABLE_MASK;
+		}
+
+		// Never used - nothing lives further along this probe run
+		if ( ( 0 == entry->digest ) && ( 0 == entry->seconds ) ) {
+			replace = ( index + probe ) & DIGI_TABLE_MASK;
+			break;
+		}
+	}
+
+	table[replace].digest = digest;
+	table[replace].seconds = now;
+	return 0;
+}
+
+void Digi_Init() {
+	for ( uint8_t i=0; i < DIGI_TABLE_SIZE; i++ ) {
+		table[i].digest = 0;
+		table[i].seconds = 0;
+	}
+
+	// Start the clock past the window so empty entries read as expired
+	digiSeconds = DIGI_DUPLICATE_SECONDS;
+
+	AX25_Encode_Address( ourAddress, APRS_CALLSIGN );
+}
+
+void Digi_Tick_Second() {
+	digiSeconds++;
+}
+
+/*
+ * Receive path callback: frame is a good AX.25 frame without FCS
+ */
+void Digi_Receive_Frame( uint8_t *frame, uint16_t length ) {
+	uint16_t addressEnd = 0;
+
+	// Find the end of the address field
+	while ( addressEnd + AX25_ADDRESS_LENGTH <= length ) {
+		addressEnd += AX25_ADDRESS_LENGTH;
+		if ( frame[addressEnd - 1] & AX25_LAST_ADDRESS_BIT ) {
+			break;
+		}
+	}
+	if ( ( addressEnd < 2 * AX25_ADDRESS_LENGTH ) || !( frame[addressEnd - 1] & AX25_LAST_ADDRESS_BIT ) ) {
+		return;
+	}
+
+	// APRS is UI frames only - connected mode traffic is left alone
+	uint16_t information = addressEnd + 2;
+	if ( ( information > length ) || ( AX25_CONTROL_UI != frame[addressEnd] ) ||
+		( AX25_PID_NO_LAYER_3 != frame[addressEnd + 1] ) ) {
+		return;
+	}
+
+	uint8_t digipeaters = addressEnd / AX25_ADDRESS_LENGTH - 2;
+
+	// Ignore our own frames coming back
+	if ( _Digi_Same_Station( &frame[AX25_ADDRESS_LENGTH], ourAddress ) ) {
+		return;
+	}
+
+	// First path entry not yet used
+	uint8_t hop = 0;
+	while ( ( hop < digipeaters ) && ( frame[( 2 + hop ) * AX25_ADDRESS_LENGTH + 6] & AX25_H_BIT ) ) {
+		hop++;
+	}
+	if ( hop >= digipeaters ) {
+		return;
+	}
+
+	uint8_t *address = &frame[( 2 + hop ) * AX25_ADDRESS_LENGTH];
+	uint8_t directed = _Digi_Same_Station( address, ourAddress );
+	uint8_t remaining = ( address[6] & AX25_SSID_MASK ) >> 1;
+
+	if ( ! directed ) {
+		// WIDEn-N: "WIDE" then a digit 1..DIGI_MAX_HOPS, then a space
+		uint8_t n = ( address[4] >> 1 ) - '0';
+		if ( ( ( address[0] >> 1 ) != 'W' ) || ( ( address[1] >> 1 ) != 'I' ) ||
+			( ( address[2] >> 1 ) != 'D' ) || ( ( address[3] >> 1 ) != 'E' ) ||
+			( ( address[5] >> 1 ) != ' ' ) || ( n < 1 ) || ( n > DIGI_MAX_HOPS ) ||
+			( 0 == remaining ) || ( remaining > n ) ) {
+			return;
+		}
+	}
+
+	// Digest: source and destination CRC in the top half, information field in the bottom
+	uint32_t digest = ( (uint32_t) AX25_Compute_FCS( frame, 2 * AX25_ADDRESS_LENGTH ) << 16 ) |
+		AX25_Compute_FCS( &frame[information], length - information );
+
+	if ( _Digi_Check_And_Insert( digest ) ) {
+		digiDuplicatesDropped++;
+		return;
+	}
+
+	// Build the relayed frame: used hops, our callsign, the rest
+	uint8_t insert = ! directed && ( digipeaters < AX25_MAX_DIGIPEATERS );
+	uint16_t hopOffset = ( 2 + hop ) * AX25_ADDRESS_LENGTH;
+	uint16_t relayLength = 0;
+
+	if ( length + ( insert ? AX25_ADDRESS_LENGTH : 0 ) > AX25_MAX_FRAME_LENGTH ) {
+		return;
+	}
+
+	for ( uint16_t i=0; i < hopOffset; i++ ) {
+		relayFrame[relayLength++] = frame[i];
+	}
+
+	if ( insert ) {
+		for ( uint8_t i=0; i < AX25_ADDRESS_LENGTH; i++ ) {
+			relayFrame[relayLength++] = ourAddress[i];
+		}
+		relayFrame[relayLength - 1] = ( ourAddress[6] & ~AX25_LAST_ADDRESS_BIT ) | AX25_H_BIT;
+	}
+
+	for ( uint16_t i=hopOffset; i < length; i++ ) {
+		relayFrame[relayLength++] = frame[i];
+	}
+
+	uint8_t *relayed = &relayFrame[hopOffset + ( insert ? AX25_ADDRESS_LENGTH : 0 )];
+	if ( directed ) {
+		relayed[6] |= AX25_H_BIT;
+	} else {
+		remaining--;
+		relayed[6] = ( relayed[6] & ~AX25_SSID_MASK ) | ( remaining << 1 );
+		if ( 0 == remaining ) {
+			relayed[6] |= AX25_H_BIT;
+		}
+	}
+
+	if ( RDA1846_Send_Packet( CSMA_SOURCE_DIGI, relayFrame, relayLength ) ) {
+		digiFramesRelayed++;
+	}
+}
+
+void Digi_Get_Stats( uint32_t *framesRelayed, uint32_t *duplicatesDropped, uint32_t *lookups, uint32_t *probes ) {
+	if ( framesRelayed ) {
+		*framesRelayed = digiFramesRelayed;
+	}
+	if ( duplicatesDropped ) {
+		*duplicatesDropped = digiDuplicatesDropped;
+	}
+	if ( lookups ) {
+		*lookups = digiLookups;
+	}
+	if ( probes ) {
+		*probes = digiProbes;
+	}
+}
+
+/*
+ * RAM held by the duplicate table
+ */
+uint16_t Digi_Get_Table_Bytes() {
+	return sizeof( table );
+}
@@ -0,0 +1,19 @@
+// APRS WIDEn-N digipeater
+//
+// Relays frames heard on the receive path, dropping duplicates
+// seen within the last DIGI_DUPLICATE_SECONDS
+
+#ifndef __DIGI_H
+#define __DIGI_H
+
+#include "stdint.h"
+
+#define DIGI_DUPLICATE_SECONDS 30
+
+void Digi_Init();
+void Digi_Tick_Second();
+void Digi_Receive_Frame( uint8_t *frame, uint16_t length );
+void Digi_Get_Stats( uint32_t *framesRelayed, uint32_t *duplicatesDropped, uint32_t *lookups, uint32_t *probes );
+uint16_t Digi_Get_Table_Bytes();
+
+#endif // __DIGI_H
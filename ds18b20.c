@@ -4,8 +4,7 @@
 
 #include "ds18b20.h"
 #include "onewire.h"
-
-#include "stdio.h" // TODO REMOVE AFTER DEBUGGING
+#include "telemetry.h"
 
 #define DS18B20_SCRATCHPAD_LENGTH 9
 
@@ -20,7 +19,7 @@ uint8_t DS18B20_Data_Valid() {
 
 void _DS18B20_Devices_Present_CB( uint8_t data ) {
 	// TODO
-	printf( "_DS18B20_Devices_Present_CB: %hu\n", data );
+	Telemetry_Send_Event( TELEMETRY_EVENT_ONEWIRE_PRESENCE, data );
 }
 
 void _DS18B20_Read_Scratchpad_Callback( uint8_t data ) {
@@ -0,0 +1,477 @@
+// Persistent observation log for the TM4C123-WX station
+//
+// The log region is a ring of 128 byte pages, eight to a 1 KB
+// erase sector. Observations collect in a page in RAM and the
+// page is programmed in one go through the flash write buffer
+// when it fills (or gets an hour old), so each page is written
+// exactly once between erases. Moving into a sector erases it,
+// dropping the oldest eight pages - every sector sees one erase
+// per trip around the ring, which is all the wear leveling a
+// log like this needs.
+//
+// Each page starts with a sequence number and a full
+// observation, followed by small deltas for the rest, and ends
+// with the AX.25 CRC-16 over everything before it. A page cut
+// short by a power failure fails its CRC and is skipped.
+//
+// After each page is committed, EEPROM block 1 is updated with
+// its index and sequence. At boot the page it names is checked
+// and the scan only walks forward from there past any pages
+// committed after the last EEPROM update. If the EEPROM copy
+// doesn't check out, the first page of each sector is enough to
+// find the newest sector.
+//
+// tm4c123-wx.icf ends the program's ROM region at 0x2FFFF, so the
+// log region is never linked over.
+//
+// Erasing and programming stall instruction fetches from flash
+// for a few milliseconds (an erase up to ~15 ms), which delays
+// interrupts but loses nothing - audio samples are collected by
+// the uDMA.
+
+#include "flash-log.h"
+#include "ax25.h"
+#include "tm4c123gh6pm.h"
+
+#define FLASH_LOG_START 0x00030000
+#define FLASH_LOG_SECTOR_SIZE 1024
+#define FLASH_LOG_SECTORS 64
+#define FLASH_LOG_PAGE_WORDS 32
+#define FLASH_LOG_PAGES_PER_SECTOR 8
+
+#define FLASH_LOG_ERASED 0xFFFFFFFF
+
+// Sequence, first observation time and values, count and used
+#define FLASH_LOG_HEADER_BYTES ( 10 + 2 * FLASH_LOG_VALUES )
+#define FLASH_LOG_DELTA_BYTES ( FLASH_LOG_PAGE_SIZE - FLASH_LOG_HEADER_BYTES - 2 )
+#define FLASH_LOG_CRC_BYTES ( FLASH_LOG_PAGE_SIZE - 2 )
+
+// Each further observation: seconds since the previous one, then
+// the change in each value
+#define FLASH_LOG_RECORD_BYTES ( 1 + FLASH_LOG_VALUES )
+
+// Commit a page that has been open this long even if not full
+#define FLASH_LOG_MAX_PAGE_SECONDS 3600
+
+#define FLASH_LOG_EEPROM_BLOCK 1
+#define FLASH_LOG_EEPROM_MAGIC 0x574C4F47
+
+// Flash write key when BOOTCFG KEY is clear
+#define FLASH_LOG_ALTERNATE_KEY 0x71D50000
+
+#define FLASH_LOG_FWB ((volatile uint32_t *)0x400FD100)
+
+typedef union Flash_Log_Pages {
+	uint32_t words[FLASH_LOG_PAGE_WORDS];
+	uint8_t bytes[FLASH_LOG_PAGE_SIZE];
+	struct {
+		uint32_t sequence;
+		uint32_t seconds;
+		int16_t values[FLASH_LOG_VALUES];
+		uint8_t count;
+		uint8_t used;
+		uint8_t deltas[FLASH_LOG_DELTA_BYTES];
+		uint16_t crc;
+	} fields;
+} Flash_Log_Page;
+
+static Flash_Log_Page openPage;
+static uint8_t pageOpen = 0;
+static uint32_t lastSeconds;
+static int16_t lastValues[FLASH_LOG_VALUES];
+
+// Next page to program and the sequence it gets
+static uint16_t headPage = 0;
+static uint32_t nextSequence = 1;
+
+static uint8_t eepromReady = 0;
+
+static uint32_t logObservations = 0;
+static uint32_t logPagesWritten = 0;
+static uint32_t logSectorsErased = 0;
+static uint32_t logPagesSkipped = 0;
+
+const Flash_Log_Page *_Flash_Log_Page( uint16_t page ) {
+	return (const Flash_Log_Page *) ( FLASH_LOG_START + (uint32_t) page * FLASH_LOG_PAGE_SIZE );
+}
+
+uint16_t _Flash_Log_Next_Page( uint16_t page ) {
+	page++;
+	if ( FLASH_LOG_PAGES == page ) {
+		page = 0;
+	}
+	return page;
+}
+
+uint8_t _Flash_Log_Page_Valid( const Flash_Log_Page *page ) {
+	if ( FLASH_LOG_ERASED == page->fields.sequence ) {
+		return 0;
+	}
+	return page->fields.crc == AX25_Compute_FCS( (uint8_t *) page->bytes, FLASH_LOG_CRC_BYTES );
+}
+
+uint8_t _Flash_Log_Page_Erased( const Flash_Log_Page *page ) {
+	for ( uint8_t i=0; i < FLASH_LOG_PAGE_WORDS; i++ ) {
+		if ( FLASH_LOG_ERASED != page->words[i] ) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+uint32_t _Flash_Log_Key() {
+	return ( FLASH_BOOTCFG_R & FLASH_BOOTCFG_KEY ) ? FLASH_FMC_WRKEY : FLASH_LOG_ALTERNATE_KEY;
+}
+
+void _Flash_Log_Erase_Sector( uint16_t page ) {
+	FLASH_FMA_R = FLASH_LOG_START + (uint32_t) page * FLASH_LOG_PAGE_SIZE;
+	FLASH_FMC_R = _Flash_Log_Key() | FLASH_FMC_ERASE;
+	while ( FLASH_FMC_R & FLASH_FMC_ERASE ) {
+	}
+	logSectorsErased++;
+}
+
+/*
+ * Programs all 32 words of a page through the write buffer
+ * Returns 0 if the page doesn't read back as written
+ */
+uint8_t _Flash_Log_Program_Page( uint16_t page, const uint32_t *words ) {
+	FLASH_FMA_R = FLASH_LOG_START + (uint32_t) page * FLASH_LOG_PAGE_SIZE;
+	for ( uint8_t i=0; i < FLASH_LOG_PAGE_WORDS; i++ ) {
+		FLASH_LOG_FWB[i] = words[i];
+	}
+	FLASH_FMC2_R = _Flash_Log_Key() | FLASH_FMC2_WRBUF;
+	while ( FLASH_FMC2_R & FLASH_FMC2_WRBUF ) {
+	}
+
+	const Flash_Log_Page *written = _Flash_Log_Page( page );
+	for ( uint8_t i=0; i < FLASH_LOG_PAGE_WORDS; i++ ) {
+		if ( written->words[i] != words[i] ) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+uint8_t _Flash_Log_EEPROM_Init() {
+	volatile uint32_t delay;
+
+	SYSCTL_RCGCEEPROM_R |= 0x01;
+	delay = SYSCTL_RCGCEEPROM_R;
+	while ( 0 == ( SYSCTL_PREEPROM_R & 0x01 ) ) {
+	}
+
+	while ( EEPROM_EEDONE_R & EEPROM_EEDONE_WORKING ) {
+	}
+
+	// A failed copy buffer recovery leaves the EEPROM unusable
+	if ( EEPROM_EESUPP_R & ( EEPROM_EESUPP_PRETRY | EEPROM_EESUPP_ERETRY ) ) {
+		return 0;
+	}
+	return 1;
+}
+
+void _Flash_Log_EEPROM_Write( uint32_t word ) {
+	EEPROM_EERDWRINC_R = word;
+	while ( EEPROM_EEDONE_R & EEPROM_EEDONE_WORKING ) {
+	}
+}
+
+/*
+ * Records the newest committed page in EEPROM
+ */
+void _Flash_Log_Save_Head( uint16_t page, uint32_t sequence ) {
+	if ( ! eepromReady ) {
+		return;
+	}
+	EEPROM_EEBLOCK_R = FLASH_LOG_EEPROM_BLOCK;
+	EEPROM_EEOFFSET_R = 0;
+	_Flash_Log_EEPROM_Write( FLASH_LOG_EEPROM_MAGIC );
+	_Flash_Log_EEPROM_Write( page );
+	_Flash_Log_EEPROM_Write( sequence );
+}
+
+/*
+ * Looks up the newest committed page named in EEPROM
+ * Returns 0 if there is none or it doesn't match the flash
+ */
+uint8_t _Flash_Log_Load_Head( uint16_t *page, uint32_t *sequence ) {
+	if ( ! eepromReady ) {
+		return 0;
+	}
+	EEPROM_EEBLOCK_R = FLASH_LOG_EEPROM_BLOCK;
+	EEPROM_EEOFFSET_R = 0;
+	uint32_t magic = EEPROM_EERDWRINC_R;
+	uint32_t savedPage = EEPROM_EERDWRINC_R;
+	uint32_t savedSequence = EEPROM_EERDWRINC_R;
+
+	if ( ( FLASH_LOG_EEPROM_MAGIC != magic ) || ( savedPage >= FLASH_LOG_PAGES ) ) {
+		return 0;
+	}
+
+	const Flash_Log_Page *newest = _Flash_Log_Page( savedPage );
+	if ( ! _Flash_Log_Page_Valid( newest ) || ( newest->fields.sequence != savedSequence ) ) {
+		return 0;
+	}
+
+	*page = savedPage;
+	*sequence = savedSequence;
+	return 1;
+}
+
+/*
+ * Finds the newest sector from the first good page of each
+ * Returns 0 if the log is empty
+ */
+uint8_t _Flash_Log_Scan_Sectors( uint16_t *page, uint32_t *sequence ) {
+	uint8_t found = 0;
+
+	for ( uint16_t sector=0; sector < FLASH_LOG_SECTORS; sector++ ) {
+		for ( uint8_t i=0; i < FLASH_LOG_PAGES_PER_SECTOR; i++ ) {
+			uint16_t candidate = sector * FLASH_LOG_PAGES_PER_SECTOR + i;
+			const Flash_Log_Page *first = _Flash_Log_Page( candidate );
+			if ( _Flash_Log_Page_Valid( first ) ) {
+				if ( ! found || ( first->fields.sequence > *sequence ) ) {
+					*page = candidate;
+					*sequence = first->fields.sequence;
+					found = 1;
+				}
+				break;
+			}
+		}
+	}
+
+	return found;
+}
+
+void Flash_Log_Init() {
+	uint16_t newestPage = 0;
+	uint32_t newestSequence = 0;
+
+	eepromReady = _Flash_Log_EEPROM_Init();
+
+	if ( ! _Flash_Log_Load_Head( &newestPage, &newestSequence ) ) {
+		if ( ! _Flash_Log_Scan_Sectors( &newestPage, &newestSequence ) ) {
+			// Empty log - start at the bottom of the region
+			headPage = 0;
+			nextSequence = 1;
+			pageOpen = 0;
+			return;
+		}
+	}
+
+	// Walk past anything committed after the newest page we know
+	// of, stopping at an erased page or the previous lap's data
+	uint16_t page = _Flash_Log_Next_Page( newestPage );
+	for ( uint16_t i=1; i < FLASH_LOG_PAGES; i++ ) {
+		const Flash_Log_Page *next = _Flash_Log_Page( page );
+		if ( _Flash_Log_Page_Erased( next ) ) {
+			break;
+		}
+		if ( _Flash_Log_Page_Valid( next ) ) {
+			if ( next->fields.sequence <= newestSequence ) {
+				break;
+			}
+			newestSequence = next->fields.sequence;
+		}
+		page = _Flash_Log_Next_Page( page );
+	}
+
+	headPage = page;
+	nextSequence = newestSequence + 1;
+	pageOpen = 0;
+}
+
+/*
+ * Programs the open page into the next usable page of the ring
+ */
+void _Flash_Log_Commit() {
+	if ( ! pageOpen ) {
+		return;
+	}
+
+	openPage.fields.sequence = nextSequence;
+	openPage.fields.crc = AX25_Compute_FCS( openPage.bytes, FLASH_LOG_CRC_BYTES );
+
+	// Give up after a full lap of pages that won't take a write
+	for ( uint16_t attempts=0; attempts < FLASH_LOG_PAGES; attempts++ ) {
+		uint16_t page = headPage;
+		headPage = _Flash_Log_Next_Page( headPage );
+
+		if ( 0 == ( page % FLASH_LOG_PAGES_PER_SECTOR ) ) {
+			_Flash_Log_Erase_Sector( page );
+		} else if ( ! _Flash_Log_Page_Erased( _Flash_Log_Page( page ) ) ) {
+			// Left over from a power failure
+			logPagesSkipped++;
+			continue;
+		}
+
+		if ( _Flash_Log_Program_Page( page, openPage.words ) ) {
+			logPagesWritten++;
+			_Flash_Log_Save_Head( page, nextSequence );
+			nextSequence++;
+			break;
+		}
+		logPagesSkipped++;
+	}
+
+	pageOpen = 0;
+}
+
+void _Flash_Log_Open( uint32_t seconds, int16_t *values ) {
+	for ( uint8_t i=0; i < FLASH_LOG_PAGE_WORDS; i++ ) {
+		openPage.words[i] = FLASH_LOG_ERASED;
+	}
+	openPage.fields.seconds = seconds;
+	for ( uint8_t v=0; v < FLASH_LOG_VALUES; v++ ) {
+		openPage.fields.values[v] = values[v];
+	}
+	openPage.fields.count = 1;
+	openPage.fields.used = 0;
+	pageOpen = 1;
+}
+
+/*
+ * Adds an observation to the open page, committing the page
+ * first if the observation can't be added as a small delta
+ * values: FLASH_LOG_VALUES readings, FLASH_LOG_NO_VALUE if missing
+ */
+void Flash_Log_Append( uint32_t seconds, int16_t *values ) {
+	uint8_t fits = pageOpen;
+
+	if ( fits ) {
+		uint32_t elapsed = seconds - lastSeconds;
+		if ( ( seconds < lastSeconds ) || ( elapsed > 0xFF ) ||
+			( seconds - openPage.fields.seconds > FLASH_LOG_MAX_PAGE_SECONDS ) ||
+			( openPage.fields.used + FLASH_LOG_RECORD_BYTES > FLASH_LOG_DELTA_BYTES ) ) {
+			fits = 0;
+		}
+
+		// Changes to or from a missing value never fit
+		for ( uint8_t v=0; v < FLASH_LOG_VALUES; v++ ) {
+			int32_t change = (int32_t) values[v] - lastValues[v];
+			if ( ( change > 127 ) || ( change < -127 ) ) {
+				fits = 0;
+			}
+		}
+	}
+
+	if ( fits ) {
+		uint8_t *record = &openPage.fields.deltas[openPage.fields.used];
+		record[0] = seconds - lastSeconds;
+		for ( uint8_t v=0; v < FLASH_LOG_VALUES; v++ ) {
+			record[1 + v] = (uint8_t) (int8_t) ( values[v] - lastValues[v] );
+		}
+		openPage.fields.used += FLASH_LOG_RECORD_BYTES;
+		openPage.fields.count++;
+	} else {
+		_Flash_Log_Commit();
+		_Flash_Log_Open( seconds, values );
+	}
+
+	lastSeconds = seconds;
+	for ( uint8_t v=0; v < FLASH_LOG_VALUES; v++ ) {
+		lastValues[v] = values[v];
+	}
+	logObservations++;
+}
+
+/*
+ * Commits the open page now, e.g. before a planned power down
+ */
+void Flash_Log_Flush() {
+	_Flash_Log_Commit();
+}
+
+uint32_t _Flash_Log_Read_Page( const Flash_Log_Page *page, uint32_t sinceSeconds, void (*callback)( uint32_t seconds, int16_t *values ) ) {
+	uint32_t seconds = page->fields.seconds;
+	int16_t values[FLASH_LOG_VALUES];
+	uint32_t delivered = 0;
+
+	for ( uint8_t v=0; v < FLASH_LOG_VALUES; v++ ) {
+		values[v] = page->fields.values[v];
+	}
+
+	for ( uint8_t i=0; i < page->fields.count; i++ ) {
+		if ( i ) {
+			const uint8_t *record = &page->fields.deltas[( i - 1 ) * FLASH_LOG_RECORD_BYTES];
+			seconds += record[0];
+			for ( uint8_t v=0; v < FLASH_LOG_VALUES; v++ ) {
+				values[v] += (int8_t) record[1 + v];
+			}
+		}
+		if ( seconds >= sinceSeconds ) {
+			callback( seconds, values );
+			delivered++;
+		}
+	}
+
+	return delivered;
+}
+
+/*
+ * Replays the logged observations from sinceSeconds on, oldest
+ * first, including those not yet committed to flash
+ * Returns the number of observations passed to the callback
+ */
+uint32_t Flash_Log_Read( uint32_t sinceSeconds, void (*callback)( uint32_t seconds, int16_t *values ) ) {
+	uint32_t delivered = 0;
+
+	// The ring after the head holds the oldest pages
+	uint16_t page = headPage;
+	for ( uint16_t i=0; i < FLASH_LOG_PAGES; i++ ) {
+		const Flash_Log_Page *logged = _Flash_Log_Page( page );
+		if ( _Flash_Log_Page_Valid( logged ) && ( logged->fields.sequence < nextSequence ) ) {
+			delivered += _Flash_Log_Read_Page( logged, sinceSeconds, callback );
+		}
+		page = _Flash_Log_Next_Page( page );
+	}
+
+	if ( pageOpen ) {
+		delivered += _Flash_Log_Read_Page( &openPage, sinceSeconds, callback );
+	}
+
+	return delivered;
+}
+
+/*
+ * The next page to be programmed - the pages after it hold the
+ * oldest observations
+ */
+uint16_t Flash_Log_Get_Head() {
+	return headPage;
+}
+
+/*
+ * Committed page as stored in flash, 0 if erased or not intact
+ */
+const uint8_t *Flash_Log_Get_Page( uint16_t page ) {
+	if ( page >= FLASH_LOG_PAGES ) {
+		return 0;
+	}
+
+	const Flash_Log_Page *logged = _Flash_Log_Page( page );
+	if ( ! _Flash_Log_Page_Valid( logged ) || ( logged->fields.sequence >= nextSequence ) ) {
+		return 0;
+	}
+	return logged->bytes;
+}
+
+/*
+ * Observations appended, pages programmed, sectors erased and
+ * pages skipped over as unusable since boot
+ */
+void Flash_Log_Get_Stats( uint32_t *observations, uint32_t *pagesWritten, uint32_t *sectorsErased, uint32_t *pagesSkipped ) {
+	if ( observations ) {
+		*observations = logObservations;
+	}
+	if ( pagesWritten ) {
+		*pagesWritten = logPagesWritten;
+	}
+	if ( sectorsErased ) {
+		*sectorsErased = logSectorsErased;
+	}
+	if ( pagesSkipped ) {
+		*pagesSkipped = logPagesSkipped;
+	}
+}
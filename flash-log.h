@@ -0,0 +1,27 @@
+// Persistent observation log for the TM4C123-WX station
+//
+// Observations go to the top 64 KB of flash (0x30000 - 0x3FFFF),
+// with the position of the newest page kept in EEPROM block 1
+
+#ifndef __FLASH_LOG_H
+#define __FLASH_LOG_H
+
+#include "stdint.h"
+#include "history.h"
+
+// One value per history channel in each observation
+#define FLASH_LOG_VALUES HISTORY_CHANNELS
+#define FLASH_LOG_NO_VALUE INT16_MIN
+
+#define FLASH_LOG_PAGE_SIZE 128
+#define FLASH_LOG_PAGES 512
+
+void Flash_Log_Init();
+void Flash_Log_Append( uint32_t seconds, int16_t *values );
+void Flash_Log_Flush();
+uint32_t Flash_Log_Read( uint32_t sinceSeconds, void (*callback)( uint32_t seconds, int16_t *values ) );
+uint16_t Flash_Log_Get_Head();
+const uint8_t *Flash_Log_Get_Page( uint16_t page );
+void Flash_Log_Get_Stats( uint32_t *observations, uint32_t *pagesWritten, uint32_t *sectorsErased, uint32_t *pagesSkipped );
+
+#endif // __FLASH_LOG_H
@@ -0,0 +1,129 @@
+// Fixed-width number formatting for the LCD and APRS reports
+//
+// Every function writes exactly width characters and returns
+// width, so calls can be chained along a line. Values too wide
+// for their field keep their least significant digits.
+
+#include "format.h"
+
+// n / 91 == ( n * 0xB40B40B5 ) >> 38 for every n below 2^31
+#define FORMAT_BASE91_RECIPROCAL 0xB40B40B5
+#define FORMAT_BASE91_SHIFT 38
+
+/*
+ * Right aligned decimal, padded on the left with pad ('0' or ' ')
+ */
+uint8_t Format_Unsigned( char *dest, uint32_t value, uint8_t width, char pad ) {
+	uint8_t i = width;
+
+	if ( 0 == width ) {
+		return 0;
+	}
+
+	// Always at least one digit
+	do {
+		i--;
+		dest[i] = '0' + ( value % 10 );
+		value = value / 10;
+	} while ( i && value );
+
+	while ( i ) {
+		i--;
+		dest[i] = pad;
+	}
+
+	return width;
+}
+
+/*
+ * Puts a minus sign just ahead of the first digit of a space
+ * padded field, over the leading digit if there is no room
+ */
+void _Format_Sign( char *dest, uint8_t width ) {
+	uint8_t i = 0;
+	while ( ( i < width ) && ( ' ' == dest[i] ) ) {
+		i++;
+	}
+	dest[i ? i - 1 : 0] = '-';
+}
+
+/*
+ * Right aligned signed decimal. Zero padding puts the sign in
+ * the first column ("-05"), space padding next to the digits (" -5")
+ */
+uint8_t Format_Signed( char *dest, int32_t value, uint8_t width, char pad ) {
+	if ( ( value >= 0 ) || ( 0 == width ) ) {
+		return Format_Unsigned( dest, value, width, pad );
+	}
+
+	uint32_t magnitude = - (uint32_t) value;
+
+	if ( '0' == pad ) {
+		dest[0] = '-';
+		if ( width > 1 ) {
+			Format_Unsigned( &dest[1], magnitude, width - 1, '0' );
+		}
+		return width;
+	}
+
+	Format_Unsigned( dest, magnitude, width, ' ' );
+	_Format_Sign( dest, width );
+
+	return width;
+}
+
+/*
+ * Space padded fixed point: value is in units of 10^-decimals,
+ * e.g. Format_Fixed( dest, -1234, 2, 7 ) gives " -12.34"
+ */
+uint8_t Format_Fixed( char *dest, int32_t value, uint8_t decimals, uint8_t width ) {
+	if ( ( 0 == decimals ) || ( width < decimals + 2 ) ) {
+		return Format_Signed( dest, value, width, ' ' );
+	}
+
+	uint32_t magnitude = ( value < 0 ) ? - (uint32_t) value : (uint32_t) value;
+	uint8_t point = width - decimals - 1;
+
+	uint32_t scale = 1;
+	for ( uint8_t i=0; i < decimals; i++ ) {
+		scale *= 10;
+	}
+
+	Format_Unsigned( dest, magnitude / scale, point, ' ' );
+	dest[point] = '.';
+	Format_Unsigned( &dest[point + 1], magnitude % scale, decimals, '0' );
+
+	if ( value < 0 ) {
+		_Format_Sign( dest, point );
+	}
+
+	return width;
+}
+
+/*
+ * width Base91 digits, most significant first
+ * Uses a reciprocal multiply instead of dividing by 91
+ */
+uint8_t Format_Base91( char *dest, uint32_t value, uint8_t width ) {
+	uint8_t i = width;
+
+	while ( i ) {
+		i--;
+		uint32_t quotient = (uint32_t) ( ( (uint64_t) value * FORMAT_BASE91_RECIPROCAL ) >> FORMAT_BASE91_SHIFT );
+		dest[i] = 33 + ( value - quotient * 91 );
+		value = quotient;
+	}
+
+	return width;
+}
+
+/*
+ * Left aligned text, cut off or padded with spaces to width
+ */
+uint8_t Format_String( char *dest, const char *text, uint8_t width ) {
+	for ( uint8_t i=0; i < width; i++ ) {
+		dest[i] = ( *text ) ? *text++ : ' ';
+	}
+
+	return width;
+}
@@ -0,0 +1,17 @@
+// Fixed-width number formatting for the LCD and APRS reports
+//
+// Writes straight into the caller's buffer without varargs or a
+// terminating zero, so fields can be patched in place
+
+#ifndef __FORMAT_H
+#define __FORMAT_H
+
+#include "stdint.h"
+
+uint8_t Format_Unsigned( char *dest, uint32_t value, uint8_t width, char pad );
+uint8_t Format_Signed( char *dest, int32_t value, uint8_t width, char pad );
+uint8_t Format_Fixed( char *dest, int32_t value, uint8_t decimals, uint8_t width );
+uint8_t Format_Base91( char *dest, uint32_t value, uint8_t width );
+uint8_t Format_String( char *dest, const char *text, uint8_t width );
+
+#endif // __FORMAT_H
@@ -0,0 +1,24 @@
+// FX.25 forward error correction for AX.25 packets
+//
+// Wraps the bit stuffed AX.25 frame in a correlation tag and a
+// Reed-Solomon codeblock. Legacy receivers still find the flags
+// and frame inside the data portion and ignore the rest.
+
+#ifndef __FX25_H
+#define __FX25_H
+
+#include "stdint.h"
+
+#define FX25_TAG_LENGTH 8
+#define FX25_MAX_BLOCK_LENGTH 255
+
+// Check bytes per codeblock: 16, 32 or 64 (0 disables FX.25)
+#define FX25_CHECK_BYTES_NONE 0
+#define FX25_CHECK_BYTES_16 16
+#define FX25_CHECK_BYTES_32 32
+#define FX25_CHECK_BYTES_64 64
+
+uint16_t FX25_Get_Block_Length( uint8_t checkBytes, uint16_t dataBits );
+uint16_t FX25_Encode_Line( uint8_t *frame, uint16_t length, uint8_t checkBytes, uint8_t preambleFlags, uint8_t *line, uint16_t maxLine );
+
+#endif // __FX25_H
@@ -7,7 +7,6 @@
 
 #include "gps.h"
 #include "uart.h"
-#include "string.h"
 
 #define GPS_GPRMC_TOKENS 12
 #define GPS_GPRMC_MAX_TOKEN_LENGTH 12
@@ -27,10 +26,16 @@ static uint8_t gpsSeconds = 0;
 static uint8_t gpsLatitudeDegrees = 0;
 static uint8_t gpsLatitudeMinutes = 0;
 static uint8_t gpsLatitudeSeconds = 0;
+static uint8_t gpsLatitudeHundredths = 0;
 
 static uint8_t gpsLongitudeDegrees = 0;
 static uint8_t gpsLongitudeMinutes = 0;
 static uint8_t gpsLongitudeSeconds = 0;
+static uint8_t gpsLongitudeHundredths = 0;
+
+#define GPS_MAX_SECOND_CALLBACKS 4
+static void (*GPS_Second_Callbacks[GPS_MAX_SECOND_CALLBACKS])();
+static uint8_t gpsSecondCallbackCount = 0;
 
 uint8_t _GPS_Value_From_Scratchpad_Entry( uint8_t entry, uint8_t offset, uint8_t length ) {
 	uint8_t value = 0;
@@ -46,7 +51,10 @@ void GPS_ProcessLine( char *data ) {
 	gpsDeviceDetected = 1;
 
 	// Is it at least 16  but not more than 66 characters long?
-	uint16_t length = strlen( data );
+	uint16_t length = 0;
+	while ( data[length] && ( length <= 66 ) ) {
+		length++;
+	}
 	if ( ( length < 16 ) | ( length > 66 ) ) {
 		return;
 	}
@@ -75,18 +83,18 @@ void GPS_ProcessLine( char *data ) {
 	}
 
 	uint8_t tokenIndex = 0;
+	uint8_t tokenLength = 0;
 
-	// Now, tokenize into the scratchpad
-	char dataChar[2];
-	dataChar[0] = 0;
-	dataChar[1] = 0;
-
-	for ( uint16_t i=0; i < length; i++ ) {
+	// Now, tokenize into the scratchpad, dropping the checksum
+	// field after the last comma
+	for ( uint16_t i=0; ( i < length ) && ( tokenIndex < GPS_GPRMC_TOKENS ); i++ ) {
 		if ( ',' == data[i] ) {
+			scratchpad[tokenIndex][tokenLength] = 0;
 			tokenIndex++;
-		} else if (strlen( scratchpad[tokenIndex] ) < GPS_GPRMC_MAX_TOKEN_LENGTH - 1 ) {
-			dataChar[0] = data[i];
-			strcat( scratchpad[tokenIndex], dataChar );
+			tokenLength = 0;
+		} else if ( tokenLength < GPS_GPRMC_MAX_TOKEN_LENGTH - 1 ) {
+			scratchpad[tokenIndex][tokenLength] = data[i];
+			tokenLength++;
 		}
 	}
 
@@ -102,18 +110,49 @@ void GPS_ProcessLine( char *data ) {
 
 	gpsLatitudeDegrees = _GPS_Value_From_Scratchpad_Entry( 3, 0, 2);
 	gpsLatitudeMinutes = _GPS_Value_From_Scratchpad_Entry( 3, 2, 2);
-	gpsLatitudeSeconds = 0; // TODO
+	// ddmm.mmmm - keep hundredths of a minute, derive seconds from them
+	gpsLatitudeHundredths = _GPS_Value_From_Scratchpad_Entry( 3, 5, 2);
+	gpsLatitudeSeconds = ( gpsLatitudeHundredths * 60 ) / 100;
 
 	gpsLongitudeDegrees = _GPS_Value_From_Scratchpad_Entry( 5, 0, 3);
 	gpsLongitudeMinutes = _GPS_Value_From_Scratchpad_Entry( 5, 3, 2);
-	gpsLongitudeSeconds = 0; // TODO
+	// dddmm.mmmm
+	gpsLongitudeHundredths = _GPS_Value_From_Scratchpad_Entry( 5, 6, 2);
+	gpsLongitudeSeconds = ( gpsLongitudeHundredths * 60 ) / 100;
+
+	if ( gpsDataValid ) {
+		for ( uint8_t i=0; i < gpsSecondCallbackCount; i++ ) {
+			GPS_Second_Callbacks[i]();
+		}
+	}
 }
 
 void GPS_Init() {
+	// Nothing heard yet, whatever a benchmark build fed the parser
+	gpsDeviceDetected = 0;
+	gpsDataValid = 0;
+
 	UART_Init();
 	UART_Register_Receive_Callback( GPS_ProcessLine );
 }
 
+/*
+ * Accepts a callback (up to GPS_MAX_SECOND_CALLBACKS of them)
+ * that is called from the UART interrupt each time a valid fix
+ * with a new UTC time is parsed
+ */
+void GPS_Register_Second_Callback( void (*callback)() ) {
+	for ( uint8_t i=0; i < gpsSecondCallbackCount; i++ ) {
+		if ( GPS_Second_Callbacks[i] == callback ) {
+			return;
+		}
+	}
+	if ( callback && ( gpsSecondCallbackCount < GPS_MAX_SECOND_CALLBACKS ) ) {
+		GPS_Second_Callbacks[gpsSecondCallbackCount] = callback;
+		gpsSecondCallbackCount++;
+	}
+}
+
 uint8_t GPS_Device_Detected() {
 	return gpsDeviceDetected;
 }
@@ -173,5 +212,39 @@ void GPS_Get_Longitude( uint8_t *degrees, uint8_t *minutes, uint8_t *seconds, ch
 	}
 	if ( hemisphere ) {
 		*hemisphere = gpsDataValid ? scratchpad[6][0] : '-';
-	}}
+	}
+}
+
+/*
+ * Hundredths of a minute for latitude and longitude
+ * (the .hh in APRS ddmm.hh / dddmm.hh positions)
+ */
+void GPS_Get_Position_Hundredths( uint8_t *latHundredths, uint8_t *longHundredths ) {
+	if ( latHundredths ) {
+		*latHundredths = gpsDataValid ? gpsLatitudeHundredths : 0;
+	}
+	if ( longHundredths ) {
+		*longHundredths = gpsDataValid ? gpsLongitudeHundredths : 0;
+	}
+}
 
+/*
+ * UTC seconds since 1 January 2000 - a monotonic time stamp for
+ * anything that has to outlive midnight. 0 without a fix.
+ */
+uint32_t GPS_Get_Seconds() {
+	static const uint16_t daysBeforeMonth[12] = { 0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334 };
+
+	if ( ! gpsDataValid || ( gpsMonth < 1 ) || ( gpsMonth > 12 ) ) {
+		return 0;
+	}
+
+	// Every fourth year from 2000 through 2099 is a leap year
+	uint32_t days = 365 * (uint32_t) gpsYear + ( gpsYear + 3 ) / 4;
+	days += daysBeforeMonth[gpsMonth - 1] + gpsDay - 1;
+	if ( ( 0 == ( gpsYear & 0x03 ) ) && ( gpsMonth > 2 ) ) {
+		days++;
+	}
+
+	return ( ( days * 24 + gpsHour ) * 60 + gpsMinute ) * 60 + gpsSeconds;
+}
@@ -11,6 +11,7 @@
 #include "stdint.h"
 
 void GPS_Init();
+void GPS_Register_Second_Callback( void (*callback)() );
 
 uint8_t GPS_Device_Detected();
 uint8_t GPS_Data_Valid();
@@ -19,6 +20,8 @@ void GPS_Get_Date( uint16_t *year, uint8_t *month, uint8_t *day );
 void GPS_Get_Time( uint8_t *hour, uint8_t *minute, uint8_t *seconds );
 void GPS_Get_Latitude( uint8_t *degrees, uint8_t *minutes, uint8_t *seconds, char *hemisphere );
 void GPS_Get_Longitude( uint8_t *degrees, uint8_t *minutes, uint8_t *seconds, char *hemisphere );
+void GPS_Get_Position_Hundredths( uint8_t *latHundredths, uint8_t *longHundredths );
+uint32_t GPS_Get_Seconds();
 
 
 #endif // __GPS_H
\ No newline at end of file
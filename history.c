@@ -0,0 +1,340 @@
+// Sensor history for the TM4C123-WX station
+//
+// Samples are kept per channel in a ring of two byte records:
+// seconds since the previous sample and the change in value.
+// A step too big for one record (a gap in the GPS time or a
+// jump in the reading) is spread over several records flagged
+// as continued, and the ring starts over if that would take
+// more than a handful. The time and value of the record just
+// before the oldest one are kept aside, so walking forward from
+// there rebuilds every sample.
+//
+// The statistics don't look at the ring. Each window is split
+// into buckets holding the minimum, maximum, sum and count of
+// the samples that landed in them; a new sample only touches
+// the current bucket of each window, and a window's statistics
+// combine its buckets. A window therefore covers the current,
+// partly filled bucket and the ones before it - between one
+// bucket short of the window and the full window of samples.
+//
+// Samples are added from and statistics read by the Timer1A
+// tick, so no locking is needed.
+
+#include "history.h"
+
+// An hour of samples at one every five seconds
+#define HISTORY_RING_LENGTH 720
+
+#define HISTORY_CONTINUED 0x80
+#define HISTORY_MAX_STEP_SECONDS 0x7F
+#define HISTORY_MAX_STEP_VALUE 127
+
+// Start the ring over rather than spend more records on a step
+#define HISTORY_MAX_RECORDS_PER_SAMPLE 32
+
+typedef struct History_Records {
+	uint8_t seconds; // since the previous record, HISTORY_CONTINUED if partial
+	int8_t delta;
+} History_Record;
+
+typedef struct History_Buckets {
+	int16_t minimum;
+	int16_t maximum;
+	int32_t sum;
+	uint16_t count;
+} History_Bucket;
+
+typedef struct History_Windows {
+	uint16_t bucketSeconds;
+	uint8_t buckets;
+	uint8_t first;
+} History_Window;
+
+// 6 x 10 s, 10 x 1 min, 12 x 5 min and 24 x 1 hour
+#define HISTORY_BUCKETS 52
+static const History_Window historyWindows[HISTORY_WINDOWS] = {
+	{ 10, 6, 0 },
+	{ 60, 10, 6 },
+	{ 300, 12, 16 },
+	{ 3600, 24, 28 }
+};
+
+typedef struct History_Channels {
+	History_Record ring[HISTORY_RING_LENGTH];
+	uint16_t tail;
+	uint16_t length;
+
+	// The sample (or partial step) just before the oldest record
+	uint32_t baseSeconds;
+	int16_t baseValue;
+	uint8_t baseIsSample;
+
+	uint32_t lastSeconds;
+	int16_t lastValue;
+	uint16_t sampleCount;
+
+	History_Bucket buckets[HISTORY_BUCKETS];
+	uint32_t currentSlot[HISTORY_WINDOWS];
+} History_Channel;
+
+static History_Channel historyChannels[HISTORY_CHANNELS];
+
+void _History_Clear_Bucket( History_Bucket *bucket ) {
+	bucket->minimum = INT16_MAX;
+	bucket->maximum = INT16_MIN;
+	bucket->sum = 0;
+	bucket->count = 0;
+}
+
+void _History_Restart( History_Channel *channel, uint32_t seconds, int16_t value ) {
+	channel->tail = 0;
+	channel->length = 0;
+	channel->baseSeconds = seconds;
+	channel->baseValue = value;
+	channel->baseIsSample = 1;
+	channel->sampleCount = 1;
+}
+
+void History_Init() {
+	for ( uint8_t c=0; c < HISTORY_CHANNELS; c++ ) {
+		History_Channel *channel = &historyChannels[c];
+		channel->length = 0;
+		channel->sampleCount = 0;
+		for ( uint8_t b=0; b < HISTORY_BUCKETS; b++ ) {
+			_History_Clear_Bucket( &channel->buckets[b] );
+		}
+		for ( uint8_t w=0; w < HISTORY_WINDOWS; w++ ) {
+			channel->currentSlot[w] = 0;
+		}
+	}
+}
+
+void _History_Append( History_Channel *channel, uint8_t seconds, int8_t delta ) {
+	if ( HISTORY_RING_LENGTH == channel->length ) {
+		// Fold the oldest record into the base
+		History_Record *oldest = &channel->ring[channel->tail];
+		if ( channel->baseIsSample ) {
+			channel->sampleCount--;
+		}
+		channel->baseSeconds += oldest->seconds & HISTORY_MAX_STEP_SECONDS;
+		channel->baseValue += oldest->delta;
+		channel->baseIsSample = ( 0 == ( oldest->seconds & HISTORY_CONTINUED ) );
+
+		channel->tail++;
+		if ( HISTORY_RING_LENGTH == channel->tail ) {
+			channel->tail = 0;
+		}
+		channel->length--;
+	}
+
+	uint16_t head = channel->tail + channel->length;
+	if ( head >= HISTORY_RING_LENGTH ) {
+		head -= HISTORY_RING_LENGTH;
+	}
+	channel->ring[head].seconds = seconds;
+	channel->ring[head].delta = delta;
+	channel->length++;
+}
+
+void _History_Record( History_Channel *channel, uint32_t seconds, int16_t value ) {
+	if ( 0 == channel->sampleCount ) {
+		_History_Restart( channel, seconds, value );
+		return;
+	}
+
+	uint32_t elapsed = seconds - channel->lastSeconds;
+	int32_t change = value - channel->lastValue;
+
+	uint32_t magnitude = ( change < 0 ) ? -change : change;
+	uint32_t records = ( ( elapsed > magnitude ? elapsed : magnitude ) + HISTORY_MAX_STEP_VALUE - 1 ) / HISTORY_MAX_STEP_VALUE;
+	if ( records > HISTORY_MAX_RECORDS_PER_SAMPLE ) {
+		_History_Restart( channel, seconds, value );
+		return;
+	}
+
+	while ( ( elapsed > HISTORY_MAX_STEP_SECONDS ) || ( change > HISTORY_MAX_STEP_VALUE ) || ( change < -HISTORY_MAX_STEP_VALUE ) ) {
+		uint8_t step = ( elapsed > HISTORY_MAX_STEP_SECONDS ) ? HISTORY_MAX_STEP_SECONDS : elapsed;
+		int8_t delta = ( change > HISTORY_MAX_STEP_VALUE ) ? HISTORY_MAX_STEP_VALUE : ( change < -HISTORY_MAX_STEP_VALUE ) ? -HISTORY_MAX_STEP_VALUE : change;
+		_History_Append( channel, HISTORY_CONTINUED | step, delta );
+		elapsed -= step;
+		change -= delta;
+	}
+	_History_Append( channel, elapsed, change );
+
+	channel->sampleCount++;
+}
+
+/*
+ * Moves a window's current bucket up to seconds, emptying the
+ * buckets it passes over, and adds the sample to it
+ */
+void _History_Update_Window( History_Channel *channel, uint8_t w, uint32_t seconds, int16_t value ) {
+	const History_Window *window = &historyWindows[w];
+	History_Bucket *buckets = &channel->buckets[window->first];
+	uint32_t slot = seconds / window->bucketSeconds;
+
+	if ( slot != channel->currentSlot[w] ) {
+		uint32_t steps = slot - channel->currentSlot[w];
+		if ( steps > window->buckets ) {
+			steps = window->buckets;
+		}
+		for ( uint8_t i=0; i < steps; i++ ) {
+			_History_Clear_Bucket( &buckets[( slot - i ) % window->buckets] );
+		}
+		channel->currentSlot[w] = slot;
+	}
+
+	History_Bucket *bucket = &buckets[slot % window->buckets];
+	if ( value < bucket->minimum ) {
+		bucket->minimum = value;
+	}
+	if ( value > bucket->maximum ) {
+		bucket->maximum = value;
+	}
+	bucket->sum += value;
+	bucket->count++;
+}
+
+/*
+ * seconds: GPS time stamp (see GPS_Get_Seconds) of the sample
+ * Samples are expected in time order - a step backwards starts
+ * the channel over
+ */
+void History_Add_Sample( uint8_t channel, uint32_t seconds, int16_t value ) {
+	if ( channel >= HISTORY_CHANNELS ) {
+		return;
+	}
+
+	History_Channel *history = &historyChannels[channel];
+	if ( history->sampleCount && ( seconds < history->lastSeconds ) ) {
+		history->sampleCount = 0;
+		for ( uint8_t b=0; b < HISTORY_BUCKETS; b++ ) {
+			_History_Clear_Bucket( &history->buckets[b] );
+		}
+	}
+
+	if ( 0 == history->sampleCount ) {
+		for ( uint8_t w=0; w < HISTORY_WINDOWS; w++ ) {
+			history->currentSlot[w] = seconds / historyWindows[w].bucketSeconds;
+		}
+	}
+
+	_History_Record( history, seconds, value );
+	for ( uint8_t w=0; w < HISTORY_WINDOWS; w++ ) {
+		_History_Update_Window( history, w, seconds, value );
+	}
+
+	history->lastSeconds = seconds;
+	history->lastValue = value;
+}
+
+/*
+ * Statistics over a window ending at seconds (normally now)
+ * Returns 0 if the channel has no samples in the window
+ */
+uint8_t History_Get_Stats( uint8_t channel, uint8_t window, uint32_t seconds, History_Stats *stats ) {
+	if ( ( channel >= HISTORY_CHANNELS ) || ( window >= HISTORY_WINDOWS ) ) {
+		return 0;
+	}
+
+	History_Channel *history = &historyChannels[channel];
+	if ( 0 == history->sampleCount ) {
+		return 0;
+	}
+
+	const History_Window *config = &historyWindows[window];
+	History_Bucket *buckets = &history->buckets[config->first];
+	uint32_t current = history->currentSlot[window];
+	uint32_t now = seconds / config->bucketSeconds;
+	if ( now < current ) {
+		now = current;
+	}
+
+	// Buckets the window has moved past since the last sample
+	if ( now - current >= config->buckets ) {
+		return 0;
+	}
+	uint8_t live = config->buckets - ( now - current );
+
+	int16_t minimum = INT16_MAX;
+	int16_t maximum = INT16_MIN;
+	int64_t sum = 0;
+	uint32_t count = 0;
+	uint8_t index = current % config->buckets;
+	for ( uint8_t i=0; i < live; i++ ) {
+		History_Bucket *bucket = &buckets[index];
+		index = index ? index - 1 : config->buckets - 1;
+		if ( bucket->count ) {
+			if ( bucket->minimum < minimum ) {
+				minimum = bucket->minimum;
+			}
+			if ( bucket->maximum > maximum ) {
+				maximum = bucket->maximum;
+			}
+			sum += bucket->sum;
+			count += bucket->count;
+		}
+	}
+
+	if ( 0 == count ) {
+		return 0;
+	}
+
+	stats->minimum = minimum;
+	stats->maximum = maximum;
+	stats->last = history->lastValue;
+	stats->count = count;
+
+	// Rounded to the nearest, halves away from zero
+	if ( sum < 0 ) {
+		stats->mean = -(int16_t) ( ( -sum + count / 2 ) / count );
+	} else {
+		stats->mean = (int16_t) ( ( sum + count / 2 ) / count );
+	}
+
+	return 1;
+}
+
+/*
+ * Copies out the most recent samples, oldest first
+ * Returns the number of samples copied
+ */
+uint16_t History_Get_Samples( uint8_t channel, uint32_t *seconds, int16_t *values, uint16_t maxSamples ) {
+	if ( channel >= HISTORY_CHANNELS ) {
+		return 0;
+	}
+
+	History_Channel *history = &historyChannels[channel];
+	uint16_t skip = ( history->sampleCount > maxSamples ) ? history->sampleCount - maxSamples : 0;
+	uint16_t copied = 0;
+
+	uint32_t time = history->baseSeconds;
+	int16_t value = history->baseValue;
+	uint16_t index = history->tail;
+
+	for ( int32_t r = history->baseIsSample ? -1 : 0; r < (int32_t) history->length; r++ ) {
+		if ( r >= 0 ) {
+			History_Record *record = &history->ring[index];
+			index++;
+			if ( HISTORY_RING_LENGTH == index ) {
+				index = 0;
+			}
+
+			time += record->seconds & HISTORY_MAX_STEP_SECONDS;
+			value += record->delta;
+			if ( record->seconds & HISTORY_CONTINUED ) {
+				continue;
+			}
+		}
+
+		if ( skip ) {
+			skip--;
+		} else if ( history->sampleCount && ( copied < maxSamples ) ) {
+			seconds[copied] = time;
+			values[copied] = value;
+			copied++;
+		}
+	}
+
+	return copied;
+}
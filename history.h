@@ -0,0 +1,36 @@
+// Sensor history for the TM4C123-WX station
+//
+// Keeps the last hour or so of samples per sensor in RAM, and
+// running minimum / maximum / mean / last over the 1 minute,
+// 10 minute, 1 hour and 24 hour windows for the reports
+
+#ifndef __HISTORY_H
+#define __HISTORY_H
+
+#include "stdint.h"
+
+// Sensor channels
+#define HISTORY_TEMPERATURE 0
+#define HISTORY_CHANNELS 1
+
+// Statistics windows
+#define HISTORY_1_MINUTE 0
+#define HISTORY_10_MINUTES 1
+#define HISTORY_1_HOUR 2
+#define HISTORY_24_HOURS 3
+#define HISTORY_WINDOWS 4
+
+typedef struct History_Stats {
+	int16_t minimum;
+	int16_t maximum;
+	int16_t mean;
+	int16_t last;
+	uint32_t count;
+} History_Stats;
+
+void History_Init();
+void History_Add_Sample( uint8_t channel, uint32_t seconds, int16_t value );
+uint8_t History_Get_Stats( uint8_t channel, uint8_t window, uint32_t seconds, History_Stats *stats );
+uint16_t History_Get_Samples( uint8_t channel, uint32_t *seconds, int16_t *values, uint16_t maxSamples );
+
+#endif // __HISTORY_H
@@ -0,0 +1,376 @@
+// KISS TNC interface for a host computer (Direwolf, Xastir, kissattach)
+//
+// Frames from the host are unescaped byte by byte straight out of
+// the UART RX FIFO into a reserved CSMA transmit buffer, so a data
+// frame is copied exactly once on its way to the radio. Frames
+// heard on the air are copied once into a small ring and escaped
+// on the fly as the UART TX FIFO drains.
+//
+// Uses UART0: PA0 (U0Rx) and PA1 (U0Tx) at 115200 baud
+
+#include "kiss.h"
+#include "ax25.h"
+#include "csma.h"
+#include "rda1846.h"
+#include "clock.h"
+#include "profile.h"
+#include "tm4c123gh6pm.h"
+#include "intrinsics.h"
+
+#define KISS_BAUD 115200
+
+// Frames to the host waiting for the UART
+#define KISS_TX_FRAMES 4
+
+// Shortest useful frame: two addresses and a control byte
+#define KISS_MIN_FRAME_LENGTH ( 2 * AX25_ADDRESS_LENGTH + 1 )
+
+// Match the CSMA defaults until the host sets its own
+#define KISS_DEFAULT_PERSISTENCE 63
+#define KISS_DEFAULT_SLOTTIME 10
+#define KISS_MAX_DEFER_MS 10000
+
+typedef enum {
+	KISS_RX_WAIT_FEND,
+	KISS_RX_COMMAND,
+	KISS_RX_DATA,
+	KISS_RX_PARAMETER,
+	KISS_RX_DISCARD
+} KISS_RX_State;
+
+typedef enum {
+	KISS_TX_IDLE,
+	KISS_TX_COMMAND,
+	KISS_TX_DATA,
+	KISS_TX_END
+} KISS_TX_State;
+
+// Host to radio
+static KISS_RX_State rxState = KISS_RX_WAIT_FEND;
+static uint8_t rxEscaped = 0;
+static uint8_t rxCommand = 0;
+static uint8_t rxBuffer = CSMA_NO_BUFFER;
+static uint8_t *rxFrame = 0;
+static uint16_t rxLength = 0;
+
+// Radio to host
+static uint8_t txFrames[KISS_TX_FRAMES][AX25_MAX_FRAME_LENGTH];
+static uint16_t txLengths[KISS_TX_FRAMES];
+static volatile uint8_t txHead = 0;
+static volatile uint8_t txTail = 0;
+static KISS_TX_State txState = KISS_TX_IDLE;
+static uint16_t txIndex = 0;
+static uint8_t txEscapePending = 0;
+
+// Channel access parameters in KISS units
+static uint8_t kissPersistence = KISS_DEFAULT_PERSISTENCE;
+static uint8_t kissSlotTime = KISS_DEFAULT_SLOTTIME;
+
+static uint32_t kissFramesFromHost = 0;
+static uint32_t kissFramesToHost = 0;
+static uint32_t kissFramesDropped = 0;
+static uint32_t kissBytesCopied = 0;
+
+void _KISS_Apply_Channel_Access() {
+	CSMA_Set_Parameters( CSMA_SOURCE_KISS, (uint16_t) kissSlotTime * 10, kissPersistence, KISS_MAX_DEFER_MS );
+}
+
+void _KISS_Set_Parameter( uint8_t command, uint8_t value ) {
+	switch ( command ) {
+		case KISS_CMD_TXDELAY:
+			RDA1846_Set_TX_Delay( (uint16_t) value * 10 );
+			break;
+		case KISS_CMD_PERSISTENCE:
+			kissPersistence = value;
+			_KISS_Apply_Channel_Access();
+			break;
+		case KISS_CMD_SLOTTIME:
+			kissSlotTime = value;
+			_KISS_Apply_Channel_Access();
+			break;
+		default:
+			// TXtail, FullDuplex and SetHardware don't apply to this radio
+			break;
+	}
+}
+
+void _KISS_Abandon_Frame() {
+	if ( CSMA_NO_BUFFER != rxBuffer ) {
+		CSMA_Release_Frame( rxBuffer );
+		rxBuffer = CSMA_NO_BUFFER;
+	}
+}
+
+void _KISS_End_Frame() {
+	if ( KISS_RX_DATA == rxState ) {
+		if ( ( rxLength >= KISS_MIN_FRAME_LENGTH ) && ! rxEscaped ) {
+			CSMA_Commit_Frame( rxBuffer, rxLength );
+			rxBuffer = CSMA_NO_BUFFER;
+			kissFramesFromHost++;
+		} else {
+			_KISS_Abandon_Frame();
+		}
+	}
+}
+
+void _KISS_Start_Frame( uint8_t command ) {
+	rxCommand = command;
+
+	// Only port 0 exists
+	if ( command & 0xF0 ) {
+		rxState = ( KISS_CMD_RETURN == command ) ? KISS_RX_WAIT_FEND : KISS_RX_DISCARD;
+		return;
+	}
+
+	if ( KISS_CMD_DATA != command ) {
+		rxState = KISS_RX_PARAMETER;
+		return;
+	}
+
+	rxBuffer = CSMA_Reserve_Frame( CSMA_SOURCE_KISS, &rxFrame );
+	if ( CSMA_NO_BUFFER == rxBuffer ) {
+		// Transmit queue is full, the host will have to resend
+		kissFramesDropped++;
+		rxState = KISS_RX_DISCARD;
+		return;
+	}
+
+	rxLength = 0;
+	rxState = KISS_RX_DATA;
+}
+
+void _KISS_Receive_Byte( uint8_t data ) {
+	if ( KISS_FEND == data ) {
+		_KISS_End_Frame();
+		rxEscaped = 0;
+		rxState = KISS_RX_COMMAND;
+		return;
+	}
+
+	if ( KISS_RX_WAIT_FEND == rxState || KISS_RX_DISCARD == rxState ) {
+		return;
+	}
+
+	if ( rxEscaped ) {
+		rxEscaped = 0;
+		if ( KISS_TFEND == data ) {
+			data = KISS_FEND;
+		} else if ( KISS_TFESC == data ) {
+			data = KISS_FESC;
+		}
+	} else if ( KISS_FESC == data ) {
+		rxEscaped = 1;
+		return;
+	}
+
+	switch ( rxState ) {
+		case KISS_RX_COMMAND:
+			_KISS_Start_Frame( data );
+			break;
+		case KISS_RX_PARAMETER:
+			_KISS_Set_Parameter( rxCommand, data );
+			rxState = KISS_RX_DISCARD;
+			break;
+		case KISS_RX_DATA:
+			if ( rxLength < AX25_MAX_FRAME_LENGTH ) {
+				rxFrame[rxLength++] = data;
+				kissBytesCopied++;
+			} else {
+				kissFramesDropped++;
+				_KISS_Abandon_Frame();
+				rxState = KISS_RX_DISCARD;
+			}
+			break;
+		default:
+			break;
+	}
+}
+
+/*
+ * Produces the next byte of the frame at the head of the ring
+ * Returns 0 when there is nothing left to send
+ */
+uint8_t _KISS_Next_TX_Byte( uint8_t *data ) {
+	uint8_t next;
+
+	if ( txEscapePending ) {
+		*data = txEscapePending;
+		txEscapePending = 0;
+		return 1;
+	}
+
+	switch ( txState ) {
+		case KISS_TX_IDLE:
+			if ( txHead == txTail ) {
+				return 0;
+			}
+			txIndex = 0;
+			txState = KISS_TX_COMMAND;
+			*data = KISS_FEND;
+			return 1;
+
+		case KISS_TX_COMMAND:
+			txState = KISS_TX_DATA;
+			*data = KISS_CMD_DATA;
+			return 1;
+
+		case KISS_TX_DATA:
+			if ( txIndex >= txLengths[txHead] ) {
+				txState = KISS_TX_END;
+				*data = KISS_FEND;
+				return 1;
+			}
+			next = txFrames[txHead][txIndex++];
+			if ( KISS_FEND == next ) {
+				*data = KISS_FESC;
+				txEscapePending = KISS_TFEND;
+			} else if ( KISS_FESC == next ) {
+				*data = KISS_FESC;
+				txEscapePending = KISS_TFESC;
+			} else {
+				*data = next;
+			}
+			return 1;
+
+		case KISS_TX_END:
+		default:
+			// Closing FEND is in the FIFO, move on to the next frame
+			txHead = ( txHead + 1 ) % KISS_TX_FRAMES;
+			kissFramesToHost++;
+			txState = KISS_TX_IDLE;
+			return _KISS_Next_TX_Byte( data );
+	}
+}
+
+void _KISS_Fill_TX_FIFO() {
+	uint8_t data;
+
+	while ( ( UART0_FR_R & UART_FR_TXFF ) == 0 ) {
+		if ( ! _KISS_Next_TX_Byte( &data ) ) {
+			// All caught up
+			UART0_IM_R &= ~UART_IM_TXIM;
+			return;
+		}
+		UART0_DR_R = data;
+	}
+
+	// FIFO full, come back when it drains
+	UART0_IM_R |= UART_IM_TXIM;
+}
+
+// Divisor for KISS_BAUD at the current system clock
+// The UART must be disabled, the LCRH write that follows latches it
+void _KISS_Set_Baud() {
+	uint32_t divisor = Clock_Get_UART_Divisor( KISS_BAUD );
+	UART0_IBRD_R = divisor >> 6;
+	UART0_FBRD_R = divisor & 0x3F;
+}
+
+void _KISS_Clock_Changed( uint32_t hz ) {
+	// Let the byte in progress finish
+	while ( UART0_FR_R & UART_FR_BUSY ) {};
+
+	UART0_CTL_R &= ~UART_CTL_UARTEN;
+	_KISS_Set_Baud();
+	UART0_LCRH_R = 0x70;
+	UART0_CTL_R |= UART_CTL_UARTEN;
+}
+
+// Initialize UART0 at 115200 8N1
+void KISS_Init() {
+	rxState = KISS_RX_WAIT_FEND;
+	rxBuffer = CSMA_NO_BUFFER;
+	txHead = 0;
+	txTail = 0;
+	txState = KISS_TX_IDLE;
+	txEscapePending = 0;
+
+	SYSCTL_RCGCUART_R |= 0x0001;			// Enable UART0
+	SYSCTL_RCGCGPIO_R |= 0x0001;			// Enable GPIO clocks on Port A
+
+	while ( ( SYSCTL_PRGPIO_R & 0x01 ) == 0 ) {};
+
+	GPIO_PORTA_AFSEL_R |= 0x03;				// Enable alt function on A0 and A1
+
+	// Set the Port Mux Control for PA0 as U0RX (1) and PA1 as U0TX (1)
+	GPIO_PORTA_PCTL_R = (GPIO_PORTA_PCTL_R & 0xFFFFFF00) | 0x00000011;
+
+	GPIO_PORTA_DEN_R |= 0x03;				// Enable digital on A0 and A1
+
+	// Set the baud rate (115200) from the system clock
+	UART0_CTL_R &= ~UART_CTL_UARTEN;		// Disable the UART
+	_KISS_Set_Baud();
+	Clock_Register_Change_Callback( _KISS_Clock_Changed );
+
+	UART0_LCRH_R = 0x70;					// 8N1 + FIFO
+
+	// RX interrupt at 1/2 full, receive timeout catches the tail
+	// of a frame; TX interrupt when the FIFO drops to 1/8 full
+	UART0_IFLS_R = (UART0_IFLS_R & 0xFFFFFFC0) | 0x00000010;
+	UART0_IM_R = UART_IM_RXIM | UART_IM_RTIM;
+
+	UART0_CTL_R |= UART_CTL_RXE | UART_CTL_TXE | UART_CTL_UARTEN;
+
+	// UART0 / IRQ5 / NVIC_PRI1_R / b15-13 / Priority 2
+	NVIC_PRI1_R = (NVIC_PRI1_R & 0xFFFF00FF) | 0x00004000;
+	NVIC_EN0_R = 1 << 5;
+}
+
+/*
+ * Receive path callback: passes a frame (without FCS) heard on
+ * the air up to the host. Dropped if the host isn't keeping up.
+ */
+void KISS_Send_Frame( uint8_t *frame, uint16_t length ) {
+	uint8_t next = ( txTail + 1 ) % KISS_TX_FRAMES;
+
+	if ( ( next == txHead ) || ( length > AX25_MAX_FRAME_LENGTH ) ) {
+		kissFramesDropped++;
+		return;
+	}
+
+	for ( uint16_t i=0; i < length; i++ ) {
+		txFrames[txTail][i] = frame[i];
+	}
+	txLengths[txTail] = length;
+	kissBytesCopied += length;
+
+	__istate_t state = __get_interrupt_state();
+	__disable_interrupt();
+	txTail = next;
+	_KISS_Fill_TX_FIFO();
+	__set_interrupt_state( state );
+}
+
+// Handles UART0 interrupt events, IRQ5
+void KISS_UART0_Handler() {
+	PROFILE_ENTER( PROFILE_KISS );
+
+	if ( UART0_MIS_R & ( UART_MIS_RXMIS | UART_MIS_RTMIS ) ) {
+		UART0_ICR_R = UART_ICR_RXIC | UART_ICR_RTIC;	// Acknowledge the interrupt
+		while ( ( UART0_FR_R & UART_FR_RXFE ) == 0 ) {
+			_KISS_Receive_Byte( UART0_DR_R );
+		}
+	}
+
+	if ( UART0_MIS_R & UART_MIS_TXMIS ) {
+		UART0_ICR_R = UART_ICR_TXIC;
+		_KISS_Fill_TX_FIFO();
+	}
+
+	PROFILE_EXIT( PROFILE_KISS );
+}
+
+void KISS_Get_Stats( uint32_t *framesFromHost, uint32_t *framesToHost, uint32_t *framesDropped, uint32_t *bytesCopied ) {
+	if ( framesFromHost ) {
+		*framesFromHost = kissFramesFromHost;
+	}
+	if ( framesToHost ) {
+		*framesToHost = kissFramesToHost;
+	}
+	if ( framesDropped ) {
+		*framesDropped = kissFramesDropped;
+	}
+	if ( bytesCopied ) {
+		*bytesCopied = kissBytesCopied;
+	}
+}
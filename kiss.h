@@ -0,0 +1,29 @@
+// KISS TNC interface for a host computer (Direwolf, Xastir, kissattach)
+//
+// Uses UART0: PA0 (U0Rx) and PA1 (U0Tx) at 115200 baud
+
+#ifndef __KISS_H
+#define __KISS_H
+
+#include "stdint.h"
+
+#define KISS_FEND 0xC0
+#define KISS_FESC 0xDB
+#define KISS_TFEND 0xDC
+#define KISS_TFESC 0xDD
+
+#define KISS_CMD_DATA 0x00
+#define KISS_CMD_TXDELAY 0x01
+#define KISS_CMD_PERSISTENCE 0x02
+#define KISS_CMD_SLOTTIME 0x03
+#define KISS_CMD_TXTAIL 0x04
+#define KISS_CMD_FULLDUPLEX 0x05
+#define KISS_CMD_SETHARDWARE 0x06
+#define KISS_CMD_RETURN 0xFF
+
+void KISS_Init();
+void KISS_UART0_Handler();
+void KISS_Send_Frame( uint8_t *frame, uint16_t length );
+void KISS_Get_Stats( uint32_t *framesFromHost, uint32_t *framesToHost, uint32_t *framesDropped, uint32_t *bytesCopied );
+
+#endif // __KISS_H
@@ -4,10 +4,78 @@
 // Connect PA2/SSI0Clk to SCK
 // Connect PA3/SSI0Fss to /CS
 // Connect PA5/SSI0Tx to SDI
+//
+// Bytes are queued in a ring that the SSI0 TX FIFO interrupt
+// drains, so writing to the display never waits on the SPI clock
 
 #include "lcd.h"
 #include "stdint.h"
 #include "tm4c123gh6pm.h"
+#include "intrinsics.h"
+#include "clock.h"
+#include "profile.h"
+
+// OpenLCD's receive interrupt keeps up to about 100 kHz
+#define LCD_SSI_BIT_RATE 100000
+
+#define LCD_TX_BUFFER 128
+
+#define LCD_SSI_SR_TNF 0x02
+#define LCD_SSI_SR_BSY 0x10
+#define LCD_SSI_IM_TXIM 0x08
+
+// Cursor command is two bytes: 0xFE, 0x80 | address
+#define LCD_CURSOR_MOVE_BYTES 2
+#define LCD_CURSOR_UNKNOWN 0xFF
+
+// What the display is showing, so writes only send what changed
+static char lcdShadow[LCD_ROWS][LCD_COLUMNS];
+static uint8_t lcdCursor = LCD_CURSOR_UNKNOWN;
+
+static uint8_t txBuffer[LCD_TX_BUFFER];
+static volatile uint8_t txHead = 0;
+static volatile uint8_t txTail = 0;
+static void (*LCD_Complete_Callback)();
+
+/*
+ * Picks the prescaler (even, 2 - 254) and serial clock rate
+ * that give the fastest bit rate not above bitRate
+ */
+void _LCD_Set_Bit_Rate( uint32_t systemHz, uint32_t bitRate ) {
+	uint32_t divisor = ( systemHz + bitRate - 1 ) / bitRate;
+	uint32_t scr = ( divisor + 253 ) / 254;
+	uint32_t cpsdvsr = ( divisor + scr - 1 ) / scr;
+
+	cpsdvsr = ( cpsdvsr + 1 ) & ~1;
+	if ( cpsdvsr < 2 ) {
+		cpsdvsr = 2;
+	}
+	if ( scr > 256 ) {
+		scr = 256;
+	}
+
+	SSI0_CPSR_R = cpsdvsr;
+	SSI0_CR0_R = ( SSI0_CR0_R & ~0x0000FF00 ) | ( ( scr - 1 ) << 8 );
+}
+
+/*
+ * Moves bytes from the ring into the TX FIFO until one runs out
+ */
+void _LCD_Fill_FIFO() {
+	while ( ( txHead != txTail ) && ( SSI0_SR_R & LCD_SSI_SR_TNF ) ) {
+		SSI0_DR_R = txBuffer[txHead];
+		txHead = ( txHead + 1 ) % LCD_TX_BUFFER;
+	}
+}
+
+void _LCD_Clock_Changed( uint32_t hz ) {
+	// Let the bytes in the FIFO go out at the old rate
+	while ( SSI0_SR_R & LCD_SSI_SR_BSY ) {};
+
+	SSI0_CR1_R = 0x0;
+	_LCD_Set_Bit_Rate( hz, LCD_SSI_BIT_RATE );
+	SSI0_CR1_R = 0x02;
+}
 
 void LCD_Init()
 {
@@ -37,45 +105,194 @@ void LCD_Init()
 	// Disable SSI, master mode while we configure it
 	SSI0_CR1_R = 0x0;
 
-	// Divide 16 MHz bus clock down
-	SSI0_CPSR_R = 0xFF;
-
 	// SCR = 0, SPH (CPHA) = 0, SPO (CPOL) = 0 Freescale
 	SSI0_CR0_R &= ~(0x0000FFF0);
 
 	// DSS = 8 bit data
 	SSI0_CR0_R |= 0x07;
 
+	// Divide the bus clock down to the display's bit rate
+	_LCD_Set_Bit_Rate( Clock_Get_Hz(), LCD_SSI_BIT_RATE );
+	Clock_Register_Change_Callback( _LCD_Clock_Changed );
+
+	// TX interrupt when the FIFO is half empty, enabled as needed
+	SSI0_IM_R = 0;
+	txHead = 0;
+	txTail = 0;
+
 	// Enable SSI
 	SSI0_CR1_R = 0x02;
+
+	// SSI0 / IRQ7 / NVIC_PRI1_R / b31-29 / Priority 2
+	NVIC_PRI1_R = (NVIC_PRI1_R & 0x1FFFFFFF) | 0x40000000;
+	NVIC_EN0_R = 1 << 7;
 }
 
+/*
+ * Queues a byte for the display
+ * Only waits if the ring is full, while the interrupt drains it
+ */
 void LCD_Out( uint16_t code)
 {
-	while ((SSI0_SR_R & 0x00000002) == 0)
+	uint8_t next = ( txTail + 1 ) % LCD_TX_BUFFER;
+
+	while ( next == txHead )
 	{
 	}
 
-	SSI0_DR_R = code;
+	txBuffer[txTail] = code;
+
+	__istate_t state = __get_interrupt_state();
+	__disable_interrupt();
+	txTail = next;
+	if ( 0 == ( SSI0_IM_R & LCD_SSI_IM_TXIM ) ) {
+		// Idle - prime the FIFO, the interrupt takes it from here
+		_LCD_Fill_FIFO();
+		SSI0_IM_R |= LCD_SSI_IM_TXIM;
+	}
+	__set_interrupt_state( state );
 }
 
-void LCD_Write( char *line1, char *line2 ) {
+/*
+ * Accepts a callback that is called (from the SSI interrupt)
+ * once all queued bytes have been handed to the TX FIFO
+ */
+void LCD_Register_Complete_Callback( void (*callback)() ) {
+	LCD_Complete_Callback = callback;
+}
+
+uint8_t LCD_Busy() {
+	return ( txHead != txTail ) || ( SSI0_SR_R & LCD_SSI_SR_BSY );
+}
+
+// Handles SSI0 interrupt events, IRQ7
+void LCD_SSI0_Handler() {
+	PROFILE_ENTER( PROFILE_LCD );
+
+	// TX FIFO interrupt isn't latched, refilling clears it
+	_LCD_Fill_FIFO();
+
+	if ( txHead != txTail ) {
+		PROFILE_EXIT( PROFILE_LCD );
+		return;
+	}
+
+	// Ring is empty, stay quiet until the next LCD_Out
+	SSI0_IM_R &= ~LCD_SSI_IM_TXIM;
+	if ( LCD_Complete_Callback ) {
+		LCD_Complete_Callback();
+	}
+
+	PROFILE_EXIT( PROFILE_LCD );
+}
+
+#ifdef BENCH_ENABLED
+/*
+ * Sends what's queued without the interrupt and waits for it to
+ * go out - for bench.c, which holds the interrupt off
+ */
+void LCD_Bench_Reset() {
+	while ( txHead != txTail ) {
+		_LCD_Fill_FIFO();
+	}
+	while ( SSI0_SR_R & LCD_SSI_SR_BSY ) {
+	}
+
+	SSI0_IM_R &= ~LCD_SSI_IM_TXIM;
+	NVIC_UNPEND0_R = 1 << 7;
+}
+#endif
+
+/*
+ * Moves the cursor unless the next character already lands there
+ */
+void _LCD_Move_Cursor( uint8_t row, uint8_t column ) {
+	uint8_t position = row * LCD_COLUMNS + column;
+
+	if ( position == lcdCursor ) {
+		return;
+	}
+
+	LCD_Out( 0xFE ); // Command mode
+	LCD_Out( 0x80 | ( row * 0x40 + column ) ); // Set DDRAM address
+	lcdCursor = position;
+}
+
+/*
+ * Clears the display and the shadow copy of it
+ */
+void LCD_Clear() {
 	LCD_Out( 0x7C ); // Enter setting mode
 	LCD_Out( 0x2D ); // Clear display
-	while ( *line1 ) {
-		LCD_Out( *line1 );
-		line1++;
+
+	for ( uint8_t row=0; row < LCD_ROWS; row++ ) {
+		for ( uint8_t column=0; column < LCD_COLUMNS; column++ ) {
+			lcdShadow[row][column] = ' ';
+		}
 	}
-	while ( *line2 ) {
-		LCD_Out( *line2 );
-		line2++;
+	lcdCursor = 0;
+}
+
+/*
+ * Writes text into a field width characters wide at row, column,
+ * padding with spaces. Only the characters that differ from what
+ * is already on the display are sent.
+ */
+void LCD_Write_Field( uint8_t row, uint8_t column, char *text, uint8_t width ) {
+	if ( ( row >= LCD_ROWS ) || ( column >= LCD_COLUMNS ) ) {
+		return;
+	}
+	if ( column + width > LCD_COLUMNS ) {
+		width = LCD_COLUMNS - column;
 	}
+
+	uint8_t end = column + width;
+	char line[LCD_COLUMNS];
+
+	for ( uint8_t i=column; i < end; i++ ) {
+		line[i] = ( *text ) ? *text++ : ' ';
+	}
+
+	uint8_t i = column;
+	while ( i < end ) {
+		if ( line[i] == lcdShadow[row][i] ) {
+			i++;
+			continue;
+		}
+
+		_LCD_Move_Cursor( row, i );
+
+		// Resending a short run of unchanged characters is cheaper
+		// than the two byte cursor move it would take to skip them
+		uint8_t last = i;
+		for ( uint8_t j=i; j < end; j++ ) {
+			if ( line[j] != lcdShadow[row][j] ) {
+				if ( j - last > LCD_CURSOR_MOVE_BYTES ) {
+					break;
+				}
+				last = j;
+			}
+		}
+
+		while ( i <= last ) {
+			LCD_Out( line[i] );
+			lcdShadow[row][i] = line[i];
+			i++;
+		}
+
+		// The display's cursor wraps at the end of a row, ours doesn't
+		lcdCursor = ( i < LCD_COLUMNS ) ? row * LCD_COLUMNS + i : LCD_CURSOR_UNKNOWN;
+	}
+}
+
+void LCD_Write( char *line1, char *line2 ) {
+	LCD_Write_Field( 0, 0, line1, LCD_COLUMNS );
+	LCD_Write_Field( 1, 0, line2, LCD_COLUMNS );
 }
 
 void LCD_Backlight_Full()
 {
-	LCD_Out( 0x7C ); // Enter setting mode
-	LCD_Out( 0x2D ); // Clear display
+	LCD_Clear();
 
 	LCD_Out( 0x7C ); // Enter setting mode
 	LCD_Out( 0x9D ); // Red backlight full
@@ -4,9 +4,22 @@
 #ifndef __LCD_H
 #define __LCD_H
 
+#include "stdint.h"
+
+#define LCD_ROWS 2
+#define LCD_COLUMNS 16
+
 void LCD_Init();
 void LCD_Backlight_Full();
+void LCD_Clear();
 void LCD_Write( char *line1, char *line2 );
+void LCD_Write_Field( uint8_t row, uint8_t column, char *text, uint8_t width );
+void LCD_Register_Complete_Callback( void (*callback)() );
+uint8_t LCD_Busy();
+void LCD_SSI0_Handler();
 
+#ifdef BENCH_ENABLED
+void LCD_Bench_Reset();
+#endif
 
 #endif // __LCD_H
\ No newline at end of file
@@ -8,17 +8,41 @@
 // 23 February 2020
 
 #include "stdint.h"
-#include "stdio.h"
 #include "string.h"
 
 #include "tm4c123gh6pm.h"
 
 #include "lcd.h"
 #include "ds18b20.h"
+#include "wind-rain.h"
 #include "gps.h"
 #include "rda1846.h"
-
-uint8_t cycleCount = 0; // 0 to 119
+#include "pwm-i2c.h"
+#include "bme280.h"
+#include "adc-supply.h"
+#include "aprs.h"
+#include "adc-audio.h"
+#include "csma.h"
+#include "tdma.h"
+#include "afsk.h"
+#include "digi.h"
+#include "kiss.h"
+#include "format.h"
+#include "clock.h"
+#include "calibration.h"
+#include "power.h"
+#include "history.h"
+#include "flash-log.h"
+#include "telemetry.h"
+#include "profile.h"
+#include "trace.h"
+#include "bench.h"
+
+uint8_t cycleCount = 0; // 0 to 29
+
+// Send a weather report every 10 minutes (1200 cycles)
+#define APRS_REPORT_CYCLES 1200
+uint16_t reportCycleCount = 0;
 
 uint8_t gpsDataValid = 0;
 uint8_t gpsDeviceDetected = 0;
@@ -31,8 +55,40 @@ char latHem, longHem;
 
 int16_t temperatureDegreesF = 0;
 
+// Log one observation per GPS minute
+uint8_t loggedMinute = 0xFF;
+
+// Alternate the top line between the time and the day's extremes
+uint8_t displayExtremes = 0;
+
 #define PF2 (*((volatile uint32_t *)0x40025010))
 
+/*
+ * Frames heard on the air go to the digipeater and the KISS host
+ */
+void Receive_Frame( uint8_t *frame, uint16_t length ) {
+	KISS_Send_Frame( frame, length );
+	Digi_Receive_Frame( frame, length );
+}
+
+/*
+ * Stores the last minute's mean of each sensor in flash
+ */
+void Log_Observation() {
+	uint32_t now = GPS_Get_Seconds();
+	int16_t values[FLASH_LOG_VALUES];
+
+	for ( uint8_t channel=0; channel < FLASH_LOG_VALUES; channel++ ) {
+		History_Stats lastMinute;
+		values[channel] = FLASH_LOG_NO_VALUE;
+		if ( History_Get_Stats( channel, HISTORY_1_MINUTE, now, &lastMinute ) ) {
+			values[channel] = lastMinute.mean;
+		}
+	}
+
+	Flash_Log_Append( now, values );
+}
+
 void Init() {
 	// Activate clock for Port F
 	SYSCTL_RCGCGPIO_R |= 0x00000020;
@@ -56,6 +112,10 @@ void Init() {
 	PF2 = 0x04;
 }
 
+void Timer1A_Clock_Changed( uint32_t hz ) {
+	TIMER1_TAILR_R = hz / 2;
+}
+
 // Temporary until we hook this up properly
 // Request an updated temperature once per second
 // When we do this for reals, we won't need to
@@ -82,9 +142,10 @@ void Timer1A_Init() {
 	// No prescaling
 	TIMER1_TAPR_R = 0;
 
-	// Assuming a 16 MHz clock, set the initial counting value
-	// (8000000 -> 0x7A1200 -> 2 Hz
-	TIMER1_TAILR_R = 0x7A1200;
+	// Set the initial counting value for 2 Hz from the system clock
+	// (8000000 -> 0x7A1200 at 16 MHz)
+	Timer1A_Clock_Changed( Clock_Get_Hz() );
+	Clock_Register_Change_Callback( Timer1A_Clock_Changed );
 
 	// Enable timeout (rollover) interrupt
 	TIMER1_IMR_R |= TIMER_IMR_TATOIM;
@@ -106,12 +167,29 @@ void Timer1A_Init() {
  * Fires twice each second
  */
 void Timer1A_Handler() {
+	// The periodic timer reloaded when it fired and has been
+	// counting down since
+	PROFILE_ENTER_LATE( PROFILE_TICK, TIMER1_TAILR_R - TIMER1_TAV_R );
+
 	// Acknowledge interrupt
 	TIMER1_ICR_R = TIMER_ICR_TATOCINT;
+	TRACE( TRACE_TICK, cycleCount, 0 );
 
 	// Toggle the LED on every cycle
 	PF2 ^= 0x04;
 
+	// Keep the digipeater's duplicate window and power stats moving,
+	// the wind and rain counted, the supplies measured, the I2C bus
+	// watched and the telemetry flowing
+	if ( cycleCount & 0x01 ) {
+		Wind_Rain_Tick_Second();
+		ADC_Supply_Start_Sequence();
+		Digi_Tick_Second();
+		PWM_I2C_Tick_Second();
+		Power_Tick_Second();
+		Telemetry_Tick_Second();
+	}
+
 	// TODO read thermometer
 
 	// Every 10th cycle (5 seconds) update GPS and therm state
@@ -128,13 +206,22 @@ void Timer1A_Handler() {
 		thermometerDataValid = DS18B20_Data_Valid();
 		if ( thermometerDataValid ) {
 			temperatureDegreesF = DS18B20_Get_Temperature_F();
+			if ( gpsDataValid ) {
+				History_Add_Sample( HISTORY_TEMPERATURE, GPS_Get_Seconds(), temperatureDegreesF );
+				Telemetry_Send_Sample( HISTORY_TEMPERATURE, GPS_Get_Seconds(), temperatureDegreesF );
+			}
+		}
+
+		if ( gpsDataValid && ( minute != loggedMinute ) ) {
+			Log_Observation();
+			loggedMinute = minute;
 		}
 	}
 
 	// Update the display every 10 seconds
 	if ( 0 == cycleCount % 20 ) {
-		char line1[17];
-		char line2[17];
+		char line1[LCD_COLUMNS + 1];
+		char line2[LCD_COLUMNS + 1];
 
 		if ( ! gpsDeviceDetected ) {
 			strcpy( line1, "Looking for GPS" );
@@ -147,19 +234,54 @@ void Timer1A_Handler() {
 			GPS_Get_Time( &hour, &minute, &seconds );
 			GPS_Get_Latitude( &latDeg, 0, 0, &latHem );
 			GPS_Get_Longitude( &longDeg, 0, 0, &longHem );
-			sprintf( line1, "%02hu/%02hu/%04u %02u:%02u", month, day, year, hour, minute );
+
+			History_Stats extremes;
+			displayExtremes = ! displayExtremes;
+			if ( displayExtremes && History_Get_Stats( HISTORY_TEMPERATURE, HISTORY_24_HOURS, GPS_Get_Seconds(), &extremes ) ) {
+				// Hi TTT  Lo TTT F
+				Format_String( &line1[0], "Hi ", 3 );
+				Format_Signed( &line1[3], extremes.maximum, 3, ' ' );
+				Format_String( &line1[6], "  Lo ", 5 );
+				Format_Signed( &line1[11], extremes.minimum, 3, ' ' );
+				Format_String( &line1[14], " F", 2 );
+				line1[16] = 0;
+			} else {
+				// MM/DD/YYYY HH:MM
+				Format_Unsigned( &line1[0], month, 2, '0' );
+				line1[2] = '/';
+				Format_Unsigned( &line1[3], day, 2, '0' );
+				line1[5] = '/';
+				Format_Unsigned( &line1[6], year, 4, '0' );
+				line1[10] = ' ';
+				Format_Unsigned( &line1[11], hour, 2, '0' );
+				line1[13] = ':';
+				Format_Unsigned( &line1[14], minute, 2, '0' );
+				line1[16] = 0;
+			}
+
+			// DD H DDD H TTT F
+			Format_Unsigned( &line2[0], latDeg, 2, '0' );
+			line2[2] = ' ';
+			line2[3] = latHem;
+			line2[4] = ' ';
+			Format_Unsigned( &line2[5], longDeg, 3, '0' );
+			line2[8] = ' ';
+			line2[9] = longHem;
+			line2[10] = ' ';
 			if ( DS18B20_Data_Valid() ) {
-				sprintf( line2, "%02hu %c %03hu %c %3d F", latDeg, latHem, longDeg, longHem, temperatureDegreesF );
+				Format_Signed( &line2[11], temperatureDegreesF, 3, ' ' );
 			} else {
-				sprintf( line2, "%02hu %c %03hu %c --- F", latDeg, latHem, longDeg, longHem );
+				Format_String( &line2[11], "---", 3 );
 			}
+			Format_String( &line2[14], " F", 2 );
+			line2[16] = 0;
 		}
 
 		LCD_Write( line1, line2 );
 	}
 
 	// On six cycles (3 seconds) in, start a new temperature measurement
-	if ( cycleCount % 6 ) {
+	if ( 6 == cycleCount ) {
 		DS18B20_Initiate_Measurement();
 	}
 
@@ -168,31 +290,91 @@ void Timer1A_Handler() {
 		DS18B20_Read_Scratchpad();
 	}
 
+	// Measure humidity and pressure every 5 seconds, fetching the
+	// result half a second later
+	if ( 8 == cycleCount % 10 ) {
+		BME280_Initiate_Measurement();
+	} else if ( 9 == cycleCount % 10 ) {
+		BME280_Read_Measurement();
+	}
+
+	reportCycleCount++;
+	if ( reportCycleCount >= APRS_REPORT_CYCLES ) {
+		if ( APRS_Send_Weather_Report() ) {
+			reportCycleCount = 0;
+		}
+	}
+
 	cycleCount++;
-	// Every 120 cycles (60 seconds) start over again
+	// Every 30 cycles (15 seconds) start over again
 	if ( 29 < cycleCount ) {
 		cycleCount = 0;
 	}
+
+	PROFILE_EXIT( PROFILE_TICK );
 }
 
 int main( void ) {
+	// Run from the PLL, plenty of headroom for the demodulator
+	Clock_Init( CLOCK_80_MHZ );
+
+	// Stream the station's state to a host on UART5 - first, so
+	// events from the other drivers' start up make it out
+	Telemetry_Init();
+	Profile_Init();
+	Trace_Init();
+
 	// Initialize the LCD
 	LCD_Init();
+
+	// Benchmark builds time the hot paths while nothing else is
+	// queued - the LCD is the only driver they need started
+	Bench_Run();
+
 	LCD_Backlight_Full();
 
-	// Initialize the thermometer
+	// Initialize the thermometer, anemometer and rain gauge, and
+	// the battery and solar panel monitor
 	DS18B20_Init();
+	Wind_Rain_Init();
+	ADC_Supply_Init();
 
-	// Initialize the GPS
+	// Initialize the GPS, and trim the clock against it
 	GPS_Init();
+	Calibration_Init();
 
-	// Initialize the Radio
+	// Keep a history of the readings for the reports, and a
+	// log of them that survives a power cycle
+	History_Init();
+	Flash_Log_Init();
+
+	// Initialize the Radio and its channel access scheduler
 	RDA1846_Init();
+	CSMA_Init();
+
+	// The humidity and pressure sensor shares the radio's I2C bus
+	BME280_Init();
+
+	// Send in our own GPS time slot
+	TDMA_Init( TDMA_SLOT_AUTO );
+
+	// Render the APRS report templates
+	APRS_Init();
+
+	// Start listening to the receiver audio, relay what we hear
+	// and pass it up to a KISS host
+	ADC_Audio_Init();
+	Digi_Init();
+	KISS_Init();
+	AFSK_Register_Frame_Callback( Receive_Frame );
 
 	// Initialize the main application leds and polling timer
 	Init();
 	Timer1A_Init();
 
+	// Everything else happens in interrupts - sleep in between
+	Power_Init();
 	while ( 1 ) {
+		Power_Idle();
 	}
 }
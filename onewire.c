@@ -7,9 +7,12 @@
 // 23 February 2020
 
 #include "onewire.h"
+#include "clock.h"
+#include "profile.h"
+#include "trace.h"
+#include "capture.h"
 #include "tm4c123gh6pm.h"
-
-#include "stdio.h" // TODO REMOVE AFTER DEBUGGING
+#include "intrinsics.h"
 
 #define ONEWIRE_MAX_TASKS 500
 
@@ -33,11 +36,18 @@ typedef struct OneWire_Tasks {
 } OneWire_Task;
 
 static OneWire_Task tasks[ONEWIRE_MAX_TASKS];
-static uint16_t taskCount = 0;
+static volatile uint16_t taskCount = 0;
 static uint16_t currentTaskIndex = 0;
+static volatile uint8_t queueRunning = 0;
+
+void _OneWire_Wait( uint32_t microseconds );
 
 void _OneWire_AddTask( uint8_t type, uint16_t holdTime, void (*callback)(uint8_t data) ) {
+	__istate_t state = __get_interrupt_state();
+	__disable_interrupt();
+
 	if ( taskCount >= ONEWIRE_MAX_TASKS ) {
+		__set_interrupt_state( state );
 		return;
 	}
 
@@ -45,6 +55,15 @@ void _OneWire_AddTask( uint8_t type, uint16_t holdTime, void (*callback)(uint8_t
 	tasks[taskCount].holdTime = holdTime;
 	tasks[taskCount].callback = callback;
 	taskCount++;
+	TRACE( TRACE_ONEWIRE_ADD, type, taskCount );
+
+	// Timer0 only runs while there is work queued
+	if ( ! queueRunning ) {
+		queueRunning = 1;
+		_OneWire_Wait( ONEWIRE_MIN_WAIT_MICROSECONDS );
+	}
+
+	__set_interrupt_state( state );
 }
 
 void _OneWire_Wait( uint32_t microseconds ) {
@@ -73,8 +92,8 @@ void _OneWire_Wait( uint32_t microseconds ) {
 	// No prescaling
 	TIMER0_TAPR_R = 0;
 
-	// Assuming a 16 MHz clock, set the initial counting value
-	TIMER0_TAILR_R = microseconds * 16;
+	// Set the initial counting value from the system clock
+	TIMER0_TAILR_R = Clock_Microseconds_To_Ticks( microseconds );
 
 	// Enable timeout (rollover) interrupt
 	TIMER0_IMR_R |= TIMER_IMR_TATOIM;
@@ -83,6 +102,7 @@ void _OneWire_Wait( uint32_t microseconds ) {
 	TIMER0_ICR_R = TIMER_ICR_TATOCINT;
 
 	// Enable the countdown
+	PROFILE_SCHEDULE( PROFILE_ONEWIRE, TIMER0_TAILR_R );
 	TIMER0_CTL_R |= TIMER_CTL_TAEN;
 
 	// Set timer priority
@@ -112,6 +132,10 @@ void _OneWire_Release_Bus() {
 }
 
 uint8_t _OneWire_Sample_Bus() {
+#ifdef CAPTURE_REPLAY
+	// Replaying - the bus says what it said last time
+	return Capture_Replay_OneWire();
+#else
 	//if ( PB7 & 0x80 ) {
 	//	return 1;
 	//}
@@ -121,6 +145,7 @@ uint8_t _OneWire_Sample_Bus() {
 		return 1;
 	}
 	return 0;
+#endif
 }
 
 void _OneWire_Write_0_Bit() {
@@ -154,17 +179,22 @@ void OneWire_Init( void ) {
 	//GPIO_PORTB_PUR_R |= 0x80;			// Enable weak pull up for PB7
 	GPIO_PORTE_PUR_R |= 0x08;			// Enable weak pull up for PE3
 
-	// Start task queue processing
-	_OneWire_Wait( 1000 );
+	// Task queue processing starts when the first task is added
+	queueRunning = 0;
 }
 
 void OneWire_Timer0A_Handler() {
+	PROFILE_ENTER( PROFILE_ONEWIRE );
+
 	// Acknowledge the interrupt (Timer0A)
 	TIMER0_ICR_R = TIMER_ICR_TATOCINT;
 
 	if ( 0 == taskCount ) {
-		// If no tasks in the queue, go back to sleep for 1 ms
-		_OneWire_Wait( 1000 );
+		// Queue is empty - stop, and gate Timer0 until more work arrives
+		queueRunning = 0;
+		SYSCTL_RCGCTIMER_R &= ~0x01;
+		TRACE( TRACE_ONEWIRE_IDLE, 0, 0 );
+		PROFILE_EXIT( PROFILE_ONEWIRE );
 		return;
 	}
 
@@ -172,6 +202,7 @@ void OneWire_Timer0A_Handler() {
 	OneWire_Task currentTask = tasks[ currentTaskIndex ];
 	// Start the next one shot right away
 	_OneWire_Wait( currentTask.holdTime );
+	TRACE( TRACE_ONEWIRE_TASK, currentTask.type, taskCount - currentTaskIndex - 1 );
 	// Set up for next task now
 	currentTaskIndex++;
 	if ( currentTaskIndex >= taskCount ) {
@@ -194,21 +225,26 @@ void OneWire_Timer0A_Handler() {
 	if ( currentTask.type == ONEWIRE_SAMPLE_BUS ) {
 		shiftRegister = shiftRegister >> 1;
 		sample = _OneWire_Sample_Bus();
+		CAPTURE_ONEWIRE_SAMPLE( sample );
 		if ( sample ) {
 			shiftRegister |= 0x80;
 		}
 		if ( currentTask.callback ) {
+			TRACE( TRACE_ONEWIRE_CALLBACK, currentTask.type, sample );
 			currentTask.callback( sample );
 		}
 	}
 
 	if ( currentTask.type == ONEWIRE_TRANSFER_BYTE ) {
 		if ( currentTask.callback ) {
+			TRACE( TRACE_ONEWIRE_CALLBACK, currentTask.type, shiftRegister );
 			currentTask.callback( shiftRegister );
 		}
 	}
 
 	// TODO BUS HIGH
+
+	PROFILE_EXIT( PROFILE_ONEWIRE );
 }
 
 void OneWire_Reset( void (*callback)(uint8_t data) ) {
@@ -239,4 +275,21 @@ void OneWire_ReadByte( void (*callback)(uint8_t data) ) {
 
 void OneWire_WaitForHigh( void (*callback)(uint8_t data) ) {
 	_OneWire_AddTask( ONEWIRE_WAIT_BUS_HIGH, 1000, callback );
-}
\ No newline at end of file
+}
+
+#ifdef BENCH_ENABLED
+/*
+ * Throws away queued tasks before the handler has run any of them
+ * and stops Timer0 - for bench.c, between timing runs
+ */
+void OneWire_Bench_Reset() {
+	TIMER0_CTL_R &= ~TIMER_CTL_TAEN;
+	TIMER0_ICR_R = TIMER_ICR_TATOCINT;
+	NVIC_UNPEND0_R = 1 << 19;
+	SYSCTL_RCGCTIMER_R &= ~0x01;
+
+	taskCount = 0;
+	currentTaskIndex = 0;
+	queueRunning = 0;
+}
+#endif
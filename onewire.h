@@ -14,4 +14,8 @@ void OneWire_WriteByte( uint8_t data );
 void OneWire_ReadByte( void (*callback)(uint8_t data) );
 void OneWire_WaitForHigh( void (*callback)(uint8_t data) );
 
+#ifdef BENCH_ENABLED
+void OneWire_Bench_Reset();
+#endif
+
 #endif // __ONEWIRE_H
\ No newline at end of file
@@ -0,0 +1,60 @@
+// Low power idle for the TM4C123
+//
+// Everything the station does runs from interrupts, so main()
+// only has to sleep between them. Drivers arm their one-shot
+// timers only while they have work queued and gate the timer
+// clocks when they go idle, so the next wakeup is whichever
+// pending timer or peripheral fires first.
+//
+// Plain sleep rather than deep sleep: deep sleep drops the
+// system clock to the PIOSC and stops the PLL, which would throw
+// off the GPS UART and the 9600 Hz audio sampling. With ACG
+// clear in RCC, peripherals keep their run mode (RCGC) clocks in
+// sleep, so whatever a driver gates in RCGC stays gated.
+
+#include "power.h"
+#include "tm4c123gh6pm.h"
+#include "intrinsics.h"
+
+#define POWER_RCC_ACG 0x08000000
+#define POWER_SCR_SLEEPDEEP 0x04
+#define POWER_SCR_SLEEPONEXIT 0x02
+
+static volatile uint32_t wakeupsThisMinute = 0;
+static uint32_t wakeupsPerMinute = 0;
+static uint8_t powerSeconds = 0;
+
+void Power_Init() {
+	// Sleep uses the run mode clock gating
+	SYSCTL_RCC_R &= ~POWER_RCC_ACG;
+
+	// WFI enters plain sleep and returns to the idle loop
+	NVIC_SYS_CTRL_R &= ~( POWER_SCR_SLEEPDEEP | POWER_SCR_SLEEPONEXIT );
+}
+
+/*
+ * Sleeps until the next interrupt - call from the main loop
+ */
+void Power_Idle() {
+	__WFI();
+	wakeupsThisMinute++;
+}
+
+/*
+ * Call once a second to roll the wakeup count over each minute
+ */
+void Power_Tick_Second() {
+	powerSeconds++;
+	if ( powerSeconds >= 60 ) {
+		wakeupsPerMinute = wakeupsThisMinute;
+		wakeupsThisMinute = 0;
+		powerSeconds = 0;
+	}
+}
+
+/*
+ * Times the idle loop woke up during the last full minute
+ */
+uint32_t Power_Get_Wakeups_Per_Minute() {
+	return wakeupsPerMinute;
+}
@@ -0,0 +1,13 @@
+// Low power idle for the TM4C123
+
+#ifndef __POWER_H
+#define __POWER_H
+
+#include "stdint.h"
+
+void Power_Init();
+void Power_Idle();
+void Power_Tick_Second();
+uint32_t Power_Get_Wakeups_Per_Minute();
+
+#endif // __POWER_H
@@ -0,0 +1,222 @@
+// Interrupt handler profiling with the DWT cycle counter
+//
+// Handlers nest by priority, so a stack of the handlers in
+// progress lets a preempted handler's duration leave out the
+// cycles spent in the ones that preempted it. Each push and pop
+// is made with interrupts masked, along with the cycle count it
+// goes with: a handler preempting in between would push into the
+// same slot, or bill its time to the wrong handler.
+
+#include "profile.h"
+#include "intrinsics.h"
+
+#ifdef PROFILE_HOST
+static uint32_t hostCycles = 0;
+static uint32_t (*hostCounter)() = 0;
+
+void Profile_Host_Advance( uint32_t cycles ) {
+	hostCycles += cycles;
+}
+
+/*
+ * Reads a counter of the host's instead of the virtual one, e.g.
+ * for the bench runner - 0 goes back to the virtual counter
+ */
+void Profile_Host_Set_Counter( uint32_t (*counter)() ) {
+	hostCounter = counter;
+}
+#endif
+
+/*
+ * Starts the DWT cycle counter - every module that reads it calls
+ * this from its init, since any of them may be built alone
+ */
+void Profile_Enable_Cycle_Counter() {
+#ifndef PROFILE_HOST
+	DEMCR |= 0x01000000;
+	DWT_CTRL |= 0x01;
+#endif
+}
+
+uint32_t Profile_Get_Cycles() {
+#ifdef PROFILE_HOST
+	return hostCounter ? hostCounter() : hostCycles;
+#else
+	return DWT_CYCCNT;
+#endif
+}
+
+#ifdef PROFILE_ENABLED
+
+static Profile_ISR profiles[PROFILE_ISRS];
+
+// When each handler's one-shot is due
+static uint32_t scheduledCycles[PROFILE_ISRS];
+static uint8_t scheduled[PROFILE_ISRS];
+
+// Handlers in progress, innermost last
+static uint8_t stack[PROFILE_ISRS];
+static uint8_t depth = 0;
+static uint32_t enteredCycles[PROFILE_ISRS];
+static uint32_t preemptedCycles[PROFILE_ISRS];
+
+uint8_t _Profile_Bucket( uint32_t value ) {
+	if ( 0 == value ) {
+		return 0;
+	}
+#ifdef PROFILE_HOST
+	uint8_t bucket = 32 - __builtin_clz( value );
+#else
+	uint8_t bucket = 32 - __CLZ( value );
+#endif
+	return ( bucket < PROFILE_BUCKETS ) ? bucket : PROFILE_BUCKETS - 1;
+}
+
+void _Profile_Count( uint16_t *histogram, uint32_t value ) {
+	uint8_t bucket = _Profile_Bucket( value );
+	if ( histogram[bucket] < 0xFFFF ) {
+		histogram[bucket]++;
+	}
+}
+
+void Profile_Init() {
+	Profile_Enable_Cycle_Counter();
+	Profile_Reset();
+}
+
+/*
+ * Notes when a one-shot timer (counting system clock ticks, the
+ * same as the DWT) is due to interrupt. Call just before it starts.
+ */
+void Profile_Schedule( uint8_t isr, uint32_t ticks ) {
+	if ( isr >= PROFILE_ISRS ) {
+		return;
+	}
+
+	scheduledCycles[isr] = Profile_Get_Cycles() + ticks;
+	scheduled[isr] = 1;
+}
+
+/*
+ * Call first thing in a handler. Latency comes from the schedule
+ * unless the caller knows it (PROFILE_NO_LATENCY otherwise).
+ */
+void Profile_Enter( uint8_t isr, uint32_t latency ) {
+	if ( isr >= PROFILE_ISRS ) {
+		return;
+	}
+
+	__istate_t state = __get_interrupt_state();
+	__disable_interrupt();
+	uint32_t now = Profile_Get_Cycles();
+	enteredCycles[isr] = now;
+	preemptedCycles[isr] = 0;
+	stack[depth] = isr;
+	depth++;
+	__set_interrupt_state( state );
+
+	if ( ( PROFILE_NO_LATENCY == latency ) && scheduled[isr] ) {
+		int32_t late = (int32_t) ( now - scheduledCycles[isr] );
+		latency = ( late > 0 ) ? late : 0;
+	}
+	scheduled[isr] = 0;
+
+	if ( PROFILE_NO_LATENCY != latency ) {
+		_Profile_Count( profiles[isr].latency, latency );
+		if ( latency > profiles[isr].maxLatency ) {
+			profiles[isr].maxLatency = latency;
+		}
+	}
+}
+
+/*
+ * Call last thing in a handler (and before any early return)
+ */
+void Profile_Exit( uint8_t isr ) {
+	if ( isr >= PROFILE_ISRS ) {
+		return;
+	}
+
+	__istate_t state = __get_interrupt_state();
+	__disable_interrupt();
+	if ( 0 == depth ) {
+		__set_interrupt_state( state );
+		return;
+	}
+	uint32_t elapsed = Profile_Get_Cycles() - enteredCycles[isr];
+	uint32_t duration = elapsed - preemptedCycles[isr];
+	depth--;
+	if ( depth ) {
+		// Don't bill the handler we preempted for our time
+		preemptedCycles[stack[depth - 1]] += elapsed;
+	}
+	__set_interrupt_state( state );
+
+	Profile_ISR *profile = &profiles[isr];
+	profile->count++;
+	profile->cycles += duration;
+	_Profile_Count( profile->duration, duration );
+	if ( duration > profile->maxDuration ) {
+		profile->maxDuration = duration;
+	}
+}
+
+/*
+ * Copies out one handler's profile
+ * Returns 0 if there is no such handler
+ */
+uint8_t Profile_Get_ISR( uint8_t isr, Profile_ISR *profile ) {
+	if ( ( isr >= PROFILE_ISRS ) || ! profile ) {
+		return 0;
+	}
+
+	// Telemetry asks from inside its own critical sections too
+	__istate_t state = __get_interrupt_state();
+	__disable_interrupt();
+	*profile = profiles[isr];
+	__set_interrupt_state( state );
+
+	return 1;
+}
+
+void Profile_Reset() {
+	__istate_t state = __get_interrupt_state();
+	__disable_interrupt();
+	for ( uint8_t isr=0; isr < PROFILE_ISRS; isr++ ) {
+		profiles[isr].count = 0;
+		profiles[isr].cycles = 0;
+		profiles[isr].maxLatency = 0;
+		profiles[isr].maxDuration = 0;
+		for ( uint8_t bucket=0; bucket < PROFILE_BUCKETS; bucket++ ) {
+			profiles[isr].latency[bucket] = 0;
+			profiles[isr].duration[bucket] = 0;
+		}
+		scheduled[isr] = 0;
+	}
+	__set_interrupt_state( state );
+}
+
+#else
+
+// Compiled out - the handlers aren't calling in, so just say so
+
+void Profile_Init() {
+}
+
+void Profile_Schedule( uint8_t isr, uint32_t ticks ) {
+}
+
+void Profile_Enter( uint8_t isr, uint32_t latency ) {
+}
+
+void Profile_Exit( uint8_t isr ) {
+}
+
+uint8_t Profile_Get_ISR( uint8_t isr, Profile_ISR *profile ) {
+	return 0;
+}
+
+void Profile_Reset() {
+}
+
+#endif // PROFILE_ENABLED
@@ -0,0 +1,80 @@
+// Interrupt handler profiling with the DWT cycle counter
+//
+// Built only when PROFILE_ENABLED is defined (the Debug project
+// configuration defines it); otherwise the PROFILE_ macros compile
+// to nothing and the handlers carry no overhead. Defining
+// PROFILE_HOST swaps the DWT for a virtual cycle counter that a
+// simulation advances, so host and hardware profiles line up.
+//
+// Each handler gets a count, its total cycles and log2 histograms
+// of entry latency and duration. Bucket 0 counts zeros and bucket
+// n counts values from 2^(n-1) to 2^n - 1, with the last bucket
+// taking everything longer.
+
+#ifndef __PROFILE_H
+#define __PROFILE_H
+
+#include "stdint.h"
+
+#define PROFILE_ONEWIRE 0
+#define PROFILE_GPS_UART 1
+#define PROFILE_I2C 2
+#define PROFILE_TICK 3
+#define PROFILE_CSMA 4
+#define PROFILE_KISS 5
+#define PROFILE_LCD 6
+#define PROFILE_AUDIO 7
+#define PROFILE_TELEMETRY 8
+#define PROFILE_RAIN 9
+#define PROFILE_SUPPLY 10
+#define PROFILE_PWM 11
+#define PROFILE_WIND 12
+#define PROFILE_ISRS 13
+
+#define PROFILE_BUCKETS 24
+
+// Debug Exception and Monitor Control, and the DWT cycle counter
+#define DEMCR (*((volatile uint32_t *)0xE000EDFC))
+#define DWT_CTRL (*((volatile uint32_t *)0xE0001000))
+#define DWT_CYCCNT (*((volatile uint32_t *)0xE0001004))
+
+typedef struct Profile_ISRs {
+	uint32_t count;
+	uint64_t cycles;
+	uint32_t maxLatency;
+	uint32_t maxDuration;
+	uint16_t latency[PROFILE_BUCKETS];
+	uint16_t duration[PROFILE_BUCKETS];
+} Profile_ISR;
+
+#ifdef PROFILE_ENABLED
+// Call where a one-shot timer is armed to fire in ticks
+#define PROFILE_SCHEDULE( isr, ticks ) Profile_Schedule( isr, ticks )
+#define PROFILE_ENTER( isr ) Profile_Enter( isr, PROFILE_NO_LATENCY )
+// For periodic timers that can say how long ago they fired
+#define PROFILE_ENTER_LATE( isr, cycles ) Profile_Enter( isr, cycles )
+#define PROFILE_EXIT( isr ) Profile_Exit( isr )
+#else
+#define PROFILE_SCHEDULE( isr, ticks )
+#define PROFILE_ENTER( isr )
+#define PROFILE_ENTER_LATE( isr, cycles )
+#define PROFILE_EXIT( isr )
+#endif
+
+#define PROFILE_NO_LATENCY 0xFFFFFFFF
+
+void Profile_Init();
+void Profile_Enable_Cycle_Counter();
+uint32_t Profile_Get_Cycles();
+void Profile_Schedule( uint8_t isr, uint32_t ticks );
+void Profile_Enter( uint8_t isr, uint32_t latency );
+void Profile_Exit( uint8_t isr );
+uint8_t Profile_Get_ISR( uint8_t isr, Profile_ISR *profile );
+void Profile_Reset();
+
+#ifdef PROFILE_HOST
+void Profile_Host_Advance( uint32_t cycles );
+void Profile_Host_Set_Counter( uint32_t (*counter)() );
+#endif
+
+#endif // __PROFILE_H
@@ -2,36 +2,138 @@
 // Based on work by Jonathan Valvano
 //
 // Useful for I2C devices that can also accept
-// PWM inputs, like radios or other audio devices
+// PWM inputs, like radios or other audio devices,
+// sharing the bus with other I2C devices
 //
 // Uses Timer2A for one-shots
 // Uses I2C0: PB2 (SCL), PB3 (SDA)
 // Uses PB4 as nCS
-// Uses PB6 as PWM
+// Uses PWM0 generator 0: PB6 (M0PWM0)
+//
+// Every bus access is a transaction - a device, a register, and
+// bytes written after it or read back after a repeated start -
+// queued by priority and run a byte at a time from the I2C0
+// interrupt, with the result handed to a callback.
+//
+// The PWM device (the radio) queues at radio priority, and can
+// have a transaction wait some milliseconds (Timer2A) before its
+// next one, e.g. to let the synthesizer settle or to pace its RSSI
+// polling. That wait only holds back the radio's queue: sensor
+// transactions use the bus meanwhile, and also get a turn after
+// every PWM_I2C_RADIO_BURST radio transactions in a row, so a long
+// radio set up can't starve them either.
+//
+// A device that NACKs gets a STOP, finished from the next I2C0
+// interrupt. A transaction that makes no progress for
+// PWM_I2C_TIMEOUT_SECONDS (a lost interrupt, or a device holding
+// SCL or SDA low) is ended with PWM_I2C_TIMEOUT, after clocking
+// the bus by hand until the device lets go of it.
+//
+// The PWM output plays audio into the device: a source hands over
+// an 8-bit level each PWM period, from the generator's own reload
+// interrupt, so the sample clock is the PWM carrier itself. It
+// runs at priority 1, above the audio demodulator's long blocks,
+// so no period goes out with a stale level.
 //
 // Allen Snook
 // 2 March 2020
 
 #include "pwm-i2c.h"
+#include "clock.h"
+#include "profile.h"
+#include "trace.h"
+#include "capture.h"
+#include "intrinsics.h"
 #include "tm4c123gh6pm.h"
 
+#define PB2 (*((volatile uint32_t *)0x40005010))
+#define PB3 (*((volatile uint32_t *)0x40005020))
 #define PB4 (*((volatile uint32_t *)0x40005040))
 
 #define PWM_I2C_MAX_COMMANDS 100
+#define PWM_I2C_MAX_SENSOR_TRANSACTIONS 8
 #define PWM_I2C_MIN_WAIT_MILLISECONDS 1
-
-typedef struct PWM_I2C_Commands {
-	uint16_t address;
-	uint16_t data;
-	uint16_t mask;
-	uint16_t waitMS;
-} PWM_I2C_Command;
+#define PWM_I2C_BIT_RATE 100000
+
+// Radio transactions in a row before a waiting sensor goes
+#define PWM_I2C_RADIO_BURST 4
+
+// Seconds ticks without a byte moving before a transaction is ended
+#define PWM_I2C_TIMEOUT_SECONDS 2
+
+// A byte and its ACK - enough for any device to let go of SDA
+#define PWM_I2C_RECOVERY_CLOCKS 9
+
+// What the transaction on the bus is doing
+#define PWM_I2C_STATE_IDLE 0
+#define PWM_I2C_STATE_WRITE 1
+#define PWM_I2C_STATE_READ 2
+#define PWM_I2C_STATE_STOPPING 3
+
+typedef struct PWM_I2C_Transactions {
+	const PWM_I2C_Device *device;
+	uint8_t reg;
+	uint8_t writeLength;
+	uint8_t readLength;
+	uint8_t writeData[PWM_I2C_MAX_WRITE];
+	uint16_t mask;					// Word writes: bits kept from a read first
+	uint16_t waitMS;				// Radio: hold its queue this long after
+	uint8_t *readData;				// 0 for word reads
+	void (*callback)( uint8_t status, uint8_t *data, uint8_t length );
+	void (*wordCallback)( uint16_t data );
+} PWM_I2C_Transaction;
+
+// Ring of pending transactions - the I2C0 handler consumes from
+// head, queueing appends at tail
+typedef struct PWM_I2C_Queues {
+	PWM_I2C_Transaction *transactions;
+	uint16_t size;
+	volatile uint16_t head;
+	volatile uint16_t tail;
+} PWM_I2C_Queue;
 
 void (*pwm_i2c_callback)();
 
-static PWM_I2C_Command commands[PWM_I2C_MAX_COMMANDS];
-static uint16_t commandCount = 0;
-static uint16_t currentCommandIndex = 0;
+static PWM_I2C_Transaction radioTransactions[PWM_I2C_MAX_COMMANDS];
+static PWM_I2C_Transaction sensorTransactions[PWM_I2C_MAX_SENSOR_TRANSACTIONS];
+static PWM_I2C_Queue queues[PWM_I2C_PRIORITIES] = {
+	{ radioTransactions, PWM_I2C_MAX_COMMANDS, 0, 0 },
+	{ sensorTransactions, PWM_I2C_MAX_SENSOR_TRANSACTIONS, 0, 0 }
+};
+
+static PWM_I2C_Device radioDevice = { 0, PWM_I2C_PRIORITY_RADIO };
+
+// The transaction on the bus, and how far into its current
+// phase (bytes after the register, or bytes read) it is
+static PWM_I2C_Transaction current;
+static volatile uint8_t currentState = PWM_I2C_STATE_IDLE;
+static uint8_t phaseWrite = 0;
+static uint8_t phaseRead = 0;
+static uint8_t phaseBytes = 0;
+static uint8_t *phaseData;
+static uint8_t updatePending = 0;
+static uint8_t wordData[2];
+static uint8_t stoppingStatus = PWM_I2C_OK;
+
+// Bumped by the handler as bytes move, watched by the seconds tick
+static volatile uint8_t progress = 0;
+static uint8_t lastProgress = 0;
+static uint8_t stalledSeconds = 0;
+static volatile uint8_t timeoutPending = 0;
+
+static volatile uint8_t radioHeld = 0;
+static uint8_t radioRun = 0;
+
+static uint8_t (*pwmSource)( uint8_t *level );
+static uint32_t pwmSampleRate = 0;
+static uint16_t pwmLoad = 0;
+
+static uint32_t pwmI2CTransactions = 0;
+static uint32_t pwmI2CErrors = 0;
+static uint32_t pwmI2CBytes = 0;
+static uint32_t pwmI2CRecoveries = 0;
+
+void _PWM_I2C_Next();
 
 /*
  * Sets up Timer2A as a one-shot timer
@@ -63,8 +165,9 @@ void _PWM_I2C_Sleep( uint16_t milliseconds ) {
 	// No prescaling
 	TIMER2_TAPR_R = 0;
 
-	// Assuming a 16 MHz clock, set the initial counting value
-	TIMER2_TAILR_R = milliseconds * 16000;
+	// Set the initial counting value from the system clock,
+	// capped at what the 32 bit timer can count
+	TIMER2_TAILR_R = Clock_Milliseconds_To_Ticks( milliseconds );
 
 	// Enable timeout (rollover) interrupt
 	TIMER2_IMR_R |= TIMER_IMR_TATOIM;
@@ -73,6 +176,7 @@ void _PWM_I2C_Sleep( uint16_t milliseconds ) {
 	TIMER2_ICR_R = TIMER_ICR_TATOCINT;
 
 	// Enable the countdown
+	PROFILE_SCHEDULE( PROFILE_I2C, TIMER2_TAILR_R );
 	TIMER2_CTL_R |= TIMER_CTL_TAEN;
 
 	// Set timer priority
@@ -84,134 +188,489 @@ void _PWM_I2C_Sleep( uint16_t milliseconds ) {
 }
 
 /*
- * Read a 16-b word from the I2C device at address
- * Based on Valvano p.376
- *
+ * Gets the I2C0 handler to look at the queues
+ */
+void _PWM_I2C_Kick() {
+#ifdef CAPTURE_REPLAY
+	// Replaying - no interrupts, the queue runs to its next wait now
+	_PWM_I2C_Next();
+#else
+	// I2C0 is interrupt 8
+	NVIC_PEND0_R = 1 << 8;
+#endif
+}
+
+/*
+ * Addresses the device and sends the register, then either writes
+ * writeLength bytes from data or reads readLength bytes into it
+ */
+void _PWM_I2C_Begin( uint8_t writeLength, uint8_t readLength, uint8_t *data ) {
+	phaseWrite = writeLength;
+	phaseRead = readLength;
+	phaseBytes = 0;
+	phaseData = data;
+	currentState = PWM_I2C_STATE_WRITE;
+
+	I2C0_MSA_R = ( current.device->address << 1 ) & 0xFE;
+	I2C0_MDR_R = current.reg;
+	I2C0_MCS_R = I2C_MCS_START | I2C_MCS_RUN | ( ( writeLength || readLength ) ? 0 : I2C_MCS_STOP );
+}
+
+/*
+ * Repeated start, reading phaseRead bytes
  */
-uint16_t PWM_I2C_Read( uint8_t address ) {
-	// TODO Handle errors, retries
+void _PWM_I2C_Begin_Read() {
+	phaseBytes = 0;
+	currentState = PWM_I2C_STATE_READ;
 
-	// Wait until ready
-	while ( I2C0_MCS_R & 0x00000001 ) {};
+	I2C0_MSA_R = ( ( current.device->address << 1 ) & 0xFE ) | 0x01;
+	I2C0_MCS_R = I2C_MCS_START | I2C_MCS_RUN | ( ( 1 == phaseRead ) ? I2C_MCS_STOP : I2C_MCS_ACK );
+}
 
-	I2C0_MSA_R = ( address << 1 ) & 0xFE;
-	I2C0_MSA_R |= 0x01;
-	I2C0_MCS_R = ( I2C_MCS_ACK | I2C_MCS_START | I2C_MCS_RUN );
+/*
+ * Puts a word write's data over the bits its mask keeps from the
+ * value just read
+ */
+void _PWM_I2C_Apply_Mask() {
+	uint16_t newValue = ( ( ( wordData[0] << 8 ) | wordData[1] ) & current.mask ) |
+		( ( current.writeData[0] << 8 ) | current.writeData[1] );
+
+	current.writeData[0] = newValue >> 8;
+	current.writeData[1] = newValue & 0xFF;
+	updatePending = 0;
+}
+
+/*
+ * Hands the transaction's result over and frees the bus
+ */
+void _PWM_I2C_Finish( uint8_t status ) {
+	uint8_t priority = current.device->priority;
+	uint8_t *data = current.readData ? current.readData : wordData;
 
-	// Wait until ready
-	while ( I2C0_MCS_R & 0x00000001 ) {};
+	pwmI2CTransactions++;
+	if ( PWM_I2C_OK != status ) {
+		pwmI2CErrors++;
+	}
 
-	uint16_t data = ( I2C0_MDR_R & 0xFF );
-	data = data << 8;
+	if ( PWM_I2C_PRIORITY_RADIO == priority ) {
+		radioRun++;
+		if ( current.waitMS ) {
+			radioHeld = 1;
+			_PWM_I2C_Sleep( current.waitMS );
+		}
+	} else {
+		radioRun = 0;
+	}
 
-	I2C0_MCS_R = ( I2C_MCS_STOP | I2C_MCS_RUN );
+	if ( current.readLength && ( PWM_I2C_OK == status ) ) {
+		CAPTURE_I2C_READ( current.device->address, current.reg, data, current.readLength );
+		TRACE( TRACE_I2C_READ, current.reg, ( data[0] << 8 ) | ( ( current.readLength > 1 ) ? data[1] : 0 ) );
+	}
 
-	// Wait until ready
-	while ( I2C0_MCS_R & 0x00000001 ) {};
+	if ( current.wordCallback ) {
+		current.wordCallback( ( data[0] << 8 ) | data[1] );
+	} else if ( current.callback ) {
+		current.callback( status, data, current.readLength );
+	}
 
-	data |= ( I2C0_MDR_R & 0xFF );
+	// The radio's queue has run dry with its waits satisfied
+	if ( ( PWM_I2C_PRIORITY_RADIO == priority ) && ! radioHeld &&
+		( queues[PWM_I2C_PRIORITY_RADIO].head == queues[PWM_I2C_PRIORITY_RADIO].tail ) && pwm_i2c_callback ) {
+		pwm_i2c_callback();
+	}
 
-	return data;
+	// Anything the callbacks queued waits for the handler
+	currentState = PWM_I2C_STATE_IDLE;
 }
 
 /*
- * Write a 16-b word to the I2C device at address
- * Based on Valvano p.375
+ * Puts the current transaction on the bus
  */
-void _PWM_I2C_Write( uint8_t address, uint16_t data, uint16_t mask ) {
-	uint16_t newValue = data;
+void _PWM_I2C_Start() {
+	uint8_t *readData = current.readData ? current.readData : wordData;
 
-	// Has a mask? Read the register first
-	if ( 0xFFFF != mask ) {
-		uint16_t currentValue = PWM_I2C_Read( address );
-		newValue = ( currentValue & mask ) | data;
+	updatePending = ( 0xFFFF != current.mask );
+	if ( current.writeLength ) {
+		TRACE( TRACE_I2C_WRITE, current.reg, ( current.writeData[0] << 8 ) | current.writeData[1] );
 	}
 
-	// Wait until ready
-	while ( I2C0_MCS_R & 0x00000001 ) {};
-
-	// Transmit the first 8 bits
-	I2C0_MSA_R = ( address << 1 ) & 0xFE;
-	I2C0_MSA_R &= ~0x01;
-	I2C0_MDR_R = ( newValue >> 8 ) & 0xFF;
-	I2C0_MCS_R = ( I2C_MCS_START | I2C_MCS_RUN );
+#ifdef CAPTURE_REPLAY
+	// Replaying - the devices say what they said last time
+	if ( updatePending ) {
+		Capture_Replay_I2C( current.device->address, current.reg, wordData, 2 );
+		_PWM_I2C_Apply_Mask();
+	}
+	if ( current.readLength ) {
+		Capture_Replay_I2C( current.device->address, current.reg, readData, current.readLength );
+	}
+	pwmI2CBytes += 1 + current.writeLength + current.readLength;
+	_PWM_I2C_Finish( PWM_I2C_OK );
+#else
+	// A masked write reads the register first
+	if ( updatePending ) {
+		_PWM_I2C_Begin( 0, 2, wordData );
+	} else if ( current.readLength ) {
+		_PWM_I2C_Begin( 0, current.readLength, readData );
+	} else {
+		_PWM_I2C_Begin( current.writeLength, 0, current.writeData );
+	}
+#endif
+}
 
-	// Wait until ready
-	while ( I2C0_MCS_R & 0x00000001 ) {};
+/*
+ * Takes the next transaction from the queues, if any is ready -
+ * radio first, unless a sensor has waited out a burst of them
+ */
+void _PWM_I2C_Next() {
+	while ( PWM_I2C_STATE_IDLE == currentState ) {
+		PWM_I2C_Queue *radio = &queues[PWM_I2C_PRIORITY_RADIO];
+		PWM_I2C_Queue *sensor = &queues[PWM_I2C_PRIORITY_SENSOR];
+		uint8_t radioReady = ! radioHeld && ( radio->head != radio->tail );
+		uint8_t sensorReady = ( sensor->head != sensor->tail );
+		PWM_I2C_Queue *queue;
+
+		if ( radioReady && ( ! sensorReady || ( radioRun < PWM_I2C_RADIO_BURST ) ) ) {
+			queue = radio;
+		} else if ( sensorReady ) {
+			queue = sensor;
+		} else {
+			TRACE( TRACE_I2C_IDLE, radioHeld, 0 );
+			return;
+		}
 
-	// TODO Check, handle errors
+		current = queue->transactions[queue->head];
+		queue->head = ( queue->head + 1 ) % queue->size;
+		_PWM_I2C_Start();
+	}
+}
 
-	// Transmit the second 8
-	I2C0_MDR_R = newValue & 0xFF;
-	I2C0_MCS_R = ( I2C_MCS_STOP | I2C_MCS_RUN );
+/*
+ * Spins for at least ticks system clocks - only for bus recovery
+ */
+void _PWM_I2C_Delay( uint32_t ticks ) {
+	for ( volatile uint32_t i = ticks / 4 + 1; i; i-- ) {};
+}
 
-	// Wait until transmission done
-	while ( I2C0_MCS_R & 0x00000001 ) {};
+/*
+ * Frees a bus a device is holding: with the master off, clocks
+ * SCL by hand until the device lets go of SDA, sends a STOP, and
+ * hands the pins back to the master. Around 100 us at 100 kHz.
+ */
+void _PWM_I2C_Recover_Bus() {
+	uint32_t halfBit = Clock_Microseconds_To_Ticks( 500000 / PWM_I2C_BIT_RATE );
+
+	I2C0_MCR_R = 0;
+
+	// SCL and SDA as open drain GPIO, both released
+	GPIO_PORTB_ODR_R |= 0x0C;
+	PB2 = 0x04;
+	PB3 = 0x08;
+	GPIO_PORTB_DIR_R |= 0x0C;
+	GPIO_PORTB_AFSEL_R &= ~0x0C;
+	_PWM_I2C_Delay( halfBit );
+
+	for ( uint8_t i=0; ( i < PWM_I2C_RECOVERY_CLOCKS ) && ! ( PB3 & 0x08 ); i++ ) {
+		PB2 = 0;
+		_PWM_I2C_Delay( halfBit );
+		PB2 = 0x04;
+		_PWM_I2C_Delay( halfBit );
+	}
 
-	// TODO Check, handle errors
+	// STOP: SDA rises while SCL is high
+	PB2 = 0;
+	PB3 = 0;
+	_PWM_I2C_Delay( halfBit );
+	PB2 = 0x04;
+	_PWM_I2C_Delay( halfBit );
+	PB3 = 0x08;
+	_PWM_I2C_Delay( halfBit );
+
+	GPIO_PORTB_AFSEL_R |= 0x0C;
+	GPIO_PORTB_DIR_R &= ~0x0C;
+	GPIO_PORTB_ODR_R &= ~0x04;
+	I2C0_MCR_R = 0x0010;
+
+	pwmI2CRecoveries++;
 }
 
 /*
- * Grabs the next command in the queue, performs it
+ * Moves the transaction on the bus along a byte
  */
-void PWM_I2C_Timer2A_Handler() {
-	// Acknowledge the interrupt
-		TIMER2_ICR_R = TIMER_ICR_TATOCINT;
+void _PWM_I2C_Step( uint32_t status ) {
+	progress++;
+
+	// The STOP after an error is out
+	if ( PWM_I2C_STATE_STOPPING == currentState ) {
+		_PWM_I2C_Finish( stoppingStatus );
+		return;
+	}
 
-	// No commands? Just return
-	if ( 0 == commandCount ) {
+	if ( status & I2C_MCS_ERROR ) {
+		// Arbitration lost means someone else has the bus, otherwise
+		// end our claim on it - the STOP interrupts when it's done
+		if ( status & I2C_MCS_ARBLST ) {
+			_PWM_I2C_Finish( PWM_I2C_ARBITRATION_LOST );
+		} else {
+			stoppingStatus = PWM_I2C_NACK;
+			currentState = PWM_I2C_STATE_STOPPING;
+			I2C0_MCS_R = I2C_MCS_STOP;
+		}
 		return;
 	}
 
-	// Grab the next command in the queue
-	// If no more commands, reset the queue and call the callback
-	if ( currentCommandIndex >= commandCount ) {
-		commandCount = 0;
-		currentCommandIndex = 0;
-		if ( pwm_i2c_callback ) {
-			pwm_i2c_callback();
+	pwmI2CBytes++;
+
+	if ( PWM_I2C_STATE_WRITE == currentState ) {
+		if ( phaseBytes < phaseWrite ) {
+			I2C0_MDR_R = phaseData[phaseBytes++];
+			I2C0_MCS_R = I2C_MCS_RUN | ( ( phaseBytes == phaseWrite ) && ! phaseRead ? I2C_MCS_STOP : 0 );
+			return;
+		}
+		if ( phaseRead ) {
+			_PWM_I2C_Begin_Read();
+			return;
+		}
+	} else {
+		phaseData[phaseBytes++] = I2C0_MDR_R & 0xFF;
+		if ( phaseBytes < phaseRead ) {
+			I2C0_MCS_R = I2C_MCS_RUN | ( ( phaseBytes + 1 == phaseRead ) ? I2C_MCS_STOP : I2C_MCS_ACK );
 			return;
 		}
 	}
 
-	PWM_I2C_Command currentCommand = commands[ currentCommandIndex ];
+	// A masked write has its current value - on to the write
+	if ( updatePending ) {
+		_PWM_I2C_Apply_Mask();
+		_PWM_I2C_Begin( current.writeLength, 0, current.writeData );
+		return;
+	}
+
+	_PWM_I2C_Finish( PWM_I2C_OK );
+}
+
+/*
+ * Runs the bus a byte at a time, and starts the next transaction
+ * when one finishes (or when kicked by a new one being queued)
+ */
+void PWM_I2C_I2C0_Handler() {
+	PROFILE_ENTER( PROFILE_I2C );
+
+	// The seconds tick found the transaction stuck
+	if ( timeoutPending ) {
+		timeoutPending = 0;
+		if ( PWM_I2C_STATE_IDLE != currentState ) {
+			_PWM_I2C_Recover_Bus();
+			I2C0_MICR_R = I2C_MICR_IC;
+			_PWM_I2C_Finish( PWM_I2C_TIMEOUT );
+		}
+	}
+
+	if ( I2C0_MMIS_R & I2C_MMIS_MIS ) {
+		I2C0_MICR_R = I2C_MICR_IC;
+		if ( PWM_I2C_STATE_IDLE != currentState ) {
+			_PWM_I2C_Step( I2C0_MCS_R );
+		}
+	}
+
+	_PWM_I2C_Next();
+
+	PROFILE_EXIT( PROFILE_I2C );
+}
+
+/*
+ * A radio transaction's wait is over
+ */
+void PWM_I2C_Timer2A_Handler() {
+	PROFILE_ENTER( PROFILE_I2C );
+
+	// Acknowledge the interrupt, and gate Timer2 until the next wait
+	TIMER2_ICR_R = TIMER_ICR_TATOCINT;
+	SYSCTL_RCGCTIMER_R &= ~0x04;
+	radioHeld = 0;
+
+	// If no more radio transactions, call the callback
+	if ( ( queues[PWM_I2C_PRIORITY_RADIO].head == queues[PWM_I2C_PRIORITY_RADIO].tail ) && pwm_i2c_callback ) {
+		pwm_i2c_callback();
+	}
+
+	_PWM_I2C_Next();
 
-	// Otherwise, do the command
-	_PWM_I2C_Write( currentCommand.address, currentCommand.data, currentCommand.mask );
+	PROFILE_EXIT( PROFILE_I2C );
+}
 
-	// Increment the command index
-	currentCommandIndex++;
+/*
+ * Call once a second - ends a transaction that has gone
+ * PWM_I2C_TIMEOUT_SECONDS without a byte moving
+ */
+void PWM_I2C_Tick_Second() {
+	uint8_t seen = progress;
 
-	// Arm the one-shot
-	_PWM_I2C_Sleep( currentCommand.waitMS );
+	if ( ( PWM_I2C_STATE_IDLE == currentState ) || ( seen != lastProgress ) ) {
+		lastProgress = seen;
+		stalledSeconds = 0;
+		return;
+	}
+
+	if ( ++stalledSeconds >= PWM_I2C_TIMEOUT_SECONDS ) {
+		stalledSeconds = 0;
+		timeoutPending = 1;
+		_PWM_I2C_Kick();
+	}
 }
 
 /*
- * Adds a command to the queue
- * If this is the first command added, also kicks off queue processing
+ * Appends a transaction to its device's ring, and gets the bus
+ * going if it's idle
+ * Returns 0 if the ring is full
+ */
+uint8_t _PWM_I2C_Add_Transaction( const PWM_I2C_Transaction *transaction ) {
+	PWM_I2C_Queue *queue = &queues[transaction->device->priority];
+
+	__istate_t state = __get_interrupt_state();
+	__disable_interrupt();
+
+	uint16_t nextTail = ( queue->tail + 1 ) % queue->size;
+	if ( nextTail == queue->head ) {
+		__set_interrupt_state( state );
+		return 0;
+	}
+
+	queue->transactions[queue->tail] = *transaction;
+	queue->tail = nextTail;
+	TRACE( TRACE_I2C_QUEUE, transaction->reg, ( queue->tail + queue->size - queue->head ) % queue->size );
+
+	__set_interrupt_state( state );
+
+	// Don't cut short a radio wait already in progress - the
+	// handler knows what's ready to go
+	if ( PWM_I2C_STATE_IDLE == currentState ) {
+		_PWM_I2C_Kick();
+	}
+	return 1;
+}
+
+/*
+ * Adds a write of the PWM device's 16-bit register to the queue,
+ * keeping the bits set in mask from its current value (0xFFFF
+ * for a plain write)
  */
 void PWM_I2C_Queue_Command( uint8_t address, uint16_t data, uint16_t mask, uint16_t waitMS ) {
-	if ( commandCount >= PWM_I2C_MAX_COMMANDS ) {
+	PWM_I2C_Transaction transaction = { &radioDevice, address, 2, 0, { data >> 8, data & 0xFF }, mask, waitMS, 0, 0, 0 };
+
+	_PWM_I2C_Add_Transaction( &transaction );
+}
+
+/*
+ * Adds a read of the PWM device's 16-bit register to the queue -
+ * callback gets the value read, from the I2C0 interrupt
+ */
+void PWM_I2C_Queue_Read( uint8_t address, void (*callback)(uint16_t data), uint16_t waitMS ) {
+	if ( ! callback ) {
 		return;
 	}
 
-	commands[commandCount].address = address;
-	commands[commandCount].data = data;
-	commands[commandCount].mask = mask;
-	commands[commandCount].waitMS = waitMS;
-	commandCount++;
+	PWM_I2C_Transaction transaction = { &radioDevice, address, 0, 2, { 0 }, 0xFFFF, waitMS, 0, 0, callback };
+
+	_PWM_I2C_Add_Transaction( &transaction );
+}
+
+/*
+ * Queues a write of up to PWM_I2C_MAX_WRITE bytes to a device,
+ * starting at register reg - callback (optional) gets the result,
+ * from the I2C0 interrupt
+ * Returns 0 if the write is too long or the device's queue is full
+ */
+uint8_t PWM_I2C_Queue_Write( const PWM_I2C_Device *device, uint8_t reg, const uint8_t *data, uint8_t length,
+	void (*callback)( uint8_t status, uint8_t *data, uint8_t length ) ) {
+	if ( ! device || ( device->priority >= PWM_I2C_PRIORITIES ) || ( length > PWM_I2C_MAX_WRITE ) ) {
+		return 0;
+	}
+
+	PWM_I2C_Transaction transaction = { device, reg, length, 0, { 0 }, 0xFFFF, 0, 0, callback, 0 };
+	for ( uint8_t i=0; i < length; i++ ) {
+		transaction.writeData[i] = data[i];
+	}
+
+	return _PWM_I2C_Add_Transaction( &transaction );
+}
+
+/*
+ * Queues a read of length bytes from a device, starting at
+ * register reg, into data - which must stay put until callback
+ * gets it back, from the I2C0 interrupt
+ * Returns 0 if the device's queue is full
+ */
+uint8_t PWM_I2C_Queue_Burst_Read( const PWM_I2C_Device *device, uint8_t reg, uint8_t *data, uint8_t length,
+	void (*callback)( uint8_t status, uint8_t *data, uint8_t length ) ) {
+	if ( ! device || ( device->priority >= PWM_I2C_PRIORITIES ) || ! data || ! length || ! callback ) {
+		return 0;
+	}
+
+	PWM_I2C_Transaction transaction = { device, reg, 0, length, { 0 }, 0xFFFF, 0, data, callback, 0 };
+
+	return _PWM_I2C_Add_Transaction( &transaction );
+}
+
+/*
+ * PWM period in system clocks for the sample rate, to the nearest
+ */
+void _PWM_I2C_Set_PWM_Load( uint32_t hz ) {
+	if ( ! pwmSampleRate ) {
+		return;
+	}
+	pwmLoad = ( hz + pwmSampleRate / 2 ) / pwmSampleRate - 1;
+	PWM0_0_LOAD_R = pwmLoad;
+}
 
-	_PWM_I2C_Sleep( 1 );
+/*
+ * SCL period is 2 * ( 1 + TPR ) * 10 system clocks
+ * e.g. TPR = 7 for 100 kHz at 16 MHz
+ */
+void _PWM_I2C_Clock_Changed( uint32_t hz ) {
+	I2C0_MTPR_R = ( hz + ( 20 * PWM_I2C_BIT_RATE ) - 1 ) / ( 20 * PWM_I2C_BIT_RATE ) - 1;
+	_PWM_I2C_Set_PWM_Load( hz );
 }
 
 /*
- * Initialize the I2C interface
+ * Sets up PWM0 generator 0 on PB6, idle until started
+ */
+void _PWM_I2C_PWM_Init() {
+	volatile unsigned long delay;
+
+	SYSCTL_RCGCPWM_R |= 0x01;			// Activate PWM0
+	delay = SYSCTL_RCGCPWM_R;
+	SYSCTL_RCC_R &= ~SYSCTL_RCC_USEPWMDIV;	// PWM clock is the system clock
+
+	GPIO_PORTB_AFSEL_R |= 0x40;			// Alternate function on PB6
+	GPIO_PORTB_PCTL_R = (GPIO_PORTB_PCTL_R & 0xF0FFFFFF) | 0x04000000;	// M0PWM0
+	GPIO_PORTB_AMSEL_R &= ~0x40;
+	GPIO_PORTB_DEN_R |= 0x40;
+
+	// Count down: high from reload until the count reaches CMPA
+	PWM0_0_CTL_R = 0;
+	PWM0_0_GENA_R = PWM_0_GENA_ACTLOAD_ONE | PWM_0_GENA_ACTCMPAD_ZERO;
+	PWM0_ENABLE_R &= ~PWM_ENABLE_PWM0EN;
+
+	// PWM0 generator 0 / IRQ10 / NVIC_PRI2_R / b23-21 / Priority 1
+	NVIC_PRI2_R = (NVIC_PRI2_R & 0xFF1FFFFF) | 0x00200000;
+	NVIC_EN0_R = 1 << 10;
+}
+
+/*
+ * Initialize the I2C interface, with the PWM device (the one
+ * the nCS line selects) at address
  * Based on Valvano p 374
  *
  */
-void PWM_I2C_Init() {
-	commandCount = 0;
-	currentCommandIndex = 0;
+void PWM_I2C_Init( uint8_t address ) {
+	for ( uint8_t priority=0; priority < PWM_I2C_PRIORITIES; priority++ ) {
+		queues[priority].head = 0;
+		queues[priority].tail = 0;
+	}
+	currentState = PWM_I2C_STATE_IDLE;
+	radioHeld = 0;
+	radioRun = 0;
+	radioDevice.address = address;
 	pwm_i2c_callback = 0;
 
 	// Set up I2C
@@ -227,20 +686,121 @@ void PWM_I2C_Init() {
 	GPIO_PORTB_DEN_R |= 0x0C;			// Enable digital I/O on PB2, PB3
 
 	I2C0_MCR_R = 0x0010;				// TM4C123 is I2C master
-	I2C0_MTPR_R = 0x8;					// 100 kHz clock (10000ns / ( 62.5ns - 1 ) )
+	_PWM_I2C_Clock_Changed( Clock_Get_Hz() );	// 100 kHz clock
+	Clock_Register_Change_Callback( _PWM_I2C_Clock_Changed );
+
+	// Interrupt as each byte is done
+	I2C0_MICR_R = I2C_MICR_IC;
+	I2C0_MIMR_R = I2C_MIMR_IM;
+
+	// I2C0 / IRQ8 / NVIC_PRI2_R / b7-5 / Priority 2, the same
+	// as Timer2A so the two never preempt each other
+	NVIC_PRI2_R = (NVIC_PRI2_R & 0xFFFFFF1F) | 0x00000040;
+	NVIC_EN0_R = 1 << 8;
 
 	// Setup nCS on PB4
 	GPIO_PORTB_DIR_R |= 0x10;			// Set PB4 for out
 	GPIO_PORTB_DEN_R |= 0x10;			// Enable digital I/O on PB4
 	PB4 = 0x0;							// Take PB4 low
+
+	_PWM_I2C_PWM_Init();
+}
+
+/*
+ * Plays levels (0-255, 128 the midpoint) from source on PB6, one
+ * each PWM period at sampleRate, until source returns 0
+ */
+void PWM_I2C_Start_PWM( uint32_t sampleRate, uint8_t (*source)( uint8_t *level ) ) {
+	uint8_t level;
+
+	PWM_I2C_Stop_PWM();
+	if ( ! source( &level ) ) {
+		return;
+	}
+
+	pwmSampleRate = sampleRate;
+	_PWM_I2C_Set_PWM_Load( Clock_Get_Hz() );
+	PWM0_0_CMPA_R = ( (uint32_t) level * pwmLoad ) >> 8;
+	pwmSource = source;
+
+	PWM0_0_ISC_R = PWM_0_ISC_INTCNTLOAD;
+	PWM0_0_INTEN_R = PWM_0_INTEN_INTCNTLOAD;
+	PWM0_INTEN_R |= PWM_INTEN_INTPWM0;
+	PWM0_0_CTL_R = PWM_0_CTL_ENABLE;
+	PWM0_ENABLE_R |= PWM_ENABLE_PWM0EN;
+}
+
+void PWM_I2C_Stop_PWM() {
+	PWM0_ENABLE_R &= ~PWM_ENABLE_PWM0EN;
+	PWM0_0_CTL_R = 0;
+	PWM0_0_INTEN_R = 0;
+	PWM0_0_ISC_R = PWM_0_ISC_INTCNTLOAD;
+	pwmSource = 0;
+}
+
+uint8_t PWM_I2C_PWM_Running() {
+	return 0 != pwmSource;
+}
+
+/*
+ * The generator reloaded - the next period gets the next level
+ */
+void PWM_I2C_PWM0Gen0_Handler() {
+	uint8_t level;
+
+	PROFILE_ENTER( PROFILE_PWM );
+
+	PWM0_0_ISC_R = PWM_0_ISC_INTCNTLOAD;
+	if ( pwmSource && pwmSource( &level ) ) {
+		PWM0_0_CMPA_R = ( (uint32_t) level * pwmLoad ) >> 8;
+	} else {
+		PWM_I2C_Stop_PWM();
+	}
+
+	PROFILE_EXIT( PROFILE_PWM );
 }
 
 /*
  * Accepts a callback that is called after
- * the transmit queue is empty (i.e. after all
- *waits are satisfied)
+ * the radio's queue is empty (i.e. after all
+ * its waits are satisfied)
  */
 void PWM_I2C_Set_Callback( void (*callback)() ) {
 	pwm_i2c_callback = callback;
 }
 
+void PWM_I2C_Get_Stats( uint32_t *transactions, uint32_t *errors, uint32_t *bytes, uint32_t *recoveries ) {
+	if ( transactions ) {
+		*transactions = pwmI2CTransactions;
+	}
+	if ( errors ) {
+		*errors = pwmI2CErrors;
+	}
+	if ( bytes ) {
+		*bytes = pwmI2CBytes;
+	}
+	if ( recoveries ) {
+		*recoveries = pwmI2CRecoveries;
+	}
+}
+
+
+#ifdef BENCH_ENABLED
+/*
+ * Throws away queued transactions before the handler has started
+ * any of them and stops Timer2 - for bench.c, between timing runs
+ */
+void PWM_I2C_Bench_Reset() {
+	TIMER2_CTL_R &= ~TIMER_CTL_TAEN;
+	TIMER2_ICR_R = TIMER_ICR_TATOCINT;
+	NVIC_UNPEND0_R = ( 1 << 23 ) | ( 1 << 8 );
+	SYSCTL_RCGCTIMER_R &= ~0x04;
+
+	for ( uint8_t priority=0; priority < PWM_I2C_PRIORITIES; priority++ ) {
+		queues[priority].head = 0;
+		queues[priority].tail = 0;
+	}
+	radioHeld = 0;
+	radioRun = 0;
+}
+#endif
@@ -2,12 +2,13 @@
 // Based on work by Jonathan Valvano
 //
 // Useful for I2C devices that can also accept
-// PWM inputs, like radios or other audio devices
+// PWM inputs, like radios or other audio devices,
+// sharing the bus with other I2C devices
 //
 // Uses Timer2A for one-shots
 // Uses I2C0: PB2 (SCL), PB3 (SDA)
 // Uses PB4 as nCS
-// Uses PB6 as PWM
+// Uses PWM0 generator 0: PB6 (M0PWM0)
 //
 // Allen Snook
 // 2 March 2020
@@ -17,9 +18,50 @@
 
 #include "stdint.h"
 
-void PWM_I2C_Init();
+// Device priorities - radio transactions go first, sensors get
+// the bus between them
+#define PWM_I2C_PRIORITY_RADIO 0
+#define PWM_I2C_PRIORITY_SENSOR 1
+#define PWM_I2C_PRIORITIES 2
+
+// Longest write after the register address
+#define PWM_I2C_MAX_WRITE 4
+
+// Transaction results handed to callbacks
+#define PWM_I2C_OK 0
+#define PWM_I2C_NACK 1
+#define PWM_I2C_ARBITRATION_LOST 2
+#define PWM_I2C_TIMEOUT 3
+
+typedef struct PWM_I2C_Devices {
+	uint8_t address;			// 7-bit bus address
+	uint8_t priority;			// PWM_I2C_PRIORITY_*
+} PWM_I2C_Device;
+
+void PWM_I2C_Init( uint8_t address );
 void PWM_I2C_Set_Callback( void (*callback)() );
+
+// The PWM device's 16-bit registers, at radio priority
 void PWM_I2C_Queue_Command( uint8_t address, uint16_t data, uint16_t mask, uint16_t waitMS );
-uint16_t PWM_I2C_Read( uint8_t address );
+void PWM_I2C_Queue_Read( uint8_t address, void (*callback)(uint16_t data), uint16_t waitMS );
+
+// Any device's 8-bit registers
+uint8_t PWM_I2C_Queue_Write( const PWM_I2C_Device *device, uint8_t reg, const uint8_t *data, uint8_t length,
+	void (*callback)( uint8_t status, uint8_t *data, uint8_t length ) );
+uint8_t PWM_I2C_Queue_Burst_Read( const PWM_I2C_Device *device, uint8_t reg, uint8_t *data, uint8_t length,
+	void (*callback)( uint8_t status, uint8_t *data, uint8_t length ) );
+
+void PWM_I2C_Tick_Second();
+void PWM_I2C_Get_Stats( uint32_t *transactions, uint32_t *errors, uint32_t *bytes, uint32_t *recoveries );
+
+// Audio into the PWM device
+void PWM_I2C_Start_PWM( uint32_t sampleRate, uint8_t (*source)( uint8_t *level ) );
+void PWM_I2C_Stop_PWM();
+uint8_t PWM_I2C_PWM_Running();
+void PWM_I2C_PWM0Gen0_Handler();
+
+#ifdef BENCH_ENABLED
+void PWM_I2C_Bench_Reset();
+#endif
 
-#endif // __PWM_I2C_H
\ No newline at end of file
+#endif // __PWM_I2C_H
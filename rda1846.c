@@ -8,6 +8,13 @@
 
 #include "rda1846.h"
 #include "pwm-i2c.h"
+#include "ax25.h"
+#include "fx25.h"
+#include "csma.h"
+#include "afsk.h"
+
+// With SEN (PWM_I2C's nCS) held low
+#define RDA1846_I2C_ADDRESS 0x71
 
 #define RDA1846_CLK_MODE_R 0x04
 #define RDA1846_GPIO_MODE_R 0x1F
@@ -17,6 +24,63 @@
 #define RDA1846_TX_VOICE_R 0x3A
 #define RDA1846_RX_VOLUME_R 0x44
 #define RDA1846_SQ_THRESH_R 0x49
+#define RDA1846_RSSI_R 0x1B
+#define RDA1846_FLAG_R 0x1C
+
+#define RDA1846_FLAG_SQUELCH_OPEN 0x0002
+
+#define RDA1846_BAUD 1200
+
+// Default TX delay: about 160 ms of flags ahead of each frame
+#define RDA1846_DEFAULT_TX_DELAY_MS 160
+#define RDA1846_DEFAULT_RSSI_POLL_MS 10
+// Poll rate while nothing is waiting on the channel state
+#define RDA1846_IDLE_RSSI_POLL_MS 100
+#define RDA1846_DEFAULT_BUSY_DBM -100
+
+// Time for the synthesizer to settle after a fast retune
+#define RDA1846_RETUNE_SETTLE_MS 2
+#define RDA1846_DEFAULT_SCAN_DBM -110
+
+#define RDA1846_MODE_OFF 0
+#define RDA1846_MODE_RX 1
+#define RDA1846_MODE_TX 2
+
+static uint8_t txLine[AX25_MAX_LINE_LENGTH];
+static uint16_t txLineBits = 0;
+static uint8_t txPreambleFlags = ( RDA1846_DEFAULT_TX_DELAY_MS * RDA1846_BAUD ) / 8000;
+static void (*txCompleteCallback)();
+
+static uint16_t rssiPollMS = RDA1846_DEFAULT_RSSI_POLL_MS;
+static uint8_t rssiPolling = 0;
+static uint8_t channelWatched = 0;
+static int16_t busyThresholdDBm = RDA1846_DEFAULT_BUSY_DBM;
+static volatile int16_t rssiDBm = -135;
+static volatile uint8_t squelchOpen = 0;
+static void (*channelClearCallback)();
+
+// FX.25 check bytes per codeblock, 0 sends plain AX.25
+static uint8_t txFX25CheckBytes = FX25_CHECK_BYTES_NONE;
+
+// Mode and frequency as of the last queued commands, so retunes
+// only write the registers that actually change
+static uint8_t radioMode = RDA1846_MODE_OFF;
+static uint32_t tunedFreqRaw = 0;
+static uint32_t homeFreqKHz = 0;
+static uint8_t transmitting = 0;
+
+static uint32_t scanFreqKHz[RDA1846_SCAN_MAX_CHANNELS];
+static uint16_t scanDwellMS[RDA1846_SCAN_MAX_CHANNELS];
+static uint8_t scanChannels = 0;
+static uint8_t scanChannel = 0;
+static uint16_t scanElapsedMS = 0;
+static uint8_t scanning = 0;
+static int16_t scanThresholdDBm = RDA1846_DEFAULT_SCAN_DBM;
+static void (*scanStopCallback)( uint8_t channel );
+
+static uint32_t scanRetunes = 0;
+static uint32_t scanWritesSkipped = 0;
+static uint32_t scanListCycles = 0;
 
 // Private methods
 
@@ -75,6 +139,7 @@ void _RDA1846_Set_Clock_Mode( uint8_t mode ) {
 
 void RDA1846_Set_TX() {
 	// TODO: Add 70cm support
+	radioMode = RDA1846_MODE_TX;
 
 	// Disable RX (Clear b:5)
 	PWM_I2C_Queue_Command( RDA1846_CTL_R, 0, 0xFFDF, 0 );
@@ -90,6 +155,8 @@ void RDA1846_Set_TX() {
 }
 
 void RDA1846_Set_RX() {
+	radioMode = RDA1846_MODE_RX;
+
 	// Disable TX (Clear b:6)
 	PWM_I2C_Queue_Command( RDA1846_CTL_R, 0, 0xFFBF, 0 );
 
@@ -129,28 +196,286 @@ void _RDA1846_Set_Squelch_Threshholds( int16_t openThreshhold, int16_t shutThres
 	PWM_I2C_Queue_Command( RDA1846_SQ_THRESH_R, threshhold, 0xFFFF, 0 );
 }
 
+/*
+ * Queues the writes to move the synthesizer to freqKHZ
+ * In RX with the band already set up, only the frequency words
+ * that changed are written - usually just the low one - and the
+ * RX path is left running instead of being cycled off and on.
+ */
+void _RDA1846_Tune( uint32_t freqKHZ ) {
+	uint32_t freqRaw = freqKHZ << 4;
+
+	if ( ( 0 == tunedFreqRaw ) || ( RDA1846_MODE_RX != radioMode ) ) {
+		// Turn off RX and TX
+		PWM_I2C_Queue_Command( RDA1846_CTL_R, 0, 0xFF9F, 0 );
+		radioMode = RDA1846_MODE_OFF;
+
+		PWM_I2C_Queue_Command( 0x05, 0x8763, 0xFFFF, 0 );
+
+		// Send top half to high register, bottom half to low
+		PWM_I2C_Queue_Command( RDA1846_FREQ_HI_R, ( 0x3FFF & (freqRaw >> 16 ) ), 0xFFFF, 0 );
+		PWM_I2C_Queue_Command( RDA1846_FREQ_LO_R, ( freqRaw & 0xFFFF ), 0xFFFF, 0 );
+		tunedFreqRaw = freqRaw;
+
+		RDA1846_Set_RX();
+		return;
+	}
+
+	if ( freqRaw == tunedFreqRaw ) {
+		scanWritesSkipped += 2;
+		return;
+	}
+
+	if ( ( freqRaw >> 16 ) != ( tunedFreqRaw >> 16 ) ) {
+		PWM_I2C_Queue_Command( RDA1846_FREQ_HI_R, ( 0x3FFF & (freqRaw >> 16 ) ), 0xFFFF, 0 );
+	} else {
+		scanWritesSkipped++;
+	}
+	PWM_I2C_Queue_Command( RDA1846_FREQ_LO_R, ( freqRaw & 0xFFFF ), 0xFFFF, RDA1846_RETUNE_SETTLE_MS );
+	tunedFreqRaw = freqRaw;
+}
+
+/*
+ * Called with each RSSI / squelch poll while scanning
+ * Holds on a channel with activity, otherwise moves on once
+ * the channel's dwell time is up
+ */
+void _RDA1846_Scan_Poll() {
+	if ( ! scanning || transmitting ) {
+		return;
+	}
+
+	if ( squelchOpen || ( rssiDBm > scanThresholdDBm ) ) {
+		scanning = 0;
+		if ( scanStopCallback ) {
+			scanStopCallback( scanChannel );
+		}
+		return;
+	}
+
+	scanElapsedMS += rssiPollMS;
+	if ( scanElapsedMS < scanDwellMS[scanChannel] ) {
+		return;
+	}
+
+	scanElapsedMS = 0;
+	scanChannel++;
+	if ( scanChannel >= scanChannels ) {
+		scanChannel = 0;
+		scanListCycles++;
+	}
+
+	scanRetunes++;
+	_RDA1846_Tune( scanFreqKHz[scanChannel] );
+}
+
+void _RDA1846_Get_RSSI();
+
+void _RDA1846_RSSI_Callback( uint16_t data ) {
+	// rssi_db<9:0> in 1/8 dB steps above -135 dBm
+	rssiDBm = ( ( data & 0x03FF ) >> 3 ) - 135;
+}
+
+void _RDA1846_Flag_Callback( uint16_t data ) {
+	squelchOpen = ( data & RDA1846_FLAG_SQUELCH_OPEN ) ? 1 : 0;
+
+	// Any retune is queued ahead of the next poll
+	_RDA1846_Scan_Poll();
+
+	if ( channelClearCallback && ! RDA1846_Channel_Busy() ) {
+		void (*callback)() = channelClearCallback;
+		channelClearCallback = 0;
+		callback();
+	}
+
+	// Keep polling at the configured rate
+	if ( rssiPollMS ) {
+		_RDA1846_Get_RSSI();
+	} else {
+		rssiPolling = 0;
+	}
+}
+
+/*
+ * Polls at the configured rate only while something is waiting
+ * on the channel state, so the I2C timer can sleep in between
+ */
+uint16_t _RDA1846_Poll_Interval() {
+	if ( channelWatched || scanning || channelClearCallback || ( rssiPollMS > RDA1846_IDLE_RSSI_POLL_MS ) ) {
+		return rssiPollMS;
+	}
+	return RDA1846_IDLE_RSSI_POLL_MS;
+}
+
+/*
+ * Queues reads of the RSSI and squelch flag registers
+ * The flag read waits out the poll interval before the next poll
+ */
 void _RDA1846_Get_RSSI() {
-	// TODO
+	rssiPolling = 1;
+	PWM_I2C_Queue_Read( RDA1846_RSSI_R, _RDA1846_RSSI_Callback, 0 );
+	PWM_I2C_Queue_Read( RDA1846_FLAG_R, _RDA1846_Flag_Callback, _RDA1846_Poll_Interval() );
+}
+
+/*
+ * TX is up - play the line into the mic input while the queue
+ * waits out its airtime
+ */
+void _RDA1846_TX_Keyed_Callback( uint16_t data ) {
+	AFSK_Start_Modulator( txLine, txLineBits );
+	PWM_I2C_Start_PWM( AFSK_TX_SAMPLE_RATE, AFSK_Modulate );
+}
+
+void _RDA1846_TX_Complete_Callback( uint16_t data ) {
+	// Ends on its own with the line, unless the clock moved on us
+	PWM_I2C_Stop_PWM();
+
+	transmitting = 0;
+	if ( scanning ) {
+		_RDA1846_Tune( scanFreqKHz[scanChannel] );
+	}
+
+	if ( txCompleteCallback ) {
+		void (*callback)() = txCompleteCallback;
+		txCompleteCallback = 0;
+		callback();
+	}
 }
 
 // Public methods
 
-void RDA1846_Wait_For_Channel( /* callback */ ) {
+/*
+ * Channel is busy if the squelch is open or the signal
+ * strength is above the busy threshold
+ */
+uint8_t RDA1846_Channel_Busy() {
+	return squelchOpen || ( rssiDBm > busyThresholdDBm );
+}
+
+int16_t RDA1846_Get_RSSI() {
+	return rssiDBm;
+}
+
+/*
+ * Calls back (from the I2C interrupt) at the first poll that
+ * finds the channel clear
+ */
+void RDA1846_Wait_For_Channel( void (*callback)() ) {
+	channelClearCallback = callback;
 }
 
+/*
+ * on: something (the CSMA scheduler) needs a fresh channel state,
+ * poll at the full rate. Takes effect after the current poll.
+ */
+void RDA1846_Watch_Channel( uint8_t on ) {
+	channelWatched = on;
+}
+
+/*
+ * milliseconds: time between RSSI / squelch polls while the channel
+ * is watched, 0 stops polling
+ */
+void RDA1846_Set_RSSI_Poll_Rate( uint16_t milliseconds ) {
+	rssiPollMS = milliseconds;
+	if ( rssiPollMS && ! rssiPolling ) {
+		_RDA1846_Get_RSSI();
+	}
+}
+
+void RDA1846_Set_Busy_Threshold( int16_t dBm ) {
+	busyThresholdDBm = dBm;
+}
+
+/*
+ * Time spent sending flags after keying up, before the frame
+ */
+void RDA1846_Set_TX_Delay( uint16_t milliseconds ) {
+	uint32_t flags = ( (uint32_t) milliseconds * RDA1846_BAUD ) / 8000;
+	if ( flags > AX25_MAX_PREAMBLE_FLAGS ) {
+		flags = AX25_MAX_PREAMBLE_FLAGS;
+	}
+	txPreambleFlags = flags;
+}
+
+/*
+ * Sets the home channel, used for transmitting and whenever
+ * the radio isn't scanning
+ */
 void RDA1846_Set_Frequency_KHz( uint32_t freqKHZ ) {
-	uint32_t freqRaw = freqKHZ << 4;
+	homeFreqKHz = freqKHZ;
+	_RDA1846_Tune( freqKHZ );
+}
+
+/*
+ * freqKHz, dwellMS: up to RDA1846_SCAN_MAX_CHANNELS channels and
+ * the time to listen on each (rounded up to the RSSI poll rate)
+ */
+void RDA1846_Set_Scan_List( const uint32_t *freqKHz, const uint16_t *dwellMS, uint8_t count ) {
+	if ( count > RDA1846_SCAN_MAX_CHANNELS ) {
+		count = RDA1846_SCAN_MAX_CHANNELS;
+	}
+
+	scanning = 0;
+	for ( uint8_t i=0; i < count; i++ ) {
+		scanFreqKHz[i] = freqKHz[i];
+		scanDwellMS[i] = dwellMS[i];
+	}
+	scanChannels = count;
+	scanChannel = 0;
+}
 
-	// Turn off RX and TX
-	PWM_I2C_Queue_Command( RDA1846_CTL_R, 0, 0xFF9F, 0 );
+/*
+ * Scanning stops on a channel when the squelch opens or the RSSI
+ * is above dBm
+ */
+void RDA1846_Set_Scan_Threshold( int16_t dBm ) {
+	scanThresholdDBm = dBm;
+}
 
-	PWM_I2C_Queue_Command( 0x05, 0x8763, 0xFFFF, 0 );
+/*
+ * Starts (or resumes after a stop) cycling through the scan list
+ * Calls back (from the I2C interrupt) with the channel index
+ * when activity stops the scan
+ */
+void RDA1846_Start_Scan( void (*callback)( uint8_t channel ) ) {
+	if ( 0 == scanChannels ) {
+		return;
+	}
 
-	// Send top half to high register, bottom half to low
-	PWM_I2C_Queue_Command( RDA1846_FREQ_HI_R, ( 0x3FFF & (freqRaw >> 16 ) ), 0xFFFF, 0 );
-	PWM_I2C_Queue_Command( RDA1846_FREQ_LO_R, ( freqRaw & 0xFFFF ), 0xFFFF, 0 );
+	scanStopCallback = callback;
+	scanElapsedMS = 0;
+	scanning = 1;
+	_RDA1846_Tune( scanFreqKHz[scanChannel] );
 
-	RDA1846_Set_RX();
+	// Scanning is paced by the channel polls
+	if ( 0 == rssiPollMS ) {
+		RDA1846_Set_RSSI_Poll_Rate( RDA1846_DEFAULT_RSSI_POLL_MS );
+	}
+}
+
+/*
+ * Stops scanning and returns to the home channel
+ */
+void RDA1846_Stop_Scan() {
+	scanning = 0;
+	_RDA1846_Tune( homeFreqKHz );
+}
+
+uint8_t RDA1846_Scanning() {
+	return scanning;
+}
+
+void RDA1846_Get_Scan_Stats( uint32_t *retunes, uint32_t *writesSkipped, uint32_t *listCycles ) {
+	if ( retunes ) {
+		*retunes = scanRetunes;
+	}
+	if ( writesSkipped ) {
+		*writesSkipped = scanWritesSkipped;
+	}
+	if ( listCycles ) {
+		*listCycles = scanListCycles;
+	}
 }
 
 /*
@@ -163,6 +488,18 @@ void RDA1846_Set_Volume( uint16_t volume1, uint16_t volume2 ) {
 	PWM_I2C_Queue_Command( RDA1846_RX_VOLUME_R, rawVolume, 0xFFFF, 0);
 }
 
+/*
+ * checkBytes: 0 (plain AX.25), 16, 32 or 64 FX.25 check bytes
+ */
+void RDA1846_Set_FX25( uint8_t checkBytes ) {
+	if ( ( FX25_CHECK_BYTES_16 == checkBytes ) || ( FX25_CHECK_BYTES_32 == checkBytes ) ||
+		( FX25_CHECK_BYTES_64 == checkBytes ) ) {
+		txFX25CheckBytes = checkBytes;
+	} else {
+		txFX25CheckBytes = FX25_CHECK_BYTES_NONE;
+	}
+}
+
 void RDA1846_Set_Power( uint8_t power ) {
 }
 
@@ -170,7 +507,69 @@ void RDA1846_Set_Power( uint8_t power ) {
 void RDA1846_Test_Connection( /* callback */ ) {
 }
 
-void RDA1846_Send_Packet( char *data ) {
+/*
+ * Bits a frame (without FCS) will take on air with the current
+ * TX delay and FX.25 setting
+ */
+uint16_t RDA1846_Get_Airtime_Bits( uint8_t *frame, uint16_t length ) {
+	uint16_t bits = AX25_Count_Stuffed_Bits( frame, length ) + 16;
+
+	if ( FX25_CHECK_BYTES_NONE != txFX25CheckBytes ) {
+		uint16_t blockLength = FX25_Get_Block_Length( txFX25CheckBytes, bits );
+		if ( blockLength ) {
+			return ( txPreambleFlags + blockLength ) * 8;
+		}
+	}
+
+	return txPreambleFlags * 8 + bits;
+}
+
+/*
+ * Accepts an AX.25 frame (without FCS) for transmission when
+ * the channel access scheduler finds the channel clear, using the
+ * channel access parameters of source (CSMA_SOURCE_...)
+ * Returns 0 if the transmit queue is full
+ */
+uint8_t RDA1846_Send_Packet( uint8_t source, uint8_t *frame, uint16_t length ) {
+	return CSMA_Queue_Frame( source, frame, length );
+}
+
+/*
+ * Keys up and sends a frame (without FCS) right away - only for
+ * the channel access scheduler. Calls back once back in RX.
+ * Returns the number of bits sent on air
+ */
+uint16_t RDA1846_Transmit( uint8_t *frame, uint16_t length, void (*callback)() ) {
+	txLineBits = 0;
+
+	if ( FX25_CHECK_BYTES_NONE != txFX25CheckBytes ) {
+		txLineBits = FX25_Encode_Line( frame, length, txFX25CheckBytes, txPreambleFlags, txLine, AX25_MAX_LINE_LENGTH );
+	}
+
+	// Plain AX.25 if FX.25 is off or the frame is too long for a codeblock
+	if ( 0 == txLineBits ) {
+		txLineBits = AX25_Encode_Line( frame, length, txPreambleFlags, txLine, AX25_MAX_LINE_LENGTH );
+	}
+
+	txCompleteCallback = callback;
+	transmitting = 1;
+
+	// Always send on the home channel, scanning picks up again
+	// where it left off once back in RX
+	if ( tunedFreqRaw != ( homeFreqKHz << 4 ) ) {
+		_RDA1846_Tune( homeFreqKHz );
+	}
+
+	RDA1846_Set_TX();
+
+	// Hold TX for the length of the line, then drop back to RX
+	uint16_t airtimeMS = ( (uint32_t) txLineBits * 1000 ) / RDA1846_BAUD + 1;
+	PWM_I2C_Queue_Read( RDA1846_CTL_R, _RDA1846_TX_Keyed_Callback, airtimeMS );
+
+	RDA1846_Set_RX();
+	PWM_I2C_Queue_Read( RDA1846_CTL_R, _RDA1846_TX_Complete_Callback, 0 );
+
+	return txLineBits;
 }
 
 void _RDA1846_Init_Complete_Callback() {
@@ -178,13 +577,15 @@ void _RDA1846_Init_Complete_Callback() {
 
 	// Finish setting up the radio
 	RDA1846_Set_Frequency_KHz( 144390 );
-	RDA1846_Set_RX();
 	RDA1846_Set_Volume( 12, 12 );
 	RDA1846_Set_Squelch( 0 ); // off
+
+	// Start watching the channel
+	_RDA1846_Get_RSSI();
 }
 
 void RDA1846_Init() {
-	PWM_I2C_Init();
+	PWM_I2C_Init( RDA1846_I2C_ADDRESS );
 	PWM_I2C_Set_Callback( _RDA1846_Init_Complete_Callback );
 
 	_RDA1846_Soft_Reset();
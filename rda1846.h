@@ -8,10 +8,31 @@
 
 #include "stdint.h"
 
+#define RDA1846_SCAN_MAX_CHANNELS 16
+
 void RDA1846_Init();
 void RDA1846_Set_Squelch( uint8_t on );
 void RDA1846_Set_Frequency_KHz( uint32_t freqKHZ );
 void RDA1846_Set_Volume( uint16_t volume1, uint16_t volume2 );
+uint8_t RDA1846_Send_Packet( uint8_t source, uint8_t *frame, uint16_t length );
+uint16_t RDA1846_Transmit( uint8_t *frame, uint16_t length, void (*callback)() );
+uint16_t RDA1846_Get_Airtime_Bits( uint8_t *frame, uint16_t length );
+void RDA1846_Set_FX25( uint8_t checkBytes );
+void RDA1846_Set_TX_Delay( uint16_t milliseconds );
+
+void RDA1846_Set_RSSI_Poll_Rate( uint16_t milliseconds );
+void RDA1846_Set_Busy_Threshold( int16_t dBm );
+int16_t RDA1846_Get_RSSI();
+uint8_t RDA1846_Channel_Busy();
+void RDA1846_Wait_For_Channel( void (*callback)() );
+void RDA1846_Watch_Channel( uint8_t on );
+
+void RDA1846_Set_Scan_List( const uint32_t *freqKHz, const uint16_t *dwellMS, uint8_t count );
+void RDA1846_Set_Scan_Threshold( int16_t dBm );
+void RDA1846_Start_Scan( void (*callback)( uint8_t channel ) );
+void RDA1846_Stop_Scan();
+uint8_t RDA1846_Scanning();
+void RDA1846_Get_Scan_Stats( uint32_t *retunes, uint32_t *writesSkipped, uint32_t *listCycles );
 
 
 #endif // __RDA1846_H
\ No newline at end of file
@@ -0,0 +1,158 @@
+// GPS time slotted transmit scheduling
+//
+// The UTC minute is split into TDMA_SLOTS slots. A frame handed
+// to TDMA_Send_Packet waits for this station's slot; if its slot
+// has already started (or the GPS sentence for the slot start was
+// lost) and the frame no longer fits in what is left, it waits
+// for the same slot in the next frame.
+//
+// Fitting a frame in a slot accounts for the time the GPS sentence
+// takes to arrive after the second boundary, the RDA1846_Set_TX
+// keying sequence and the airtime of the frame itself.
+
+#include "tdma.h"
+#include "aprs.h"
+#include "ax25.h"
+#include "csma.h"
+#include "gps.h"
+#include "rda1846.h"
+
+// RMC arrives a few hundred ms after the second it reports
+#define TDMA_GPS_LATENCY_MS 250
+
+// RDA1846_Set_TX: masked register writes plus the 50 ms GPIO
+// settle, one RSSI poll and one CSMA tick ahead of it
+#define TDMA_KEYING_LATENCY_MS 80
+
+// Left unused at the end of each slot for timing error between stations
+#define TDMA_GUARD_MS 100
+
+// Most of a slot a frame can use when we catch the slot start
+#define TDMA_SLOT_USABLE_MS ( TDMA_SLOT_SECONDS * 1000 - TDMA_GPS_LATENCY_MS - TDMA_KEYING_LATENCY_MS - TDMA_GUARD_MS )
+
+static uint8_t tdmaSlot = TDMA_SLOT_NONE;
+
+static uint8_t pendingFrame[AX25_MAX_FRAME_LENGTH];
+static uint16_t pendingLength = 0;
+static volatile uint8_t pending = 0;
+
+static uint32_t tdmaFramesSent = 0;
+static uint32_t tdmaSlotsDeferred = 0;
+static uint32_t tdmaFramesTooLong = 0;
+
+/*
+ * FNV-1a hash of the callsign, folded onto the slot count
+ */
+uint8_t _TDMA_Slot_From_Callsign( char *callsign ) {
+	uint32_t hash = 2166136261;
+	while ( *callsign ) {
+		hash ^= (uint8_t) *callsign;
+		hash *= 16777619;
+		callsign++;
+	}
+	return hash % TDMA_SLOTS;
+}
+
+void _TDMA_GPS_Second() {
+	if ( ! pending ) {
+		return;
+	}
+
+	uint8_t minute, seconds;
+	GPS_Get_Time( 0, &minute, &seconds );
+
+	uint8_t slotStart = tdmaSlot * TDMA_SLOT_SECONDS;
+	uint8_t secondOfFrame = ( minute * 60 + seconds ) % TDMA_FRAME_SECONDS;
+
+	if ( ( secondOfFrame < slotStart ) || ( secondOfFrame >= slotStart + TDMA_SLOT_SECONDS ) ) {
+		return;
+	}
+
+	// Time left in our slot from when this sentence arrived
+	int32_t remainingMS = TDMA_SLOT_USABLE_MS - ( secondOfFrame - slotStart ) * 1000;
+	int32_t neededMS = ( (uint32_t) RDA1846_Get_Airtime_Bits( pendingFrame, pendingLength ) * 1000 ) / 1200;
+
+	if ( neededMS > TDMA_SLOT_USABLE_MS ) {
+		// Would never fit a slot
+		tdmaFramesTooLong++;
+		pending = 0;
+		return;
+	}
+
+	if ( neededMS > remainingMS ) {
+		// Joined our slot too late, try again next frame
+		tdmaSlotsDeferred++;
+		return;
+	}
+
+	// Waiting out another station's carrier must not run the frame
+	// past the end of the slot into the next station's
+	CSMA_Set_Parameters( CSMA_SOURCE_STATION, 10, 255, remainingMS - neededMS );
+
+	if ( RDA1846_Send_Packet( CSMA_SOURCE_STATION, pendingFrame, pendingLength ) ) {
+		tdmaFramesSent++;
+		pending = 0;
+	}
+}
+
+/*
+ * slotId: 0 to TDMA_SLOTS - 1, TDMA_SLOT_AUTO to hash the
+ * callsign, or TDMA_SLOT_NONE to send without slotting
+ */
+void TDMA_Init( uint8_t slotId ) {
+	pending = 0;
+
+	if ( TDMA_SLOT_NONE == slotId ) {
+		tdmaSlot = TDMA_SLOT_NONE;
+		return;
+	}
+
+	if ( slotId >= TDMA_SLOTS ) {
+		slotId = _TDMA_Slot_From_Callsign( APRS_CALLSIGN );
+	}
+	tdmaSlot = slotId;
+
+	// The slot already keeps stations apart - send at the first clear
+	// 10 ms tick, and give up rather than spill into the next slot
+	CSMA_Set_Parameters( CSMA_SOURCE_STATION, 10, 255, TDMA_SLOT_SECONDS * 1000 - TDMA_GPS_LATENCY_MS - TDMA_GUARD_MS );
+
+	GPS_Register_Second_Callback( _TDMA_GPS_Second );
+}
+
+uint8_t TDMA_Get_Slot() {
+	return tdmaSlot;
+}
+
+/*
+ * Holds a frame (without FCS) for this station's next slot
+ * Returns 0 if a frame is already waiting
+ */
+uint8_t TDMA_Send_Packet( uint8_t *frame, uint16_t length ) {
+	if ( TDMA_SLOT_NONE == tdmaSlot ) {
+		return RDA1846_Send_Packet( CSMA_SOURCE_STATION, frame, length );
+	}
+
+	if ( pending || ( length > AX25_MAX_FRAME_LENGTH ) ) {
+		return 0;
+	}
+
+	for ( uint16_t i=0; i < length; i++ ) {
+		pendingFrame[i] = frame[i];
+	}
+	pendingLength = length;
+	pending = 1;
+
+	return 1;
+}
+
+void TDMA_Get_Stats( uint32_t *framesSent, uint32_t *slotsDeferred, uint32_t *framesTooLong ) {
+	if ( framesSent ) {
+		*framesSent = tdmaFramesSent;
+	}
+	if ( slotsDeferred ) {
+		*slotsDeferred = tdmaSlotsDeferred;
+	}
+	if ( framesTooLong ) {
+		*framesTooLong = tdmaFramesTooLong;
+	}
+}
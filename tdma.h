@@ -0,0 +1,25 @@
+// GPS time slotted transmit scheduling
+//
+// Every station owns one slot in a repeating frame aligned to
+// GPS (UTC) time, so co-located stations never key up together
+
+#ifndef __TDMA_H
+#define __TDMA_H
+
+#include "stdint.h"
+
+#define TDMA_FRAME_SECONDS 60
+#define TDMA_SLOT_SECONDS 2
+#define TDMA_SLOTS ( TDMA_FRAME_SECONDS / TDMA_SLOT_SECONDS )
+
+// Pick the slot from a hash of the callsign
+#define TDMA_SLOT_AUTO 0xFF
+// No slotting, frames go straight to the CSMA scheduler
+#define TDMA_SLOT_NONE 0xFE
+
+void TDMA_Init( uint8_t slotId );
+uint8_t TDMA_Get_Slot();
+uint8_t TDMA_Send_Packet( uint8_t *frame, uint16_t length );
+void TDMA_Get_Stats( uint32_t *framesSent, uint32_t *slotsDeferred, uint32_t *framesTooLong );
+
+#endif // __TDMA_H
@@ -0,0 +1,901 @@
+// Binary telemetry stream to a host computer
+//
+// Records are queued whole (header, payload and CRC) into a
+// small ring of slots and COBS encoded on the fly as the UART
+// TX FIFO drains, so nothing waits on the UART and a full ring
+// just drops the record. The encoder reads a frame through up
+// to three pieces (header, body, CRC), which lets a history
+// dump send the flash log pages straight out of flash. Handler
+// profiles (profile.h) go out one handler per frame on request,
+// the event trace (trace.h) in batches of records, a driver
+// capture (capture.h) as a byte stream and the benchmark results
+// (bench.h) one benchmark per frame.
+//
+// Higher priority handlers queue records too, so the UART5
+// handler refills the FIFO with interrupts masked.
+//
+// Uses UART5: PE4 (U5Rx) and PE5 (U5Tx) at 921600 baud
+
+#include "telemetry.h"
+#include "ax25.h"
+#include "afsk.h"
+#include "kiss.h"
+#include "csma.h"
+#include "tdma.h"
+#include "digi.h"
+#include "calibration.h"
+#include "power.h"
+#include "flash-log.h"
+#include "rda1846.h"
+#include "gps.h"
+#include "ds18b20.h"
+#include "wind-rain.h"
+#include "pwm-i2c.h"
+#include "adc-supply.h"
+#include "clock.h"
+#include "profile.h"
+#include "trace.h"
+#include "capture.h"
+#include "bench.h"
+#include "tm4c123gh6pm.h"
+#include "intrinsics.h"
+
+#define TELEMETRY_BAUD 921600
+
+#define TELEMETRY_TX_SLOTS 16
+#define TELEMETRY_SLOT_LENGTH 32
+#define TELEMETRY_HEADER_LENGTH 3
+#define TELEMETRY_CRC_LENGTH 2
+#define TELEMETRY_MAX_PAYLOAD ( TELEMETRY_SLOT_LENGTH - TELEMETRY_HEADER_LENGTH - TELEMETRY_CRC_LENGTH )
+
+// Longest run COBS can describe with one code byte
+#define TELEMETRY_COBS_MAX_RUN 254
+
+#define TELEMETRY_RX_LENGTH 16
+
+// Handler, handlers, count, cycles, max latency, max duration
+// and the two histograms
+#define TELEMETRY_PROFILE_LENGTH ( 2 + 4 + 8 + 4 + 4 + 4 * PROFILE_BUCKETS )
+
+// Index of the first record and how many follow, then the records
+#define TELEMETRY_TRACE_RECORDS 16
+#define TELEMETRY_TRACE_RECORD_LENGTH 8
+#define TELEMETRY_TRACE_LENGTH ( 4 + 1 + TELEMETRY_TRACE_RECORDS * TELEMETRY_TRACE_RECORD_LENGTH )
+
+// Stream offset of the first byte, then the bytes
+#define TELEMETRY_CAPTURE_BYTES 120
+#define TELEMETRY_CAPTURE_LENGTH ( 4 + TELEMETRY_CAPTURE_BYTES )
+
+// Benchmark, benchmarks, iterations, minimum, maximum and total
+// cycles, and the clock they were counted at
+#define TELEMETRY_BENCH_LENGTH ( 2 + 2 + 4 + 4 + 4 + 4 )
+
+// Driver counters go out every 10 seconds
+#define TELEMETRY_COUNTER_SECONDS 10
+
+typedef enum {
+	TELEMETRY_ENCODE_CODE,
+	TELEMETRY_ENCODE_DATA,
+	TELEMETRY_ENCODE_DELIMITER
+} Telemetry_Encode_State;
+
+// Queued records, complete with header and CRC
+static uint8_t txSlots[TELEMETRY_TX_SLOTS][TELEMETRY_SLOT_LENGTH];
+static uint8_t txLengths[TELEMETRY_TX_SLOTS];
+static volatile uint8_t txHead = 0;
+static volatile uint8_t txTail = 0;
+static uint8_t txSequence = 0;
+
+// The frame being encoded, in up to three pieces
+static const uint8_t *framePieces[3];
+static uint16_t pieceLengths[3];
+static uint16_t frameLength = 0;
+static uint16_t framePosition = 0;
+static uint8_t frameFromSlot = 0;
+static uint8_t frameActive = 0;
+
+static Telemetry_Encode_State encodeState = TELEMETRY_ENCODE_CODE;
+static uint8_t runRemaining = 0;
+static uint8_t runLength = 0;
+
+// History dump - pages go out between queued records
+static volatile uint8_t dumpActive = 0;
+static uint16_t dumpPage = 0;
+static uint16_t dumpPagesLeft = 0;
+static uint16_t dumpPagesSent = 0;
+static uint8_t dumpHeader[TELEMETRY_HEADER_LENGTH + 2];
+static uint8_t dumpCRC[TELEMETRY_CRC_LENGTH];
+
+// Profile report - one frame per handler, also between records
+static volatile uint8_t profileActive = 0;
+static uint8_t profileISR = 0;
+static uint8_t profileFlags = 0;
+static uint8_t profileFrame[TELEMETRY_HEADER_LENGTH + TELEMETRY_PROFILE_LENGTH + TELEMETRY_CRC_LENGTH];
+
+// Trace - batches of records, once through or kept streaming
+static volatile uint8_t traceActive = 0;
+static uint8_t traceStreaming = 0;
+static uint32_t traceNext = 0;
+static uint8_t traceFrame[TELEMETRY_HEADER_LENGTH + TELEMETRY_TRACE_LENGTH + TELEMETRY_CRC_LENGTH];
+
+// Capture - streamed while recording, then closed off
+static volatile uint8_t captureActive = 0;
+static uint8_t captureFrame[TELEMETRY_HEADER_LENGTH + TELEMETRY_CAPTURE_LENGTH + TELEMETRY_CRC_LENGTH];
+
+// Benchmark results - one frame per benchmark
+static volatile uint8_t benchActive = 0;
+static uint8_t benchIndex = 0;
+static uint8_t benchFrame[TELEMETRY_HEADER_LENGTH + TELEMETRY_BENCH_LENGTH + TELEMETRY_CRC_LENGTH];
+
+static uint8_t rxFrame[TELEMETRY_RX_LENGTH];
+static uint8_t rxLength = 0;
+static uint8_t rxOverflow = 0;
+
+static uint8_t counterSeconds = 0;
+
+static uint32_t telemetryFramesSent = 0;
+static uint32_t telemetryFramesDropped = 0;
+static uint32_t telemetryPagesDumped = 0;
+
+uint8_t *_Telemetry_Put_U16( uint8_t *dest, uint16_t value ) {
+	dest[0] = value & 0xFF;
+	dest[1] = value >> 8;
+	return dest + 2;
+}
+
+uint8_t *_Telemetry_Put_U32( uint8_t *dest, uint32_t value ) {
+	dest[0] = value & 0xFF;
+	dest[1] = ( value >> 8 ) & 0xFF;
+	dest[2] = ( value >> 16 ) & 0xFF;
+	dest[3] = value >> 24;
+	return dest + 4;
+}
+
+void _Telemetry_Put_CRC( uint8_t *dest, uint16_t crc ) {
+	crc ^= 0xFFFF;
+	dest[0] = crc & 0xFF;
+	dest[1] = crc >> 8;
+}
+
+uint8_t _Telemetry_Frame_Byte( uint16_t index ) {
+	if ( index < pieceLengths[0] ) {
+		return framePieces[0][index];
+	}
+	index -= pieceLengths[0];
+	if ( index < pieceLengths[1] ) {
+		return framePieces[1][index];
+	}
+	return framePieces[2][index - pieceLengths[1]];
+}
+
+void _Telemetry_Start_Frame( const uint8_t *header, uint16_t headerLength, const uint8_t *body, uint16_t bodyLength, const uint8_t *crc ) {
+	framePieces[0] = header;
+	pieceLengths[0] = headerLength;
+	framePieces[1] = body;
+	pieceLengths[1] = bodyLength;
+	framePieces[2] = crc;
+	pieceLengths[2] = crc ? TELEMETRY_CRC_LENGTH : 0;
+	frameLength = headerLength + bodyLength + pieceLengths[2];
+	framePosition = 0;
+	encodeState = TELEMETRY_ENCODE_CODE;
+	frameActive = 1;
+}
+
+/*
+ * Sets up the next history page, straight from flash
+ * Returns 0 once the dump is over
+ */
+uint8_t _Telemetry_Next_Dump_Frame() {
+	while ( dumpPagesLeft ) {
+		const uint8_t *page = Flash_Log_Get_Page( dumpPage );
+		uint16_t index = dumpPage;
+
+		dumpPagesLeft--;
+		dumpPage++;
+		if ( FLASH_LOG_PAGES == dumpPage ) {
+			dumpPage = 0;
+		}
+
+		if ( page ) {
+			dumpHeader[0] = TELEMETRY_VERSION;
+			dumpHeader[1] = TELEMETRY_RECORD_LOG_PAGE;
+			dumpHeader[2] = txSequence++;
+			_Telemetry_Put_U16( &dumpHeader[3], index );
+
+			uint16_t crc = AX25_Update_CRC( 0xFFFF, dumpHeader, sizeof( dumpHeader ) );
+			_Telemetry_Put_CRC( dumpCRC, AX25_Update_CRC( crc, page, FLASH_LOG_PAGE_SIZE ) );
+
+			_Telemetry_Start_Frame( dumpHeader, sizeof( dumpHeader ), page, FLASH_LOG_PAGE_SIZE, dumpCRC );
+			dumpPagesSent++;
+			telemetryPagesDumped++;
+			return 1;
+		}
+	}
+
+	// Close with the number of pages sent
+	dumpHeader[0] = TELEMETRY_VERSION;
+	dumpHeader[1] = TELEMETRY_RECORD_DUMP_END;
+	dumpHeader[2] = txSequence++;
+	_Telemetry_Put_U16( &dumpHeader[3], dumpPagesSent );
+	_Telemetry_Put_CRC( dumpCRC, AX25_Update_CRC( 0xFFFF, dumpHeader, sizeof( dumpHeader ) ) );
+	_Telemetry_Start_Frame( dumpHeader, sizeof( dumpHeader ), 0, 0, dumpCRC );
+	dumpActive = 0;
+	return 1;
+}
+
+/*
+ * Sets up the next handler's profile, copied out as it goes
+ * An empty report (no handlers) means profiling is compiled out
+ */
+uint8_t _Telemetry_Next_Profile_Frame() {
+	Profile_ISR profile;
+	uint8_t *p = profileFrame;
+
+	*p++ = TELEMETRY_VERSION;
+	*p++ = TELEMETRY_RECORD_PROFILE;
+	*p++ = txSequence++;
+	*p++ = profileISR;
+
+	if ( Profile_Get_ISR( profileISR, &profile ) ) {
+		*p++ = PROFILE_ISRS;
+		p = _Telemetry_Put_U32( p, profile.count );
+		p = _Telemetry_Put_U32( p, (uint32_t) profile.cycles );
+		p = _Telemetry_Put_U32( p, (uint32_t) ( profile.cycles >> 32 ) );
+		p = _Telemetry_Put_U32( p, profile.maxLatency );
+		p = _Telemetry_Put_U32( p, profile.maxDuration );
+		for ( uint8_t bucket=0; bucket < PROFILE_BUCKETS; bucket++ ) {
+			p = _Telemetry_Put_U16( p, profile.latency[bucket] );
+		}
+		for ( uint8_t bucket=0; bucket < PROFILE_BUCKETS; bucket++ ) {
+			p = _Telemetry_Put_U16( p, profile.duration[bucket] );
+		}
+		profileISR++;
+	} else {
+		*p++ = 0;
+		profileISR = PROFILE_ISRS;
+	}
+
+	if ( profileISR >= PROFILE_ISRS ) {
+		if ( profileFlags & TELEMETRY_PROFILE_RESET ) {
+			Profile_Reset();
+		}
+		profileActive = 0;
+	}
+
+	_Telemetry_Put_CRC( p, AX25_Update_CRC( 0xFFFF, profileFrame, p - profileFrame ) );
+	_Telemetry_Start_Frame( profileFrame, p - profileFrame + TELEMETRY_CRC_LENGTH, 0, 0, 0 );
+	return 1;
+}
+
+/*
+ * Sets up the next benchmark's result
+ * An empty report (no benchmarks) means they were compiled out
+ */
+uint8_t _Telemetry_Next_Bench_Frame() {
+	Bench_Result result;
+	uint8_t *p = benchFrame;
+
+	*p++ = TELEMETRY_VERSION;
+	*p++ = TELEMETRY_RECORD_BENCH;
+	*p++ = txSequence++;
+	*p++ = benchIndex;
+
+	if ( Bench_Get_Result( benchIndex, &result ) ) {
+		*p++ = BENCHES;
+		p = _Telemetry_Put_U16( p, result.iterations );
+		p = _Telemetry_Put_U32( p, result.minimum );
+		p = _Telemetry_Put_U32( p, result.maximum );
+		p = _Telemetry_Put_U32( p, result.total );
+		p = _Telemetry_Put_U32( p, Clock_Get_Hz() );
+		benchIndex++;
+	} else {
+		*p++ = 0;
+		benchIndex = BENCHES;
+	}
+
+	if ( benchIndex >= BENCHES ) {
+		benchActive = 0;
+	}
+
+	_Telemetry_Put_CRC( p, AX25_Update_CRC( 0xFFFF, benchFrame, p - benchFrame ) );
+	_Telemetry_Start_Frame( benchFrame, p - benchFrame + TELEMETRY_CRC_LENGTH, 0, 0, 0 );
+	return 1;
+}
+
+/*
+ * Sets up the next batch of trace records
+ * Returns 0 if a stream has nothing new to send, or the next
+ * record isn't ready
+ */
+uint8_t _Telemetry_Next_Trace_Frame() {
+	Trace_Record record;
+	uint32_t head = Trace_Get_Head();
+
+	if ( traceStreaming && ( traceNext == head ) ) {
+		return 0;
+	}
+
+	// Skip whatever the ring has already lost
+	if ( head - traceNext > TRACE_RECORDS ) {
+		traceNext = head - TRACE_RECORDS;
+	}
+
+	uint8_t *p = traceFrame;
+	*p++ = TELEMETRY_VERSION;
+	*p++ = TELEMETRY_RECORD_TRACE;
+	uint8_t *sequence = p++;
+	p = _Telemetry_Put_U32( p, traceNext );
+	uint8_t *count = p++;
+	*count = 0;
+
+	while ( ( *count < TELEMETRY_TRACE_RECORDS ) && ( traceNext != head ) ) {
+		if ( ! Trace_Get_Record( traceNext, &record ) ) {
+			// Overwritten as we went, or still being written by a
+			// handler this one preempted - pick up again next frame
+			break;
+		}
+		p = _Telemetry_Put_U32( p, record.cycles );
+		*p++ = record.event;
+		*p++ = record.arg;
+		p = _Telemetry_Put_U16( p, record.value );
+		traceNext++;
+		( *count )++;
+	}
+
+	if ( ! *count ) {
+		if ( traceNext != head ) {
+			// Nothing ready - the next record queued, at least the
+			// second's state, comes back for it
+			return 0;
+		}
+		// An empty record closes a one-time read out
+		if ( ! traceStreaming ) {
+			traceActive = 0;
+		}
+	}
+
+	*sequence = txSequence++;
+	_Telemetry_Put_CRC( p, AX25_Update_CRC( 0xFFFF, traceFrame, p - traceFrame ) );
+	_Telemetry_Start_Frame( traceFrame, p - traceFrame + TELEMETRY_CRC_LENGTH, 0, 0, 0 );
+	return 1;
+}
+
+/*
+ * Sets up the next piece of the capture stream
+ * Returns 0 if there's nothing new to send yet
+ */
+uint8_t _Telemetry_Next_Capture_Frame() {
+	uint32_t offset;
+	uint8_t running = Capture_Running();
+	uint16_t length = Capture_Read( &captureFrame[TELEMETRY_HEADER_LENGTH + 4], TELEMETRY_CAPTURE_BYTES, &offset );
+
+	if ( ! length ) {
+		if ( running ) {
+			return 0;
+		}
+		// Stopped and drained - an empty record closes the stream
+		captureActive = 0;
+	}
+
+	captureFrame[0] = TELEMETRY_VERSION;
+	captureFrame[1] = TELEMETRY_RECORD_CAPTURE;
+	captureFrame[2] = txSequence++;
+	_Telemetry_Put_U32( &captureFrame[TELEMETRY_HEADER_LENGTH], offset );
+
+	length += TELEMETRY_HEADER_LENGTH + 4;
+	_Telemetry_Put_CRC( &captureFrame[length], AX25_Update_CRC( 0xFFFF, captureFrame, length ) );
+	_Telemetry_Start_Frame( captureFrame, length + TELEMETRY_CRC_LENGTH, 0, 0, 0 );
+	return 1;
+}
+
+/*
+ * Picks the next frame: queued records first, then a profile
+ * report, the benchmarks, the trace, the capture and the dump
+ */
+uint8_t _Telemetry_Load_Frame() {
+	if ( txHead != txTail ) {
+		_Telemetry_Start_Frame( txSlots[txHead], txLengths[txHead], 0, 0, 0 );
+		frameFromSlot = 1;
+		return 1;
+	}
+
+	frameFromSlot = 0;
+	if ( profileActive ) {
+		return _Telemetry_Next_Profile_Frame();
+	}
+	if ( benchActive ) {
+		return _Telemetry_Next_Bench_Frame();
+	}
+	if ( traceActive && _Telemetry_Next_Trace_Frame() ) {
+		return 1;
+	}
+	if ( captureActive && _Telemetry_Next_Capture_Frame() ) {
+		return 1;
+	}
+	if ( dumpActive ) {
+		return _Telemetry_Next_Dump_Frame();
+	}
+
+	return 0;
+}
+
+void _Telemetry_End_Frame() {
+	frameActive = 0;
+	telemetryFramesSent++;
+	if ( frameFromSlot ) {
+		txHead = ( txHead + 1 ) % TELEMETRY_TX_SLOTS;
+	}
+}
+
+/*
+ * Produces the next COBS encoded byte
+ * Returns 0 when there is nothing left to send
+ */
+uint8_t _Telemetry_Next_TX_Byte( uint8_t *data ) {
+	if ( ! frameActive && ! _Telemetry_Load_Frame() ) {
+		return 0;
+	}
+
+	while ( 1 ) {
+		switch ( encodeState ) {
+			case TELEMETRY_ENCODE_CODE:
+				// Code byte: one more than the run of non-zero bytes ahead
+				runLength = 0;
+				while ( ( framePosition + runLength < frameLength ) && ( runLength < TELEMETRY_COBS_MAX_RUN ) &&
+					_Telemetry_Frame_Byte( framePosition + runLength ) ) {
+					runLength++;
+				}
+				runRemaining = runLength;
+				encodeState = TELEMETRY_ENCODE_DATA;
+				*data = runLength + 1;
+				return 1;
+
+			case TELEMETRY_ENCODE_DATA:
+				if ( runRemaining ) {
+					*data = _Telemetry_Frame_Byte( framePosition++ );
+					runRemaining--;
+					return 1;
+				}
+
+				if ( framePosition == frameLength ) {
+					encodeState = TELEMETRY_ENCODE_DELIMITER;
+				} else {
+					// A short run stopped at a zero, which the code
+					// byte stands for - a full run just stopped
+					if ( runLength < TELEMETRY_COBS_MAX_RUN ) {
+						framePosition++;
+					}
+					encodeState = TELEMETRY_ENCODE_CODE;
+				}
+				break;
+
+			case TELEMETRY_ENCODE_DELIMITER:
+			default:
+				_Telemetry_End_Frame();
+				*data = 0;
+				return 1;
+		}
+	}
+}
+
+void _Telemetry_Fill_TX_FIFO() {
+	uint8_t data;
+
+	while ( ( UART5_FR_R & UART_FR_TXFF ) == 0 ) {
+		if ( ! _Telemetry_Next_TX_Byte( &data ) ) {
+			// All caught up
+			UART5_IM_R &= ~UART_IM_TXIM;
+			return;
+		}
+		UART5_DR_R = data;
+	}
+
+	// FIFO full, come back when it drains
+	UART5_IM_R |= UART_IM_TXIM;
+}
+
+/*
+ * Queues a record with its header and CRC
+ * Returns 0 (and drops it) if the ring is full
+ */
+uint8_t _Telemetry_Queue( uint8_t type, const uint8_t *payload, uint8_t length ) {
+	uint8_t queued = 0;
+
+	if ( length > TELEMETRY_MAX_PAYLOAD ) {
+		return 0;
+	}
+
+	__istate_t state = __get_interrupt_state();
+	__disable_interrupt();
+	uint8_t next = ( txTail + 1 ) % TELEMETRY_TX_SLOTS;
+	if ( next == txHead ) {
+		telemetryFramesDropped++;
+	} else {
+		uint8_t *slot = txSlots[txTail];
+		slot[0] = TELEMETRY_VERSION;
+		slot[1] = type;
+		slot[2] = txSequence++;
+		for ( uint8_t i=0; i < length; i++ ) {
+			slot[TELEMETRY_HEADER_LENGTH + i] = payload[i];
+		}
+		length += TELEMETRY_HEADER_LENGTH;
+		_Telemetry_Put_CRC( &slot[length], AX25_Update_CRC( 0xFFFF, slot, length ) );
+		txLengths[txTail] = length + TELEMETRY_CRC_LENGTH;
+
+		txTail = next;
+		_Telemetry_Fill_TX_FIFO();
+		queued = 1;
+	}
+	__set_interrupt_state( state );
+
+	return queued;
+}
+
+void _Telemetry_Start_Dump() {
+	if ( dumpActive ) {
+		return;
+	}
+
+	// Oldest page first
+	dumpPage = Flash_Log_Get_Head();
+	dumpPagesLeft = FLASH_LOG_PAGES;
+	dumpPagesSent = 0;
+	dumpActive = 1;
+	_Telemetry_Fill_TX_FIFO();
+}
+
+void _Telemetry_Start_Profile( uint8_t flags ) {
+	if ( profileActive ) {
+		return;
+	}
+
+	profileISR = 0;
+	profileFlags = flags;
+	profileActive = 1;
+	_Telemetry_Fill_TX_FIFO();
+}
+
+void _Telemetry_Start_Bench() {
+	if ( benchActive ) {
+		return;
+	}
+
+	benchIndex = 0;
+	benchActive = 1;
+	_Telemetry_Fill_TX_FIFO();
+}
+
+void _Telemetry_Start_Trace( uint8_t flags ) {
+	// A new request replaces one in progress
+	traceStreaming = ( flags & TELEMETRY_TRACE_STREAM ) ? 1 : 0;
+	if ( ! traceActive ) {
+		// Everything the ring still holds
+		uint32_t head = Trace_Get_Head();
+		traceNext = ( head > TRACE_RECORDS ) ? head - TRACE_RECORDS : 0;
+		traceActive = 1;
+	}
+	_Telemetry_Fill_TX_FIFO();
+}
+
+void _Telemetry_Start_Capture( uint8_t flags ) {
+	if ( flags & TELEMETRY_CAPTURE_START ) {
+		if ( ! Capture_Running() ) {
+			Capture_Start();
+		}
+		captureActive = 1;
+	} else {
+		Capture_Stop();
+	}
+	_Telemetry_Fill_TX_FIFO();
+}
+
+void _Telemetry_Handle_Request( uint8_t *frame, uint8_t length ) {
+	if ( length < TELEMETRY_HEADER_LENGTH + TELEMETRY_CRC_LENGTH ) {
+		return;
+	}
+	if ( AX25_Update_CRC( 0xFFFF, frame, length ) != 0xF0B8 ) {
+		// Residue of a good AX.25 FCS
+		return;
+	}
+	if ( TELEMETRY_VERSION != frame[0] ) {
+		return;
+	}
+
+	if ( TELEMETRY_REQUEST_DUMP == frame[1] ) {
+		_Telemetry_Start_Dump();
+	}
+
+	// Optional flags byte after the header
+	uint8_t flags = 0;
+	if ( length > TELEMETRY_HEADER_LENGTH + TELEMETRY_CRC_LENGTH ) {
+		flags = frame[TELEMETRY_HEADER_LENGTH];
+	}
+
+	if ( TELEMETRY_REQUEST_PROFILE == frame[1] ) {
+		_Telemetry_Start_Profile( flags );
+	}
+
+	if ( TELEMETRY_REQUEST_BENCH == frame[1] ) {
+		_Telemetry_Start_Bench();
+	}
+
+	if ( TELEMETRY_REQUEST_TRACE == frame[1] ) {
+		_Telemetry_Start_Trace( flags );
+	}
+
+	if ( TELEMETRY_REQUEST_CAPTURE == frame[1] ) {
+		_Telemetry_Start_Capture( flags );
+	}
+}
+
+/*
+ * Undoes the COBS encoding in place once a zero ends the frame
+ */
+void _Telemetry_Receive_Byte( uint8_t data ) {
+	if ( data ) {
+		if ( rxLength < TELEMETRY_RX_LENGTH ) {
+			rxFrame[rxLength++] = data;
+		} else {
+			rxOverflow = 1;
+		}
+		return;
+	}
+
+	if ( ! rxOverflow && rxLength ) {
+		uint8_t in = 0;
+		uint8_t out = 0;
+		uint8_t valid = 1;
+		while ( in < rxLength ) {
+			uint8_t code = rxFrame[in++];
+			for ( uint8_t i=1; i < code; i++ ) {
+				if ( in >= rxLength ) {
+					valid = 0;
+					break;
+				}
+				rxFrame[out++] = rxFrame[in++];
+			}
+			if ( ( code < 0xFF ) && ( in < rxLength ) ) {
+				rxFrame[out++] = 0;
+			}
+		}
+		if ( valid ) {
+			_Telemetry_Handle_Request( rxFrame, out );
+		}
+	}
+
+	rxLength = 0;
+	rxOverflow = 0;
+}
+
+void _Telemetry_Set_Baud() {
+	uint32_t divisor = Clock_Get_UART_Divisor( TELEMETRY_BAUD );
+	UART5_IBRD_R = divisor >> 6;
+	UART5_FBRD_R = divisor & 0x3F;
+}
+
+void _Telemetry_Clock_Changed( uint32_t hz ) {
+	// Let the byte in progress finish
+	while ( UART5_FR_R & UART_FR_BUSY ) {};
+
+	UART5_CTL_R &= ~UART_CTL_UARTEN;
+	_Telemetry_Set_Baud();
+	UART5_LCRH_R = 0x70;
+	UART5_CTL_R |= UART_CTL_UARTEN;
+}
+
+// Initialize UART5 at 921600 8N1
+void Telemetry_Init() {
+	txHead = 0;
+	txTail = 0;
+	frameActive = 0;
+	dumpActive = 0;
+	profileActive = 0;
+	benchActive = 0;
+	traceActive = 0;
+	captureActive = 0;
+	rxLength = 0;
+
+	SYSCTL_RCGCUART_R |= 0x0020;			// Enable UART5
+	SYSCTL_RCGCGPIO_R |= 0x0010;			// Enable GPIO clocks on Port E
+
+	while ( ( SYSCTL_PRGPIO_R & 0x10 ) == 0 ) {};
+
+	GPIO_PORTE_AMSEL_R &= ~0x30;			// No analog on E4 and E5
+	GPIO_PORTE_AFSEL_R |= 0x30;				// Enable alt function on E4 and E5
+
+	// Set the Port Mux Control for PE4 as U5RX (1) and PE5 as U5TX (1)
+	GPIO_PORTE_PCTL_R = (GPIO_PORTE_PCTL_R & 0xFF00FFFF) | 0x00110000;
+
+	GPIO_PORTE_DEN_R |= 0x30;				// Enable digital on E4 and E5
+
+	// Set the baud rate (921600) from the system clock
+	UART5_CTL_R &= ~UART_CTL_UARTEN;		// Disable the UART
+	_Telemetry_Set_Baud();
+	Clock_Register_Change_Callback( _Telemetry_Clock_Changed );
+
+	UART5_LCRH_R = 0x70;					// 8N1 + FIFO
+
+	// RX interrupt at 1/2 full, receive timeout catches the tail
+	// of a request; TX interrupt when the FIFO drops to 1/8 full
+	UART5_IFLS_R = (UART5_IFLS_R & 0xFFFFFFC0) | 0x00000010;
+	UART5_IM_R = UART_IM_RXIM | UART_IM_RTIM;
+
+	UART5_CTL_R |= UART_CTL_RXE | UART_CTL_TXE | UART_CTL_UARTEN;
+
+	// UART5 / IRQ61 / NVIC_PRI15_R / b15-13 / Priority 3
+	NVIC_PRI15_R = (NVIC_PRI15_R & 0xFFFF00FF) | 0x00006000;
+	NVIC_EN1_R = 1 << ( 61 - 32 );
+}
+
+// Handles UART5 interrupt events, IRQ61
+void Telemetry_UART5_Handler() {
+	PROFILE_ENTER( PROFILE_TELEMETRY );
+
+	// Keep _Telemetry_Queue out while the encoder runs
+	__istate_t state = __get_interrupt_state();
+	__disable_interrupt();
+
+	if ( UART5_MIS_R & ( UART_MIS_RXMIS | UART_MIS_RTMIS ) ) {
+		UART5_ICR_R = UART_ICR_RXIC | UART_ICR_RTIC;	// Acknowledge the interrupt
+		while ( ( UART5_FR_R & UART_FR_RXFE ) == 0 ) {
+			_Telemetry_Receive_Byte( UART5_DR_R );
+		}
+	}
+
+	if ( UART5_MIS_R & UART_MIS_TXMIS ) {
+		UART5_ICR_R = UART_ICR_TXIC;
+		_Telemetry_Fill_TX_FIFO();
+	}
+
+	__set_interrupt_state( state );
+
+	PROFILE_EXIT( PROFILE_TELEMETRY );
+}
+
+void _Telemetry_Send_State() {
+	uint8_t payload[TELEMETRY_MAX_PAYLOAD];
+	uint8_t *p = payload;
+
+	uint8_t flags = 0;
+	flags |= GPS_Device_Detected() ? 0x01 : 0;
+	flags |= GPS_Data_Valid() ? 0x02 : 0;
+	flags |= DS18B20_Data_Valid() ? 0x04 : 0;
+	flags |= RDA1846_Scanning() ? 0x08 : 0;
+	flags |= ADC_Supply_Data_Valid() ? 0x10 : 0;
+
+	// Positions in hundredths of a minute, north and east positive
+	uint8_t latDeg, latMin, latHundredths, longDeg, longMin, longHundredths;
+	char latHem, longHem;
+	GPS_Get_Latitude( &latDeg, &latMin, 0, &latHem );
+	GPS_Get_Longitude( &longDeg, &longMin, 0, &longHem );
+	GPS_Get_Position_Hundredths( &latHundredths, &longHundredths );
+	int32_t latitude = ( latDeg * 60 + latMin ) * 100 + latHundredths;
+	int32_t longitude = ( longDeg * 60 + longMin ) * 100 + longHundredths;
+	if ( 'S' == latHem ) {
+		latitude = -latitude;
+	}
+	if ( 'W' == longHem ) {
+		longitude = -longitude;
+	}
+
+	int16_t temperature = DS18B20_Data_Valid() ? DS18B20_Get_Temperature_F() : TELEMETRY_NO_VALUE;
+
+	p = _Telemetry_Put_U32( p, GPS_Get_Seconds() );
+	*p++ = flags;
+	p = _Telemetry_Put_U32( p, (uint32_t) latitude );
+	p = _Telemetry_Put_U32( p, (uint32_t) longitude );
+	p = _Telemetry_Put_U16( p, (uint16_t) temperature );
+	p = _Telemetry_Put_U32( p, Clock_Get_Hz() );
+	p = _Telemetry_Put_U32( p, (uint32_t) Clock_Get_Correction_PPM() );
+
+	// Millivolts - fills the record
+	p = _Telemetry_Put_U16( p, ADC_Supply_Get_Battery_MV() );
+	p = _Telemetry_Put_U16( p, ADC_Supply_Get_Solar_MV() );
+
+	_Telemetry_Queue( TELEMETRY_RECORD_STATE, payload, p - payload );
+}
+
+void _Telemetry_Send_Counters( uint8_t group, uint32_t *counters, uint8_t count ) {
+	uint8_t payload[2 + 4 * 4];
+	uint8_t *p = payload;
+
+	*p++ = group;
+	*p++ = count;
+	for ( uint8_t i=0; i < count; i++ ) {
+		p = _Telemetry_Put_U32( p, counters[i] );
+	}
+
+	_Telemetry_Queue( TELEMETRY_RECORD_COUNTERS, payload, p - payload );
+}
+
+void _Telemetry_Send_All_Counters() {
+	uint32_t c[4];
+
+	AFSK_Get_Stats( &c[0], &c[1], &c[2] );
+	_Telemetry_Send_Counters( TELEMETRY_COUNTERS_AFSK, c, 3 );
+
+	KISS_Get_Stats( &c[0], &c[1], &c[2], &c[3] );
+	_Telemetry_Send_Counters( TELEMETRY_COUNTERS_KISS, c, 4 );
+
+	CSMA_Get_Stats( &c[0], &c[1], &c[2] );
+	_Telemetry_Send_Counters( TELEMETRY_COUNTERS_CSMA, c, 3 );
+
+	TDMA_Get_Stats( &c[0], &c[1], &c[2] );
+	_Telemetry_Send_Counters( TELEMETRY_COUNTERS_TDMA, c, 3 );
+
+	Digi_Get_Stats( &c[0], &c[1], &c[2], &c[3] );
+	_Telemetry_Send_Counters( TELEMETRY_COUNTERS_DIGI, c, 4 );
+
+	Calibration_Get_Stats( &c[0], &c[1], (int32_t *) &c[2] );
+	_Telemetry_Send_Counters( TELEMETRY_COUNTERS_CALIBRATION, c, 3 );
+
+	c[0] = Power_Get_Wakeups_Per_Minute();
+	_Telemetry_Send_Counters( TELEMETRY_COUNTERS_POWER, c, 1 );
+
+	Flash_Log_Get_Stats( &c[0], &c[1], &c[2], &c[3] );
+	_Telemetry_Send_Counters( TELEMETRY_COUNTERS_FLASH_LOG, c, 4 );
+
+	RDA1846_Get_Scan_Stats( &c[0], &c[1], &c[2] );
+	_Telemetry_Send_Counters( TELEMETRY_COUNTERS_RADIO_SCAN, c, 3 );
+
+	Telemetry_Get_Stats( &c[0], &c[1], &c[2] );
+	_Telemetry_Send_Counters( TELEMETRY_COUNTERS_TELEMETRY, c, 3 );
+
+	Capture_Get_Stats( &c[0], &c[1] );
+	_Telemetry_Send_Counters( TELEMETRY_COUNTERS_CAPTURE, c, 2 );
+
+	Wind_Rain_Get_Stats( &c[0], &c[1], &c[2], &c[3] );
+	_Telemetry_Send_Counters( TELEMETRY_COUNTERS_WIND_RAIN, c, 4 );
+
+	PWM_I2C_Get_Stats( &c[0], &c[1], &c[2], &c[3] );
+	_Telemetry_Send_Counters( TELEMETRY_COUNTERS_I2C, c, 4 );
+
+	ADC_Supply_Get_Stats( &c[0], &c[1] );
+	c[2] = (uint32_t) (int32_t) ADC_Supply_Get_Chip_Temperature();
+	_Telemetry_Send_Counters( TELEMETRY_COUNTERS_SUPPLY, c, 3 );
+}
+
+/*
+ * Call once a second: station state every second, driver
+ * counters every TELEMETRY_COUNTER_SECONDS
+ */
+void Telemetry_Tick_Second() {
+	_Telemetry_Send_State();
+
+	counterSeconds++;
+	if ( counterSeconds >= TELEMETRY_COUNTER_SECONDS ) {
+		counterSeconds = 0;
+		_Telemetry_Send_All_Counters();
+	}
+}
+
+uint8_t Telemetry_Send_Sample( uint8_t channel, uint32_t seconds, int16_t value ) {
+	uint8_t payload[7];
+
+	payload[0] = channel;
+	_Telemetry_Put_U32( &payload[1], seconds );
+	_Telemetry_Put_U16( &payload[5], (uint16_t) value );
+
+	return _Telemetry_Queue( TELEMETRY_RECORD_SAMPLE, payload, sizeof( payload ) );
+}
+
+uint8_t Telemetry_Send_Event( uint8_t event, uint32_t value ) {
+	uint8_t payload[5];
+
+	payload[0] = event;
+	_Telemetry_Put_U32( &payload[1], value );
+
+	return _Telemetry_Queue( TELEMETRY_RECORD_EVENT, payload, sizeof( payload ) );
+}
+
+void Telemetry_Get_Stats( uint32_t *framesSent, uint32_t *framesDropped, uint32_t *pagesDumped ) {
+	if ( framesSent ) {
+		*framesSent = telemetryFramesSent;
+	}
+	if ( framesDropped ) {
+		*framesDropped = telemetryFramesDropped;
+	}
+	if ( pagesDumped ) {
+		*pagesDumped = telemetryPagesDumped;
+	}
+}
@@ -0,0 +1,76 @@
+// Binary telemetry stream to a host computer
+//
+// Uses UART5: PE4 (U5Rx) and PE5 (U5Tx) at 921600 baud
+//
+// Every frame is COBS encoded and ends in a zero byte:
+//   version, record type, sequence, payload, CRC-16 (LSB first)
+// The CRC is the AX.25 FCS over everything before it. Multi-byte
+// fields are little endian. tools/telemetry-decode.py decodes it.
+
+#ifndef __TELEMETRY_H
+#define __TELEMETRY_H
+
+#include "stdint.h"
+
+#define TELEMETRY_VERSION 1
+
+// Station to host
+#define TELEMETRY_RECORD_STATE 0x01
+#define TELEMETRY_RECORD_SAMPLE 0x02
+#define TELEMETRY_RECORD_COUNTERS 0x03
+#define TELEMETRY_RECORD_LOG_PAGE 0x04
+#define TELEMETRY_RECORD_DUMP_END 0x05
+#define TELEMETRY_RECORD_EVENT 0x06
+#define TELEMETRY_RECORD_PROFILE 0x07
+#define TELEMETRY_RECORD_TRACE 0x08
+#define TELEMETRY_RECORD_CAPTURE 0x09
+#define TELEMETRY_RECORD_BENCH 0x0A
+
+// Host to station
+#define TELEMETRY_REQUEST_DUMP 0x81
+#define TELEMETRY_REQUEST_PROFILE 0x82
+#define TELEMETRY_REQUEST_TRACE 0x83
+#define TELEMETRY_REQUEST_CAPTURE 0x84
+#define TELEMETRY_REQUEST_BENCH 0x85
+
+// Profile request flags
+#define TELEMETRY_PROFILE_RESET 0x01
+
+// Trace request flags - without STREAM the ring goes out once,
+// closed by an empty trace record. A stream sends new records
+// whenever the link goes idle, and at least once a second.
+#define TELEMETRY_TRACE_STREAM 0x01
+
+// Capture request flags - START records (capture.h) until a
+// request without it, then an empty capture record closes it
+#define TELEMETRY_CAPTURE_START 0x01
+
+// Counter groups
+#define TELEMETRY_COUNTERS_AFSK 1
+#define TELEMETRY_COUNTERS_KISS 2
+#define TELEMETRY_COUNTERS_CSMA 3
+#define TELEMETRY_COUNTERS_TDMA 4
+#define TELEMETRY_COUNTERS_DIGI 5
+#define TELEMETRY_COUNTERS_CALIBRATION 6
+#define TELEMETRY_COUNTERS_POWER 7
+#define TELEMETRY_COUNTERS_FLASH_LOG 8
+#define TELEMETRY_COUNTERS_RADIO_SCAN 9
+#define TELEMETRY_COUNTERS_TELEMETRY 10
+#define TELEMETRY_COUNTERS_CAPTURE 11
+#define TELEMETRY_COUNTERS_WIND_RAIN 12
+#define TELEMETRY_COUNTERS_I2C 13
+#define TELEMETRY_COUNTERS_SUPPLY 14
+
+// Events
+#define TELEMETRY_EVENT_ONEWIRE_PRESENCE 1
+
+#define TELEMETRY_NO_VALUE INT16_MIN
+
+void Telemetry_Init();
+void Telemetry_UART5_Handler();
+void Telemetry_Tick_Second();
+uint8_t Telemetry_Send_Sample( uint8_t channel, uint32_t seconds, int16_t value );
+uint8_t Telemetry_Send_Event( uint8_t event, uint32_t value );
+void Telemetry_Get_Stats( uint32_t *framesSent, uint32_t *framesDropped, uint32_t *pagesDumped );
+
+#endif // __TELEMETRY_H
@@ -0,0 +1,300 @@
+// Host test of the supply monitor's scaling and averaging
+//
+// Models ADC1 behind the stand-in registers: a write to PSSI runs
+// sample sequencer 1 as adc-supply.c set it up - each step's input
+// from SSMUX1 and SSCTL1, converted 2^SAC times at 125 ksps and
+// averaged to one result in the FIFO - and interrupts after the
+// step marked END if its IE is set. The battery and solar panel
+// come through their dividers, and the temperature sensor by the
+// datasheet's VTSENS = 2.7 - (T + 55) / 75.
+//
+// Checks the sequencer set up, every code's millivolts against the
+// exact rounding and against the input to within half a code, the
+// die temperature over -40 to 85 C, that one interrupt reads
+// exactly the three results, and a second start while converting
+// counted as missed. Then puts a charge controller's ripple and
+// noise on the battery and checks the averaged readings against
+// single conversions. Prints the errors.
+
+#include "host.h"
+#include "adc-supply.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define TEST_REFERENCE_MV 3300.0
+#define TEST_CODES 4096
+#define TEST_SAMPLES_PER_SECOND 125000.0
+
+// SSCTL nibble bits
+#define TEST_STEP_END 0x2
+#define TEST_STEP_IE 0x4
+#define TEST_STEP_TS 0x8
+
+#define TEST_FIFO 4
+
+#define TEST_NOISY_SEQUENCES 2000
+#define TEST_BATTERY_MV 12800.0
+
+// Millivolts at the top of each divider, and the die in C
+static double batteryMV;
+static double solarMV;
+static double chipC;
+
+// Ripple at the top of the battery divider, and noise in codes
+static double rippleMV;
+static double rippleHz;
+static double ripplePhase;
+static double noiseCodes;
+
+static uint16_t fifo[TEST_FIFO];
+static uint8_t fifoCount;
+static uint8_t fifoRead;
+static uint32_t interrupts;
+
+// The first conversion of each battery step, before averaging
+static double singleBatteryMV;
+
+// The scaling's insides, which adc-supply.h doesn't need to show
+uint16_t _ADC_Supply_Millivolts( uint32_t code, uint32_t fullScaleMV );
+
+/*
+ * The FIFO hands out a result each read
+ */
+void _Test_Register_Hook( volatile uint32_t *reg ) {
+	if ( reg == &Host_ADC1_SSFIFO1_R ) {
+		Host_ADC1_SSFIFO1_R = ( fifoRead < fifoCount ) ? fifo[fifoRead] : 0;
+		fifoRead++;
+	}
+}
+
+double _Test_Gaussian() {
+	double u = ( rand() + 1.0 ) / ( RAND_MAX + 2.0 );
+	double v = ( rand() + 1.0 ) / ( RAND_MAX + 2.0 );
+	return sqrt( -2.0 * log( u ) ) * cos( 2.0 * M_PI * v );
+}
+
+double _Test_Divided( double topMV, uint32_t top, uint32_t bottom ) {
+	return topMV * bottom / ( top + bottom );
+}
+
+/*
+ * One conversion of a pin, 1 LSB = VREF / 4096
+ */
+uint16_t _Test_Convert( double pinMV ) {
+	double code = floor( pinMV * TEST_CODES / TEST_REFERENCE_MV + noiseCodes * _Test_Gaussian() );
+	if ( code < 0 ) {
+		return 0;
+	}
+	return ( code > TEST_CODES - 1 ) ? TEST_CODES - 1 : (uint16_t) code;
+}
+
+double _Test_Pin_MV( uint8_t mux, uint8_t sensor ) {
+	if ( sensor ) {
+		return 1000.0 * ( 2.7 - ( chipC + 55.0 ) / 75.0 );
+	}
+	if ( 2 == mux ) {
+		double ripple = rippleMV * sin( ripplePhase );
+		ripplePhase += 2.0 * M_PI * rippleHz / TEST_SAMPLES_PER_SECOND;
+		return _Test_Divided( batteryMV + ripple, ADC_SUPPLY_BATTERY_TOP_KOHMS, ADC_SUPPLY_BATTERY_BOTTOM_KOHMS );
+	}
+	if ( 3 == mux ) {
+		return _Test_Divided( solarMV, ADC_SUPPLY_SOLAR_TOP_KOHMS, ADC_SUPPLY_SOLAR_BOTTOM_KOHMS );
+	}
+	return 0;
+}
+
+/*
+ * Runs SS1 if it's been started, and takes its interrupt
+ */
+void _Test_Run_Sequencer() {
+	if ( ! ( Host_ADC1_PSSI_R & 0x02 ) || ! ( Host_ADC1_ACTSS_R & 0x02 ) ) {
+		return;
+	}
+	Host_ADC1_PSSI_R = 0;
+
+	uint32_t samples = 1 << Host_ADC1_SAC_R;
+	uint8_t interrupt = 0;
+	fifoCount = 0;
+	fifoRead = 0;
+	for ( uint8_t step=0; step < TEST_FIFO; step++ ) {
+		uint8_t control = ( Host_ADC1_SSCTL1_R >> ( 4 * step ) ) & 0xF;
+		uint8_t mux = ( Host_ADC1_SSMUX1_R >> ( 4 * step ) ) & 0xF;
+		uint32_t sum = 0;
+
+		for ( uint32_t i=0; i < samples; i++ ) {
+			uint16_t code = _Test_Convert( _Test_Pin_MV( mux, control & TEST_STEP_TS ) );
+			if ( ( 0 == i ) && ( 2 == mux ) && ! ( control & TEST_STEP_TS ) ) {
+				singleBatteryMV = code * TEST_REFERENCE_MV / ( TEST_CODES - 1 ) *
+					( ADC_SUPPLY_BATTERY_TOP_KOHMS + ADC_SUPPLY_BATTERY_BOTTOM_KOHMS ) / ADC_SUPPLY_BATTERY_BOTTOM_KOHMS;
+			}
+			sum += code;
+		}
+		fifo[fifoCount++] = sum / samples;
+
+		interrupt |= ( control & TEST_STEP_IE ) ? 1 : 0;
+		if ( control & TEST_STEP_END ) {
+			break;
+		}
+	}
+
+	if ( interrupt && ( Host_ADC1_IM_R & 0x02 ) ) {
+		interrupts++;
+		ADC_Supply_ADC1Seq1_Handler();
+		HOST_CHECK( fifoRead == fifoCount );
+	}
+}
+
+void _Test_Sequence() {
+	ADC_Supply_Start_Sequence();
+	_Test_Run_Sequencer();
+}
+
+void _Test_Setup() {
+	HOST_CHECK( 0x02 & Host_SYSCTL_RCGCADC_R );
+	HOST_CHECK( 0x03 == ( Host_GPIO_PORTE_AMSEL_R & 0x03 ) );
+	HOST_CHECK( 0 == ( Host_GPIO_PORTE_DEN_R & 0x03 ) );
+	HOST_CHECK( 0 == ( Host_GPIO_PORTE_DIR_R & 0x03 ) );
+	HOST_CHECK( 0x02 & Host_ADC1_ACTSS_R );
+	HOST_CHECK( 0 == ( Host_ADC1_EMUX_R & 0x00F0 ) );
+	HOST_CHECK( 6 == Host_ADC1_SAC_R );
+	HOST_CHECK( 0x02 & Host_ADC1_IM_R );
+	HOST_CHECK( Host_NVIC_EN1_R & ( 1 << ( 49 - 32 ) ) );
+
+	// Not read yet
+	HOST_CHECK( ! ADC_Supply_Data_Valid() );
+	HOST_CHECK( ADC_SUPPLY_NO_READING == ADC_Supply_Get_Chip_Temperature() );
+}
+
+/*
+ * Every code, battery rising while solar falls so a swapped pair
+ * shows, each input in the middle of its code
+ */
+void _Test_Codes() {
+	double batteryScale = ( ADC_SUPPLY_BATTERY_TOP_KOHMS + ADC_SUPPLY_BATTERY_BOTTOM_KOHMS ) / (double) ADC_SUPPLY_BATTERY_BOTTOM_KOHMS;
+	double solarScale = ( ADC_SUPPLY_SOLAR_TOP_KOHMS + ADC_SUPPLY_SOLAR_BOTTOM_KOHMS ) / (double) ADC_SUPPLY_SOLAR_BOTTOM_KOHMS;
+	double worst = 0;
+	uint16_t last = 0;
+
+	chipC = 25;
+	for ( uint32_t code=0; code < TEST_CODES; code++ ) {
+		uint32_t solarCode = TEST_CODES - 1 - code;
+		batteryMV = ( code + 0.5 ) * TEST_REFERENCE_MV / TEST_CODES * batteryScale;
+		solarMV = ( solarCode + 0.5 ) * TEST_REFERENCE_MV / TEST_CODES * solarScale;
+		_Test_Sequence();
+
+		uint16_t battery = ADC_Supply_Get_Battery_MV();
+		uint16_t solar = ADC_Supply_Get_Solar_MV();
+
+		// Rounded to the nearest, against 4095 as the reference
+		HOST_CHECK( battery == (uint16_t) floor( code * TEST_REFERENCE_MV * batteryScale / ( TEST_CODES - 1 ) + 0.5 ) );
+		HOST_CHECK( solar == (uint16_t) floor( solarCode * TEST_REFERENCE_MV * solarScale / ( TEST_CODES - 1 ) + 0.5 ) );
+		HOST_CHECK( battery >= last );
+		last = battery;
+
+		// Within half a code, and the rounding, of what's there
+		double error = fabs( battery - batteryMV );
+		if ( error > worst ) {
+			worst = error;
+		}
+		HOST_CHECK( error <= TEST_REFERENCE_MV * batteryScale / TEST_CODES / 2 + 0.5 );
+		HOST_CHECK( fabs( solar - solarMV ) <= TEST_REFERENCE_MV * solarScale / TEST_CODES / 2 + 0.5 );
+	}
+	HOST_CHECK( ADC_Supply_Data_Valid() );
+
+	// The full scale fits, up to the 19:1 divider the scaling claims
+	HOST_CHECK( 25300 == ADC_Supply_Get_Solar_MV() || 25300 == ADC_Supply_Get_Battery_MV() );
+	HOST_CHECK( 62700 == _ADC_Supply_Millivolts( TEST_CODES - 1, 3300 * 19 ) );
+	HOST_CHECK( 0 == _ADC_Supply_Millivolts( 0, 3300 * 19 ) );
+
+	printf( "codes: 0 to %u mV, worst %.2f mV from the input\n", last, worst );
+}
+
+void _Test_Temperature() {
+	double worst = 0;
+
+	batteryMV = 12000;
+	solarMV = 18000;
+	for ( int16_t tenths=-400; tenths <= 850; tenths++ ) {
+		chipC = tenths / 10.0;
+		_Test_Sequence();
+
+		// A code is 0.06 C, and the code is the one below
+		double error = ADC_Supply_Get_Chip_Temperature() - tenths;
+		if ( fabs( error ) > worst ) {
+			worst = fabs( error );
+		}
+		HOST_CHECK( fabs( error ) <= 1.2 );
+	}
+	printf( "temperature: -40.0 to 85.0 C, worst %.2f tenths off\n", worst );
+}
+
+void _Test_Missed() {
+	uint32_t sequences, missed, sequencesAfter, missedAfter;
+
+	ADC_Supply_Get_Stats( &sequences, &missed );
+	uint32_t interruptsBefore = interrupts;
+
+	// The tick comes round again before the results are in
+	ADC_Supply_Start_Sequence();
+	ADC_Supply_Start_Sequence();
+	_Test_Run_Sequencer();
+	_Test_Sequence();
+
+	ADC_Supply_Get_Stats( &sequencesAfter, &missedAfter );
+	HOST_CHECK( sequencesAfter == sequences + 2 );
+	HOST_CHECK( missedAfter == missed + 1 );
+	HOST_CHECK( interrupts == interruptsBefore + 2 );
+}
+
+/*
+ * The battery with a charge controller's PWM ripple on it and a
+ * few codes of noise, read each second at a random point in the
+ * ripple
+ */
+void _Test_Noise() {
+	double averagedSquares = 0, singleSquares = 0, averagedSum = 0;
+
+	batteryMV = TEST_BATTERY_MV;
+	rippleMV = 300;
+	rippleHz = 23437;
+	noiseCodes = 2;
+	for ( uint32_t i=0; i < TEST_NOISY_SEQUENCES; i++ ) {
+		ripplePhase = 2.0 * M_PI * rand() / RAND_MAX;
+		_Test_Sequence();
+
+		double averaged = ADC_Supply_Get_Battery_MV() - TEST_BATTERY_MV;
+		double single = singleBatteryMV - TEST_BATTERY_MV;
+		averagedSquares += averaged * averaged;
+		averagedSum += averaged;
+		singleSquares += single * single;
+	}
+
+	double averagedRMS = sqrt( averagedSquares / TEST_NOISY_SEQUENCES );
+	double singleRMS = sqrt( singleSquares / TEST_NOISY_SEQUENCES );
+	double mean = averagedSum / TEST_NOISY_SEQUENCES;
+	printf( "ripple %.0f mV at %.0f Hz, noise %.0f codes: single conversions %.1f mV rms, 64x averaged %.1f mV rms (mean %+.1f mV)\n",
+		rippleMV, rippleHz, noiseCodes, singleRMS, averagedRMS, mean );
+
+	HOST_CHECK( averagedRMS < singleRMS / 4 );
+	// A code at the divider top is 6.2 mV
+	HOST_CHECK( averagedRMS < 8.0 );
+	HOST_CHECK( fabs( mean ) < 6.2 );
+}
+
+int main() {
+	Host_Init();
+	srand( 50 );
+
+	Host_Set_Register_Hook( _Test_Register_Hook );
+	ADC_Supply_Init();
+
+	_Test_Setup();
+	_Test_Codes();
+	_Test_Temperature();
+	_Test_Missed();
+	_Test_Noise();
+
+	return Host_Report( "adc-supply-model" );
+}
@@ -0,0 +1,313 @@
+// Host runner for the AFSK demodulator
+//
+// With no arguments, feeds the demodulator synthetic audio and
+// checks how many frames come out: tones generated here (phase
+// continuous 1200 / 2200 Hz at AFSK_SAMPLE_RATE) clean, with
+// de-emphasis style twist, with the sender's baud rate off, and
+// buried in white noise, plus the station's own modulator looped
+// back. Every frame the callback gets must be one that was sent.
+//
+// With a file, decodes a recording instead - 16-bit PCM WAV, mono
+// or the left channel, at any rate (resampled to AFSK_SAMPLE_RATE)
+// - and prints the frame count, checked against an expected count
+// if one is given:
+//   build/afsk-runner track2.wav [expected]
+//
+// Also prints host time per second of audio.
+
+#include "host.h"
+#include "afsk.h"
+#include "ax25.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define TEST_FRAMES 200
+#define TEST_TONE_AMPLITUDE 800.0
+#define TEST_BLOCK_SAMPLES 256
+
+typedef struct Test_Channels {
+	const char *name;
+	double markGain;
+	double spaceGain;
+	double baudError;
+	double noise;
+	uint16_t minimumFrames;
+} Test_Channel;
+
+// Noise is the standard deviation relative to the tone amplitude
+static const Test_Channel testChannels[] = {
+	{ "clean", 1.0, 1.0, 0.0, 0.0, TEST_FRAMES },
+	{ "mark +6 dB", 1.0, 0.5, 0.0, 0.1, TEST_FRAMES * 98 / 100 },
+	{ "space +6 dB", 0.5, 1.0, 0.0, 0.1, TEST_FRAMES * 98 / 100 },
+	{ "baud +1%", 1.0, 1.0, 0.01, 0.0, TEST_FRAMES * 95 / 100 },
+	{ "baud -1%", 1.0, 1.0, -0.01, 0.0, TEST_FRAMES * 95 / 100 },
+	{ "noise 0.25", 1.0, 1.0, 0.0, 0.25, TEST_FRAMES * 97 / 100 },
+	{ "noise 0.3", 1.0, 1.0, 0.0, 0.3, TEST_FRAMES * 3 / 4 },
+};
+
+static uint8_t sentFrames[TEST_FRAMES][AX25_MAX_FRAME_LENGTH];
+static uint16_t sentLengths[TEST_FRAMES];
+static uint8_t sentMatched[TEST_FRAMES];
+static uint32_t framesMatched = 0;
+static uint32_t framesUnknown = 0;
+
+static uint16_t block[TEST_BLOCK_SAMPLES];
+static uint16_t blockLength = 0;
+static uint64_t demodulatorNanoseconds = 0;
+
+void _Test_Frame_Callback( uint8_t *frame, uint16_t length ) {
+	for ( int i=0; i < TEST_FRAMES; i++ ) {
+		if ( ( sentLengths[i] == length ) && ( 0 == memcmp( sentFrames[i], frame, length ) ) ) {
+			if ( ! sentMatched[i] ) {
+				sentMatched[i] = 1;
+				framesMatched++;
+			}
+			return;
+		}
+	}
+	framesUnknown++;
+}
+
+void _Test_Flush() {
+	uint64_t start = Host_Nanoseconds();
+	AFSK_Process_Samples( block, blockLength );
+	demodulatorNanoseconds += Host_Nanoseconds() - start;
+	blockLength = 0;
+}
+
+/*
+ * Queues one sample for the demodulator, in blocks as the DMA
+ * hands them over
+ */
+void _Test_Sample( double value ) {
+	int32_t code = (int32_t) lround( 2048.0 + value );
+	if ( code < 0 ) {
+		code = 0;
+	} else if ( code > 4095 ) {
+		code = 4095;
+	}
+	block[blockLength++] = code;
+	if ( TEST_BLOCK_SAMPLES == blockLength ) {
+		_Test_Flush();
+	}
+}
+
+double _Test_Gaussian() {
+	double u = ( rand() + 1.0 ) / ( RAND_MAX + 2.0 );
+	double v = ( rand() + 1.0 ) / ( RAND_MAX + 2.0 );
+	return sqrt( -2.0 * log( u ) ) * cos( 2.0 * M_PI * v );
+}
+
+/*
+ * Random UI frames between 20 and 200 bytes, some heavy in ones
+ */
+void _Test_Make_Frames() {
+	for ( int i=0; i < TEST_FRAMES; i++ ) {
+		sentLengths[i] = 20 + rand() % 181;
+		for ( int j=0; j < sentLengths[i]; j++ ) {
+			sentFrames[i][j] = ( i & 1 ) && ( rand() & 1 ) ? 0xFF : rand();
+		}
+	}
+}
+
+void _Test_Reset() {
+	AFSK_Init();
+	AFSK_Register_Frame_Callback( _Test_Frame_Callback );
+	memset( sentMatched, 0, sizeof( sentMatched ) );
+	framesMatched = 0;
+	framesUnknown = 0;
+	blockLength = 0;
+	demodulatorNanoseconds = 0;
+}
+
+/*
+ * Sends every frame through a channel: NRZI, tones, gains, noise,
+ * and half a second of silence around each
+ */
+void _Test_Channel( const Test_Channel *channel ) {
+	static uint8_t line[AX25_MAX_LINE_LENGTH];
+	double phase = 0.0;
+	double bitPosition = 0.0;
+	double samplesPerBit = (double) AFSK_SAMPLE_RATE / ( AFSK_BAUD * ( 1.0 + channel->baudError ) );
+	uint32_t samples = 0;
+
+	_Test_Reset();
+
+	for ( int i=0; i < TEST_FRAMES; i++ ) {
+		uint16_t bits = AX25_Encode_Line( sentFrames[i], sentLengths[i], 24, line, sizeof( line ) );
+		uint8_t space = 0;
+
+		for ( int s=0; s < AFSK_SAMPLE_RATE / 2; s++ ) {
+			_Test_Sample( channel->noise * TEST_TONE_AMPLITUDE * _Test_Gaussian() );
+			samples++;
+		}
+
+		for ( uint16_t bit=0; bit < bits; bit++ ) {
+			// NRZI - a zero switches tones
+			if ( 0 == ( ( line[bit >> 3] >> ( bit & 7 ) ) & 1 ) ) {
+				space = ! space;
+			}
+			double frequency = space ? 2200.0 : 1200.0;
+			double gain = space ? channel->spaceGain : channel->markGain;
+
+			bitPosition += samplesPerBit;
+			while ( bitPosition >= 1.0 ) {
+				bitPosition -= 1.0;
+				phase += 2.0 * M_PI * frequency / AFSK_SAMPLE_RATE;
+				_Test_Sample( TEST_TONE_AMPLITUDE * ( gain * sin( phase ) + channel->noise * _Test_Gaussian() ) );
+				samples++;
+			}
+		}
+	}
+	for ( int s=0; s < AFSK_SAMPLE_RATE / 2; s++ ) {
+		_Test_Sample( 0.0 );
+		samples++;
+	}
+	_Test_Flush();
+
+	uint32_t decoded, fcsErrors, processed;
+	AFSK_Get_Stats( &decoded, &fcsErrors, &processed );
+	printf( "%-12s %3u/%u frames, %u FCS errors, %.2f ms per audio second\n", channel->name,
+		framesMatched, TEST_FRAMES, fcsErrors, demodulatorNanoseconds / 1e6 / ( samples / (double) AFSK_SAMPLE_RATE ) );
+
+	HOST_CHECK( processed == samples );
+	HOST_CHECK( decoded == framesMatched + framesUnknown );
+	HOST_CHECK( 0 == framesUnknown );
+	HOST_CHECK( framesMatched >= channel->minimumFrames );
+}
+
+/*
+ * The station's own modulator, taking every fourth level of its
+ * 38400 Hz output as the demodulator's 9600 Hz input
+ */
+void _Test_Loopback() {
+	static uint8_t line[AX25_MAX_LINE_LENGTH];
+	uint8_t level;
+
+	_Test_Reset();
+
+	for ( int i=0; i < TEST_FRAMES; i++ ) {
+		uint16_t bits = AX25_Encode_Line( sentFrames[i], sentLengths[i], 24, line, sizeof( line ) );
+		AFSK_Start_Modulator( line, bits );
+		for ( uint32_t s=0; AFSK_Modulate( &level ); s++ ) {
+			if ( 0 == ( s % ( AFSK_TX_SAMPLE_RATE / AFSK_SAMPLE_RATE ) ) ) {
+				_Test_Sample( ( level - 128 ) * 8.0 );
+			}
+		}
+		for ( int s=0; s < AFSK_SAMPLES_PER_BIT * 16; s++ ) {
+			_Test_Sample( 0.0 );
+		}
+	}
+	_Test_Flush();
+
+	printf( "%-12s %3u/%u frames\n", "loopback", framesMatched, TEST_FRAMES );
+	HOST_CHECK( 0 == framesUnknown );
+	HOST_CHECK( TEST_FRAMES == framesMatched );
+}
+
+uint32_t _Test_Read_U32( const uint8_t *bytes ) {
+	return bytes[0] | ( bytes[1] << 8 ) | ( bytes[2] << 16 ) | ( (uint32_t) bytes[3] << 24 );
+}
+
+/*
+ * Decodes a WAV recording - returns the number of good frames,
+ * -1 if the file can't be used
+ */
+int _Test_Recording( const char *path ) {
+	FILE *file = fopen( path, "rb" );
+	if ( ! file ) {
+		perror( path );
+		return -1;
+	}
+
+	uint8_t header[12], chunk[8], format[16];
+	uint16_t channels = 0, sampleBits = 0;
+	uint32_t rate = 0, length = 0;
+
+	if ( ( 12 != fread( header, 1, 12, file ) ) || memcmp( header, "RIFF", 4 ) || memcmp( &header[8], "WAVE", 4 ) ) {
+		fprintf( stderr, "%s: not a WAV file\n", path );
+		fclose( file );
+		return -1;
+	}
+
+	// Find the format, then stop at the data
+	while ( 8 == fread( chunk, 1, 8, file ) ) {
+		length = _Test_Read_U32( &chunk[4] );
+		if ( 0 == memcmp( chunk, "fmt ", 4 ) ) {
+			if ( ( length < 16 ) || ( 16 != fread( format, 1, 16, file ) ) ) {
+				break;
+			}
+			channels = format[2] | ( format[3] << 8 );
+			rate = _Test_Read_U32( &format[4] );
+			sampleBits = format[14] | ( format[15] << 8 );
+			fseek( file, ( length - 16 ) + ( length & 1 ), SEEK_CUR );
+		} else if ( 0 == memcmp( chunk, "data", 4 ) ) {
+			break;
+		} else {
+			fseek( file, length + ( length & 1 ), SEEK_CUR );
+		}
+	}
+
+	if ( ( 16 != sampleBits ) || ( 0 == channels ) || ( 0 == rate ) ) {
+		fprintf( stderr, "%s: need 16-bit PCM\n", path );
+		fclose( file );
+		return -1;
+	}
+
+	_Test_Reset();
+
+	// Linear interpolation down (or up) to the demodulator's rate,
+	// 16-bit full scale to 12-bit
+	double step = (double) rate / AFSK_SAMPLE_RATE;
+	double position = 0.0;
+	double previous = 0.0, current = 0.0;
+	uint32_t index = 0, samples = 0;
+	int16_t frame[16];
+	while ( ( channels <= 16 ) && ( channels == fread( frame, sizeof( int16_t ), channels, file ) ) ) {
+		previous = current;
+		current = frame[0] / 16.0;
+		index++;
+		while ( position <= index - 1 ) {
+			double fraction = position - ( index - 2 );
+			_Test_Sample( ( index < 2 ) ? current : previous + ( current - previous ) * fraction );
+			samples++;
+			position += step;
+		}
+	}
+	fclose( file );
+	_Test_Flush();
+
+	uint32_t decoded, fcsErrors;
+	AFSK_Get_Stats( &decoded, &fcsErrors, 0 );
+	printf( "%s: %u frames, %u FCS errors, %.1f s of audio, %.2f ms per audio second\n", path, decoded,
+		fcsErrors, samples / (double) AFSK_SAMPLE_RATE,
+		demodulatorNanoseconds / 1e6 / ( samples / (double) AFSK_SAMPLE_RATE ) );
+
+	return decoded;
+}
+
+int main( int argc, char **argv ) {
+	Host_Init();
+
+	if ( argc > 1 ) {
+		int decoded = _Test_Recording( argv[1] );
+		HOST_CHECK( decoded >= 0 );
+		if ( argc > 2 ) {
+			HOST_CHECK( decoded >= atoi( argv[2] ) );
+		}
+		return Host_Report( "afsk-runner" );
+	}
+
+	srand( 29 );
+	_Test_Make_Frames();
+
+	for ( int i=0; i < sizeof( testChannels ) / sizeof( testChannels[0] ); i++ ) {
+		_Test_Channel( &testChannels[i] );
+	}
+	_Test_Loopback();
+
+	return Host_Report( "afsk-runner" );
+}
@@ -0,0 +1,469 @@
+// Host test for the APRS report templates
+//
+// Drives the three report builders with random GPS, weather and
+// supply readings and compares each info field with the same
+// report rendered from scratch by snprintf. Also checks the AX.25
+// header, the FCS against the CRC-16/X.25 check value, and that
+// the stuffed line unstuffs back to the frame and FCS. Decodes the
+// compressed report back to a position and telemetry, which must
+// land within the format's resolution. Prints what a report costs
+// patched in place against rendered by snprintf, and the airtime
+// of each mode.
+
+#include "host.h"
+#include "aprs.h"
+#include "ax25.h"
+#include "gps.h"
+#include "ds18b20.h"
+#include "history.h"
+#include "rda1846.h"
+#include "tdma.h"
+#include "wind-rain.h"
+#include "adc-supply.h"
+#include "format.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define TEST_RUNS 20000
+#define TEST_TIMING_RUNS 200000
+#define TEST_HEADER_LENGTH ( 3 * AX25_ADDRESS_LENGTH + 2 )
+
+// What the stubs hand the report builders
+static uint8_t gpsMonth, gpsDay, gpsHour, gpsMinute;
+static uint8_t latDeg, latMin, latHundredths, longDeg, longMin, longHundredths;
+static char latHem, longHem;
+static uint8_t historyValid;
+static int16_t historyMean;
+static uint8_t ds18b20Valid;
+static int16_t ds18b20F;
+static uint16_t windTenths, gustTenths;
+static uint16_t batteryMV, solarMV;
+
+static uint8_t *sentFrame;
+static uint16_t sentLength;
+
+uint8_t GPS_Data_Valid() { return 1; }
+uint32_t GPS_Get_Seconds() { return 0; }
+
+void GPS_Get_Date( uint16_t *year, uint8_t *month, uint8_t *day ) {
+	*year = 2024;
+	*month = gpsMonth;
+	*day = gpsDay;
+}
+
+void GPS_Get_Time( uint8_t *hour, uint8_t *minute, uint8_t *seconds ) {
+	*hour = gpsHour;
+	*minute = gpsMinute;
+	if ( seconds ) {
+		*seconds = 0;
+	}
+}
+
+void GPS_Get_Latitude( uint8_t *degrees, uint8_t *minutes, uint8_t *seconds, char *hemisphere ) {
+	*degrees = latDeg;
+	*minutes = latMin;
+	*hemisphere = latHem;
+}
+
+void GPS_Get_Longitude( uint8_t *degrees, uint8_t *minutes, uint8_t *seconds, char *hemisphere ) {
+	*degrees = longDeg;
+	*minutes = longMin;
+	*hemisphere = longHem;
+}
+
+void GPS_Get_Position_Hundredths( uint8_t *latH, uint8_t *longH ) {
+	*latH = latHundredths;
+	*longH = longHundredths;
+}
+
+uint8_t DS18B20_Data_Valid() { return ds18b20Valid; }
+int16_t DS18B20_Get_Temperature_F() { return ds18b20F; }
+
+uint8_t History_Get_Stats( uint8_t channel, uint8_t window, uint32_t seconds, History_Stats *stats ) {
+	if ( ! historyValid ) {
+		return 0;
+	}
+	stats->mean = historyMean;
+	return 1;
+}
+
+uint16_t Wind_Rain_Get_Speed( uint8_t seconds ) { return windTenths; }
+uint16_t Wind_Rain_Get_Gust( uint8_t minutes ) { return gustTenths; }
+uint16_t ADC_Supply_Get_Battery_MV() { return batteryMV; }
+uint16_t ADC_Supply_Get_Solar_MV() { return solarMV; }
+
+uint16_t RDA1846_Get_Airtime_Bits( uint8_t *frame, uint16_t length ) {
+	return AX25_Count_Stuffed_Bits( frame, length ) + 16;
+}
+
+uint8_t TDMA_Send_Packet( uint8_t *frame, uint16_t length ) {
+	sentFrame = frame;
+	sentLength = length;
+	return 1;
+}
+
+/*
+ * Random readings, including the edges the fields clamp at
+ */
+void _Test_Randomize() {
+	gpsMonth = 1 + rand() % 12;
+	gpsDay = 1 + rand() % 31;
+	gpsHour = rand() % 24;
+	gpsMinute = rand() % 60;
+	latDeg = rand() % 90;
+	latMin = rand() % 60;
+	latHundredths = rand() % 100;
+	longDeg = rand() % 180;
+	longMin = rand() % 60;
+	longHundredths = rand() % 100;
+	latHem = ( rand() & 1 ) ? 'N' : 'S';
+	longHem = ( rand() & 1 ) ? 'E' : 'W';
+	historyValid = rand() % 3;
+	historyMean = rand() % 1300 - 200;
+	ds18b20Valid = rand() & 1;
+	ds18b20F = rand() % 300 - 100;
+	windTenths = ( rand() % 8 ) ? rand() % 1500 : rand() % 12000;
+	gustTenths = ( rand() % 8 ) ? rand() % 2000 : rand() % 12000;
+	batteryMV = rand() % 20000;
+	solarMV = ( rand() % 8 ) ? rand() % 25000 : 65535;
+}
+
+void _Test_Base91( char *dest, uint32_t value, int width ) {
+	for ( int i=width - 1; i >= 0; i-- ) {
+		dest[i] = 33 + value % 91;
+		value = value / 91;
+	}
+	dest[width] = 0;
+}
+
+unsigned _Test_MPH( unsigned tenths ) {
+	unsigned mph = ( tenths + 5 ) / 10;
+	return ( mph > 999 ) ? 999 : mph;
+}
+
+/*
+ * The temperature the builders should pick, -9999 if none
+ */
+int _Test_Temperature() {
+	if ( historyValid ) {
+		return historyMean;
+	}
+	if ( ds18b20Valid ) {
+		return ds18b20F;
+	}
+	return -9999;
+}
+
+void _Test_Temperature_Field( char *dest, int degreesF ) {
+	if ( -9999 == degreesF ) {
+		strcpy( dest, "..." );
+		return;
+	}
+	if ( degreesF < -99 ) {
+		degreesF = -99;
+	} else if ( degreesF > 999 ) {
+		degreesF = 999;
+	}
+	snprintf( dest, 4, "%03d", degreesF );
+}
+
+int _Test_Positioned( char *report ) {
+	char temperature[4];
+	_Test_Temperature_Field( temperature, _Test_Temperature() );
+	return snprintf( report, 64, "@%02u%02u%02uz%02u%02u.%02u%c/%03u%02u.%02u%c_.../%03ug%03ut%s",
+		gpsDay, gpsHour, gpsMinute, latDeg, latMin, latHundredths, latHem,
+		longDeg, longMin, longHundredths, longHem,
+		_Test_MPH( windTenths ), _Test_MPH( gustTenths ), temperature );
+}
+
+int _Test_Positionless( char *report ) {
+	char temperature[4];
+	_Test_Temperature_Field( temperature, _Test_Temperature() );
+	return snprintf( report, 64, "_%02u%02u%02u%02uc...s%03ug%03ut%s",
+		gpsMonth, gpsDay, gpsHour, gpsMinute,
+		_Test_MPH( windTenths ), _Test_MPH( gustTenths ), temperature );
+}
+
+int _Test_Compressed( char *report, unsigned sequence ) {
+	char temperature[4], y[5], x[5], telemetry[9];
+	int degreesF = _Test_Temperature();
+	_Test_Temperature_Field( temperature, degreesF );
+
+	// APRS 1.01 ch. 9, in hundredths of a minute
+	uint64_t latitude = ( latDeg * 60 + latMin ) * 100 + latHundredths;
+	uint64_t longitude = ( longDeg * 60 + longMin ) * 100 + longHundredths;
+	uint64_t fromNorthPole = ( 'S' == latHem ) ? 540000 + latitude : 540000 - latitude;
+	uint64_t fromDateLine = ( 'W' == longHem ) ? 1080000 - longitude : 1080000 + longitude;
+	_Test_Base91( y, 380926 * fromNorthPole / 6000, 4 );
+	_Test_Base91( x, 190463 * fromDateLine / 6000, 4 );
+
+	unsigned channels[3];
+	channels[0] = ( -9999 == degreesF ) ? 0 : ( ( degreesF + 100 < 0 ) ? 0 : degreesF + 100 );
+	channels[1] = ( batteryMV + 5 ) / 10;
+	channels[2] = ( solarMV + 5 ) / 10;
+	_Test_Base91( &telemetry[0], sequence, 2 );
+	for ( int i=0; i < 3; i++ ) {
+		_Test_Base91( &telemetry[2 + 2 * i], ( channels[i] > 8280 ) ? 8280 : channels[i], 2 );
+	}
+
+	return snprintf( report, 64, "@%02u%02u%02uz/%s%s_  !g%03ut%s|%s|",
+		gpsDay, gpsHour, gpsMinute, y, x, _Test_MPH( gustTenths ), temperature, telemetry );
+}
+
+uint32_t _Test_Decode_Base91( const char *digits, int width ) {
+	uint32_t value = 0;
+	for ( int i=0; i < width; i++ ) {
+		value = value * 91 + ( digits[i] - 33 );
+	}
+	return value;
+}
+
+/*
+ * Reads the position and telemetry back out of a compressed report
+ * - the position must be within one step of the Base91 grid
+ * (1/380926 degree north, 1/190463 east) and the telemetry exact
+ */
+void _Test_Decode_Compressed( uint8_t *frame, uint16_t length ) {
+	const char *info = (const char *) &frame[TEST_HEADER_LENGTH];
+
+	double latitude = 90.0 - _Test_Decode_Base91( &info[9], 4 ) / 380926.0;
+	double longitude = -180.0 + _Test_Decode_Base91( &info[13], 4 ) / 190463.0;
+
+	double wantLatitude = latDeg + ( latMin + latHundredths / 100.0 ) / 60.0;
+	double wantLongitude = longDeg + ( longMin + longHundredths / 100.0 ) / 60.0;
+	if ( 'S' == latHem ) {
+		wantLatitude = -wantLatitude;
+	}
+	if ( 'W' == longHem ) {
+		wantLongitude = -wantLongitude;
+	}
+	HOST_CHECK( fabs( latitude - wantLatitude ) <= 1.0 / 380926.0 );
+	HOST_CHECK( fabs( longitude - wantLongitude ) <= 1.0 / 190463.0 );
+
+	// Channel 1 is the unclamped degrees F + 100, 0 if unknown
+	int degreesF = _Test_Temperature();
+	if ( -9999 != degreesF ) {
+		int wantChannel = ( degreesF + 100 < 0 ) ? 0 : degreesF + 100;
+		HOST_CHECK( wantChannel == (int) _Test_Decode_Base91( &info[32], 2 ) );
+	}
+
+	// EQNS 0,0.01,0 - within half a count below the 82.8 V top
+	int battery = _Test_Decode_Base91( &info[34], 2 ) * 10;
+	int solar = _Test_Decode_Base91( &info[36], 2 ) * 10;
+	HOST_CHECK( abs( battery - batteryMV ) <= 5 );
+	HOST_CHECK( ( solarMV > 82800 ) ? ( 82800 == solar ) : ( abs( solar - solarMV ) <= 5 ) );
+}
+
+/*
+ * Format_Base91's reciprocal divide against plain division over
+ * every four digit value and random wider ones
+ */
+void _Test_Format_Base91() {
+	char digits[6], want[6];
+	uint32_t mismatches = 0;
+
+	for ( uint32_t value=0; value < 91 * 91 * 91 * 91; value += 1 + ( value & 0x3 ) ) {
+		Format_Base91( digits, value, 4 );
+		_Test_Base91( want, value, 4 );
+		mismatches += memcmp( digits, want, 4 ) ? 1 : 0;
+	}
+	for ( int run=0; run < 1000000; run++ ) {
+		uint32_t value = ( (uint32_t) rand() ) & 0x7FFFFFFF;
+		Format_Base91( digits, value, 5 );
+		_Test_Base91( want, value, 5 );
+		mismatches += memcmp( digits, want, 5 ) ? 1 : 0;
+	}
+	HOST_CHECK( 0 == mismatches );
+}
+
+/*
+ * The info field matches the reference and the header is intact
+ */
+void _Test_Check_Report( uint8_t *frame, uint16_t length, const char *reference, int referenceLength ) {
+	static uint8_t header[AX25_MAX_HEADER_LENGTH];
+	uint16_t headerLength = AX25_Encode_Header( header, APRS_DESTINATION, APRS_CALLSIGN, APRS_PATH );
+
+	HOST_CHECK( TEST_HEADER_LENGTH == headerLength );
+	HOST_CHECK( headerLength + referenceLength == length );
+	HOST_CHECK( 0 == memcmp( frame, header, headerLength ) );
+	if ( memcmp( &frame[headerLength], reference, referenceLength ) ) {
+		HOST_CHECK( ! "info field matches" );
+		fprintf( stderr, "  got  %.*s\n  want %s\n", length - headerLength, &frame[headerLength], reference );
+	}
+}
+
+/*
+ * Unstuffs a line back into bytes between the opening and closing
+ * flags - returns the byte count, or -1 if it isn't a clean frame
+ */
+int _Test_Unstuff( uint8_t *line, uint16_t bits, uint8_t preambleFlags, uint8_t *out ) {
+	for ( int i=0; i <= preambleFlags; i++ ) {
+		if ( AX25_FLAG != line[i] ) {
+			return -1;
+		}
+	}
+
+	uint32_t bit = ( preambleFlags + 1 ) * 8;
+	uint32_t end = bits - 8;
+	int ones = 0, count = 0, filled = 0;
+	uint8_t byte = 0;
+
+	for ( uint32_t i=end; i < bits; i++ ) {
+		if ( ( ( line[i >> 3] >> ( i & 7 ) ) & 1 ) != ( ( AX25_FLAG >> ( i - end ) ) & 1 ) ) {
+			return -1;
+		}
+	}
+
+	for ( ; bit < end; bit++ ) {
+		int value = ( line[bit >> 3] >> ( bit & 7 ) ) & 1;
+		if ( 5 == ones ) {
+			// Must be the stuffed zero
+			if ( value ) {
+				return -1;
+			}
+			ones = 0;
+			continue;
+		}
+		ones = value ? ones + 1 : 0;
+		byte |= value << filled;
+		filled++;
+		if ( 8 == filled ) {
+			out[count++] = byte;
+			byte = 0;
+			filled = 0;
+		}
+	}
+
+	return filled ? -1 : count;
+}
+
+void _Test_FCS() {
+	// CRC-16/X.25 check value
+	uint8_t check[] = "123456789";
+	HOST_CHECK( 0x906E == AX25_Compute_FCS( check, 9 ) );
+
+	// Split across buffers
+	uint16_t crc = AX25_Update_CRC( 0xFFFF, check, 4 );
+	HOST_CHECK( 0x906E == ( AX25_Update_CRC( crc, &check[4], 5 ) ^ 0xFFFF ) );
+}
+
+void _Test_Line( uint8_t *frame, uint16_t length ) {
+	static uint8_t line[AX25_MAX_LINE_LENGTH];
+	static uint8_t unstuffed[AX25_MAX_FRAME_LENGTH + 2];
+	uint8_t preambleFlags = rand() % 8;
+
+	uint16_t bits = AX25_Encode_Line( frame, length, preambleFlags, line, sizeof( line ) );
+	HOST_CHECK( bits == ( preambleFlags + 2 ) * 8 + AX25_Count_Stuffed_Bits( frame, length ) );
+
+	int count = _Test_Unstuff( line, bits, preambleFlags, unstuffed );
+	HOST_CHECK( count == length + 2 );
+	HOST_CHECK( 0 == memcmp( unstuffed, frame, length ) );
+	uint16_t fcs = AX25_Compute_FCS( frame, length );
+	HOST_CHECK( ( ( fcs & 0xFF ) == unstuffed[length] ) && ( ( fcs >> 8 ) == unstuffed[length + 1] ) );
+
+	// Too small a buffer is refused rather than overrun
+	HOST_CHECK( 0 == AX25_Encode_Line( frame, length, preambleFlags, line, ( bits >> 3 ) - 1 ) );
+}
+
+/*
+ * Random bytes, heavy in 0xFF so stuffing is exercised
+ */
+void _Test_Random_Lines() {
+	static uint8_t frame[AX25_MAX_FRAME_LENGTH];
+	for ( int run=0; run < 2000; run++ ) {
+		uint16_t length = 1 + rand() % AX25_MAX_FRAME_LENGTH;
+		for ( uint16_t i=0; i < length; i++ ) {
+			frame[i] = ( rand() & 1 ) ? 0xFF : rand();
+		}
+		_Test_Line( frame, length );
+	}
+}
+
+void _Test_Timing() {
+	char report[64];
+	uint8_t *frame;
+	volatile uint32_t sink = 0;
+
+	_Test_Randomize();
+	uint64_t start = Host_Nanoseconds();
+	for ( int i=0; i < TEST_TIMING_RUNS; i++ ) {
+		// The minute moves on, the rest stays, as between reports
+		gpsMinute = i % 60;
+		sink += APRS_Build_Positioned_Report( &frame );
+	}
+	uint64_t patched = Host_Nanoseconds() - start;
+
+	start = Host_Nanoseconds();
+	for ( int i=0; i < TEST_TIMING_RUNS; i++ ) {
+		gpsMinute = i % 60;
+		sink += _Test_Positioned( report );
+	}
+	uint64_t rendered = Host_Nanoseconds() - start;
+
+	printf( "positioned report: %.1f ns patched, %.1f ns by snprintf\n",
+		(double) patched / TEST_TIMING_RUNS, (double) rendered / TEST_TIMING_RUNS );
+}
+
+/*
+ * Bytes on air and transmit time of a typical report in each mode
+ */
+void _Test_Airtime() {
+	uint16_t bytes[2], milliseconds[2];
+
+	_Test_Randomize();
+	for ( uint8_t compressed=0; compressed < 2; compressed++ ) {
+		APRS_Set_Compressed( compressed );
+		HOST_CHECK( APRS_Send_Weather_Report() );
+		APRS_Get_Airtime( compressed, &bytes[compressed], &milliseconds[compressed] );
+	}
+	HOST_CHECK( bytes[1] < bytes[0] );
+
+	printf( "airtime: %u bytes, %u ms uncompressed; %u bytes, %u ms compressed\n",
+		bytes[0], milliseconds[0], bytes[1], milliseconds[1] );
+}
+
+int main() {
+	char reference[64];
+	uint8_t *frame;
+	uint16_t length;
+
+	Host_Init();
+	srand( 26 );
+	APRS_Init();
+	_Test_FCS();
+
+	unsigned sequence = 0;
+	for ( int run=0; run < TEST_RUNS; run++ ) {
+		_Test_Randomize();
+
+		length = APRS_Build_Positioned_Report( &frame );
+		_Test_Check_Report( frame, length, reference, _Test_Positioned( reference ) );
+		_Test_Line( frame, length );
+
+		length = APRS_Build_Positionless_Report( &frame );
+		_Test_Check_Report( frame, length, reference, _Test_Positionless( reference ) );
+
+		// Compressed goes out through the send path, which moves the
+		// telemetry sequence on
+		APRS_Set_Compressed( 1 );
+		HOST_CHECK( APRS_Send_Weather_Report() );
+		_Test_Check_Report( sentFrame, sentLength, reference, _Test_Compressed( reference, sequence ) );
+		_Test_Decode_Compressed( sentFrame, sentLength );
+		sequence = ( sequence + 1 ) % 8281;
+
+		uint16_t bytes, milliseconds;
+		APRS_Get_Airtime( 1, &bytes, &milliseconds );
+		uint16_t bits = AX25_Count_Stuffed_Bits( sentFrame, sentLength ) + 16;
+		HOST_CHECK( ( bytes == ( bits + 7 ) / 8 ) && ( milliseconds == bits * 1000 / 1200 ) );
+	}
+
+	_Test_Format_Base91();
+	_Test_Random_Lines();
+	_Test_Timing();
+	_Test_Airtime();
+
+	return Host_Report( "aprs-report" );
+}
@@ -0,0 +1,411 @@
+// Host runner for the hot path benchmarks
+//
+// Builds bench.c with BENCH_ENABLED and runs Bench_Run as main()
+// does, after LCD_Init, against the stand-in registers with the
+// SSI always ready. The counter bench.c reads is one of:
+//
+// - the host's monotonic clock in nanoseconds. The Makefile builds
+//   this runner with BENCH_BATCH 64, so each sample times a batch of
+//   calls and divides, and Bench_Run goes TEST_RUNS times keeping
+//   each path's best minimum and mean, to see past the host's
+//   scheduling noise. Only worth comparing on one machine.
+// - with --instructions, the instructions the host executes. The
+//   runner forks and single-steps the child under ptrace between
+//   each pair of counter reads, so every count is exact and the same
+//   on every run of the same build - the numbers to gate on. The
+//   Makefile builds bench-instructions for this, one call a sample,
+//   as stepping is slow and an exact count needs no batch. Two runs
+//   are taken and have to agree.
+//
+// Prints the results per path and writes them as JSON in
+// tools/bench.py's layout, marked "platform": "host" with the
+// counter, the compiler and the batch - host numbers are never
+// comparable with a station's cycle counts. With --baseline compares
+// against an earlier host run from the same counter, compiler and
+// batch, and fails when a path grew past --tolerance percent: the
+// minimum and mean instructions, or the minimum nanoseconds by
+// TEST_SLACK as well, as the means on the clock swing by half from
+// run to run. A missing baseline is an error unless --save-baseline
+// is recording the first one.
+//
+// Usage:
+//   bench-runner [--instructions] [results.json]
+//   bench-instructions --instructions --baseline bench-baseline.json [--tolerance 5] results.json
+//   bench-instructions --instructions --baseline bench-baseline.json --save-baseline results.json
+
+#include "host.h"
+#include "bench.h"
+#include "clock.h"
+#include "lcd.h"
+#include "profile.h"
+
+#include <signal.h>
+#include <sys/ptrace.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TEST_RUNS 200
+#define TEST_INSTRUCTION_RUNS 2
+#define TEST_TOLERANCE 25.0
+// Paths that take a few ns on the host would fail on a percentage
+// alone, so a regression in ns has to be this many as well
+#define TEST_SLACK 20
+// A counter read, from the child to the tracer
+#define TEST_MARK_SIGNAL SIGUSR1
+#define TEST_MAX_JSON 16384
+
+// Mirrors the BENCH_ numbers in bench.h, as tools/telemetry-decode.py names them
+static const char *testNames[BENCHES] = {
+	"gps-process-line",
+	"gps-scratchpad-value",
+	"ds18b20-temperature",
+	"onewire-write-byte",
+	"onewire-read-byte",
+	"i2c-queue-command",
+	"lcd-write",
+	"lcd-format"
+};
+
+typedef struct Test_Bests {
+	uint16_t iterations;
+	uint32_t minimum;
+	uint32_t maximum;
+	double mean;
+} Test_Best;
+
+static Test_Best bests[BENCHES];
+static uint8_t instructions = 0;
+static const char *counterName = "nanoseconds";
+static uint16_t runs = TEST_RUNS;
+
+// Written by the tracer at every counter read
+static volatile uint64_t steppedInstructions = 0;
+
+void Telemetry_Send_Event( uint8_t event, uint32_t data ) {
+}
+
+uint32_t _Test_Nanoseconds() {
+	return (uint32_t) Host_Nanoseconds();
+}
+
+/*
+ * Stops for the tracer, which leaves the count here and starts or
+ * stops stepping
+ */
+uint32_t _Test_Instructions() {
+	raise( TEST_MARK_SIGNAL );
+	return (uint32_t) steppedInstructions;
+}
+
+/*
+ * Runs the child at full speed, and one instruction at a time from
+ * one counter read to the next. Bench.c reads in pairs - start, then
+ * end - so that's the timed regions and nothing else.
+ * Returns the child's exit status
+ */
+int _Test_Trace( pid_t child ) {
+	uint64_t count = 0;
+	uint8_t stepping = 0;
+	int status;
+
+	// Stopped itself once traced
+	if ( ( child != waitpid( child, &status, 0 ) ) || ! WIFSTOPPED( status ) ) {
+		return 2;
+	}
+	ptrace( PTRACE_CONT, child, 0, 0 );
+
+	while ( child == waitpid( child, &status, 0 ) ) {
+		if ( WIFEXITED( status ) ) {
+			return WEXITSTATUS( status );
+		}
+		if ( WIFSIGNALED( status ) ) {
+			fprintf( stderr, "bench child killed by signal %d\n", WTERMSIG( status ) );
+			return 2;
+		}
+
+		int signal = WSTOPSIG( status );
+		if ( TEST_MARK_SIGNAL == signal ) {
+			ptrace( PTRACE_POKEDATA, child, (void *) &steppedInstructions, (void *) count );
+			stepping = ! stepping;
+			signal = 0;
+		} else if ( ( SIGTRAP == signal ) && stepping ) {
+			count++;
+			signal = 0;
+		}
+		ptrace( stepping ? PTRACE_SINGLESTEP : PTRACE_CONT, child, 0, (void *) (long) signal );
+	}
+
+	perror( "waitpid" );
+	return 2;
+}
+
+/*
+ * Forks a child to run the benchmarks under this process's tracing
+ * Returns 1 in the child; the parent never returns, exiting with
+ * the child's status
+ */
+uint8_t _Test_Start_Tracing() {
+	fflush( stdout );
+	pid_t child = fork();
+	if ( child < 0 ) {
+		perror( "fork" );
+		exit( 2 );
+	}
+	if ( child ) {
+		exit( _Test_Trace( child ) );
+	}
+
+	if ( ptrace( PTRACE_TRACEME, 0, 0, 0 ) ) {
+		perror( "ptrace" );
+		exit( 2 );
+	}
+	raise( SIGSTOP );
+	return 1;
+}
+
+/*
+ * The SSI always has room and is never busy, so the LCD's bytes
+ * go straight out
+ */
+void _Test_Register_Hook( volatile uint32_t *reg ) {
+	if ( reg == &Host_SSI0_SR_R ) {
+		Host_SSI0_SR_R = 0x02;
+	}
+}
+
+void _Test_Run() {
+	for ( uint8_t bench=0; bench < BENCHES; bench++ ) {
+		bests[bench].minimum = 0xFFFFFFFF;
+		bests[bench].maximum = 0;
+		bests[bench].mean = 1e30;
+	}
+
+	for ( uint16_t run=0; run < runs; run++ ) {
+		Bench_Run();
+
+		for ( uint8_t bench=0; bench < BENCHES; bench++ ) {
+			Bench_Result result;
+			Test_Best *best = &bests[bench];
+
+			HOST_CHECK( Bench_Get_Result( bench, &result ) );
+			HOST_CHECK( BENCH_ITERATIONS == result.iterations );
+			HOST_CHECK( result.minimum <= result.maximum );
+
+			// Stepped counts don't move between runs
+			if ( instructions && run ) {
+				HOST_CHECK( result.minimum == best->minimum );
+				HOST_CHECK( result.maximum == best->maximum );
+				HOST_CHECK( (double) result.total / result.iterations == best->mean );
+			}
+
+			best->iterations = result.iterations;
+			if ( result.minimum < best->minimum ) {
+				best->minimum = result.minimum;
+			}
+			if ( result.maximum > best->maximum ) {
+				best->maximum = result.maximum;
+			}
+			if ( (double) result.total / result.iterations < best->mean ) {
+				best->mean = (double) result.total / result.iterations;
+			}
+		}
+	}
+	HOST_CHECK( ! Bench_Get_Result( BENCHES, 0 ) );
+}
+
+/*
+ * Writes the results in bench.py's layout
+ * Returns 0 if the file can't be written
+ */
+uint8_t _Test_Write_JSON( const char *path ) {
+	FILE *out = fopen( path, "w" );
+	if ( ! out ) {
+		return 0;
+	}
+
+	uint8_t nanoseconds = ! instructions;
+	fprintf( out, "{\n  \"platform\": \"host\",\n  \"counter\": \"%s\",\n  \"compiler\": \"%s\",\n  \"batch\": %u,\n"
+		"  \"runs\": %u,\n  \"hz\": %s,\n  \"benchmarks\": {\n",
+		counterName, __VERSION__, BENCH_BATCH, runs, nanoseconds ? "1000000000" : "null" );
+	for ( uint8_t bench=0; bench < BENCHES; bench++ ) {
+		Test_Best *best = &bests[bench];
+		fprintf( out, "    \"%s\": {\n      \"bench\": \"%s\",\n      \"index\": %u,\n      \"benches\": %u,\n      \"iterations\": %u,\n"
+			"      \"minCycles\": %u,\n      \"maxCycles\": %u,\n      \"meanCycles\": %.2f,\n      \"hz\": %s,\n",
+			testNames[bench], testNames[bench], bench, BENCHES, best->iterations, best->minimum, best->maximum, best->mean,
+			nanoseconds ? "1000000000" : "null" );
+		if ( nanoseconds ) {
+			fprintf( out, "      \"minNs\": %u,\n      \"meanNs\": %.2f\n", best->minimum, best->mean );
+		} else {
+			fprintf( out, "      \"minNs\": null,\n      \"meanNs\": null\n" );
+		}
+		fprintf( out, "    }%s\n", ( bench + 1 < BENCHES ) ? "," : "" );
+	}
+	fprintf( out, "  }\n}\n" );
+
+	return 0 == fclose( out );
+}
+
+/*
+ * The number after "field": in the object after "name": in json
+ * Returns 0 if it isn't there
+ */
+uint8_t _Test_JSON_Number( const char *json, const char *name, const char *field, double *value ) {
+	char key[64];
+
+	snprintf( key, sizeof( key ), "\"%s\": {", name );
+	const char *object = strstr( json, key );
+	if ( ! object ) {
+		return 0;
+	}
+	const char *end = strchr( object, '}' );
+
+	snprintf( key, sizeof( key ), "\"%s\":", field );
+	const char *found = strstr( object, key );
+	if ( ! found || ( end && found > end ) ) {
+		return 0;
+	}
+	return 1 == sscanf( found + strlen( key ), " %lf", value );
+}
+
+/*
+ * Compares against an earlier host run
+ * Returns the number of regressions, or -1 if the baseline
+ * can't be used
+ */
+int _Test_Compare( const char *path, double tolerance ) {
+	static char json[TEST_MAX_JSON];
+	char counter[64];
+	char compiler[128];
+	char batch[32];
+
+	FILE *in = fopen( path, "r" );
+	if ( ! in ) {
+		fprintf( stderr, "no baseline at %s (record one with --save-baseline)\n", path );
+		return -1;
+	}
+	size_t length = fread( json, 1, sizeof( json ) - 1, in );
+	fclose( in );
+	json[length] = 0;
+
+	if ( ! strstr( json, "\"platform\": \"host\"" ) ) {
+		fprintf( stderr, "%s isn't from a host run, its numbers don't compare with these\n", path );
+		return -1;
+	}
+	snprintf( counter, sizeof( counter ), "\"counter\": \"%s\"", counterName );
+	if ( ! strstr( json, counter ) ) {
+		fprintf( stderr, "%s counted something other than %s\n", path, counterName );
+		return -1;
+	}
+	snprintf( compiler, sizeof( compiler ), "\"compiler\": \"%s\"", __VERSION__ );
+	snprintf( batch, sizeof( batch ), "\"batch\": %u,", BENCH_BATCH );
+	if ( ! strstr( json, compiler ) || ! strstr( json, batch ) ) {
+		fprintf( stderr, "%s is from another compiler or batch than %s, %u calls a sample (record a new one with --save-baseline)\n",
+			path, __VERSION__, BENCH_BATCH );
+		return -1;
+	}
+
+	int regressions = 0;
+	for ( uint8_t bench=0; bench < BENCHES; bench++ ) {
+		double minimum, mean;
+		if ( ! _Test_JSON_Number( json, testNames[bench], "minCycles", &minimum ) ||
+			! _Test_JSON_Number( json, testNames[bench], "meanCycles", &mean ) ) {
+			printf( "%-22s %10u  (new)\n", testNames[bench], bests[bench].minimum );
+			continue;
+		}
+
+		double minChange = minimum ? 100.0 * ( bests[bench].minimum - minimum ) / minimum : 0;
+		double meanChange = mean ? 100.0 * ( bests[bench].mean - mean ) / mean : 0;
+		printf( "%-22s %10u  minCycles %+.1f%%  meanCycles %+.1f%%\n", testNames[bench], bests[bench].minimum, minChange, meanChange );
+		if ( instructions ) {
+			regressions += ( minChange > tolerance ) || ( meanChange > tolerance );
+		} else {
+			regressions += ( minChange > tolerance ) && ( bests[bench].minimum > minimum + TEST_SLACK );
+		}
+	}
+	return regressions;
+}
+
+int main( int argc, char **argv ) {
+	const char *output = 0;
+	const char *baseline = 0;
+	double tolerance = TEST_TOLERANCE;
+	uint8_t saveBaseline = 0;
+
+	for ( int i=1; i < argc; i++ ) {
+		if ( ! strcmp( argv[i], "--baseline" ) && ( i + 1 < argc ) ) {
+			baseline = argv[++i];
+		} else if ( ! strcmp( argv[i], "--tolerance" ) && ( i + 1 < argc ) ) {
+			tolerance = atof( argv[++i] );
+		} else if ( ! strcmp( argv[i], "--save-baseline" ) ) {
+			saveBaseline = 1;
+		} else if ( ! strcmp( argv[i], "--instructions" ) ) {
+			instructions = 1;
+		} else if ( ( '-' != argv[i][0] ) && ! output ) {
+			output = argv[i];
+		} else {
+			fprintf( stderr, "usage: %s [--instructions] [--baseline JSON [--tolerance PERCENT] [--save-baseline]] [results.json]\n", argv[0] );
+			return 2;
+		}
+	}
+
+	// A missing baseline would pass every run without comparing anything
+	if ( baseline && ! saveBaseline && ( 0 != access( baseline, R_OK ) ) ) {
+		fprintf( stderr, "no baseline at %s (record one with --save-baseline)\n", baseline );
+		return 2;
+	}
+
+	if ( instructions ) {
+		_Test_Start_Tracing();
+		counterName = "instructions";
+		runs = TEST_INSTRUCTION_RUNS;
+	}
+
+	Host_Init();
+	Host_Set_Register_Hook( _Test_Register_Hook );
+
+	// As main() has it
+	Clock_Init( CLOCK_80_MHZ );
+	Profile_Init();
+	LCD_Init();
+
+	// Only Bench_Run reads the counter from here, start and end in turn
+	Profile_Host_Set_Counter( _Test_Nanoseconds );
+	if ( instructions ) {
+		// The first run's LCD updates start from a blank screen and the
+		// rest from the last run's, so step the ones after
+		Bench_Run();
+		Profile_Host_Set_Counter( _Test_Instructions );
+	}
+	_Test_Run();
+
+	int regressions = 0;
+	if ( baseline && ! saveBaseline ) {
+		regressions = _Test_Compare( baseline, tolerance );
+		if ( regressions < 0 ) {
+			return 2;
+		}
+	} else {
+		for ( uint8_t bench=0; bench < BENCHES; bench++ ) {
+			printf( "%-22s %10u min %10.1f mean %10u max %s\n", testNames[bench],
+				bests[bench].minimum, bests[bench].mean, bests[bench].maximum, counterName );
+		}
+	}
+
+	if ( output && ! _Test_Write_JSON( output ) ) {
+		perror( output );
+		return 2;
+	}
+	if ( baseline && saveBaseline && ! _Test_Write_JSON( baseline ) ) {
+		perror( baseline );
+		return 2;
+	}
+	if ( regressions ) {
+		printf( "%d regressions past %.0f%%\n", regressions, tolerance );
+	}
+
+	int failed = Host_Report( "bench-runner" );
+	return failed ? failed : ( regressions ? 1 : 0 );
+}
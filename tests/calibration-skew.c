@@ -0,0 +1,206 @@
+// Host simulation of GPS calibration with an injected clock skew
+//
+// Runs calibration.c and clock.c against a simulated oscillator
+// off by a known ppm, with a GPS fix each second whose $GPRMC
+// arrives up to CALIBRATION_JITTER_MS either side of the second.
+// For each skew, prints how long the correction took to be
+// applied, the ppm it settled on and how often the drivers were
+// retuned. Checks it ends within the noise floor of the skew, and
+// that a missed fix, a time jump, a clock switch and the day
+// rollover don't throw it off. Then steps the skew, as a change
+// of temperature would, and checks the next baseline follows it.
+
+#include "host.h"
+#include "calibration.h"
+#include "clock.h"
+#include "profile.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define TEST_JITTER_MS 20
+#define TEST_TOLERANCE_PPM 10
+#define TEST_SECONDS_PER_DAY 86400
+// Starting at 23:00, so the baselines cross midnight
+#define TEST_START_SECOND ( 23 * 3600 )
+#define TEST_HOURS 3
+
+static const int32_t testSkews[] = { 0, 40, -75, 330, -1200, 25000 };
+
+static void (*secondCallback)();
+static uint32_t gpsSecond;
+
+static uint32_t trueHz;
+// Oscillator cycles since the start, in the true time base
+static uint64_t trueCycles;
+static uint64_t nowMS;
+static uint32_t retunes;
+
+void GPS_Register_Second_Callback( void (*callback)() ) {
+	secondCallback = callback;
+}
+
+void GPS_Get_Time( uint8_t *hour, uint8_t *minute, uint8_t *seconds ) {
+	uint32_t second = gpsSecond % TEST_SECONDS_PER_DAY;
+	*hour = second / 3600;
+	*minute = ( second / 60 ) % 60;
+	*seconds = second % 60;
+}
+
+void _Test_Clock_Changed( uint32_t hz ) {
+	retunes++;
+}
+
+void _Test_Set_Skew( int32_t ppm ) {
+	trueHz = (uint32_t) ( Clock_Get_Nominal_Hz() + (int64_t) Clock_Get_Nominal_Hz() * ppm / 1000000 );
+}
+
+/*
+ * Runs the oscillator on to a time in ms
+ */
+void _Test_Run_To( uint64_t ms ) {
+	uint64_t cycles = ms * trueHz / 1000;
+	if ( cycles > trueCycles ) {
+		Profile_Host_Advance( (uint32_t) ( cycles - trueCycles ) );
+		trueCycles = cycles;
+	}
+	nowMS = ms;
+}
+
+/*
+ * One second: its fix lands somewhere in the jitter either side
+ */
+void _Test_Second( uint8_t sentence ) {
+	gpsSecond++;
+	uint64_t secondMS = nowMS - nowMS % 1000 + 1000;
+	_Test_Run_To( secondMS + rand() % ( 2 * TEST_JITTER_MS + 1 ) );
+	if ( sentence ) {
+		secondCallback();
+	}
+	_Test_Run_To( secondMS + TEST_JITTER_MS * 2 );
+}
+
+/*
+ * Restarts the oscillator at a new rate in the same time base
+ */
+void _Test_Restart( int32_t ppm ) {
+	_Test_Set_Skew( ppm );
+	trueCycles = nowMS * trueHz / 1000;
+}
+
+int32_t _Test_Abs( int32_t value ) {
+	return value < 0 ? -value : value;
+}
+
+void _Test_Skew( int32_t skew ) {
+	Clock_Set_Correction_PPM( 0 );
+	Clock_Set_Hz( CLOCK_80_MHZ );
+	Calibration_Init();
+	_Test_Restart( skew );
+	gpsSecond = TEST_START_SECOND;
+	retunes = 0;
+
+	uint32_t validAfter = 0;
+	for ( uint32_t i=0; i < TEST_HOURS * 3600; i++ ) {
+		// A lost sentence now and then
+		_Test_Second( 0 != rand() % 50 );
+		if ( ! validAfter && Calibration_Valid() ) {
+			validAfter = i;
+		}
+	}
+
+	int32_t ppm = Calibration_Get_PPM();
+	double hzError = ( (double) Clock_Get_Hz() - trueHz ) * 1e6 / trueHz;
+	printf( "skew %+6d ppm: applied after %4.1f min, measured %+6d ppm, clock now %+5.1f ppm off, %u retunes\n",
+		skew, validAfter / 60.0, ppm, hzError, retunes );
+
+	HOST_CHECK( Calibration_Valid() );
+	HOST_CHECK( validAfter <= 75 * 60 );
+	HOST_CHECK( _Test_Abs( ppm - skew ) <= TEST_TOLERANCE_PPM );
+	HOST_CHECK( _Test_Abs( Clock_Get_Correction_PPM() - skew ) <= TEST_TOLERANCE_PPM * 2 );
+	// Once when the correction first goes in, rarely after
+	HOST_CHECK( retunes <= 1 + ( 0 != skew ) * 2 );
+}
+
+void _Test_Glitches() {
+	uint32_t windows, rejected, windowsBefore, rejectedBefore;
+	int32_t ppm = 150;
+
+	Clock_Set_Correction_PPM( 0 );
+	Clock_Set_Hz( CLOCK_80_MHZ );
+	Calibration_Init();
+	_Test_Restart( ppm );
+	gpsSecond = TEST_START_SECOND;
+	Calibration_Get_Stats( &windowsBefore, &rejectedBefore, 0 );
+
+	for ( uint32_t i=0; i < 2 * 3600; i++ ) {
+		_Test_Second( 1 );
+
+		// The receiver's time steps 5 s ahead, as after a reset
+		if ( 1800 == i ) {
+			gpsSecond += 5;
+		}
+		// Two minutes without a fix
+		if ( 3000 == i ) {
+			for ( uint8_t j=0; j < 120; j++ ) {
+				_Test_Second( 0 );
+			}
+		}
+	}
+
+	Calibration_Get_Stats( &windows, &rejected, 0 );
+	HOST_CHECK( 1 == rejected - rejectedBefore );
+	HOST_CHECK( windows - windowsBefore > 200 );
+	HOST_CHECK( Calibration_Valid() );
+	HOST_CHECK( _Test_Abs( Calibration_Get_PPM() - ppm ) <= TEST_TOLERANCE_PPM );
+
+	// A clock switch restarts the window in the new clock's cycles
+	Clock_Set_Hz( CLOCK_50_MHZ );
+	_Test_Restart( ppm );
+	for ( uint32_t i=0; i < 600; i++ ) {
+		_Test_Second( 1 );
+	}
+	Calibration_Get_Stats( &windowsBefore, &rejectedBefore, 0 );
+	HOST_CHECK( rejectedBefore == rejected );
+	HOST_CHECK( _Test_Abs( Calibration_Get_PPM() - ppm ) <= TEST_TOLERANCE_PPM );
+}
+
+void _Test_Drift() {
+	int32_t ppm = -60;
+
+	Clock_Set_Correction_PPM( 0 );
+	Clock_Set_Hz( CLOCK_80_MHZ );
+	Calibration_Init();
+	_Test_Restart( ppm );
+	gpsSecond = TEST_START_SECOND;
+
+	for ( uint32_t i=0; i < 12 * 3600; i++ ) {
+		_Test_Second( 1 );
+	}
+	HOST_CHECK( _Test_Abs( Calibration_Get_PPM() - ppm ) <= TEST_TOLERANCE_PPM );
+
+	// Warmer in the day: the baseline restarts daily and follows
+	ppm = -20;
+	_Test_Restart( ppm );
+	for ( uint32_t i=0; i < 14 * 3600; i++ ) {
+		_Test_Second( 1 );
+	}
+	printf( "drift -60 to %+d ppm: measured %+d ppm a day later\n", ppm, Calibration_Get_PPM() );
+	HOST_CHECK( _Test_Abs( Calibration_Get_PPM() - ppm ) <= TEST_TOLERANCE_PPM );
+}
+
+int main() {
+	Host_Init();
+	srand( 39 );
+
+	Clock_Init( CLOCK_80_MHZ );
+	Clock_Register_Change_Callback( _Test_Clock_Changed );
+
+	for ( uint8_t i=0; i < sizeof( testSkews ) / sizeof( testSkews[0] ); i++ ) {
+		_Test_Skew( testSkews[i] );
+	}
+	_Test_Glitches();
+	_Test_Drift();
+
+	return Host_Report( "calibration-skew" );
+}
@@ -0,0 +1,424 @@
+// Host replay runner for driver captures
+//
+// Builds the drivers with CAPTURE_ENABLED and CAPTURE_REPLAY. First
+// records a synthetic hour at a station through the capture ring,
+// as the drivers would in the field: the GPS's $GPRMC / $GPGGA
+// bytes a FIFO at a time, the DS18B20's bus samples on main.c's
+// thermometer schedule, and the BME280 and radio RSSI reads. Then
+// replays it: the GPS bytes go back through UART1_Handler, and the
+// station's half second tick queues the same OneWire and I2C work,
+// which onewire.c and pwm-i2c.c answer from the capture. One-shot
+// waits are skipped, the capture says what the bus did.
+//
+// Checks the GPS time and position, thermometer, BME280 and RSSI
+// readings the unmodified drivers and parsers come up with against
+// what was recorded, that recording during the replay gives the
+// same capture byte for byte, and that an altered or truncated
+// capture shows up as mismatches. Prints how much faster than real
+// time it ran.
+
+#include "host.h"
+#include "capture.h"
+#include "profile.h"
+#include "clock.h"
+#include "uart.h"
+#include "gps.h"
+#include "onewire.h"
+#include "ds18b20.h"
+#include "bme280.h"
+#include "pwm-i2c.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TEST_HZ CLOCK_80_MHZ
+#define TEST_SECONDS 3600
+#define TEST_TICK_CYCLES ( TEST_HZ / 2 )
+// 9600 baud, ten bits a byte
+#define TEST_BYTE_CYCLES ( TEST_HZ / 960 )
+#define TEST_FIFO 16
+#define TEST_CAPTURE_LENGTH ( 4 * 1024 * 1024 )
+
+#define TEST_RADIO_ADDRESS 0x71
+#define TEST_RSSI_R 0x1B
+#define TEST_BME280_ID_R 0xD0
+#define TEST_BME280_CALIBRATION_R 0x88
+#define TEST_BME280_HUMIDITY_CALIBRATION_R 0xE1
+#define TEST_BME280_DATA_R 0xF7
+
+// The datasheet's example calibration, and humidity's from a part
+static const uint8_t testCalibration[26] = {
+	0x70, 0x6B, 0x43, 0x67, 0x18, 0xFC,
+	0x7D, 0x8E, 0x43, 0xD6, 0xD0, 0x0B, 0x27, 0x0B, 0x8C, 0x00,
+	0xF9, 0xFF, 0x8C, 0x3C, 0xF8, 0xC6, 0x70, 0x17, 0x00, 0x4B
+};
+static const uint8_t testHumidityCalibration[7] = { 0x6A, 0x01, 0x00, 0x13, 0x29, 0x03, 0x1E };
+
+static uint8_t capture[TEST_CAPTURE_LENGTH];
+static uint32_t captureLength;
+static uint8_t recaptured[TEST_CAPTURE_LENGTH];
+static uint8_t altered[TEST_CAPTURE_LENGTH];
+static uint32_t recapturedLength;
+
+// The UART1 receive FIFO as UART1_Handler sees it
+static const uint8_t *fifo;
+static uint8_t fifoLength;
+static uint8_t fifoNext;
+
+static uint16_t lastRSSI;
+static uint32_t rssiReads;
+static uint32_t checks;
+
+void Telemetry_Send_Event( uint8_t event, uint32_t data ) {
+}
+
+/*
+ * What the station saw in second s
+ */
+uint16_t _Test_Sentences( uint32_t s, char *out ) {
+	char body[100];
+	uint8_t hour = 12 + s / 3600, minute = ( s / 60 ) % 60, second = s % 60;
+	uint16_t length = 0;
+
+	for ( uint8_t gga=0; gga < 2; gga++ ) {
+		if ( gga ) {
+			sprintf( body, "GPGGA,%02u%02u%02u.00,4736.%04u,N,12220.%04u,W,1,08,1.0,10.0,M,-17.0,M,,",
+				hour, minute, second, s % 6000, ( 2 * s ) % 6000 );
+		} else {
+			sprintf( body, "GPRMC,%02u%02u%02u.00,A,4736.%04u,N,12220.%04u,W,0.0,0.0,191026,,,A",
+				hour, minute, second, s % 6000, ( 2 * s ) % 6000 );
+		}
+		uint8_t checksum = 0;
+		for ( char *c=body; *c; c++ ) {
+			checksum ^= *c;
+		}
+		length += sprintf( out + length, "$%s*%02X\r\n", body, checksum );
+	}
+	return length;
+}
+
+int16_t _Test_Raw_Temperature( uint32_t tick ) {
+	// 1/16ths of a degree C, wandering through below freezing
+	return (int16_t) ( ( (int32_t) ( tick / 30 ) % 400 ) - 100 + 5 );
+}
+
+uint16_t _Test_RSSI( uint32_t tick ) {
+	return 0x0100 + ( tick * 37 ) % 0x0300;
+}
+
+void _Test_BME280_Raw( uint32_t tick, int32_t *adcT, int32_t *adcP, int32_t *adcH ) {
+	*adcT = 519888 + (int32_t) ( tick % 997 ) * 40 - 20000;
+	*adcP = 415148 + (int32_t) ( tick % 503 ) * 30 - 7000;
+	*adcH = 27000 + (int32_t) ( tick % 211 ) * 20;
+}
+
+/*
+ * The datasheet's floating point compensation, for comparison
+ */
+void _Test_BME280_Float( int32_t adcT, int32_t adcP, int32_t adcH, double *c, double *pa, double *rh ) {
+	const uint8_t *k = testCalibration;
+	const uint8_t *h = testHumidityCalibration;
+	double t1 = (uint16_t) ( k[0] | k[1] << 8 ), t2 = (int16_t) ( k[2] | k[3] << 8 ), t3 = (int16_t) ( k[4] | k[5] << 8 );
+	double p[10];
+	p[1] = (uint16_t) ( k[6] | k[7] << 8 );
+	for ( uint8_t i=2; i <= 9; i++ ) {
+		p[i] = (int16_t) ( k[6 + 2 * ( i - 1 )] | k[7 + 2 * ( i - 1 )] << 8 );
+	}
+	double h1 = k[25], h2 = (int16_t) ( h[0] | h[1] << 8 ), h3 = h[2];
+	double h4 = (int16_t) ( (int8_t) h[3] * 16 | ( h[4] & 0x0F ) ), h5 = (int16_t) ( (int8_t) h[5] * 16 | h[4] >> 4 ), h6 = (int8_t) h[6];
+
+	double var1 = ( adcT / 16384.0 - t1 / 1024.0 ) * t2;
+	double var2 = ( adcT / 131072.0 - t1 / 8192.0 ) * ( adcT / 131072.0 - t1 / 8192.0 ) * t3;
+	double fine = var1 + var2;
+	*c = fine / 5120.0;
+
+	var1 = fine / 2.0 - 64000.0;
+	var2 = var1 * var1 * p[6] / 32768.0 + var1 * p[5] * 2.0;
+	var2 = var2 / 4.0 + p[4] * 65536.0;
+	var1 = ( p[3] * var1 * var1 / 524288.0 + p[2] * var1 ) / 524288.0;
+	var1 = ( 1.0 + var1 / 32768.0 ) * p[1];
+	double pressure = 1048576.0 - adcP;
+	pressure = ( pressure - var2 / 4096.0 ) * 6250.0 / var1;
+	var1 = p[9] * pressure * pressure / 2147483648.0;
+	var2 = pressure * p[8] / 32768.0;
+	*pa = pressure + ( var1 + var2 + p[7] ) / 16.0;
+
+	double x = fine - 76800.0;
+	x = ( adcH - ( h4 * 64.0 + h5 / 16384.0 * x ) ) * ( h2 / 65536.0 * ( 1.0 + h6 / 67108864.0 * x * ( 1.0 + h3 / 67108864.0 * x ) ) );
+	x = x * ( 1.0 - h1 * x / 524288.0 );
+	*rh = ( x < 0 ) ? 0 : ( x > 100 ) ? 100 : x;
+}
+
+void _Test_Set_Cycles( uint32_t cycles ) {
+	Profile_Host_Advance( cycles - Profile_Get_Cycles() );
+}
+
+/*
+ * Moves what the ring holds out to a capture buffer, as
+ * telemetry would stream it
+ */
+void _Test_Drain( uint8_t *buffer, uint32_t *length ) {
+	uint32_t offset;
+	uint16_t copied;
+
+	do {
+		copied = Capture_Read( buffer + *length, 256, &offset );
+		*length += copied;
+	} while ( copied );
+}
+
+void _Test_Record_Scratchpad( int16_t raw ) {
+	uint8_t scratchpad[9] = { raw & 0xFF, ( raw >> 8 ) & 0xFF, 0x4B, 0x46, 0x7F, 0xFF, 0x0C, 0x10, 0x1C };
+
+	// Presence, then each byte LSB first
+	Capture_OneWire( 0 );
+	for ( uint8_t i=0; i < 9; i++ ) {
+		for ( uint8_t bit=0; bit < 8; bit++ ) {
+			Capture_OneWire( ( scratchpad[i] >> bit ) & 0x01 );
+		}
+	}
+}
+
+/*
+ * Records the hour, as the station's drivers would have
+ */
+void _Test_Record() {
+	char sentences[200];
+	uint8_t bytes[8];
+
+	captureLength = 0;
+	_Test_Set_Cycles( 0x12345678 );
+	Capture_Start();
+
+	// BME280_Init's reads
+	uint8_t id = 0x60;
+	Capture_I2C( BME280_I2C_ADDRESS, TEST_BME280_ID_R, &id, 1 );
+	Capture_I2C( BME280_I2C_ADDRESS, TEST_BME280_CALIBRATION_R, testCalibration, sizeof( testCalibration ) );
+	Capture_I2C( BME280_I2C_ADDRESS, TEST_BME280_HUMIDITY_CALIBRATION_R, testHumidityCalibration, sizeof( testHumidityCalibration ) );
+
+	uint32_t tickAt = Profile_Get_Cycles();
+	for ( uint32_t tick=0; tick < TEST_SECONDS * 2; tick++ ) {
+		_Test_Set_Cycles( tickAt );
+		uint8_t count = tick % 30;
+
+		bytes[0] = _Test_RSSI( tick ) >> 8;
+		bytes[1] = _Test_RSSI( tick ) & 0xFF;
+		Capture_I2C( TEST_RADIO_ADDRESS, TEST_RSSI_R, bytes, 2 );
+
+		if ( 6 == count ) {
+			Capture_OneWire( 0 );
+		}
+		if ( 12 == count ) {
+			_Test_Record_Scratchpad( _Test_Raw_Temperature( tick ) );
+		}
+		if ( 9 == count % 10 ) {
+			int32_t adcT, adcP, adcH;
+			_Test_BME280_Raw( tick, &adcT, &adcP, &adcH );
+			uint8_t data[8] = { adcP >> 12, adcP >> 4, adcP << 4, adcT >> 12, adcT >> 4, adcT << 4, adcH >> 8, adcH };
+			Capture_I2C( BME280_I2C_ADDRESS, TEST_BME280_DATA_R, data, sizeof( data ) );
+		}
+
+		// The GPS talks 100 ms into each second, a FIFO at a time
+		if ( tick & 0x01 ) {
+			uint16_t length = _Test_Sentences( tick / 2, sentences );
+			_Test_Set_Cycles( tickAt + TEST_HZ / 10 );
+			for ( uint16_t i=0; i < length; i += TEST_FIFO ) {
+				uint8_t batch = ( length - i < TEST_FIFO ) ? length - i : TEST_FIFO;
+				Profile_Host_Advance( batch * TEST_BYTE_CYCLES );
+				Capture_UART( (uint8_t *) sentences + i, batch );
+			}
+		}
+
+		_Test_Drain( capture, &captureLength );
+		tickAt += TEST_TICK_CYCLES;
+	}
+	Capture_Stop();
+
+	uint32_t dropped;
+	Capture_Get_Stats( 0, &dropped );
+	HOST_CHECK( 0 == dropped );
+}
+
+void _Test_Hook( volatile uint32_t *reg ) {
+	if ( reg == &Host_UART1_FR_R ) {
+		Host_UART1_FR_R = ( fifoNext < fifoLength ) ? 0 : UART_FR_RXFE;
+	} else if ( reg == &Host_UART1_DR_R ) {
+		Host_UART1_DR_R = ( fifoNext < fifoLength ) ? fifo[fifoNext++] : 0;
+	}
+}
+
+void _Test_RSSI_Callback( uint16_t data ) {
+	lastRSSI = data;
+	rssiReads++;
+}
+
+void _Test_Check_GPS( uint32_t s ) {
+	uint8_t hour, minute, second, latHundredths, longHundredths;
+
+	GPS_Get_Time( &hour, &minute, &second );
+	GPS_Get_Position_Hundredths( &latHundredths, &longHundredths );
+	HOST_CHECK( GPS_Data_Valid() );
+	HOST_CHECK( 12 + s / 3600 == hour );
+	HOST_CHECK( ( s / 60 ) % 60 == minute );
+	HOST_CHECK( s % 60 == second );
+	HOST_CHECK( ( s % 6000 ) / 100 == latHundredths );
+	HOST_CHECK( ( ( 2 * s ) % 6000 ) / 100 == longHundredths );
+	checks++;
+}
+
+/*
+ * main.c's half second tick, as far as these drivers go
+ */
+void _Test_Tick( uint32_t tick, uint8_t check ) {
+	uint8_t count = tick % 30;
+
+	PWM_I2C_Queue_Read( TEST_RSSI_R, _Test_RSSI_Callback, 0 );
+	if ( check ) {
+		HOST_CHECK( _Test_RSSI( tick ) == lastRSSI );
+	}
+
+	if ( 6 == count ) {
+		DS18B20_Initiate_Measurement();
+	}
+	if ( 12 == count ) {
+		DS18B20_Read_Scratchpad();
+	}
+	if ( 8 == count % 10 ) {
+		BME280_Initiate_Measurement();
+	} else if ( 9 == count % 10 ) {
+		BME280_Read_Measurement();
+	}
+
+	// The one-shots, back to back
+	while ( Host_SYSCTL_RCGCTIMER_R & 0x01 ) {
+		OneWire_Timer0A_Handler();
+	}
+
+	// Last second's sentences are all in by now
+	if ( check && tick && ! ( tick & 0x01 ) ) {
+		_Test_Check_GPS( tick / 2 - 1 );
+	}
+	if ( check && ( 12 == count ) ) {
+		int16_t raw = _Test_Raw_Temperature( tick );
+		HOST_CHECK( DS18B20_Data_Valid() );
+		HOST_CHECK( ( raw / 16 ) * 9 / 5 + 32 == DS18B20_Get_Temperature_F() );
+		checks++;
+	}
+	if ( check && ( 9 == count % 10 ) ) {
+		int32_t adcT, adcP, adcH;
+		double c, pa, rh;
+		_Test_BME280_Raw( tick, &adcT, &adcP, &adcH );
+		_Test_BME280_Float( adcT, adcP, adcH, &c, &pa, &rh );
+		HOST_CHECK( BME280_Data_Valid() );
+		HOST_CHECK( fabs( BME280_Get_Temperature_F() - ( c * 9 / 5 + 32 ) ) <= 0.51 );
+		HOST_CHECK( fabs( BME280_Get_Pressure() - pa / 10 ) <= 1 );
+		HOST_CHECK( fabs( BME280_Get_Humidity() - rh ) <= 1 );
+		checks++;
+	}
+}
+
+/*
+ * Replays a capture through the drivers - returns the station
+ * seconds covered
+ */
+double _Test_Replay( const uint8_t *replay, uint32_t length, uint8_t check ) {
+	Capture_Event event;
+	uint64_t stationCycles = 0;
+	uint8_t started = 0;
+	uint32_t tick = 0, tickAt = 0, last = 0;
+
+	Capture_Replay_Load( replay, length );
+	rssiReads = 0;
+	recapturedLength = 0;
+
+	while ( Capture_Replay_Next( &event ) ) {
+		if ( ! started ) {
+			// The first records are from the drivers' init
+			_Test_Set_Cycles( event.cycles );
+			Capture_Start();
+			PWM_I2C_Init( TEST_RADIO_ADDRESS );
+			GPS_Init();
+			DS18B20_Init();
+			BME280_Init();
+			started = 1;
+			tickAt = last = event.cycles;
+		}
+		stationCycles += event.cycles - last;
+		last = event.cycles;
+
+		// Ticks that came due before this record
+		while ( (int32_t) ( event.cycles - tickAt ) >= 0 ) {
+			_Test_Set_Cycles( tickAt );
+			_Test_Tick( tick, check );
+			_Test_Drain( recaptured, &recapturedLength );
+			tick++;
+			tickAt += TEST_TICK_CYCLES;
+		}
+
+		// The drivers fetch their own OneWire and I2C records
+		if ( CAPTURE_UART == event.source ) {
+			_Test_Set_Cycles( event.cycles );
+			fifo = event.data;
+			fifoLength = event.length;
+			fifoNext = 0;
+			Host_UART1_RIS_R = UART_RIS_RXRIS;
+			UART1_Handler();
+			HOST_CHECK( fifoNext == fifoLength );
+		}
+	}
+	_Test_Drain( recaptured, &recapturedLength );
+	Capture_Stop();
+
+	return stationCycles / (double) TEST_HZ;
+}
+
+int main() {
+	Host_Init();
+
+	Clock_Init( TEST_HZ );
+	Host_Set_Register_Hook( _Test_Hook );
+
+	_Test_Record();
+	printf( "recorded %u s: %u bytes of capture\n", TEST_SECONDS, captureLength );
+
+	uint64_t start = Host_Nanoseconds();
+	double seconds = _Test_Replay( capture, captureLength, 1 );
+	double wall = ( Host_Nanoseconds() - start ) / 1e9;
+	printf( "replayed %.0f s of station time in %.3f s, %.0fx real time; %u readings checked\n",
+		seconds, wall, seconds / wall, checks );
+
+	HOST_CHECK( 0 == Capture_Replay_Get_Mismatches() );
+	HOST_CHECK( checks > TEST_SECONDS );
+	HOST_CHECK( TEST_SECONDS * 2 == rssiReads );
+	HOST_CHECK( seconds / wall > 1000 );
+
+	// The drivers recorded exactly what they were fed
+	HOST_CHECK( recapturedLength == captureLength );
+	HOST_CHECK( 0 == memcmp( recaptured, capture, captureLength ) );
+
+	// An RSSI read half way through recorded from another register,
+	// as if the station had done something else
+	memcpy( altered, capture, captureLength );
+	uint32_t position = 0, rssiRecords = 0;
+	while ( 1 ) {
+		uint8_t *reg = &altered[position + CAPTURE_HEADER_LENGTH + 1];
+		if ( ( CAPTURE_I2C == altered[position] ) && ( TEST_RSSI_R == *reg ) && ( TEST_SECONDS == ++rssiRecords ) ) {
+			*reg = TEST_RSSI_R + 1;
+			break;
+		}
+		position += CAPTURE_HEADER_LENGTH + altered[position + 1];
+	}
+	_Test_Replay( altered, captureLength, 0 );
+	printf( "altered capture: %u mismatches\n", Capture_Replay_Get_Mismatches() );
+	HOST_CHECK( 1 == Capture_Replay_Get_Mismatches() );
+
+	// Cut off mid-record: the drivers ask for more than is there
+	_Test_Replay( capture, captureLength / 2 + 3, 0 );
+	_Test_Tick( 0, 0 );
+	printf( "truncated capture: %u mismatches\n", Capture_Replay_Get_Mismatches() );
+	HOST_CHECK( Capture_Replay_Get_Mismatches() > 0 );
+
+	return Host_Report( "capture-replay" );
+}
@@ -0,0 +1,269 @@
+// Simulated shared radio channel for the multi-station tests
+
+#include "channel.h"
+#include "host.h"
+#include "ax25.h"
+#include "csma.h"
+#include "rda1846.h"
+#include "clock.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CHANNEL_BAUD 1200
+
+typedef struct Channel_Transmissions {
+	uint8_t station;
+	uint8_t collided;
+	uint32_t startMS;
+	uint32_t endMS;
+} Channel_Transmission;
+
+// Put there by objcopy, see the Makefile
+extern uint8_t __start_station_bss[], __stop_station_bss[];
+extern uint8_t __start_station_data[], __stop_station_data[];
+
+static uint8_t stationCount = 0;
+static uint8_t current = 0;
+static uint32_t nowMS = 0;
+
+// Each station's copy of the firmware statics and SysTick
+static uint8_t *savedBss;
+static uint8_t *savedData;
+static uint32_t savedSysTick[CHANNEL_MAX_STATIONS][3];
+
+// The radio, per station
+static void (*txCallback[CHANNEL_MAX_STATIONS])();
+static uint32_t txEndMS[CHANNEL_MAX_STATIONS];
+static void (*clearCallback[CHANNEL_MAX_STATIONS])();
+
+static Channel_Transmission *transmissions;
+static uint32_t transmissionCount = 0;
+static uint32_t transmissionSpace = 0;
+// Every transmission before this one is off the air
+static uint32_t firstActive = 0;
+
+static size_t _Channel_Bss_Size() {
+	return __stop_station_bss - __start_station_bss;
+}
+
+static size_t _Channel_Data_Size() {
+	return __stop_station_data - __start_station_data;
+}
+
+void Channel_Init( uint8_t stations ) {
+	if ( stations > CHANNEL_MAX_STATIONS ) {
+		stations = CHANNEL_MAX_STATIONS;
+	}
+
+	// Every station starts from the image the program loaded with
+	static uint8_t *initialBss = 0;
+	static uint8_t *initialData = 0;
+	if ( ! initialBss ) {
+		initialBss = malloc( _Channel_Bss_Size() + 1 );
+		initialData = malloc( _Channel_Data_Size() + 1 );
+		memcpy( initialBss, __start_station_bss, _Channel_Bss_Size() );
+		memcpy( initialData, __start_station_data, _Channel_Data_Size() );
+	}
+
+	Channel_Free();
+	stationCount = stations;
+	savedBss = malloc( stations * _Channel_Bss_Size() + 1 );
+	savedData = malloc( stations * _Channel_Data_Size() + 1 );
+	for ( uint8_t i=0; i < stations; i++ ) {
+		memcpy( &savedBss[i * _Channel_Bss_Size()], initialBss, _Channel_Bss_Size() );
+		memcpy( &savedData[i * _Channel_Data_Size()], initialData, _Channel_Data_Size() );
+		savedSysTick[i][0] = 0;
+		savedSysTick[i][1] = 0;
+		savedSysTick[i][2] = 0;
+		txCallback[i] = 0;
+		clearCallback[i] = 0;
+	}
+
+	memcpy( __start_station_bss, initialBss, _Channel_Bss_Size() );
+	memcpy( __start_station_data, initialData, _Channel_Data_Size() );
+	Host_NVIC_ST_CTRL_R = 0;
+	current = 0;
+	nowMS = 0;
+
+	transmissionSpace = 1024;
+	transmissions = malloc( transmissionSpace * sizeof( Channel_Transmission ) );
+	transmissionCount = 0;
+	firstActive = 0;
+}
+
+void Channel_Free() {
+	free( savedBss );
+	free( savedData );
+	free( transmissions );
+	savedBss = 0;
+	savedData = 0;
+	transmissions = 0;
+}
+
+/*
+ * Swaps the firmware statics and SysTick over to station
+ */
+void Channel_Select( uint8_t station ) {
+	if ( station == current ) {
+		return;
+	}
+
+	memcpy( &savedBss[current * _Channel_Bss_Size()], __start_station_bss, _Channel_Bss_Size() );
+	memcpy( &savedData[current * _Channel_Data_Size()], __start_station_data, _Channel_Data_Size() );
+	savedSysTick[current][0] = Host_NVIC_ST_CTRL_R;
+	savedSysTick[current][1] = Host_NVIC_ST_RELOAD_R;
+	savedSysTick[current][2] = Host_NVIC_ST_CURRENT_R;
+
+	memcpy( __start_station_bss, &savedBss[station * _Channel_Bss_Size()], _Channel_Bss_Size() );
+	memcpy( __start_station_data, &savedData[station * _Channel_Data_Size()], _Channel_Data_Size() );
+	Host_NVIC_ST_CTRL_R = savedSysTick[station][0];
+	Host_NVIC_ST_RELOAD_R = savedSysTick[station][1];
+	Host_NVIC_ST_CURRENT_R = savedSysTick[station][2];
+
+	current = station;
+}
+
+uint32_t Channel_Now() {
+	return nowMS;
+}
+
+/*
+ * Whether station hears another station's carrier
+ */
+uint8_t _Channel_Busy( uint8_t station ) {
+	while ( ( firstActive < transmissionCount ) && ( transmissions[firstActive].endMS + CHANNEL_SENSE_MS <= nowMS ) ) {
+		firstActive++;
+	}
+
+	for ( uint32_t i=firstActive; i < transmissionCount; i++ ) {
+		Channel_Transmission *other = &transmissions[i];
+		if ( ( other->station != station ) && ( other->startMS + CHANNEL_SENSE_MS <= nowMS ) &&
+			( nowMS < other->endMS + CHANNEL_SENSE_MS ) ) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+uint8_t _Channel_Ticking( uint8_t station ) {
+	uint32_t control = ( station == current ) ? Host_NVIC_ST_CTRL_R : savedSysTick[station][0];
+	return ( control & 0x01 ) ? 1 : 0;
+}
+
+/*
+ * Moves time on one tick: finished transmissions call back, waits
+ * for a clear channel end, and stations with SysTick running get
+ * their slot clock interrupt. Idle stations aren't swapped in.
+ */
+void Channel_Tick() {
+	nowMS += CHANNEL_TICK_MS;
+
+	for ( uint8_t station=0; station < stationCount; station++ ) {
+		if ( txCallback[station] && ( nowMS >= txEndMS[station] ) ) {
+			Channel_Select( station );
+			void (*callback)() = txCallback[station];
+			txCallback[station] = 0;
+			callback();
+		}
+
+		if ( clearCallback[station] && ! _Channel_Busy( station ) ) {
+			Channel_Select( station );
+			void (*callback)() = clearCallback[station];
+			clearCallback[station] = 0;
+			callback();
+		}
+
+		if ( _Channel_Ticking( station ) ) {
+			Channel_Select( station );
+			CSMA_SysTick_Handler();
+		}
+	}
+}
+
+/*
+ * Transmit time of a frame (without FCS) with the preamble flags
+ */
+uint16_t Channel_Airtime_MS( uint8_t *frame, uint16_t length ) {
+	return ( (uint32_t) RDA1846_Get_Airtime_Bits( frame, length ) * 1000 ) / CHANNEL_BAUD + 1;
+}
+
+void Channel_Get_Stats( Channel_Stat *stats ) {
+	memset( stats, 0, sizeof( Channel_Stat ) );
+	for ( uint32_t i=0; i < transmissionCount; i++ ) {
+		stats->transmissions++;
+		if ( transmissions[i].collided ) {
+			stats->collided++;
+		} else {
+			stats->successMS += transmissions[i].endMS - transmissions[i].startMS;
+		}
+	}
+}
+
+// The radio, as seen by the station selected
+
+uint8_t RDA1846_Channel_Busy() {
+	return _Channel_Busy( current );
+}
+
+/*
+ * Noise floor with a little jitter, or a strong signal
+ */
+int16_t RDA1846_Get_RSSI() {
+	return _Channel_Busy( current ) ? -70 - ( rand() & 0x7 ) : -125 + ( rand() & 0x7 );
+}
+
+void RDA1846_Wait_For_Channel( void (*callback)() ) {
+	clearCallback[current] = callback;
+}
+
+void RDA1846_Watch_Channel( uint8_t on ) {
+}
+
+uint16_t RDA1846_Get_Airtime_Bits( uint8_t *frame, uint16_t length ) {
+	return CHANNEL_PREAMBLE_FLAGS * 8 + AX25_Count_Stuffed_Bits( frame, length ) + 16;
+}
+
+uint8_t RDA1846_Send_Packet( uint8_t source, uint8_t *frame, uint16_t length ) {
+	return CSMA_Queue_Frame( source, frame, length );
+}
+
+/*
+ * Keys up: the carrier is on from CHANNEL_KEYING_MS for the
+ * frame's airtime, and any other carrier it overlaps loses both
+ */
+uint16_t RDA1846_Transmit( uint8_t *frame, uint16_t length, void (*callback)() ) {
+	if ( transmissionCount == transmissionSpace ) {
+		transmissionSpace *= 2;
+		transmissions = realloc( transmissions, transmissionSpace * sizeof( Channel_Transmission ) );
+	}
+
+	Channel_Transmission *transmission = &transmissions[transmissionCount];
+	transmission->station = current;
+	transmission->collided = 0;
+	transmission->startMS = nowMS + CHANNEL_KEYING_MS;
+	transmission->endMS = transmission->startMS + Channel_Airtime_MS( frame, length );
+
+	for ( uint32_t i=firstActive; i < transmissionCount; i++ ) {
+		Channel_Transmission *other = &transmissions[i];
+		if ( ( other->startMS < transmission->endMS ) && ( transmission->startMS < other->endMS ) ) {
+			other->collided = 1;
+			transmission->collided = 1;
+		}
+	}
+	transmissionCount++;
+
+	txCallback[current] = callback;
+	txEndMS[current] = transmission->endMS;
+
+	return RDA1846_Get_Airtime_Bits( frame, length );
+}
+
+uint32_t Clock_Milliseconds_To_Ticks( uint32_t milliseconds ) {
+	return milliseconds * 80000;
+}
+
+uint8_t Clock_Register_Change_Callback( void (*callback)( uint32_t hz ) ) {
+	return 1;
+}
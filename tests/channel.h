@@ -0,0 +1,44 @@
+// Simulated shared radio channel for the multi-station tests
+//
+// Runs any number of stations on the real scheduler sources in one
+// process. The Makefile moves the .bss and .data of those sources
+// into the station_bss and station_data sections, and selecting a
+// station swaps its copy of them (and its SysTick registers) in, so
+// every station has its own queue, timers and random state.
+//
+// Stands in for the RDA1846 and the clock: a station keys up after
+// CHANNEL_KEYING_MS, hears other stations CHANNEL_SENSE_MS after
+// their carrier comes up and goes away, and any overlap of two
+// carriers loses both frames. Time moves in CHANNEL_TICK_MS ticks,
+// the CSMA slot clock.
+
+#ifndef __CHANNEL_H
+#define __CHANNEL_H
+
+#include <stdint.h>
+
+#define CHANNEL_MAX_STATIONS 128
+#define CHANNEL_TICK_MS 10
+
+// RDA1846_Set_TX's register writes and GPIO settle
+#define CHANNEL_KEYING_MS 60
+// An RSSI / squelch poll plus the squelch opening
+#define CHANNEL_SENSE_MS 20
+// 160 ms of flags, the RDA1846 default
+#define CHANNEL_PREAMBLE_FLAGS 24
+
+typedef struct Channel_Stats {
+	uint32_t transmissions;
+	uint32_t collided;
+	uint32_t successMS;
+} Channel_Stat;
+
+void Channel_Init( uint8_t stations );
+void Channel_Select( uint8_t station );
+uint32_t Channel_Now();
+void Channel_Tick();
+uint16_t Channel_Airtime_MS( uint8_t *frame, uint16_t length );
+void Channel_Get_Stats( Channel_Stat *stats );
+void Channel_Free();
+
+#endif // __CHANNEL_H
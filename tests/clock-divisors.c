@@ -0,0 +1,164 @@
+// Host test for the clock-derived divisors
+//
+// Brings up the drivers that program divisors from the system
+// clock, then switches through every supported frequency (and a
+// GPS correction either way) and checks what each one programmed:
+// the RCC2 PLL / bypass setup, the GPS and KISS UART baud rates,
+// the LCD SSI and I2C bus clocks, the CSMA SysTick slot, the ADC
+// sample trigger and the AFSK PWM sample rate, and the one-shot
+// tick conversions. Prints the rates at each frequency.
+//
+// Timer1A's 2 Hz tick is set up in main.c and isn't covered here.
+
+#include "host.h"
+#include "clock.h"
+#include "kiss.h"
+#include "uart.h"
+#include "lcd.h"
+#include "csma.h"
+#include "adc-audio.h"
+#include "pwm-i2c.h"
+#include "afsk.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define TEST_CLOCK_PLL_HZ 400000000
+#define TEST_RCC2_DIV400 0x40000000
+#define TEST_RCC2_SYSDIV2_SHIFT 22
+#define TEST_RCC2_PWRDN2 0x00002000
+#define TEST_RCC2_BYPASS2 0x00000800
+
+static const uint32_t testClocks[] = { CLOCK_16_MHZ, CLOCK_40_MHZ, CLOCK_50_MHZ, CLOCK_80_MHZ };
+static const int32_t testCorrections[] = { 0, 80, -80 };
+
+void AFSK_Init() {
+}
+
+void AFSK_Process_Samples( const uint16_t *samples, uint16_t count ) {
+}
+
+uint8_t RDA1846_Channel_Busy() {
+	return 0;
+}
+
+int16_t RDA1846_Get_RSSI() {
+	return -125;
+}
+
+void RDA1846_Wait_For_Channel( void (*callback)() ) {
+}
+
+void RDA1846_Watch_Channel( uint8_t on ) {
+}
+
+void RDA1846_Set_TX_Delay( uint16_t milliseconds ) {
+}
+
+uint16_t RDA1846_Transmit( uint8_t *frame, uint16_t length, void (*callback)() ) {
+	return 0;
+}
+
+uint8_t _Test_Source( uint8_t *level ) {
+	*level = 0x80;
+	return 1;
+}
+
+double _Test_Error( double actual, double wanted ) {
+	return ( actual - wanted ) / wanted;
+}
+
+double _Test_UART_Baud( uint32_t hz, uint32_t ibrd, uint32_t fbrd ) {
+	return hz * 4.0 / ( ibrd * 64 + fbrd );
+}
+
+void _Test_Clock( uint32_t nominalHz, int32_t ppm ) {
+	HOST_CHECK( Clock_Set_Hz( nominalHz ) );
+	Clock_Set_Correction_PPM( ppm );
+
+	// The oscillator's real rate, which the divisors must follow
+	uint32_t hz = Clock_Get_Hz();
+	HOST_CHECK( hz == (uint32_t) ( nominalHz + (int64_t) nominalHz * ppm / 1000000 ) );
+	HOST_CHECK( Clock_Get_Nominal_Hz() == nominalHz );
+	HOST_CHECK( Clock_Get_MHz() == nominalHz / 1000000 );
+
+	if ( CLOCK_16_MHZ == nominalHz ) {
+		HOST_CHECK( Host_SYSCTL_RCC2_R & TEST_RCC2_BYPASS2 );
+		HOST_CHECK( Host_SYSCTL_RCC2_R & TEST_RCC2_PWRDN2 );
+	} else {
+		HOST_CHECK( 0 == ( Host_SYSCTL_RCC2_R & TEST_RCC2_BYPASS2 ) );
+		HOST_CHECK( 0 == ( Host_SYSCTL_RCC2_R & TEST_RCC2_PWRDN2 ) );
+		HOST_CHECK( Host_SYSCTL_RCC2_R & TEST_RCC2_DIV400 );
+		HOST_CHECK( ( ( Host_SYSCTL_RCC2_R >> TEST_RCC2_SYSDIV2_SHIFT ) & 0x7F ) + 1 == TEST_CLOCK_PLL_HZ / nominalHz );
+	}
+
+	double gps = _Test_UART_Baud( hz, Host_UART1_IBRD_R, Host_UART1_FBRD_R );
+	double kiss = _Test_UART_Baud( hz, Host_UART0_IBRD_R, Host_UART0_FBRD_R );
+	double ssi = (double) hz / ( Host_SSI0_CPSR_R * ( ( ( Host_SSI0_CR0_R >> 8 ) & 0xFF ) + 1 ) );
+	double i2c = (double) hz / ( 20 * ( Host_I2C0_MTPR_R + 1 ) );
+	double slotMS = ( Host_NVIC_ST_RELOAD_R + 1 ) * 1000.0 / hz;
+	double adc = (double) hz / ( Host_TIMER3_TAILR_R + 1 );
+	double pwm = (double) hz / ( Host_PWM0_0_LOAD_R + 1 );
+
+	printf( "%2u MHz %+4d ppm: GPS %7.1f  KISS %8.1f  SSI %6.0f  I2C %6.0f  slot %6.3f ms  ADC %6.1f  PWM %7.1f\n",
+		nominalHz / 1000000, ppm, gps, kiss, ssi, i2c, slotMS, adc, pwm );
+
+	HOST_CHECK( fabs( _Test_Error( gps, 9600 ) ) < 0.001 );
+	HOST_CHECK( fabs( _Test_Error( kiss, 115200 ) ) < 0.001 );
+	// Bus clocks may only err on the slow side, by less than a step
+	// of the divisor - a fast crystal can cost a whole step
+	HOST_CHECK( ssi <= 100000 );
+	HOST_CHECK( ssi > 98000 );
+	HOST_CHECK( i2c <= 100000 );
+	HOST_CHECK( (double) hz / ( 20 * Host_I2C0_MTPR_R ) > 100000 );
+	HOST_CHECK( fabs( slotMS - 10.0 ) < 0.001 );
+	HOST_CHECK( fabs( _Test_Error( adc, AFSK_SAMPLE_RATE ) ) < 0.001 );
+	HOST_CHECK( fabs( _Test_Error( pwm, AFSK_TX_SAMPLE_RATE ) ) < 0.001 );
+
+	// One-shots, to the nearest tick of the real rate
+	static const uint32_t microseconds[] = { 1, 15, 60, 480, 1000, 999999 };
+	for ( uint8_t i=0; i < sizeof( microseconds ) / sizeof( microseconds[0] ); i++ ) {
+		double wanted = (double) microseconds[i] * hz / 1e6;
+		HOST_CHECK( fabs( Clock_Microseconds_To_Ticks( microseconds[i] ) - wanted ) <= 1.0 + wanted / 1e6 );
+	}
+	static const uint32_t milliseconds[] = { 1, 2, 10, 100, 1650, 50000 };
+	for ( uint8_t i=0; i < sizeof( milliseconds ) / sizeof( milliseconds[0] ); i++ ) {
+		double wanted = (double) milliseconds[i] * hz / 1e3;
+		HOST_CHECK( fabs( Clock_Milliseconds_To_Ticks( milliseconds[i] ) - wanted ) <= 1.0 + wanted / 1e6 );
+	}
+
+	// Long waits saturate rather than wrap
+	HOST_CHECK( 0xFFFFFFFF == Clock_Milliseconds_To_Ticks( 0xFFFFFFFF ) );
+	HOST_CHECK( 0xFFFFFFFF == Clock_Microseconds_To_Ticks( 0xFFFFFFFF ) );
+}
+
+int main() {
+	Host_Init();
+
+	UART_Init();
+	KISS_Init();
+	LCD_Init();
+	CSMA_Init();
+	ADC_Audio_Init();
+	PWM_I2C_Init( 0x71 );
+	PWM_I2C_Start_PWM( AFSK_TX_SAMPLE_RATE, _Test_Source );
+
+	// The systick only runs while frames wait, start it for its reload
+	uint8_t frame[20] = { 0 };
+	CSMA_Queue_Frame( CSMA_SOURCE_STATION, frame, sizeof( frame ) );
+
+	for ( uint8_t i=0; i < sizeof( testClocks ) / sizeof( testClocks[0] ); i++ ) {
+		for ( uint8_t j=0; j < sizeof( testCorrections ) / sizeof( testCorrections[0] ); j++ ) {
+			_Test_Clock( testClocks[i], testCorrections[j] );
+		}
+	}
+
+	// Anything else is refused and changes nothing
+	Clock_Set_Correction_PPM( 0 );
+	HOST_CHECK( Clock_Set_Hz( CLOCK_80_MHZ ) );
+	HOST_CHECK( ! Clock_Set_Hz( 20000000 ) );
+	HOST_CHECK( CLOCK_80_MHZ == Clock_Get_Hz() );
+
+	return Host_Report( "clock-divisors" );
+}
@@ -0,0 +1,105 @@
+// Host simulation of N stations sharing a channel through csma.c
+//
+// Every station runs its own copy of the CSMA scheduler with the
+// default parameters (100 ms slots, p = 64/256, 10 s maximum
+// defer) and offers a frame every TEST_MEAN_INTERVAL_MS on average,
+// at random. For each station count prints the offered load G and
+// throughput S in Erlangs, the share of transmissions lost to
+// collisions against what unslotted ALOHA would lose at the same
+// load, and the frames dropped after waiting out the defer limit.
+
+#include "host.h"
+#include "channel.h"
+#include "csma.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#define TEST_SECONDS 3600
+#define TEST_MEAN_INTERVAL_MS 30000.0
+
+static const uint8_t testStationCounts[] = { 1, 2, 4, 8, 16, 32, 64 };
+
+static uint32_t nextFrameMS[CHANNEL_MAX_STATIONS];
+
+uint32_t _Test_Interval() {
+	return (uint32_t) ( -TEST_MEAN_INTERVAL_MS * log( ( rand() + 1.0 ) / ( RAND_MAX + 2.0 ) ) );
+}
+
+void _Test_Stations( uint8_t stations ) {
+	uint8_t frame[100];
+	uint32_t offered = 0, offeredMS = 0, queueFull = 0;
+
+	Channel_Init( stations );
+	srand( 30 + stations );
+
+	for ( uint8_t i=0; i < stations; i++ ) {
+		Channel_Select( i );
+		CSMA_Init();
+		nextFrameMS[i] = _Test_Interval();
+	}
+
+	while ( Channel_Now() < TEST_SECONDS * 1000 ) {
+		for ( uint8_t i=0; i < stations; i++ ) {
+			if ( Channel_Now() < nextFrameMS[i] ) {
+				continue;
+			}
+			nextFrameMS[i] += _Test_Interval();
+
+			uint16_t length = 40 + rand() % 61;
+			for ( uint16_t j=0; j < length; j++ ) {
+				frame[j] = rand();
+			}
+
+			Channel_Select( i );
+			offered++;
+			offeredMS += Channel_Airtime_MS( frame, length );
+			if ( ! CSMA_Queue_Frame( CSMA_SOURCE_STATION, frame, length ) ) {
+				queueFull++;
+			}
+		}
+		Channel_Tick();
+	}
+
+	uint32_t sent = 0, dropped = 0;
+	for ( uint8_t i=0; i < stations; i++ ) {
+		uint32_t stationSent, stationDropped;
+		Channel_Select( i );
+		CSMA_Get_Stats( &stationSent, &stationDropped, 0 );
+		sent += stationSent;
+		dropped += stationDropped;
+	}
+
+	Channel_Stat stats;
+	Channel_Get_Stats( &stats );
+
+	double load = offeredMS / ( TEST_SECONDS * 1000.0 );
+	double throughput = stats.successMS / ( TEST_SECONDS * 1000.0 );
+	double collisions = stats.transmissions ? (double) stats.collided / stats.transmissions : 0.0;
+	double aloha = 1.0 - exp( -2.0 * load );
+
+	printf( "%3u stations  G %.3f  S %.3f  collided %5.1f%% (ALOHA %5.1f%%)  dropped %4u  queue full %4u of %5u\n",
+		stations, load, throughput, 100.0 * collisions, 100.0 * aloha, dropped, queueFull, offered );
+
+	HOST_CHECK( stats.transmissions >= sent );
+	HOST_CHECK( sent + dropped + queueFull <= offered );
+	if ( 1 == stations ) {
+		HOST_CHECK( 0 == stats.collided );
+		HOST_CHECK( 0 == dropped );
+	} else {
+		// Carrier sense has to beat not listening at all
+		HOST_CHECK( collisions < aloha );
+	}
+}
+
+int main() {
+	Host_Init();
+
+	for ( uint8_t i=0; i < sizeof( testStationCounts ); i++ ) {
+		_Test_Stations( testStationCounts[i] );
+	}
+
+	Channel_Free();
+	return Host_Report( "csma-stations" );
+}
@@ -0,0 +1,267 @@
+// Host test for the WIDEn-N digipeater
+//
+// Checks the relayed path for the New-N cases (WIDEn-N, directed,
+// hops used, full paths), that our own frames, paths it must not
+// take and anything but UI / no layer 3 are left alone, and that
+// a copy heard by another path inside DIGI_DUPLICATE_SECONDS is
+// dropped and relayed again after it. Then feeds a busy channel -
+// every beacon heard again from up to three other digipeaters -
+// and prints the frames, relays and duplicates, the probes per
+// lookup, the time per frame and the table's RAM.
+
+#include "host.h"
+#include "digi.h"
+#include "aprs.h"
+#include "ax25.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TEST_STREAM_SECONDS 3600
+#define TEST_STREAM_STATIONS 200
+// A beacon every ten minutes from each station, 1 a second or so
+#define TEST_STREAM_BEACON_SECONDS 600
+#define TEST_STREAM_MAX_COPIES 3
+#define TEST_STREAM_MAX_EVENTS ( TEST_STREAM_SECONDS / TEST_STREAM_BEACON_SECONDS * TEST_STREAM_STATIONS * ( 1 + TEST_STREAM_MAX_COPIES ) + TEST_STREAM_STATIONS * ( 1 + TEST_STREAM_MAX_COPIES ) )
+
+typedef struct Test_Paths {
+	char *path;
+	// 0 if the frame must not be relayed
+	char *relayed;
+} Test_Path;
+
+static const Test_Path testPaths[] = {
+	{ "WIDE1-1", "N0CALL-13*,WIDE1*" },
+	{ "WIDE2-2", "N0CALL-13*,WIDE2-1" },
+	{ "WIDE1-1,WIDE2-1", "N0CALL-13*,WIDE1*,WIDE2-1" },
+	{ "OTHER*,WIDE2-1", "OTHER*,N0CALL-13*,WIDE2*" },
+	{ "N0CALL-13,WIDE2-1", "N0CALL-13*,WIDE2-1" },
+	{ "A*,B*,C*,D*,E*,F*,G*,WIDE2-2", "A*,B*,C*,D*,E*,F*,G*,WIDE2-1" },
+	{ "WIDE3-3", 0 },
+	{ "WIDE2-3", 0 },
+	{ "WIDE2-0", 0 },
+	{ "WIDE1*", 0 },
+	{ "RELAY", 0 },
+	{ "N0CALL-12", 0 },
+	{ "", 0 },
+};
+
+typedef struct Test_Events {
+	uint32_t ms;
+	uint16_t station;
+	uint16_t beacon;
+	uint8_t copy;
+} Test_Event;
+
+static uint8_t relayed[AX25_MAX_FRAME_LENGTH];
+static uint16_t relayedLength;
+static uint32_t relayCount;
+static Test_Event events[TEST_STREAM_MAX_EVENTS];
+
+uint8_t RDA1846_Send_Packet( uint8_t source, uint8_t *frame, uint16_t length ) {
+	memcpy( relayed, frame, length );
+	relayedLength = length;
+	relayCount++;
+	return 1;
+}
+
+/*
+ * Builds a UI frame - a * after a hop marks it used
+ */
+uint16_t _Test_Frame( uint8_t *frame, char *source, char *path, char *information ) {
+	char plain[128];
+	uint8_t used[AX25_MAX_DIGIPEATERS];
+	uint8_t hops = 0, j = 0;
+
+	memset( used, 0, sizeof( used ) );
+	for ( uint8_t i=0; path[i]; i++ ) {
+		if ( '*' == path[i] ) {
+			used[hops] = 1;
+		} else {
+			if ( ',' == path[i] ) {
+				hops++;
+			}
+			plain[j++] = path[i];
+		}
+	}
+	plain[j] = 0;
+
+	uint16_t length = AX25_Encode_Header( frame, "APRS", source, plain );
+	for ( uint8_t i=0; i < AX25_MAX_DIGIPEATERS; i++ ) {
+		if ( used[i] ) {
+			frame[( 2 + i ) * AX25_ADDRESS_LENGTH + 6] |= AX25_H_BIT;
+		}
+	}
+
+	memcpy( &frame[length], information, strlen( information ) );
+	return length + strlen( information );
+}
+
+/*
+ * Hands the digipeater a frame, returns 1 if it relayed it
+ */
+uint8_t _Test_Receive( uint8_t *frame, uint16_t length ) {
+	uint32_t before = relayCount;
+	Digi_Receive_Frame( frame, length );
+	return relayCount != before;
+}
+
+void _Test_Paths() {
+	uint8_t frame[AX25_MAX_FRAME_LENGTH];
+	uint8_t expected[AX25_MAX_FRAME_LENGTH];
+
+	for ( uint8_t i=0; i < sizeof( testPaths ) / sizeof( testPaths[0] ); i++ ) {
+		Digi_Init();
+		uint16_t length = _Test_Frame( frame, "N1ABC-9", testPaths[i].path, "!4903.50N/07201.75W-" );
+		uint8_t wasRelayed = _Test_Receive( frame, length );
+
+		if ( ! testPaths[i].relayed ) {
+			HOST_CHECK( ! wasRelayed );
+			continue;
+		}
+
+		uint16_t expectedLength = _Test_Frame( expected, "N1ABC-9", testPaths[i].relayed, "!4903.50N/07201.75W-" );
+		HOST_CHECK( wasRelayed );
+		HOST_CHECK( relayedLength == expectedLength );
+		HOST_CHECK( 0 == memcmp( relayed, expected, expectedLength ) );
+	}
+
+	// Our own frames coming back
+	Digi_Init();
+	uint16_t length = _Test_Frame( frame, APRS_CALLSIGN, "WIDE1-1", ">own" );
+	HOST_CHECK( ! _Test_Receive( frame, length ) );
+
+	// Connected mode I frame, and UI with a layer 3 protocol
+	length = _Test_Frame( frame, "N1ABC-9", "WIDE1-1", ">connected" );
+	frame[3 * AX25_ADDRESS_LENGTH] = 0x00;
+	HOST_CHECK( ! _Test_Receive( frame, length ) );
+	length = _Test_Frame( frame, "N1ABC-9", "WIDE1-1", ">netrom" );
+	frame[3 * AX25_ADDRESS_LENGTH + 1] = 0xCF;
+	HOST_CHECK( ! _Test_Receive( frame, length ) );
+
+	// Cut off inside the address field, and ahead of the control byte
+	length = _Test_Frame( frame, "N1ABC-9", "WIDE1-1", ">short" );
+	HOST_CHECK( ! _Test_Receive( frame, 2 * AX25_ADDRESS_LENGTH + 3 ) );
+	HOST_CHECK( ! _Test_Receive( frame, 3 * AX25_ADDRESS_LENGTH ) );
+}
+
+void _Test_Duplicates() {
+	uint8_t frame[AX25_MAX_FRAME_LENGTH];
+	uint16_t length;
+
+	Digi_Init();
+	length = _Test_Frame( frame, "N1ABC-9", "WIDE2-2", ">duplicate" );
+	HOST_CHECK( _Test_Receive( frame, length ) );
+
+	// Another digipeater's copy, same source and information
+	length = _Test_Frame( frame, "N1ABC-9", "N2XYZ*,WIDE2-1", ">duplicate" );
+	for ( uint8_t i=0; i < DIGI_DUPLICATE_SECONDS - 1; i++ ) {
+		Digi_Tick_Second();
+	}
+	HOST_CHECK( ! _Test_Receive( frame, length ) );
+
+	// The same text later is a new beacon
+	Digi_Tick_Second();
+	HOST_CHECK( _Test_Receive( frame, length ) );
+
+	// Different information from the same station is not a duplicate
+	length = _Test_Frame( frame, "N1ABC-9", "WIDE2-1", ">other" );
+	HOST_CHECK( _Test_Receive( frame, length ) );
+}
+
+int _Test_Event_Compare( const void *a, const void *b ) {
+	const Test_Event *first = a;
+	const Test_Event *second = b;
+	if ( first->ms != second->ms ) {
+		return first->ms < second->ms ? -1 : 1;
+	}
+	return first->copy - second->copy;
+}
+
+void _Test_Stream() {
+	uint8_t frame[AX25_MAX_FRAME_LENGTH];
+	char source[10];
+	char path[32];
+	char information[64];
+	uint32_t eventCount = 0, beacons = 0;
+
+	// Every station beacons at its own phase through WIDE1-1,WIDE2-1
+	// and is heard again from digipeaters 1 to 10 s later
+	for ( uint16_t station=0; station < TEST_STREAM_STATIONS; station++ ) {
+		uint32_t phaseMS = rand() % ( TEST_STREAM_BEACON_SECONDS * 1000 );
+		for ( uint16_t beacon=0; phaseMS + beacon * TEST_STREAM_BEACON_SECONDS * 1000 < TEST_STREAM_SECONDS * 1000; beacon++ ) {
+			uint32_t ms = phaseMS + beacon * TEST_STREAM_BEACON_SECONDS * 1000;
+			uint8_t copies = rand() % ( TEST_STREAM_MAX_COPIES + 1 );
+			for ( uint8_t copy=0; copy <= copies; copy++ ) {
+				Test_Event *event = &events[eventCount++];
+				event->ms = ms + ( copy ? 1000 + rand() % 9000 : 0 );
+				event->station = station;
+				event->beacon = beacon;
+				event->copy = copy;
+			}
+			beacons++;
+		}
+	}
+	qsort( events, eventCount, sizeof( Test_Event ), _Test_Event_Compare );
+
+	// The counters run on across Digi_Init
+	uint32_t relayedBefore, droppedBefore, lookupsBefore, probesBefore;
+	Digi_Init();
+	Digi_Get_Stats( &relayedBefore, &droppedBefore, &lookupsBefore, &probesBefore );
+	uint32_t second = 0;
+	uint64_t nanoseconds = 0;
+
+	for ( uint32_t i=0; i < eventCount; i++ ) {
+		Test_Event *event = &events[i];
+		while ( second < event->ms / 1000 ) {
+			Digi_Tick_Second();
+			second++;
+		}
+
+		snprintf( source, sizeof( source ), "N%03u-%u", event->station, event->station % 16 );
+		if ( event->copy ) {
+			snprintf( path, sizeof( path ), "D%u*,WIDE1*,WIDE2-1", event->copy );
+		} else {
+			snprintf( path, sizeof( path ), "WIDE1-1,WIDE2-1" );
+		}
+		snprintf( information, sizeof( information ), "@%06uz4903.50N/07201.75W_%03u/%03ug%03ut%03u",
+			event->beacon * TEST_STREAM_BEACON_SECONDS, event->station, event->beacon, event->station / 10, 50 + event->station % 30 );
+		uint16_t length = _Test_Frame( frame, source, path, information );
+
+		uint64_t start = Host_Nanoseconds();
+		Digi_Receive_Frame( frame, length );
+		nanoseconds += Host_Nanoseconds() - start;
+	}
+
+	uint32_t framesRelayed, duplicatesDropped, lookups, probes;
+	Digi_Get_Stats( &framesRelayed, &duplicatesDropped, &lookups, &probes );
+	framesRelayed -= relayedBefore;
+	duplicatesDropped -= droppedBefore;
+	lookups -= lookupsBefore;
+	probes -= probesBefore;
+
+	printf( "stream: %u frames over %u s, %u beacons, %u relayed, %u duplicates dropped\n",
+		eventCount, TEST_STREAM_SECONDS, beacons, framesRelayed, duplicatesDropped );
+	printf( "stream: %.2f probes per lookup, %.0f ns per frame, table %u bytes\n",
+		lookups ? (double) probes / lookups : 0.0, (double) nanoseconds / eventCount, Digi_Get_Table_Bytes() );
+
+	// Every beacon once, every copy of it dropped
+	HOST_CHECK( framesRelayed == beacons );
+	HOST_CHECK( duplicatesDropped == eventCount - beacons );
+	HOST_CHECK( lookups == eventCount );
+	// Bounded by DIGI_MAX_PROBES - once every entry has been used a
+	// new digest walks the whole run looking for a copy
+	HOST_CHECK( probes <= lookups * 8 );
+}
+
+int main() {
+	Host_Init();
+	srand( 32 );
+
+	_Test_Paths();
+	_Test_Duplicates();
+	_Test_Stream();
+
+	return Host_Report( "digi-stream" );
+}
@@ -0,0 +1,321 @@
+// Host simulation of power failures under the flash log
+//
+// Runs flash-log.c against a model of the flash controller and
+// EEPROM behind the register hook: an erase or page program that
+// the power cuts short leaves the sector part erased or the page
+// part programmed, with the bits in flight at random, and an
+// EEPROM word write either lands or doesn't. Every so often the
+// power is cut a few operations into an append (longjmp out of
+// the hook), sometimes taking the EEPROM's contents with it, and
+// the station boots again. After each boot, checks the log reads
+// back in order, with everything committed before the cut, every
+// observation intact, and nothing missing but the open page and
+// the observation being appended at a cut. Prints the write
+// amplification, erases per sector, pages skipped and the boot
+// time with and without the EEPROM's help.
+
+#include "host.h"
+#include "flash-log.h"
+
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TEST_FLASH_START 0x00030000
+#define TEST_FLASH_SIZE 0x10000
+#define TEST_SECTOR_SIZE 1024
+#define TEST_PAGE_WORDS 32
+#define TEST_FWB ((volatile uint32_t *)0x400FD100)
+#define TEST_ALTERNATE_KEY 0x71D50000
+
+#define TEST_OBSERVATIONS 400000
+// A cut about every this many appends
+#define TEST_CUT_EVERY 2000
+// Observations in a page: one in the header, then 4 byte records
+#define TEST_PAGE_OBSERVATIONS ( 1 + ( FLASH_LOG_PAGE_SIZE - 10 - 2 * FLASH_LOG_VALUES - 2 ) / ( 1 + FLASH_LOG_VALUES ) )
+
+static uint32_t eeprom[32][16];
+static uint8_t eepromPending;
+static uint32_t eepromBlock;
+static uint32_t eepromOffset;
+static uint32_t eepromRead;
+
+static jmp_buf powerLoss;
+static int32_t operationsUntilCut = -1;
+
+static uint32_t current;
+static int32_t committedUpTo = -1;
+static uint64_t programmedBytes;
+static uint32_t erases;
+static uint32_t eepromWrites;
+static uint32_t wrongKeys;
+
+// Kept outside _Test_Power_Loss, which longjmp returns into
+static uint32_t cuts;
+static uint32_t eepromLosses;
+static uint32_t largestGap;
+static uint64_t withEEPROM, withoutEEPROM;
+static uint32_t bootsWith, bootsWithout;
+
+static int32_t readBack[FLASH_LOG_PAGES * TEST_PAGE_OBSERVATIONS + TEST_PAGE_OBSERVATIONS];
+static uint32_t readCount;
+static uint32_t badObservations;
+
+// Observations a cut was allowed to take, one bit each
+static uint8_t lost[TEST_OBSERVATIONS / 8];
+
+uint32_t _Test_Time( uint32_t i ) {
+	// A gap too long for a record every 3000 observations
+	return 1000000 + i * 60 + ( i / 3000 ) * 400;
+}
+
+void _Test_Values( uint32_t i, int16_t *values ) {
+	uint32_t t = i % 5000;
+	values[0] = ( t < 2500 ) ? t / 40 : ( 5000 - t ) / 40;
+	// Wrapping round, so the deltas go both ways
+	values[1] = (int16_t) ( ( i * 7 ) % 120 ) - 60;
+	// The gust goes missing now and then
+	values[2] = ( 17 == i % 1500 ) ? FLASH_LOG_NO_VALUE : (int16_t) ( ( i * 3 ) % 97 );
+}
+
+uint8_t _Test_Lost( uint32_t i ) {
+	return lost[i / 8] & ( 1 << ( i % 8 ) );
+}
+
+/*
+ * Counts an operation, true if the power goes during it
+ */
+uint8_t _Test_Cut_Now() {
+	if ( operationsUntilCut < 0 ) {
+		return 0;
+	}
+	return 0 == operationsUntilCut--;
+}
+
+void _Test_Erase() {
+	uint32_t address = ( Host_FLASH_FMA_R & ~( TEST_SECTOR_SIZE - 1 ) );
+	uint8_t *sector = (uint8_t *) (uintptr_t) address;
+	erases++;
+
+	if ( _Test_Cut_Now() ) {
+		uint32_t erased = rand() % TEST_SECTOR_SIZE;
+		memset( sector, 0xFF, erased );
+		for ( uint32_t i=erased; i < TEST_SECTOR_SIZE; i++ ) {
+			sector[i] &= rand();
+		}
+		longjmp( powerLoss, 1 );
+	}
+	memset( sector, 0xFF, TEST_SECTOR_SIZE );
+}
+
+void _Test_Program() {
+	uint32_t address = ( Host_FLASH_FMA_R & ~( FLASH_LOG_PAGE_SIZE - 1 ) );
+	volatile uint32_t *words = (volatile uint32_t *) (uintptr_t) address;
+	programmedBytes += FLASH_LOG_PAGE_SIZE;
+
+	if ( _Test_Cut_Now() ) {
+		uint8_t programmed = rand() % TEST_PAGE_WORDS;
+		for ( uint8_t i=0; i < programmed; i++ ) {
+			words[i] &= TEST_FWB[i];
+		}
+		words[programmed] &= TEST_FWB[programmed] | rand();
+		longjmp( powerLoss, 1 );
+	}
+
+	for ( uint8_t i=0; i < TEST_PAGE_WORDS; i++ ) {
+		words[i] &= TEST_FWB[i];
+	}
+	committedUpTo = (int32_t) current - 1;
+}
+
+/*
+ * Finishes the last EERDWRINC access: a write if the register no
+ * longer holds what was there to read
+ */
+void _Test_Settle_EEPROM() {
+	if ( ! eepromPending ) {
+		return;
+	}
+	eepromPending = 0;
+
+	if ( Host_EEPROM_EERDWRINC_R != eepromRead ) {
+		if ( _Test_Cut_Now() ) {
+			longjmp( powerLoss, 1 );
+		}
+		eeprom[eepromBlock & 31][eepromOffset & 15] = Host_EEPROM_EERDWRINC_R;
+		eepromWrites++;
+	}
+	Host_EEPROM_EEOFFSET_R = ( eepromOffset + 1 ) & 15;
+}
+
+void _Test_Register_Hook( volatile uint32_t *reg ) {
+	_Test_Settle_EEPROM();
+
+	if ( ( reg == &Host_FLASH_FMC_R ) && ( Host_FLASH_FMC_R & FLASH_FMC_ERASE ) ) {
+		if ( TEST_ALTERNATE_KEY != ( Host_FLASH_FMC_R & 0xFFFF0000 ) ) {
+			wrongKeys++;
+		}
+		_Test_Erase();
+		Host_FLASH_FMC_R = 0;
+	} else if ( ( reg == &Host_FLASH_FMC2_R ) && ( Host_FLASH_FMC2_R & FLASH_FMC2_WRBUF ) ) {
+		if ( TEST_ALTERNATE_KEY != ( Host_FLASH_FMC2_R & 0xFFFF0000 ) ) {
+			wrongKeys++;
+		}
+		_Test_Program();
+		Host_FLASH_FMC2_R = 0;
+	} else if ( reg == &Host_EEPROM_EERDWRINC_R ) {
+		eepromBlock = Host_EEPROM_EEBLOCK_R;
+		eepromOffset = Host_EEPROM_EEOFFSET_R;
+		eepromRead = eeprom[eepromBlock & 31][eepromOffset & 15];
+		Host_EEPROM_EERDWRINC_R = eepromRead;
+		eepromPending = 1;
+	}
+}
+
+void _Test_Read_Callback( uint32_t seconds, int16_t *values ) {
+	// The observation with this time stamp
+	uint32_t low = 0, high = current + 1;
+	while ( low < high ) {
+		uint32_t middle = ( low + high ) / 2;
+		if ( _Test_Time( middle ) < seconds ) {
+			low = middle + 1;
+		} else {
+			high = middle;
+		}
+	}
+
+	int16_t expected[FLASH_LOG_VALUES];
+	_Test_Values( low, expected );
+	if ( ( _Test_Time( low ) != seconds ) || memcmp( expected, values, sizeof( expected ) ) ) {
+		badObservations++;
+		return;
+	}
+	if ( readCount < sizeof( readBack ) / sizeof( readBack[0] ) ) {
+		readBack[readCount++] = low;
+	}
+}
+
+/*
+ * Boots, then reads the whole log back and checks it
+ */
+uint64_t _Test_Boot() {
+	uint64_t start = Host_Nanoseconds();
+	Flash_Log_Init();
+	uint64_t bootNS = Host_Nanoseconds() - start;
+
+	readCount = 0;
+	Flash_Log_Read( 0, _Test_Read_Callback );
+
+	uint32_t gaps = 0;
+	for ( uint32_t i=1; i < readCount; i++ ) {
+		HOST_CHECK( readBack[i] > readBack[i - 1] );
+		if ( readBack[i] != readBack[i - 1] + 1 ) {
+			uint32_t gap = readBack[i] - readBack[i - 1] - 1;
+			// Only what was open at a cut, two cuts can run together
+			for ( int32_t j=readBack[i - 1] + 1; j < readBack[i]; j++ ) {
+				HOST_CHECK( _Test_Lost( j ) );
+			}
+			if ( gap > largestGap ) {
+				largestGap = gap;
+			}
+			gaps++;
+		}
+	}
+	HOST_CHECK( gaps <= cuts );
+
+	// Nothing committed is lost
+	if ( committedUpTo >= 0 ) {
+		HOST_CHECK( readCount && ( readBack[readCount - 1] == committedUpTo ) );
+	}
+
+	return bootNS;
+}
+
+void _Test_Power_Loss() {
+	memset( eeprom, 0xFF, sizeof( eeprom ) );
+	Flash_Log_Init();
+
+	current = 0;
+	if ( setjmp( powerLoss ) ) {
+		// The power came back
+		cuts++;
+
+		// The open page and the observation being appended, no more
+		HOST_CHECK( (int32_t) current - committedUpTo <= TEST_PAGE_OBSERVATIONS + 1 );
+		for ( uint32_t i=committedUpTo + 1; i <= current; i++ ) {
+			lost[i / 8] |= 1 << ( i % 8 );
+		}
+		operationsUntilCut = -1;
+		eepromPending = 0;
+		Host_FLASH_FMC_R = 0;
+		Host_FLASH_FMC2_R = 0;
+
+		uint8_t lostEEPROM = rand() & 1;
+		if ( lostEEPROM ) {
+			memset( eeprom, 0xFF, sizeof( eeprom ) );
+			eepromLosses++;
+		}
+
+		uint64_t bootNS = _Test_Boot();
+		if ( lostEEPROM ) {
+			withoutEEPROM += bootNS;
+			bootsWithout++;
+		} else {
+			withEEPROM += bootNS;
+			bootsWith++;
+		}
+		current++;
+	}
+
+	for ( ; current < TEST_OBSERVATIONS; current++ ) {
+		if ( 0 == rand() % TEST_CUT_EVERY ) {
+			operationsUntilCut = rand() % 6;
+		}
+
+		int16_t values[FLASH_LOG_VALUES];
+		_Test_Values( current, values );
+		Flash_Log_Append( _Test_Time( current ), values );
+	}
+	operationsUntilCut = -1;
+
+	Flash_Log_Flush();
+	_Test_Boot();
+
+	uint32_t observations, pages, sectors, skipped;
+	Flash_Log_Get_Stats( &observations, &pages, &sectors, &skipped );
+
+	double logical = (double) TEST_OBSERVATIONS * ( 4 + 2 * FLASH_LOG_VALUES );
+	printf( "%u observations, %u power cuts (%u losing the EEPROM), %u readable at the end, oldest #%d\n",
+		TEST_OBSERVATIONS, cuts, eepromLosses, readCount, readCount ? readBack[0] : -1 );
+	printf( "programmed %.0f bytes for %.0f logical: write amplification %.2fx; %.1f erases per sector; "
+		"%u pages skipped since the last boot\n",
+		(double) programmedBytes, logical, programmedBytes / logical,
+		(double) erases / ( TEST_FLASH_SIZE / TEST_SECTOR_SIZE ), skipped );
+	printf( "largest gap at a cut %u observations; boot %.1f us with the EEPROM, %.1f us without; %u EEPROM writes\n",
+		largestGap, bootsWith ? withEEPROM / 1000.0 / bootsWith : 0, bootsWithout ? withoutEEPROM / 1000.0 / bootsWithout : 0,
+		eepromWrites );
+
+	HOST_CHECK( cuts > 100 );
+	HOST_CHECK( 0 == badObservations );
+	HOST_CHECK( 0 == wrongKeys );
+	HOST_CHECK( TEST_OBSERVATIONS - 1 == readBack[readCount - 1] );
+	// All but the sector being reused, less what the cuts dropped
+	// and the pages a missing gust or a time gap closed early
+	HOST_CHECK( readCount > ( FLASH_LOG_PAGES - 16 ) * ( TEST_PAGE_OBSERVATIONS - 4 ) );
+	// Each page programmed once per erase, and the EEPROM once per page
+	HOST_CHECK( programmedBytes / FLASH_LOG_PAGE_SIZE <= ( erases + cuts ) * ( TEST_SECTOR_SIZE / FLASH_LOG_PAGE_SIZE ) );
+	HOST_CHECK( eepromWrites <= 3 * ( programmedBytes / FLASH_LOG_PAGE_SIZE ) );
+}
+
+int main() {
+	Host_Init();
+	srand( 42 );
+
+	memset( (void *) TEST_FLASH_START, 0xFF, TEST_FLASH_SIZE );
+	Host_Set_Register_Hook( _Test_Register_Hook );
+
+	_Test_Power_Loss();
+
+	return Host_Report( "flash-power-loss" );
+}
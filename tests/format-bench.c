@@ -0,0 +1,200 @@
+// Host benchmark of the fixed-width formatting against snprintf
+//
+// Times each of format.c's fields against the snprintf call it
+// replaced - the display refresh's %02hu, %03hu and %3d, and a %7.2f
+// for the fixed point - and Base91, which has no printf form,
+// against plainly dividing by 91. Each sample formats TEST_BATCH
+// fields from a table of inputs and is divided down, and each
+// field keeps the best of TEST_SAMPLES, to see past the host's
+// scheduling noise. Checks both ways write the same text for every
+// input.
+//
+// Then prints the text size of format.o against the C library's
+// snprintf core (snprintf, vsnprintf, vfprintf and the float and
+// integer conversions it pulls in), as the Makefile builds and
+// extracts them next to this binary. These are host x86-64 sizes,
+// so the ratio is the thing to read rather than the bytes.
+//
+// The times are printed and not gated: they're host wall-clock and
+// only mean anything against each other on the same machine.
+
+#include "host.h"
+#include "format.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TEST_BATCH 256
+#define TEST_SAMPLES 500
+#define TEST_LINE 16
+
+#define TEST_FORMAT_OBJECT "format.o"
+#define TEST_PRINTF_OBJECTS "printf/*.o"
+
+typedef struct Test_Fields {
+	const char *name;
+	const char *against;
+	uint8_t width;
+	void (*format)( char *dest, int32_t value );
+	void (*reference)( char *dest, int32_t value );
+	int32_t minimum;
+	int32_t maximum;
+} Test_Field;
+
+static int32_t inputs[TEST_BATCH];
+static char lines[TEST_BATCH][TEST_LINE];
+
+void _Test_Unsigned_2( char *dest, int32_t value ) {
+	Format_Unsigned( dest, value, 2, '0' );
+}
+
+void _Test_Snprintf_2( char *dest, int32_t value ) {
+	snprintf( dest, TEST_LINE, "%02hu", (uint16_t) value );
+}
+
+void _Test_Unsigned_3( char *dest, int32_t value ) {
+	Format_Unsigned( dest, value, 3, '0' );
+}
+
+void _Test_Snprintf_3( char *dest, int32_t value ) {
+	snprintf( dest, TEST_LINE, "%03hu", (uint16_t) value );
+}
+
+void _Test_Signed_3( char *dest, int32_t value ) {
+	Format_Signed( dest, value, 3, ' ' );
+}
+
+void _Test_Snprintf_Signed_3( char *dest, int32_t value ) {
+	snprintf( dest, TEST_LINE, "%3d", (int) value );
+}
+
+void _Test_Fixed_7( char *dest, int32_t value ) {
+	Format_Fixed( dest, value, 2, 7 );
+}
+
+void _Test_Snprintf_Fixed_7( char *dest, int32_t value ) {
+	snprintf( dest, TEST_LINE, "%7.2f", value / 100.0 );
+}
+
+void _Test_Base91_4( char *dest, int32_t value ) {
+	Format_Base91( dest, value, 4 );
+}
+
+void _Test_Divide_Base91_4( char *dest, int32_t value ) {
+	uint32_t remaining = value;
+	for ( int8_t i=3; i >= 0; i-- ) {
+		dest[i] = 33 + ( remaining % 91 );
+		remaining /= 91;
+	}
+}
+
+static const Test_Field testFields[] = {
+	{ "Format_Unsigned", "%02hu", 2, _Test_Unsigned_2, _Test_Snprintf_2, 0, 99 },
+	{ "Format_Unsigned", "%03hu", 3, _Test_Unsigned_3, _Test_Snprintf_3, 0, 999 },
+	{ "Format_Signed", "%3d", 3, _Test_Signed_3, _Test_Snprintf_Signed_3, -99, 999 },
+	{ "Format_Fixed", "%7.2f", 7, _Test_Fixed_7, _Test_Snprintf_Fixed_7, -99999, 999999 },
+	{ "Format_Base91", "/ 91", 4, _Test_Base91_4, _Test_Divide_Base91_4, 0, 91 * 91 * 91 * 91 - 1 }
+};
+
+#define TEST_FIELDS ( sizeof( testFields ) / sizeof( testFields[0] ) )
+
+/*
+ * Best nanoseconds per field over TEST_SAMPLES batches
+ */
+double _Test_Time( void (*format)( char *dest, int32_t value ) ) {
+	uint64_t best = UINT64_MAX;
+
+	for ( uint16_t sample=0; sample < TEST_SAMPLES; sample++ ) {
+		uint64_t start = Host_Nanoseconds();
+		for ( uint16_t i=0; i < TEST_BATCH; i++ ) {
+			format( lines[i], inputs[i] );
+		}
+		uint64_t elapsed = Host_Nanoseconds() - start;
+		if ( elapsed < best ) {
+			best = elapsed;
+		}
+	}
+
+	return (double) best / TEST_BATCH;
+}
+
+void _Test_Field( const Test_Field *field ) {
+	char want[TEST_LINE];
+	uint32_t mismatches = 0;
+
+	for ( uint16_t i=0; i < TEST_BATCH; i++ ) {
+		inputs[i] = field->minimum + rand() % ( field->maximum - field->minimum + 1 );
+	}
+
+	for ( uint16_t i=0; i < TEST_BATCH; i++ ) {
+		field->reference( want, inputs[i] );
+		field->format( lines[i], inputs[i] );
+		mismatches += memcmp( lines[i], want, field->width ) ? 1 : 0;
+	}
+	HOST_CHECK( 0 == mismatches );
+
+	double formatNs = _Test_Time( field->format );
+	double referenceNs = _Test_Time( field->reference );
+	printf( "%-16s %6.1f ns   %-6s %6.1f ns   %5.1fx\n", field->name, formatNs, field->against, referenceNs,
+		referenceNs / formatNs );
+}
+
+/*
+ * Total text bytes of the objects, as size counts them
+ * Returns 0 if size can't be run or the objects aren't there
+ */
+uint32_t _Test_Text_Size( const char *directory, const char *objects ) {
+	char command[512];
+	char line[256];
+	uint32_t text = 0;
+
+	snprintf( command, sizeof( command ), "size --totals %s/%s 2>/dev/null", directory, objects );
+	FILE *size = popen( command, "r" );
+	if ( ! size ) {
+		return 0;
+	}
+	while ( fgets( line, sizeof( line ), size ) ) {
+		if ( strstr( line, "(TOTALS)" ) ) {
+			sscanf( line, " %u", &text );
+		}
+	}
+	pclose( size );
+
+	return text;
+}
+
+void _Test_Sizes( const char *program ) {
+	char directory[256];
+
+	snprintf( directory, sizeof( directory ), "%s", program );
+	char *slash = strrchr( directory, '/' );
+	if ( slash ) {
+		*slash = 0;
+	} else {
+		strcpy( directory, "." );
+	}
+
+	uint32_t formatText = _Test_Text_Size( directory, TEST_FORMAT_OBJECT );
+	uint32_t printfText = _Test_Text_Size( directory, TEST_PRINTF_OBJECTS );
+	if ( ! formatText || ! printfText ) {
+		printf( "text size: not measured, no %s or %s in %s\n", TEST_FORMAT_OBJECT, TEST_PRINTF_OBJECTS, directory );
+		return;
+	}
+	printf( "text size: format.o %u bytes, snprintf core %u bytes, %d bytes less\n", formatText, printfText,
+		(int) printfText - (int) formatText );
+}
+
+int main( int argc, char **argv ) {
+	Host_Init();
+	srand( 37 );
+
+	printf( "best of %u batches of %u fields\n", TEST_SAMPLES, TEST_BATCH );
+	printf( "%-16s %9s   %-6s %9s   %s\n", "field", "time", "vs", "time", "speedup" );
+	for ( uint8_t i=0; i < TEST_FIELDS; i++ ) {
+		_Test_Field( &testFields[i] );
+	}
+	_Test_Sizes( argv[0] );
+
+	return Host_Report( "format-bench" );
+}
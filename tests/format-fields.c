@@ -0,0 +1,207 @@
+// Host test of the fixed-width formatting
+//
+// Checks each of format.c's fields against the exact text it
+// should write, including the edges: zero padded negatives, values
+// too wide for their field, fixed point too narrow for its point,
+// INT32_MIN and zero widths. Every field is written into a buffer
+// of guard bytes, so a write outside the field shows. Then checks
+// random values against snprintf wherever they fit, and Base91
+// against dividing by 91.
+
+#include "host.h"
+#include "format.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TEST_GUARD '#'
+#define TEST_RANDOM 100000
+
+// A guard byte ahead, and room for a 255 wide field with guard after
+static char buffer[1 + 256 + 1];
+
+char *_Test_Clear() {
+	memset( buffer, TEST_GUARD, sizeof( buffer ) );
+	return &buffer[1];
+}
+
+/*
+ * The last field written should be want, with every byte around
+ * it untouched
+ */
+void _Test_Field( uint8_t written, const char *want, int line ) {
+	size_t length = strlen( want );
+	uint8_t untouched = ( TEST_GUARD == buffer[0] );
+
+	for ( size_t i=1 + length; i < sizeof( buffer ); i++ ) {
+		untouched &= ( TEST_GUARD == buffer[i] );
+	}
+
+	HOST_CHECK( written == length );
+	HOST_CHECK( untouched );
+	HOST_CHECK( 0 == memcmp( &buffer[1], want, length ) );
+	if ( ( written != length ) || ! untouched || memcmp( &buffer[1], want, length ) ) {
+		printf( "  line %d: want \"%s\" got \"%.*s\"\n", line, want, (int) length, &buffer[1] );
+	}
+}
+
+#define TEST_FIELD( call, want ) _Test_Field( call, want, __LINE__ )
+
+void _Test_Unsigned() {
+	TEST_FIELD( Format_Unsigned( _Test_Clear(), 0, 1, '0' ), "0" );
+	TEST_FIELD( Format_Unsigned( _Test_Clear(), 0, 3, ' ' ), "  0" );
+	TEST_FIELD( Format_Unsigned( _Test_Clear(), 5, 2, '0' ), "05" );
+	TEST_FIELD( Format_Unsigned( _Test_Clear(), 42, 5, ' ' ), "   42" );
+	TEST_FIELD( Format_Unsigned( _Test_Clear(), UINT32_MAX, 10, '0' ), "4294967295" );
+	TEST_FIELD( Format_Unsigned( _Test_Clear(), UINT32_MAX, 12, '0' ), "004294967295" );
+
+	// Too wide keeps the least significant digits
+	TEST_FIELD( Format_Unsigned( _Test_Clear(), 12345, 3, '0' ), "345" );
+	TEST_FIELD( Format_Unsigned( _Test_Clear(), 100, 2, ' ' ), "00" );
+
+	// Nothing at all for no width
+	TEST_FIELD( Format_Unsigned( _Test_Clear(), 7, 0, '0' ), "" );
+	TEST_FIELD( Format_Unsigned( _Test_Clear(), 0, 0, ' ' ), "" );
+}
+
+void _Test_Signed() {
+	TEST_FIELD( Format_Signed( _Test_Clear(), 7, 3, '0' ), "007" );
+	TEST_FIELD( Format_Signed( _Test_Clear(), 0, 3, ' ' ), "  0" );
+
+	// Zero padding puts the sign first, space padding by the digits
+	TEST_FIELD( Format_Signed( _Test_Clear(), -5, 3, '0' ), "-05" );
+	TEST_FIELD( Format_Signed( _Test_Clear(), -5, 3, ' ' ), " -5" );
+	TEST_FIELD( Format_Signed( _Test_Clear(), -5, 2, '0' ), "-5" );
+	TEST_FIELD( Format_Signed( _Test_Clear(), -5, 1, '0' ), "-" );
+	TEST_FIELD( Format_Signed( _Test_Clear(), -5, 1, ' ' ), "-" );
+
+	// Too wide keeps the sign over the leading digits
+	TEST_FIELD( Format_Signed( _Test_Clear(), -123, 3, '0' ), "-23" );
+	TEST_FIELD( Format_Signed( _Test_Clear(), -123, 3, ' ' ), "-23" );
+	TEST_FIELD( Format_Signed( _Test_Clear(), -12345, 4, ' ' ), "-345" );
+	TEST_FIELD( Format_Signed( _Test_Clear(), 12345, 3, ' ' ), "345" );
+
+	TEST_FIELD( Format_Signed( _Test_Clear(), INT32_MIN, 11, ' ' ), "-2147483648" );
+	TEST_FIELD( Format_Signed( _Test_Clear(), INT32_MIN, 11, '0' ), "-2147483648" );
+	TEST_FIELD( Format_Signed( _Test_Clear(), INT32_MIN, 13, ' ' ), "  -2147483648" );
+	TEST_FIELD( Format_Signed( _Test_Clear(), INT32_MIN, 13, '0' ), "-002147483648" );
+	TEST_FIELD( Format_Signed( _Test_Clear(), INT32_MIN, 5, ' ' ), "-3648" );
+	TEST_FIELD( Format_Signed( _Test_Clear(), INT32_MAX, 10, ' ' ), "2147483647" );
+
+	TEST_FIELD( Format_Signed( _Test_Clear(), -5, 0, '0' ), "" );
+	TEST_FIELD( Format_Signed( _Test_Clear(), -5, 0, ' ' ), "" );
+}
+
+void _Test_Fixed() {
+	TEST_FIELD( Format_Fixed( _Test_Clear(), -1234, 2, 7 ), " -12.34" );
+	TEST_FIELD( Format_Fixed( _Test_Clear(), 1234, 2, 7 ), "  12.34" );
+	TEST_FIELD( Format_Fixed( _Test_Clear(), 5, 2, 5 ), " 0.05" );
+	TEST_FIELD( Format_Fixed( _Test_Clear(), -5, 2, 5 ), "-0.05" );
+	TEST_FIELD( Format_Fixed( _Test_Clear(), -50, 1, 5 ), " -5.0" );
+	TEST_FIELD( Format_Fixed( _Test_Clear(), 0, 3, 6 ), " 0.000" );
+
+	// No room for the sign ahead of the units, so it takes their place
+	TEST_FIELD( Format_Fixed( _Test_Clear(), -5, 2, 4 ), "-.05" );
+
+	// Too wide keeps the least significant digits either side
+	TEST_FIELD( Format_Fixed( _Test_Clear(), 123456, 3, 6 ), "23.456" );
+	TEST_FIELD( Format_Fixed( _Test_Clear(), -123456, 3, 6 ), "-3.456" );
+
+	// Narrower than a digit, point and decimals - the plain value
+	TEST_FIELD( Format_Fixed( _Test_Clear(), -1234, 2, 3 ), "-34" );
+	TEST_FIELD( Format_Fixed( _Test_Clear(), 1234, 2, 3 ), "234" );
+	TEST_FIELD( Format_Fixed( _Test_Clear(), 1234, 3, 4 ), "1234" );
+	TEST_FIELD( Format_Fixed( _Test_Clear(), -1234, 3, 0 ), "" );
+
+	// No decimals is a signed field
+	TEST_FIELD( Format_Fixed( _Test_Clear(), -7, 0, 3 ), " -7" );
+
+	TEST_FIELD( Format_Fixed( _Test_Clear(), INT32_MIN, 2, 14 ), "  -21474836.48" );
+	TEST_FIELD( Format_Fixed( _Test_Clear(), INT32_MIN, 9, 13 ), " -2.147483648" );
+}
+
+void _Test_Base91() {
+	TEST_FIELD( Format_Base91( _Test_Clear(), 0, 2 ), "!!" );
+	TEST_FIELD( Format_Base91( _Test_Clear(), 90, 2 ), "!{" );
+	TEST_FIELD( Format_Base91( _Test_Clear(), 91, 2 ), "\"!" );
+	TEST_FIELD( Format_Base91( _Test_Clear(), 91 * 91 - 1, 2 ), "{{" );
+	TEST_FIELD( Format_Base91( _Test_Clear(), 91 * 91, 2 ), "!!" );
+	TEST_FIELD( Format_Base91( _Test_Clear(), 5, 0 ), "" );
+}
+
+void _Test_String() {
+	TEST_FIELD( Format_String( _Test_Clear(), "abc", 5 ), "abc  " );
+	TEST_FIELD( Format_String( _Test_Clear(), "abcdef", 3 ), "abc" );
+	TEST_FIELD( Format_String( _Test_Clear(), "", 2 ), "  " );
+	TEST_FIELD( Format_String( _Test_Clear(), "abc", 0 ), "" );
+}
+
+/*
+ * A random value with a random number of digits
+ */
+uint32_t _Test_Random() {
+	uint32_t value = ( (uint32_t) rand() << 16 ) ^ rand();
+	return value >> ( rand() % 32 );
+}
+
+void _Test_Against_Snprintf() {
+	char want[32];
+	uint32_t mismatches = 0;
+
+	for ( uint32_t n=0; n < TEST_RANDOM; n++ ) {
+		uint32_t value = _Test_Random();
+		int32_t signedValue = ( rand() & 1 ) ? - (int32_t) ( value >> 1 ) : (int32_t) ( value >> 1 );
+		uint8_t width = 1 + rand() % 12;
+		uint8_t zero = rand() & 1;
+		int length;
+
+		length = snprintf( want, sizeof( want ), zero ? "%0*u" : "%*u", width, value );
+		if ( length == width ) {
+			Format_Unsigned( _Test_Clear(), value, width, zero ? '0' : ' ' );
+			mismatches += memcmp( &buffer[1], want, width ) ? 1 : 0;
+		}
+
+		length = snprintf( want, sizeof( want ), zero ? "%0*d" : "%*d", width, signedValue );
+		if ( length == width ) {
+			Format_Signed( _Test_Clear(), signedValue, width, zero ? '0' : ' ' );
+			mismatches += memcmp( &buffer[1], want, width ) ? 1 : 0;
+		}
+
+		// Two decimals, space padded to the width
+		uint32_t magnitude = ( signedValue < 0 ) ? - (uint32_t) signedValue : (uint32_t) signedValue;
+		length = snprintf( want, sizeof( want ), "%s%u.%02u", ( signedValue < 0 ) ? "-" : "", magnitude / 100, magnitude % 100 );
+		if ( length <= width + 4 ) {
+			char padded[40];
+			snprintf( padded, sizeof( padded ), "%*s", width + 4, want );
+			Format_Fixed( _Test_Clear(), signedValue, 2, width + 4 );
+			mismatches += memcmp( &buffer[1], padded, width + 4 ) ? 1 : 0;
+		}
+
+		// Against dividing, over the range the reciprocal covers
+		uint32_t base91 = value >> 1;
+		Format_Base91( _Test_Clear(), base91, 5 );
+		for ( int8_t i=4; i >= 0; i-- ) {
+			want[i] = 33 + ( base91 % 91 );
+			base91 /= 91;
+		}
+		mismatches += memcmp( &buffer[1], want, 5 ) ? 1 : 0;
+	}
+
+	HOST_CHECK( 0 == mismatches );
+	printf( "%u random values: %u mismatches against snprintf and division\n", TEST_RANDOM, mismatches );
+}
+
+int main() {
+	Host_Init();
+	srand( 37 );
+
+	_Test_Unsigned();
+	_Test_Signed();
+	_Test_Fixed();
+	_Test_Base91();
+	_Test_String();
+	_Test_Against_Snprintf();
+
+	return Host_Report( "format-fields" );
+}
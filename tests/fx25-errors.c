@@ -0,0 +1,279 @@
+// Host test for the FX.25 encoder
+//
+// Encodes random frames at each check size and checks the line:
+// preamble flags, the correlation tag for the smallest codeblock
+// that holds the frame, the plain AX.25 line at the start of the
+// data portion, and a codeword whose syndromes at alpha^1 to
+// alpha^(n - k) are all zero. Then corrupts up to (n - k) / 2
+// random bytes of the codeblock and has a reference decoder
+// (Berlekamp-Massey, Chien search, Forney), with its own GF(256)
+// tables, put it back. Prints encode time per frame.
+
+#include "host.h"
+#include "fx25.h"
+#include "ax25.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TEST_RUNS 3000
+#define TEST_TIMING_RUNS 20000
+
+// Correlation tags from the specification, 0x01 to 0x0B
+static const uint64_t testTags[] = {
+	0xB74DB7DF8A532F3EULL, 0x26FF60A600CC8FDEULL, 0xC7DC0508F3D9B09EULL, 0x8F056EB4369660EEULL,
+	0x6E260B1AC5835FAEULL, 0xFF94DC634F1CFF4EULL, 0x1EB7B9CDBC09C00EULL, 0xDBF869BD2DBB1776ULL,
+	0x3ADB0C13DEAE2836ULL, 0xAB69DB6A543188D6ULL, 0x4A4ABEC4A724B796ULL,
+};
+static const uint8_t testTagCheckBytes[] = { 16, 16, 16, 16, 32, 32, 32, 32, 64, 64, 64 };
+static const uint8_t testTagDataLengths[] = { 239, 128, 64, 32, 223, 128, 64, 32, 191, 128, 64 };
+
+static uint8_t gfExp[512];
+static uint8_t gfLog[256];
+
+void _Test_GF_Init() {
+	uint16_t x = 1;
+	for ( int i=0; i < 255; i++ ) {
+		gfExp[i] = x;
+		gfExp[i + 255] = x;
+		gfLog[x] = i;
+		x = x << 1;
+		if ( x & 0x100 ) {
+			x ^= 0x11D;
+		}
+	}
+}
+
+uint8_t _Test_GF_Mul( uint8_t a, uint8_t b ) {
+	return ( a && b ) ? gfExp[gfLog[a] + gfLog[b]] : 0;
+}
+
+uint8_t _Test_GF_Div( uint8_t a, uint8_t b ) {
+	return a ? gfExp[gfLog[a] + 255 - gfLog[b]] : 0;
+}
+
+/*
+ * Syndromes of an n byte codeword, first byte the highest power
+ * Returns 1 if any is non-zero
+ */
+uint8_t _Test_Syndromes( const uint8_t *block, int n, int checkBytes, uint8_t *syndromes ) {
+	uint8_t any = 0;
+	for ( int j=0; j < checkBytes; j++ ) {
+		uint8_t s = 0;
+		for ( int i=0; i < n; i++ ) {
+			s = _Test_GF_Mul( s, gfExp[1 + j] ) ^ block[i];
+		}
+		syndromes[j] = s;
+		any |= s;
+	}
+	return any ? 1 : 0;
+}
+
+/*
+ * Corrects an n byte shortened codeword in place
+ * Returns the number of bytes corrected, -1 if it can't be
+ */
+int _Test_RS_Decode( uint8_t *block, int n, int checkBytes ) {
+	uint8_t syndromes[64];
+	if ( ! _Test_Syndromes( block, n, checkBytes, syndromes ) ) {
+		return 0;
+	}
+
+	// Berlekamp-Massey for the error locator
+	uint8_t lambda[65] = { 1 }, previous[65] = { 1 }, saved[65];
+	uint8_t previousDiscrepancy = 1;
+	int errors = 0, shift = 1;
+	for ( int r=0; r < checkBytes; r++ ) {
+		uint8_t discrepancy = syndromes[r];
+		for ( int i=1; i <= errors; i++ ) {
+			discrepancy ^= _Test_GF_Mul( lambda[i], syndromes[r - i] );
+		}
+		if ( 0 == discrepancy ) {
+			shift++;
+			continue;
+		}
+		memcpy( saved, lambda, sizeof( lambda ) );
+		uint8_t scale = _Test_GF_Div( discrepancy, previousDiscrepancy );
+		for ( int i=0; i + shift <= checkBytes; i++ ) {
+			lambda[i + shift] ^= _Test_GF_Mul( scale, previous[i] );
+		}
+		if ( 2 * errors <= r ) {
+			errors = r + 1 - errors;
+			memcpy( previous, saved, sizeof( saved ) );
+			previousDiscrepancy = discrepancy;
+			shift = 1;
+		} else {
+			shift++;
+		}
+	}
+
+	// Evaluator omega = S * lambda mod x^(n - k)
+	uint8_t omega[64];
+	for ( int i=0; i < checkBytes; i++ ) {
+		omega[i] = 0;
+		for ( int j=0; j <= i && j <= errors; j++ ) {
+			omega[i] ^= _Test_GF_Mul( syndromes[i - j], lambda[j] );
+		}
+	}
+
+	// Chien search over the positions actually sent, Forney for values
+	int found = 0;
+	for ( int i=0; i < n; i++ ) {
+		uint8_t inverse = gfExp[( 255 - ( n - 1 - i ) ) % 255];
+		uint8_t value = 0, derivative = 0, power = 1;
+		for ( int j=0; j <= errors; j++ ) {
+			value ^= _Test_GF_Mul( lambda[j], power );
+			if ( j & 1 ) {
+				derivative ^= _Test_GF_Mul( lambda[j], _Test_GF_Div( power, inverse ) );
+			}
+			power = _Test_GF_Mul( power, inverse );
+		}
+		if ( value ) {
+			continue;
+		}
+
+		uint8_t numerator = 0;
+		power = 1;
+		for ( int j=0; j < checkBytes; j++ ) {
+			numerator ^= _Test_GF_Mul( omega[j], power );
+			power = _Test_GF_Mul( power, inverse );
+		}
+		if ( 0 == derivative ) {
+			return -1;
+		}
+		block[i] ^= _Test_GF_Div( numerator, derivative );
+		found++;
+	}
+
+	if ( found != errors ) {
+		return -1;
+	}
+	return _Test_Syndromes( block, n, checkBytes, syndromes ) ? -1 : found;
+}
+
+/*
+ * Index into testTags of the tag at line, -1 if none
+ */
+int _Test_Find_Tag( const uint8_t *line ) {
+	uint64_t tag = 0;
+	for ( int i=FX25_TAG_LENGTH - 1; i >= 0; i-- ) {
+		tag = ( tag << 8 ) | line[i];
+	}
+	for ( int i=0; i < sizeof( testTags ) / sizeof( testTags[0] ); i++ ) {
+		if ( testTags[i] == tag ) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+void _Test_Frame( uint8_t checkBytes ) {
+	static uint8_t frame[AX25_MAX_FRAME_LENGTH];
+	static uint8_t line[AX25_MAX_LINE_LENGTH + FX25_TAG_LENGTH + FX25_MAX_BLOCK_LENGTH];
+	static uint8_t plain[AX25_MAX_LINE_LENGTH];
+	static uint8_t block[FX25_MAX_BLOCK_LENGTH];
+	uint8_t preambleFlags = rand() % 16;
+
+	// Up to a frame the largest codeblock holds at this check size
+	uint16_t length = 1 + rand() % ( 255 - checkBytes - 40 );
+	for ( uint16_t i=0; i < length; i++ ) {
+		frame[i] = ( rand() & 3 ) ? rand() : 0xFF;
+	}
+
+	uint16_t bits = FX25_Encode_Line( frame, length, checkBytes, preambleFlags, line, sizeof( line ) );
+	uint16_t plainBits = AX25_Encode_Line( frame, length, 0, plain, sizeof( plain ) );
+	if ( 0 == bits ) {
+		// Only refused when no codeblock holds it
+		HOST_CHECK( 0 == FX25_Get_Block_Length( checkBytes, plainBits ) );
+		return;
+	}
+
+	for ( uint8_t i=0; i < preambleFlags; i++ ) {
+		HOST_CHECK( AX25_FLAG == line[i] );
+	}
+
+	// The smallest codeblock with these check bytes that holds the frame
+	int tag = _Test_Find_Tag( &line[preambleFlags] );
+	HOST_CHECK( tag >= 0 );
+	if ( tag < 0 ) {
+		return;
+	}
+	uint16_t dataLength = testTagDataLengths[tag];
+	HOST_CHECK( checkBytes == testTagCheckBytes[tag] );
+	HOST_CHECK( dataLength * 8 >= plainBits );
+	for ( int i=0; i < sizeof( testTags ) / sizeof( testTags[0] ); i++ ) {
+		HOST_CHECK( ( testTagCheckBytes[i] != checkBytes ) || ( testTagDataLengths[i] >= dataLength ) ||
+			( testTagDataLengths[i] * 8 < plainBits ) );
+	}
+	HOST_CHECK( bits == ( preambleFlags + FX25_TAG_LENGTH + dataLength + checkBytes ) * 8 );
+	HOST_CHECK( FX25_Get_Block_Length( checkBytes, plainBits ) == FX25_TAG_LENGTH + dataLength + checkBytes );
+
+	// Legacy receivers see the plain line, then flag bits to the end
+	uint8_t *data = &line[preambleFlags + FX25_TAG_LENGTH];
+	uint16_t mismatches = 0;
+	for ( uint16_t bit=0; bit < dataLength * 8; bit++ ) {
+		uint8_t got = ( data[bit >> 3] >> ( bit & 7 ) ) & 1;
+		uint8_t want = ( bit < plainBits ) ? ( ( plain[bit >> 3] >> ( bit & 7 ) ) & 1 ) :
+			( ( AX25_FLAG >> ( ( bit - plainBits ) & 7 ) ) & 1 );
+		mismatches += ( got != want ) ? 1 : 0;
+	}
+	HOST_CHECK( 0 == mismatches );
+
+	uint8_t syndromes[64];
+	uint16_t n = dataLength + checkBytes;
+	HOST_CHECK( 0 == _Test_Syndromes( data, n, checkBytes, syndromes ) );
+
+	// Up to t = (n - k) / 2 errors anywhere in the codeblock
+	memcpy( block, data, n );
+	int errors = rand() % ( checkBytes / 2 + 1 );
+	for ( int i=0; i < errors; i++ ) {
+		uint16_t position;
+		do {
+			position = rand() % n;
+		} while ( block[position] != data[position] );
+		block[position] ^= 1 + rand() % 255;
+	}
+	HOST_CHECK( errors == _Test_RS_Decode( block, n, checkBytes ) );
+	HOST_CHECK( 0 == memcmp( block, data, n ) );
+}
+
+void _Test_Timing() {
+	static uint8_t frame[100];
+	static uint8_t line[AX25_MAX_LINE_LENGTH + FX25_TAG_LENGTH + FX25_MAX_BLOCK_LENGTH];
+	volatile uint32_t sink = 0;
+
+	for ( int i=0; i < sizeof( frame ); i++ ) {
+		frame[i] = rand();
+	}
+
+	uint8_t checkBytes[] = { FX25_CHECK_BYTES_NONE, FX25_CHECK_BYTES_16, FX25_CHECK_BYTES_32, FX25_CHECK_BYTES_64 };
+	for ( int mode=0; mode < sizeof( checkBytes ); mode++ ) {
+		uint64_t start = Host_Nanoseconds();
+		for ( int i=0; i < TEST_TIMING_RUNS; i++ ) {
+			if ( checkBytes[mode] ) {
+				sink += FX25_Encode_Line( frame, sizeof( frame ), checkBytes[mode], 8, line, sizeof( line ) );
+			} else {
+				sink += AX25_Encode_Line( frame, sizeof( frame ), 8, line, sizeof( line ) );
+			}
+		}
+		printf( "100 byte frame, %2u check bytes: %.2f us to encode\n", checkBytes[mode],
+			(double) ( Host_Nanoseconds() - start ) / TEST_TIMING_RUNS / 1000.0 );
+	}
+}
+
+int main() {
+	Host_Init();
+	srand( 28 );
+	_Test_GF_Init();
+
+	for ( int run=0; run < TEST_RUNS; run++ ) {
+		_Test_Frame( FX25_CHECK_BYTES_16 );
+		_Test_Frame( FX25_CHECK_BYTES_32 );
+		_Test_Frame( FX25_CHECK_BYTES_64 );
+	}
+
+	_Test_Timing();
+
+	return Host_Report( "fx25-errors" );
+}
@@ -0,0 +1,251 @@
+// Host test of the sensor history against a naive reference
+//
+// Feeds history.c and a plain array of every sample the same
+// streams: a temperature random walk every 5 s, then irregular
+// samples with GPS outages, jumps too big for one record and a clock
+// that steps backwards. After each sample, and at query times running
+// on past the last sample, checks every window's minimum, maximum,
+// mean, last and count against the array, and that the samples
+// History_Get_Samples rebuilds are the newest of the array's.
+// Prints the time per sample and per query against the array's.
+
+#include "host.h"
+#include "history.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+// Three days at one sample every 5 s
+#define TEST_MAX_SAMPLES 60000
+#define TEST_RING_SAMPLES 720
+
+static const uint16_t testBucketSeconds[HISTORY_WINDOWS] = { 10, 60, 300, 3600 };
+static const uint8_t testBuckets[HISTORY_WINDOWS] = { 6, 10, 12, 24 };
+
+typedef struct Test_Samples {
+	uint32_t seconds;
+	int16_t value;
+} Test_Sample;
+
+static Test_Sample samples[TEST_MAX_SAMPLES];
+static uint32_t sampleCount;
+// Since the last clock step backwards
+static uint32_t firstSample;
+
+static uint32_t copiedSeconds[TEST_RING_SAMPLES + 1];
+static int16_t copiedValues[TEST_RING_SAMPLES + 1];
+
+static uint64_t historyNS, naiveNS;
+static uint32_t queries;
+
+/*
+ * The window as history.c defines it: the bucket now is in and
+ * the ones before it
+ */
+uint8_t _Test_Naive_Stats( uint8_t window, uint32_t seconds, History_Stats *stats ) {
+	uint32_t now = seconds / testBucketSeconds[window];
+	if ( ( sampleCount > firstSample ) && ( now < samples[sampleCount - 1].seconds / testBucketSeconds[window] ) ) {
+		now = samples[sampleCount - 1].seconds / testBucketSeconds[window];
+	}
+
+	int16_t minimum = INT16_MAX;
+	int16_t maximum = INT16_MIN;
+	int64_t sum = 0;
+	uint32_t count = 0;
+	for ( uint32_t i=firstSample; i < sampleCount; i++ ) {
+		uint32_t slot = samples[i].seconds / testBucketSeconds[window];
+		if ( slot + testBuckets[window] > now ) {
+			if ( samples[i].value < minimum ) {
+				minimum = samples[i].value;
+			}
+			if ( samples[i].value > maximum ) {
+				maximum = samples[i].value;
+			}
+			sum += samples[i].value;
+			count++;
+		}
+	}
+
+	if ( 0 == count ) {
+		return 0;
+	}
+
+	stats->minimum = minimum;
+	stats->maximum = maximum;
+	stats->last = samples[sampleCount - 1].value;
+	stats->count = count;
+	stats->mean = ( sum < 0 ) ? -(int16_t) ( ( -sum + count / 2 ) / count ) : (int16_t) ( ( sum + count / 2 ) / count );
+	return 1;
+}
+
+void _Test_Compare( uint8_t channel, uint32_t seconds ) {
+	for ( uint8_t w=0; w < HISTORY_WINDOWS; w++ ) {
+		History_Stats stats = { 0 }, naive = { 0 };
+
+		uint64_t start = Host_Nanoseconds();
+		uint8_t found = History_Get_Stats( channel, w, seconds, &stats );
+		historyNS += Host_Nanoseconds() - start;
+
+		start = Host_Nanoseconds();
+		uint8_t naiveFound = _Test_Naive_Stats( w, seconds, &naive );
+		naiveNS += Host_Nanoseconds() - start;
+		queries++;
+
+		HOST_CHECK( found == naiveFound );
+		if ( found && naiveFound ) {
+			HOST_CHECK( stats.minimum == naive.minimum );
+			HOST_CHECK( stats.maximum == naive.maximum );
+			HOST_CHECK( stats.mean == naive.mean );
+			HOST_CHECK( stats.last == naive.last );
+			HOST_CHECK( stats.count == naive.count );
+		}
+	}
+}
+
+/*
+ * The rebuilt samples are the newest of the array's - all of
+ * them while the ring hasn't wrapped or started over
+ */
+void _Test_Compare_Samples( uint8_t channel, uint8_t smooth ) {
+	uint16_t copied = History_Get_Samples( channel, copiedSeconds, copiedValues, TEST_RING_SAMPLES + 1 );
+	uint32_t available = sampleCount - firstSample;
+
+	HOST_CHECK( copied <= available );
+	if ( smooth ) {
+		HOST_CHECK( copied >= ( available < TEST_RING_SAMPLES ? available : TEST_RING_SAMPLES ) );
+	}
+
+	for ( uint16_t i=0; i < copied; i++ ) {
+		Test_Sample *sample = &samples[sampleCount - copied + i];
+		HOST_CHECK( copiedSeconds[i] == sample->seconds );
+		HOST_CHECK( copiedValues[i] == sample->value );
+	}
+
+	// Fewer asked for, the newest of them
+	uint16_t few = History_Get_Samples( channel, copiedSeconds, copiedValues, 5 );
+	HOST_CHECK( few == ( copied < 5 ? copied : 5 ) );
+	if ( few ) {
+		HOST_CHECK( copiedSeconds[few - 1] == samples[sampleCount - 1].seconds );
+	}
+}
+
+uint64_t _Test_Add( uint8_t channel, uint32_t seconds, int16_t value ) {
+	if ( ( sampleCount > firstSample ) && ( seconds < samples[sampleCount - 1].seconds ) ) {
+		firstSample = sampleCount;
+	}
+	samples[sampleCount].seconds = seconds;
+	samples[sampleCount].value = value;
+	sampleCount++;
+
+	uint64_t start = Host_Nanoseconds();
+	History_Add_Sample( channel, seconds, value );
+	return Host_Nanoseconds() - start;
+}
+
+void _Test_Reset() {
+	sampleCount = 0;
+	firstSample = 0;
+	History_Init();
+}
+
+void _Test_Temperature() {
+	uint32_t seconds = 1000000;
+	int16_t value = 540;
+	uint64_t addNS = 0;
+
+	_Test_Reset();
+	for ( uint32_t i=0; i < 3 * 17280; i++ ) {
+		seconds += 5;
+		value += rand() % 5 - 2;
+		addNS += _Test_Add( HISTORY_TEMPERATURE, seconds, value );
+
+		// Every query is a 17280 sample scan for the array
+		if ( 0 == i % 97 ) {
+			_Test_Compare( HISTORY_TEMPERATURE, seconds );
+		}
+		if ( 0 == i % 1001 ) {
+			_Test_Compare_Samples( HISTORY_TEMPERATURE, 1 );
+		}
+	}
+
+	// Reading on with no new samples, until every window is empty
+	for ( uint32_t later=0; later < 25 * 3600; later += 397 ) {
+		_Test_Compare( HISTORY_TEMPERATURE, seconds + later );
+	}
+
+	printf( "temperature: %u samples, %.0f ns per sample; %u queries, %.0f ns each (array %.0f ns)\n",
+		sampleCount, (double) addNS / sampleCount, queries, (double) historyNS / queries, (double) naiveNS / queries );
+}
+
+void _Test_Irregular() {
+	uint32_t seconds = 5000000;
+	int16_t value = 80;
+
+	_Test_Reset();
+	for ( uint32_t i=0; i < 20000; i++ ) {
+		uint8_t smooth = 1;
+		seconds += 1 + rand() % 5;
+
+		if ( 0 == rand() % 500 ) {
+			// GPS outage, a few minutes to an hour and more
+			seconds += 60 + rand() % 5000;
+			smooth = 0;
+		}
+		if ( 0 == rand() % 300 ) {
+			// Jump, several records or a fresh ring
+			value = rand() % 3000;
+			smooth = 0;
+		} else {
+			value += rand() % 41 - 20;
+			if ( value < 0 ) {
+				value = 0;
+			}
+		}
+		if ( 0 == rand() % 5000 ) {
+			// Receiver reset, the clock steps backwards
+			seconds -= 3600;
+		}
+
+		_Test_Add( HISTORY_TEMPERATURE, seconds, value );
+		if ( 0 == i % 13 ) {
+			_Test_Compare( HISTORY_TEMPERATURE, seconds + rand() % 30 );
+		}
+		if ( 0 == i % 211 ) {
+			_Test_Compare_Samples( HISTORY_TEMPERATURE, smooth && ( sampleCount - firstSample < 200 ) );
+		}
+	}
+}
+
+void _Test_Edges() {
+	History_Stats stats;
+
+	_Test_Reset();
+	HOST_CHECK( ! History_Get_Stats( HISTORY_TEMPERATURE, HISTORY_1_MINUTE, 100, &stats ) );
+	HOST_CHECK( ! History_Get_Stats( HISTORY_CHANNELS, HISTORY_1_MINUTE, 100, &stats ) );
+	HOST_CHECK( ! History_Get_Stats( HISTORY_TEMPERATURE, HISTORY_WINDOWS, 100, &stats ) );
+	HOST_CHECK( 0 == History_Get_Samples( HISTORY_TEMPERATURE, copiedSeconds, copiedValues, 10 ) );
+
+	// Negative means round halves away from zero
+	_Test_Add( HISTORY_TEMPERATURE, 100, -3 );
+	_Test_Add( HISTORY_TEMPERATURE, 101, -4 );
+	_Test_Compare( HISTORY_TEMPERATURE, 101 );
+	HOST_CHECK( History_Get_Stats( HISTORY_TEMPERATURE, HISTORY_1_MINUTE, 101, &stats ) );
+	HOST_CHECK( -4 == stats.mean );
+
+	// Samples at the same second, and the extremes of the range
+	_Test_Add( HISTORY_TEMPERATURE, 101, INT16_MAX );
+	_Test_Add( HISTORY_TEMPERATURE, 102, INT16_MIN );
+	_Test_Compare( HISTORY_TEMPERATURE, 102 );
+	_Test_Compare_Samples( HISTORY_TEMPERATURE, 0 );
+}
+
+int main() {
+	Host_Init();
+	srand( 41 );
+
+	_Test_Temperature();
+	_Test_Irregular();
+	_Test_Edges();
+
+	return Host_Report( "history-naive" );
+}
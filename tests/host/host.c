@@ -0,0 +1,113 @@
+// Host support for the station's tests
+//
+// Register storage and hooks, memory at the fixed addresses the
+// drivers reach without the register header (GPIO bit-band words,
+// the flash write buffer and the flash log region), and check
+// counting.
+
+#include "host.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/mman.h>
+
+#define HOST_DEFINE_REGISTER( name ) volatile uint32_t Host_##name;
+HOST_REGISTERS( HOST_DEFINE_REGISTER )
+
+volatile uint32_t Host_PRIMASK = 0;
+volatile uint32_t Host_BASEPRI = 0;
+
+// GPIO ports B, E and F, the flash write buffer and the flash log
+static const uintptr_t mappedAddresses[] = { 0x40005000, 0x40024000, 0x40025000, 0x400FD000, 0x00030000 };
+static const size_t mappedLengths[] = { 0x1000, 0x1000, 0x1000, 0x1000, 0x10000 };
+
+static void (*registerHook)( volatile uint32_t *reg ) = 0;
+static void (*wfiHook)() = 0;
+
+static uint32_t checks = 0;
+static uint32_t failures = 0;
+
+volatile uint32_t *Host_Register( volatile uint32_t *reg ) {
+	if ( registerHook ) {
+		registerHook( reg );
+	}
+	return reg;
+}
+
+void Host_WFI() {
+	if ( wfiHook ) {
+		wfiHook();
+	}
+}
+
+void Host_Set_Register_Hook( void (*hook)( volatile uint32_t *reg ) ) {
+	registerHook = hook;
+}
+
+void Host_Set_WFI_Hook( void (*hook)() ) {
+	wfiHook = hook;
+}
+
+/*
+ * Everything zero, except what the drivers wait on at init: the
+ * peripherals report ready, the oscillator and PLL report locked,
+ * and the UART receive FIFOs are empty
+ */
+void Host_Reset_Registers() {
+#define HOST_CLEAR_REGISTER( name ) Host_##name = 0;
+	HOST_REGISTERS( HOST_CLEAR_REGISTER )
+
+	Host_SYSCTL_PRGPIO_R = 0xFFFFFFFF;
+	Host_SYSCTL_PRADC_R = 0xFFFFFFFF;
+	Host_SYSCTL_PRDMA_R = 0xFFFFFFFF;
+	Host_SYSCTL_PREEPROM_R = 0xFFFFFFFF;
+	Host_SYSCTL_RIS_R = 0xFFFFFFFF;
+	Host_UART0_FR_R = UART_FR_RXFE;
+	Host_UART1_FR_R = UART_FR_RXFE;
+	Host_UART5_FR_R = UART_FR_RXFE;
+
+	Host_PRIMASK = 0;
+	Host_BASEPRI = 0;
+	registerHook = 0;
+	wfiHook = 0;
+}
+
+void Host_Init() {
+	for ( size_t i=0; i < sizeof( mappedAddresses ) / sizeof( mappedAddresses[0] ); i++ ) {
+		void *memory = mmap( (void *) mappedAddresses[i], mappedLengths[i], PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0 );
+		if ( MAP_FAILED == memory ) {
+			perror( "mmap" );
+			exit( 2 );
+		}
+	}
+
+	// Erased flash
+	memset( (void *) 0x00030000, 0xFF, 0x10000 );
+
+	Host_Reset_Registers();
+}
+
+void Host_Check( uint8_t passed, const char *condition, const char *file, int line ) {
+	checks++;
+	if ( ! passed ) {
+		failures++;
+		fprintf( stderr, "%s:%d: check failed: %s\n", file, line, condition );
+	}
+}
+
+/*
+ * Prints the tally - returns the exit status for main
+ */
+int Host_Report( const char *name ) {
+	printf( "%s: %u checks, %u failed\n", name, checks, failures );
+	return failures ? 1 : 0;
+}
+
+uint64_t Host_Nanoseconds() {
+	struct timespec now;
+	clock_gettime( CLOCK_MONOTONIC, &now );
+	return (uint64_t) now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
@@ -0,0 +1,28 @@
+// Host support for the station's tests
+//
+// The tests build the unmodified driver sources with gcc against
+// the stand-in tm4c123gh6pm.h and intrinsics.h in this directory,
+// and play the peripherals through a register hook. A hook is
+// handed each register as the driver reaches it, before the read
+// or write, and must touch the Host_ variables directly rather
+// than through the register macros.
+
+#ifndef __HOST_H
+#define __HOST_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "tm4c123gh6pm.h"
+#include "intrinsics.h"
+
+#define HOST_CHECK( condition ) Host_Check( ( condition ) ? 1 : 0, #condition, __FILE__, __LINE__ )
+
+void Host_Init();
+void Host_Reset_Registers();
+void Host_Set_Register_Hook( void (*hook)( volatile uint32_t *reg ) );
+void Host_Set_WFI_Hook( void (*hook)() );
+void Host_Check( uint8_t passed, const char *condition, const char *file, int line );
+int Host_Report( const char *name );
+uint64_t Host_Nanoseconds();
+
+#endif // __HOST_H
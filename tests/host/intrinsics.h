@@ -0,0 +1,60 @@
+// Host stand-in for the IAR intrinsics the drivers use
+//
+// There is one thread and no interrupts on the host, so the
+// interrupt mask and BASEPRI are just variables - a test can check
+// that every critical section puts the mask back the way it was.
+
+#ifndef __INTRINSICS_INCLUDED
+#define __INTRINSICS_INCLUDED
+
+#include <stdint.h>
+
+typedef uint32_t __istate_t;
+
+extern volatile uint32_t Host_PRIMASK;
+extern volatile uint32_t Host_BASEPRI;
+
+void Host_WFI( void );
+
+static inline __istate_t __get_interrupt_state( void ) {
+	return Host_PRIMASK;
+}
+
+static inline void __set_interrupt_state( __istate_t state ) {
+	Host_PRIMASK = state;
+}
+
+static inline void __disable_interrupt( void ) {
+	Host_PRIMASK = 1;
+}
+
+static inline void __enable_interrupt( void ) {
+	Host_PRIMASK = 0;
+}
+
+static inline uint32_t __get_BASEPRI( void ) {
+	return Host_BASEPRI;
+}
+
+static inline void __set_BASEPRI( uint32_t value ) {
+	Host_BASEPRI = value;
+}
+
+// The target's exclusive monitor always succeeds with one thread;
+// pointers are to 32-bit words even where the callers cast to long
+static inline uint32_t __LDREX( void *address ) {
+	return *(volatile uint32_t *) address;
+}
+
+static inline uint32_t __STREX( uint32_t value, void *address ) {
+	*(volatile uint32_t *) address = value;
+	return 0;
+}
+
+#define __CLZ( value ) ( (uint8_t) __builtin_clz( value ) )
+#define __WFI() Host_WFI()
+
+#define __no_init
+#define __weak __attribute__((weak))
+
+#endif // __INTRINSICS_INCLUDED
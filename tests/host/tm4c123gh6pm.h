@@ -0,0 +1,486 @@
+// Host stand-in for TI's tm4c123gh6pm.h
+//
+// Every register the drivers touch is a plain variable, reached
+// through Host_Register() so a test can hook accesses and play
+// the peripheral: finish a flash erase the driver is polling for,
+// complete an I2C byte, fill a UART FIFO. Bit fields carry their
+// real values, so the drivers' masks and shifts are exercised.
+//
+// Only the registers and fields the station uses are here.
+
+#ifndef __TM4C123GH6PM_H__
+#define __TM4C123GH6PM_H__
+
+#include <stdint.h>
+
+volatile uint32_t *Host_Register( volatile uint32_t *reg );
+
+#define HOST_REGISTER( name ) ( *Host_Register( &Host_##name ) )
+
+// X-macro list, so host.c can define the storage
+#define HOST_REGISTERS( X ) \
+	X( ADC0_ACTSS_R ) \
+	X( ADC0_EMUX_R ) \
+	X( ADC0_IM_R ) \
+	X( ADC0_ISC_R ) \
+	X( ADC0_PC_R ) \
+	X( ADC0_SSCTL3_R ) \
+	X( ADC0_SSFIFO3_R ) \
+	X( ADC0_SSMUX3_R ) \
+	X( ADC1_ACTSS_R ) \
+	X( ADC1_EMUX_R ) \
+	X( ADC1_IM_R ) \
+	X( ADC1_ISC_R ) \
+	X( ADC1_PC_R ) \
+	X( ADC1_PSSI_R ) \
+	X( ADC1_SAC_R ) \
+	X( ADC1_SSCTL1_R ) \
+	X( ADC1_SSFIFO1_R ) \
+	X( ADC1_SSMUX1_R ) \
+	X( EEPROM_EEBLOCK_R ) \
+	X( EEPROM_EEDONE_R ) \
+	X( EEPROM_EEOFFSET_R ) \
+	X( EEPROM_EERDWRINC_R ) \
+	X( EEPROM_EESUPP_R ) \
+	X( FLASH_BOOTCFG_R ) \
+	X( FLASH_FMA_R ) \
+	X( FLASH_FMC2_R ) \
+	X( FLASH_FMC_R ) \
+	X( GPIO_PORTA_AFSEL_R ) \
+	X( GPIO_PORTA_AMSEL_R ) \
+	X( GPIO_PORTA_DEN_R ) \
+	X( GPIO_PORTA_PCTL_R ) \
+	X( GPIO_PORTB_AFSEL_R ) \
+	X( GPIO_PORTB_AMSEL_R ) \
+	X( GPIO_PORTB_DEN_R ) \
+	X( GPIO_PORTB_DIR_R ) \
+	X( GPIO_PORTB_ODR_R ) \
+	X( GPIO_PORTB_PCTL_R ) \
+	X( GPIO_PORTB_PUR_R ) \
+	X( GPIO_PORTC_AFSEL_R ) \
+	X( GPIO_PORTC_DEN_R ) \
+	X( GPIO_PORTC_PCTL_R ) \
+	X( GPIO_PORTD_AFSEL_R ) \
+	X( GPIO_PORTD_AMSEL_R ) \
+	X( GPIO_PORTD_DEN_R ) \
+	X( GPIO_PORTD_DIR_R ) \
+	X( GPIO_PORTD_PCTL_R ) \
+	X( GPIO_PORTD_PUR_R ) \
+	X( GPIO_PORTE_AFSEL_R ) \
+	X( GPIO_PORTE_AMSEL_R ) \
+	X( GPIO_PORTE_DEN_R ) \
+	X( GPIO_PORTE_DIR_R ) \
+	X( GPIO_PORTE_PCTL_R ) \
+	X( GPIO_PORTE_PUR_R ) \
+	X( GPIO_PORTF_DEN_R ) \
+	X( GPIO_PORTF_DIR_R ) \
+	X( I2C0_MCR_R ) \
+	X( I2C0_MCS_R ) \
+	X( I2C0_MDR_R ) \
+	X( I2C0_MICR_R ) \
+	X( I2C0_MIMR_R ) \
+	X( I2C0_MMIS_R ) \
+	X( I2C0_MSA_R ) \
+	X( I2C0_MTPR_R ) \
+	X( NVIC_EN0_R ) \
+	X( NVIC_EN1_R ) \
+	X( NVIC_EN3_R ) \
+	X( NVIC_PEND0_R ) \
+	X( NVIC_PRI12_R ) \
+	X( NVIC_PRI15_R ) \
+	X( NVIC_PRI1_R ) \
+	X( NVIC_PRI25_R ) \
+	X( NVIC_PRI2_R ) \
+	X( NVIC_PRI4_R ) \
+	X( NVIC_PRI5_R ) \
+	X( NVIC_ST_CTRL_R ) \
+	X( NVIC_ST_CURRENT_R ) \
+	X( NVIC_ST_RELOAD_R ) \
+	X( NVIC_SYS_CTRL_R ) \
+	X( NVIC_SYS_PRI3_R ) \
+	X( NVIC_UNPEND0_R ) \
+	X( PWM0_0_CMPA_R ) \
+	X( PWM0_0_CTL_R ) \
+	X( PWM0_0_GENA_R ) \
+	X( PWM0_0_INTEN_R ) \
+	X( PWM0_0_ISC_R ) \
+	X( PWM0_0_LOAD_R ) \
+	X( PWM0_ENABLE_R ) \
+	X( PWM0_INTEN_R ) \
+	X( SSI0_CPSR_R ) \
+	X( SSI0_CR0_R ) \
+	X( SSI0_CR1_R ) \
+	X( SSI0_DR_R ) \
+	X( SSI0_IM_R ) \
+	X( SSI0_SR_R ) \
+	X( SYSCTL_MISC_R ) \
+	X( SYSCTL_PRADC_R ) \
+	X( SYSCTL_PRDMA_R ) \
+	X( SYSCTL_PREEPROM_R ) \
+	X( SYSCTL_PRGPIO_R ) \
+	X( SYSCTL_RCC2_R ) \
+	X( SYSCTL_RCC_R ) \
+	X( SYSCTL_RCGCADC_R ) \
+	X( SYSCTL_RCGCDMA_R ) \
+	X( SYSCTL_RCGCEEPROM_R ) \
+	X( SYSCTL_RCGCGPIO_R ) \
+	X( SYSCTL_RCGCI2C_R ) \
+	X( SYSCTL_RCGCPWM_R ) \
+	X( SYSCTL_RCGCSSI_R ) \
+	X( SYSCTL_RCGCTIMER_R ) \
+	X( SYSCTL_RCGCUART_R ) \
+	X( SYSCTL_RCGCWTIMER_R ) \
+	X( SYSCTL_RIS_R ) \
+	X( TIMER0_CFG_R ) \
+	X( TIMER0_CTL_R ) \
+	X( TIMER0_ICR_R ) \
+	X( TIMER0_IMR_R ) \
+	X( TIMER0_TAILR_R ) \
+	X( TIMER0_TAMR_R ) \
+	X( TIMER0_TAPR_R ) \
+	X( TIMER1_CFG_R ) \
+	X( TIMER1_CTL_R ) \
+	X( TIMER1_ICR_R ) \
+	X( TIMER1_IMR_R ) \
+	X( TIMER1_TAILR_R ) \
+	X( TIMER1_TAMR_R ) \
+	X( TIMER1_TAPR_R ) \
+	X( TIMER1_TAV_R ) \
+	X( TIMER2_CFG_R ) \
+	X( TIMER2_CTL_R ) \
+	X( TIMER2_ICR_R ) \
+	X( TIMER2_IMR_R ) \
+	X( TIMER2_TAILR_R ) \
+	X( TIMER2_TAMR_R ) \
+	X( TIMER2_TAPR_R ) \
+	X( TIMER3_CFG_R ) \
+	X( TIMER3_CTL_R ) \
+	X( TIMER3_IMR_R ) \
+	X( TIMER3_TAILR_R ) \
+	X( TIMER3_TAMR_R ) \
+	X( TIMER3_TAPR_R ) \
+	X( UART0_CTL_R ) \
+	X( UART0_DR_R ) \
+	X( UART0_FBRD_R ) \
+	X( UART0_FR_R ) \
+	X( UART0_IBRD_R ) \
+	X( UART0_ICR_R ) \
+	X( UART0_IFLS_R ) \
+	X( UART0_IM_R ) \
+	X( UART0_LCRH_R ) \
+	X( UART0_MIS_R ) \
+	X( UART1_CTL_R ) \
+	X( UART1_DR_R ) \
+	X( UART1_FBRD_R ) \
+	X( UART1_FR_R ) \
+	X( UART1_IBRD_R ) \
+	X( UART1_ICR_R ) \
+	X( UART1_IFLS_R ) \
+	X( UART1_IM_R ) \
+	X( UART1_LCRH_R ) \
+	X( UART1_RIS_R ) \
+	X( UART5_CTL_R ) \
+	X( UART5_DR_R ) \
+	X( UART5_FBRD_R ) \
+	X( UART5_FR_R ) \
+	X( UART5_IBRD_R ) \
+	X( UART5_ICR_R ) \
+	X( UART5_IFLS_R ) \
+	X( UART5_IM_R ) \
+	X( UART5_LCRH_R ) \
+	X( UART5_MIS_R ) \
+	X( UDMA_ALTCLR_R ) \
+	X( UDMA_CFG_R ) \
+	X( UDMA_CHMAP2_R ) \
+	X( UDMA_CTLBASE_R ) \
+	X( UDMA_ENASET_R ) \
+	X( UDMA_PRIOCLR_R ) \
+	X( UDMA_REQMASKCLR_R ) \
+	X( UDMA_USEBURSTCLR_R ) \
+	X( WTIMER3_CFG_R ) \
+	X( WTIMER3_CTL_R ) \
+	X( WTIMER3_ICR_R ) \
+	X( WTIMER3_IMR_R ) \
+	X( WTIMER3_TAILR_R ) \
+	X( WTIMER3_TAMATCHR_R ) \
+	X( WTIMER3_TAMR_R ) \
+	X( WTIMER3_TAPMR_R ) \
+	X( WTIMER3_TAPR_R ) \
+	X( WTIMER3_TAR_R ) \
+	X( WTIMER3_TBILR_R ) \
+	X( WTIMER3_TBMR_R ) \
+	X( WTIMER3_TBPR_R ) \
+	X( WTIMER3_TBR_R )
+
+#define HOST_DECLARE_REGISTER( name ) extern volatile uint32_t Host_##name;
+HOST_REGISTERS( HOST_DECLARE_REGISTER )
+
+#define ADC0_ACTSS_R HOST_REGISTER( ADC0_ACTSS_R )
+#define ADC0_EMUX_R HOST_REGISTER( ADC0_EMUX_R )
+#define ADC0_IM_R HOST_REGISTER( ADC0_IM_R )
+#define ADC0_ISC_R HOST_REGISTER( ADC0_ISC_R )
+#define ADC0_PC_R HOST_REGISTER( ADC0_PC_R )
+#define ADC0_SSCTL3_R HOST_REGISTER( ADC0_SSCTL3_R )
+#define ADC0_SSFIFO3_R HOST_REGISTER( ADC0_SSFIFO3_R )
+#define ADC0_SSMUX3_R HOST_REGISTER( ADC0_SSMUX3_R )
+#define ADC1_ACTSS_R HOST_REGISTER( ADC1_ACTSS_R )
+#define ADC1_EMUX_R HOST_REGISTER( ADC1_EMUX_R )
+#define ADC1_IM_R HOST_REGISTER( ADC1_IM_R )
+#define ADC1_ISC_R HOST_REGISTER( ADC1_ISC_R )
+#define ADC1_PC_R HOST_REGISTER( ADC1_PC_R )
+#define ADC1_PSSI_R HOST_REGISTER( ADC1_PSSI_R )
+#define ADC1_SAC_R HOST_REGISTER( ADC1_SAC_R )
+#define ADC1_SSCTL1_R HOST_REGISTER( ADC1_SSCTL1_R )
+#define ADC1_SSFIFO1_R HOST_REGISTER( ADC1_SSFIFO1_R )
+#define ADC1_SSMUX1_R HOST_REGISTER( ADC1_SSMUX1_R )
+#define EEPROM_EEBLOCK_R HOST_REGISTER( EEPROM_EEBLOCK_R )
+#define EEPROM_EEDONE_R HOST_REGISTER( EEPROM_EEDONE_R )
+#define EEPROM_EEOFFSET_R HOST_REGISTER( EEPROM_EEOFFSET_R )
+#define EEPROM_EERDWRINC_R HOST_REGISTER( EEPROM_EERDWRINC_R )
+#define EEPROM_EESUPP_R HOST_REGISTER( EEPROM_EESUPP_R )
+#define FLASH_BOOTCFG_R HOST_REGISTER( FLASH_BOOTCFG_R )
+#define FLASH_FMA_R HOST_REGISTER( FLASH_FMA_R )
+#define FLASH_FMC2_R HOST_REGISTER( FLASH_FMC2_R )
+#define FLASH_FMC_R HOST_REGISTER( FLASH_FMC_R )
+#define GPIO_PORTA_AFSEL_R HOST_REGISTER( GPIO_PORTA_AFSEL_R )
+#define GPIO_PORTA_AMSEL_R HOST_REGISTER( GPIO_PORTA_AMSEL_R )
+#define GPIO_PORTA_DEN_R HOST_REGISTER( GPIO_PORTA_DEN_R )
+#define GPIO_PORTA_PCTL_R HOST_REGISTER( GPIO_PORTA_PCTL_R )
+#define GPIO_PORTB_AFSEL_R HOST_REGISTER( GPIO_PORTB_AFSEL_R )
+#define GPIO_PORTB_AMSEL_R HOST_REGISTER( GPIO_PORTB_AMSEL_R )
+#define GPIO_PORTB_DEN_R HOST_REGISTER( GPIO_PORTB_DEN_R )
+#define GPIO_PORTB_DIR_R HOST_REGISTER( GPIO_PORTB_DIR_R )
+#define GPIO_PORTB_ODR_R HOST_REGISTER( GPIO_PORTB_ODR_R )
+#define GPIO_PORTB_PCTL_R HOST_REGISTER( GPIO_PORTB_PCTL_R )
+#define GPIO_PORTB_PUR_R HOST_REGISTER( GPIO_PORTB_PUR_R )
+#define GPIO_PORTC_AFSEL_R HOST_REGISTER( GPIO_PORTC_AFSEL_R )
+#define GPIO_PORTC_DEN_R HOST_REGISTER( GPIO_PORTC_DEN_R )
+#define GPIO_PORTC_PCTL_R HOST_REGISTER( GPIO_PORTC_PCTL_R )
+#define GPIO_PORTD_AFSEL_R HOST_REGISTER( GPIO_PORTD_AFSEL_R )
+#define GPIO_PORTD_AMSEL_R HOST_REGISTER( GPIO_PORTD_AMSEL_R )
+#define GPIO_PORTD_DEN_R HOST_REGISTER( GPIO_PORTD_DEN_R )
+#define GPIO_PORTD_DIR_R HOST_REGISTER( GPIO_PORTD_DIR_R )
+#define GPIO_PORTD_PCTL_R HOST_REGISTER( GPIO_PORTD_PCTL_R )
+#define GPIO_PORTD_PUR_R HOST_REGISTER( GPIO_PORTD_PUR_R )
+#define GPIO_PORTE_AFSEL_R HOST_REGISTER( GPIO_PORTE_AFSEL_R )
+#define GPIO_PORTE_AMSEL_R HOST_REGISTER( GPIO_PORTE_AMSEL_R )
+#define GPIO_PORTE_DEN_R HOST_REGISTER( GPIO_PORTE_DEN_R )
+#define GPIO_PORTE_DIR_R HOST_REGISTER( GPIO_PORTE_DIR_R )
+#define GPIO_PORTE_PCTL_R HOST_REGISTER( GPIO_PORTE_PCTL_R )
+#define GPIO_PORTE_PUR_R HOST_REGISTER( GPIO_PORTE_PUR_R )
+#define GPIO_PORTF_DEN_R HOST_REGISTER( GPIO_PORTF_DEN_R )
+#define GPIO_PORTF_DIR_R HOST_REGISTER( GPIO_PORTF_DIR_R )
+#define I2C0_MCR_R HOST_REGISTER( I2C0_MCR_R )
+#define I2C0_MCS_R HOST_REGISTER( I2C0_MCS_R )
+#define I2C0_MDR_R HOST_REGISTER( I2C0_MDR_R )
+#define I2C0_MICR_R HOST_REGISTER( I2C0_MICR_R )
+#define I2C0_MIMR_R HOST_REGISTER( I2C0_MIMR_R )
+#define I2C0_MMIS_R HOST_REGISTER( I2C0_MMIS_R )
+#define I2C0_MSA_R HOST_REGISTER( I2C0_MSA_R )
+#define I2C0_MTPR_R HOST_REGISTER( I2C0_MTPR_R )
+#define NVIC_EN0_R HOST_REGISTER( NVIC_EN0_R )
+#define NVIC_EN1_R HOST_REGISTER( NVIC_EN1_R )
+#define NVIC_EN3_R HOST_REGISTER( NVIC_EN3_R )
+#define NVIC_PEND0_R HOST_REGISTER( NVIC_PEND0_R )
+#define NVIC_PRI12_R HOST_REGISTER( NVIC_PRI12_R )
+#define NVIC_PRI15_R HOST_REGISTER( NVIC_PRI15_R )
+#define NVIC_PRI1_R HOST_REGISTER( NVIC_PRI1_R )
+#define NVIC_PRI25_R HOST_REGISTER( NVIC_PRI25_R )
+#define NVIC_PRI2_R HOST_REGISTER( NVIC_PRI2_R )
+#define NVIC_PRI4_R HOST_REGISTER( NVIC_PRI4_R )
+#define NVIC_PRI5_R HOST_REGISTER( NVIC_PRI5_R )
+#define NVIC_ST_CTRL_R HOST_REGISTER( NVIC_ST_CTRL_R )
+#define NVIC_ST_CURRENT_R HOST_REGISTER( NVIC_ST_CURRENT_R )
+#define NVIC_ST_RELOAD_R HOST_REGISTER( NVIC_ST_RELOAD_R )
+#define NVIC_SYS_CTRL_R HOST_REGISTER( NVIC_SYS_CTRL_R )
+#define NVIC_SYS_PRI3_R HOST_REGISTER( NVIC_SYS_PRI3_R )
+#define NVIC_UNPEND0_R HOST_REGISTER( NVIC_UNPEND0_R )
+#define PWM0_0_CMPA_R HOST_REGISTER( PWM0_0_CMPA_R )
+#define PWM0_0_CTL_R HOST_REGISTER( PWM0_0_CTL_R )
+#define PWM0_0_GENA_R HOST_REGISTER( PWM0_0_GENA_R )
+#define PWM0_0_INTEN_R HOST_REGISTER( PWM0_0_INTEN_R )
+#define PWM0_0_ISC_R HOST_REGISTER( PWM0_0_ISC_R )
+#define PWM0_0_LOAD_R HOST_REGISTER( PWM0_0_LOAD_R )
+#define PWM0_ENABLE_R HOST_REGISTER( PWM0_ENABLE_R )
+#define PWM0_INTEN_R HOST_REGISTER( PWM0_INTEN_R )
+#define SSI0_CPSR_R HOST_REGISTER( SSI0_CPSR_R )
+#define SSI0_CR0_R HOST_REGISTER( SSI0_CR0_R )
+#define SSI0_CR1_R HOST_REGISTER( SSI0_CR1_R )
+#define SSI0_DR_R HOST_REGISTER( SSI0_DR_R )
+#define SSI0_IM_R HOST_REGISTER( SSI0_IM_R )
+#define SSI0_SR_R HOST_REGISTER( SSI0_SR_R )
+#define SYSCTL_MISC_R HOST_REGISTER( SYSCTL_MISC_R )
+#define SYSCTL_PRADC_R HOST_REGISTER( SYSCTL_PRADC_R )
+#define SYSCTL_PRDMA_R HOST_REGISTER( SYSCTL_PRDMA_R )
+#define SYSCTL_PREEPROM_R HOST_REGISTER( SYSCTL_PREEPROM_R )
+#define SYSCTL_PRGPIO_R HOST_REGISTER( SYSCTL_PRGPIO_R )
+#define SYSCTL_RCC2_R HOST_REGISTER( SYSCTL_RCC2_R )
+#define SYSCTL_RCC_R HOST_REGISTER( SYSCTL_RCC_R )
+#define SYSCTL_RCGCADC_R HOST_REGISTER( SYSCTL_RCGCADC_R )
+#define SYSCTL_RCGCDMA_R HOST_REGISTER( SYSCTL_RCGCDMA_R )
+#define SYSCTL_RCGCEEPROM_R HOST_REGISTER( SYSCTL_RCGCEEPROM_R )
+#define SYSCTL_RCGCGPIO_R HOST_REGISTER( SYSCTL_RCGCGPIO_R )
+#define SYSCTL_RCGCI2C_R HOST_REGISTER( SYSCTL_RCGCI2C_R )
+#define SYSCTL_RCGCPWM_R HOST_REGISTER( SYSCTL_RCGCPWM_R )
+#define SYSCTL_RCGCSSI_R HOST_REGISTER( SYSCTL_RCGCSSI_R )
+#define SYSCTL_RCGCTIMER_R HOST_REGISTER( SYSCTL_RCGCTIMER_R )
+#define SYSCTL_RCGCUART_R HOST_REGISTER( SYSCTL_RCGCUART_R )
+#define SYSCTL_RCGCWTIMER_R HOST_REGISTER( SYSCTL_RCGCWTIMER_R )
+#define SYSCTL_RIS_R HOST_REGISTER( SYSCTL_RIS_R )
+#define TIMER0_CFG_R HOST_REGISTER( TIMER0_CFG_R )
+#define TIMER0_CTL_R HOST_REGISTER( TIMER0_CTL_R )
+#define TIMER0_ICR_R HOST_REGISTER( TIMER0_ICR_R )
+#define TIMER0_IMR_R HOST_REGISTER( TIMER0_IMR_R )
+#define TIMER0_TAILR_R HOST_REGISTER( TIMER0_TAILR_R )
+#define TIMER0_TAMR_R HOST_REGISTER( TIMER0_TAMR_R )
+#define TIMER0_TAPR_R HOST_REGISTER( TIMER0_TAPR_R )
+#define TIMER1_CFG_R HOST_REGISTER( TIMER1_CFG_R )
+#define TIMER1_CTL_R HOST_REGISTER( TIMER1_CTL_R )
+#define TIMER1_ICR_R HOST_REGISTER( TIMER1_ICR_R )
+#define TIMER1_IMR_R HOST_REGISTER( TIMER1_IMR_R )
+#define TIMER1_TAILR_R HOST_REGISTER( TIMER1_TAILR_R )
+#define TIMER1_TAMR_R HOST_REGISTER( TIMER1_TAMR_R )
+#define TIMER1_TAPR_R HOST_REGISTER( TIMER1_TAPR_R )
+#define TIMER1_TAV_R HOST_REGISTER( TIMER1_TAV_R )
+#define TIMER2_CFG_R HOST_REGISTER( TIMER2_CFG_R )
+#define TIMER2_CTL_R HOST_REGISTER( TIMER2_CTL_R )
+#define TIMER2_ICR_R HOST_REGISTER( TIMER2_ICR_R )
+#define TIMER2_IMR_R HOST_REGISTER( TIMER2_IMR_R )
+#define TIMER2_TAILR_R HOST_REGISTER( TIMER2_TAILR_R )
+#define TIMER2_TAMR_R HOST_REGISTER( TIMER2_TAMR_R )
+#define TIMER2_TAPR_R HOST_REGISTER( TIMER2_TAPR_R )
+#define TIMER3_CFG_R HOST_REGISTER( TIMER3_CFG_R )
+#define TIMER3_CTL_R HOST_REGISTER( TIMER3_CTL_R )
+#define TIMER3_IMR_R HOST_REGISTER( TIMER3_IMR_R )
+#define TIMER3_TAILR_R HOST_REGISTER( TIMER3_TAILR_R )
+#define TIMER3_TAMR_R HOST_REGISTER( TIMER3_TAMR_R )
+#define TIMER3_TAPR_R HOST_REGISTER( TIMER3_TAPR_R )
+#define UART0_CTL_R HOST_REGISTER( UART0_CTL_R )
+#define UART0_DR_R HOST_REGISTER( UART0_DR_R )
+#define UART0_FBRD_R HOST_REGISTER( UART0_FBRD_R )
+#define UART0_FR_R HOST_REGISTER( UART0_FR_R )
+#define UART0_IBRD_R HOST_REGISTER( UART0_IBRD_R )
+#define UART0_ICR_R HOST_REGISTER( UART0_ICR_R )
+#define UART0_IFLS_R HOST_REGISTER( UART0_IFLS_R )
+#define UART0_IM_R HOST_REGISTER( UART0_IM_R )
+#define UART0_LCRH_R HOST_REGISTER( UART0_LCRH_R )
+#define UART0_MIS_R HOST_REGISTER( UART0_MIS_R )
+#define UART1_CTL_R HOST_REGISTER( UART1_CTL_R )
+#define UART1_DR_R HOST_REGISTER( UART1_DR_R )
+#define UART1_FBRD_R HOST_REGISTER( UART1_FBRD_R )
+#define UART1_FR_R HOST_REGISTER( UART1_FR_R )
+#define UART1_IBRD_R HOST_REGISTER( UART1_IBRD_R )
+#define UART1_ICR_R HOST_REGISTER( UART1_ICR_R )
+#define UART1_IFLS_R HOST_REGISTER( UART1_IFLS_R )
+#define UART1_IM_R HOST_REGISTER( UART1_IM_R )
+#define UART1_LCRH_R HOST_REGISTER( UART1_LCRH_R )
+#define UART1_RIS_R HOST_REGISTER( UART1_RIS_R )
+#define UART5_CTL_R HOST_REGISTER( UART5_CTL_R )
+#define UART5_DR_R HOST_REGISTER( UART5_DR_R )
+#define UART5_FBRD_R HOST_REGISTER( UART5_FBRD_R )
+#define UART5_FR_R HOST_REGISTER( UART5_FR_R )
+#define UART5_IBRD_R HOST_REGISTER( UART5_IBRD_R )
+#define UART5_ICR_R HOST_REGISTER( UART5_ICR_R )
+#define UART5_IFLS_R HOST_REGISTER( UART5_IFLS_R )
+#define UART5_IM_R HOST_REGISTER( UART5_IM_R )
+#define UART5_LCRH_R HOST_REGISTER( UART5_LCRH_R )
+#define UART5_MIS_R HOST_REGISTER( UART5_MIS_R )
+#define UDMA_ALTCLR_R HOST_REGISTER( UDMA_ALTCLR_R )
+#define UDMA_CFG_R HOST_REGISTER( UDMA_CFG_R )
+#define UDMA_CHMAP2_R HOST_REGISTER( UDMA_CHMAP2_R )
+#define UDMA_CTLBASE_R HOST_REGISTER( UDMA_CTLBASE_R )
+#define UDMA_ENASET_R HOST_REGISTER( UDMA_ENASET_R )
+#define UDMA_PRIOCLR_R HOST_REGISTER( UDMA_PRIOCLR_R )
+#define UDMA_REQMASKCLR_R HOST_REGISTER( UDMA_REQMASKCLR_R )
+#define UDMA_USEBURSTCLR_R HOST_REGISTER( UDMA_USEBURSTCLR_R )
+#define WTIMER3_CFG_R HOST_REGISTER( WTIMER3_CFG_R )
+#define WTIMER3_CTL_R HOST_REGISTER( WTIMER3_CTL_R )
+#define WTIMER3_ICR_R HOST_REGISTER( WTIMER3_ICR_R )
+#define WTIMER3_IMR_R HOST_REGISTER( WTIMER3_IMR_R )
+#define WTIMER3_TAILR_R HOST_REGISTER( WTIMER3_TAILR_R )
+#define WTIMER3_TAMATCHR_R HOST_REGISTER( WTIMER3_TAMATCHR_R )
+#define WTIMER3_TAMR_R HOST_REGISTER( WTIMER3_TAMR_R )
+#define WTIMER3_TAPMR_R HOST_REGISTER( WTIMER3_TAPMR_R )
+#define WTIMER3_TAPR_R HOST_REGISTER( WTIMER3_TAPR_R )
+#define WTIMER3_TAR_R HOST_REGISTER( WTIMER3_TAR_R )
+#define WTIMER3_TBILR_R HOST_REGISTER( WTIMER3_TBILR_R )
+#define WTIMER3_TBMR_R HOST_REGISTER( WTIMER3_TBMR_R )
+#define WTIMER3_TBPR_R HOST_REGISTER( WTIMER3_TBPR_R )
+#define WTIMER3_TBR_R HOST_REGISTER( WTIMER3_TBR_R )
+
+#define EEPROM_EEDONE_WORKING 0x00000001
+#define EEPROM_EESUPP_ERETRY 0x00000004
+#define EEPROM_EESUPP_PRETRY 0x00000008
+
+#define FLASH_BOOTCFG_KEY 0x00000010
+#define FLASH_FMC2_WRBUF 0x00000001
+#define FLASH_FMC_ERASE 0x00000002
+#define FLASH_FMC_WRKEY 0xA4420000
+
+#define I2C_MCS_RUN 0x00000001
+#define I2C_MCS_BUSY 0x00000001
+#define I2C_MCS_START 0x00000002
+#define I2C_MCS_ERROR 0x00000002
+#define I2C_MCS_STOP 0x00000004
+#define I2C_MCS_ADRACK 0x00000004
+#define I2C_MCS_ACK 0x00000008
+#define I2C_MCS_DATACK 0x00000008
+#define I2C_MCS_ARBLST 0x00000010
+#define I2C_MCS_IDLE 0x00000020
+#define I2C_MCS_BUSBSY 0x00000040
+#define I2C_MICR_IC 0x00000001
+#define I2C_MIMR_IM 0x00000001
+#define I2C_MMIS_MIS 0x00000001
+
+#define PWM_0_CTL_ENABLE 0x00000001
+#define PWM_0_GENA_ACTLOAD_ONE 0x0000000C
+#define PWM_0_GENA_ACTCMPAD_ZERO 0x00000080
+#define PWM_0_INTEN_INTCNTLOAD 0x00000002
+#define PWM_0_ISC_INTCNTLOAD 0x00000002
+#define PWM_ENABLE_PWM0EN 0x00000001
+#define PWM_INTEN_INTPWM0 0x00000001
+
+#define SYSCTL_RCC_USEPWMDIV 0x00100000
+
+#define TIMER_CFG_32_BIT_TIMER 0x00000000
+#define TIMER_CFG_16_BIT 0x00000004
+#define TIMER_CTL_TAEN 0x00000001
+#define TIMER_CTL_TAEVENT_NEG 0x00000004
+#define TIMER_CTL_TAEVENT_M 0x0000000C
+#define TIMER_CTL_TAOTE 0x00000020
+#define TIMER_CTL_TBEN 0x00000100
+#define TIMER_CTL_TBEVENT_NEG 0x00000400
+#define TIMER_CTL_TBEVENT_M 0x00000C00
+#define TIMER_ICR_TATOCINT 0x00000001
+#define TIMER_ICR_CAECINT 0x00000004
+#define TIMER_ICR_CBECINT 0x00000400
+#define TIMER_IMR_TATOIM 0x00000001
+#define TIMER_IMR_CAEIM 0x00000004
+#define TIMER_IMR_CBEIM 0x00000400
+#define TIMER_TAMR_TAMR_1_SHOT 0x00000001
+#define TIMER_TAMR_TAMR_PERIOD 0x00000002
+#define TIMER_TAMR_TAMR_CAP 0x00000003
+#define TIMER_TAMR_TACMR 0x00000004
+#define TIMER_TAMR_TACDIR 0x00000010
+#define TIMER_TBMR_TBMR_CAP 0x00000003
+#define TIMER_TBMR_TBCMR 0x00000004
+#define TIMER_TBMR_TBCDIR 0x00000010
+
+#define UART_CTL_UARTEN 0x00000001
+#define UART_CTL_TXE 0x00000100
+#define UART_CTL_RXE 0x00000200
+#define UART_FR_BUSY 0x00000008
+#define UART_FR_RXFE 0x00000010
+#define UART_FR_TXFF 0x00000020
+#define UART_ICR_RXIC 0x00000010
+#define UART_ICR_TXIC 0x00000020
+#define UART_ICR_RTIC 0x00000040
+#define UART_IM_RXIM 0x00000010
+#define UART_IM_TXIM 0x00000020
+#define UART_IM_RTIM 0x00000040
+#define UART_MIS_RXMIS 0x00000010
+#define UART_MIS_TXMIS 0x00000020
+#define UART_MIS_RTMIS 0x00000040
+#define UART_RIS_RXRIS 0x00000010
+
+#endif // __TM4C123GH6PM_H__
@@ -0,0 +1,720 @@
+// Host test of the I2C transaction engine against simulated devices
+//
+// Plays I2C0 at 100 kHz behind the stand-in registers: each
+// command the engine writes to MCS takes the bus for its bytes and
+// then interrupts, with Timer2A's one-shots and the seconds tick
+// on the same clock. On the bus are the radio (16-bit registers),
+// a sensor with 8-bit auto-incrementing registers that NACKs
+// writes to its read-only ones, nothing at all at one address, and
+// a device that holds SCL and SDA low until clocked free.
+//
+// Checks the commands make well-formed transactions (nothing
+// written while the bus is busy, a STOP after every error and on
+// every last byte read, repeated starts only to the same device),
+// the radio's masked writes and every burst read's data against
+// the devices, a NACK finished only once its STOP is out, a stuck
+// bus ended with PWM_I2C_TIMEOUT and clocked free, and a full
+// queue refused. Then, with the radio's queue kept full, that a
+// waiting sensor never sits through more than a burst of radio
+// transactions and the bus never idles, and with the radio polling
+// RSSI every 10 ms, how soon the sensor's reads get the bus.
+// Prints the latencies and bus utilizations.
+
+#include "host.h"
+#include "pwm-i2c.h"
+#include "clock.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Mirrors pwm-i2c.c
+#define TEST_RADIO_BURST 4
+#define TEST_TIMEOUT_SECONDS 2
+
+// Nine bit times at 100 kHz a byte, and a little for START or STOP
+#define TEST_BYTE_US 90
+#define TEST_EDGE_US 10
+
+#define TEST_RADIO 0x71
+#define TEST_SENSOR 0x76
+#define TEST_MISSING 0x40
+#define TEST_STUCK 0x50
+
+// The sensor's measurements, read only
+#define TEST_SENSOR_DATA 0xF7
+#define TEST_SENSOR_LENGTH 8
+
+// The engine never writes this - a command is anything else
+#define TEST_NO_COMMAND 0xFFFF0000
+
+// The handlers, which pwm-i2c.h leaves to the vector table
+void PWM_I2C_I2C0_Handler();
+void PWM_I2C_Timer2A_Handler();
+
+#define TEST_PB2 ( *( (volatile uint32_t *) 0x40005010 ) )
+#define TEST_PB3 ( *( (volatile uint32_t *) 0x40005020 ) )
+
+static const PWM_I2C_Device sensorDevice = { TEST_SENSOR, PWM_I2C_PRIORITY_SENSOR };
+static const PWM_I2C_Device missingDevice = { TEST_MISSING, PWM_I2C_PRIORITY_SENSOR };
+static const PWM_I2C_Device stuckDevice = { TEST_STUCK, PWM_I2C_PRIORITY_SENSOR };
+
+// Simulated time, in microseconds
+static uint64_t now;
+static uint64_t nextSecond = 1000000;
+
+// The bus: a command in flight, and the transaction it's part of
+static uint8_t busBusy;
+static uint64_t busDoneAt;
+static uint32_t busStatus;
+static uint8_t busRelease;
+static uint8_t busOwned;
+static uint8_t busAddress;
+static uint8_t busRead;
+static uint8_t busPointerSet;
+static uint8_t busPointer;
+static uint8_t busLowByte;
+static uint8_t busHigh;
+static uint8_t busStopNeeded;
+static uint8_t busArbitrationLost;
+static uint64_t busyUs;
+static uint32_t busBytes;
+static uint32_t violations;
+static uint32_t recoveriesSeen;
+
+static uint8_t stuck;
+static uint8_t sdaHeld;
+
+static uint8_t timerArmed;
+static uint64_t timerAt;
+
+// The devices' registers
+static uint16_t radioRegisters[128];
+static uint8_t sensorRegisters[256];
+
+// Who took the bus, for fairness
+static uint32_t sensorsWaiting;
+static uint8_t radioRun;
+static uint8_t longestRadioRun;
+static uint32_t radioStarts;
+static uint32_t sensorStarts;
+
+static uint32_t dryCallbacks;
+
+void Telemetry_Send_Event( uint8_t event, uint32_t data ) {
+}
+
+/*
+ * SDA stays low while the stuck device has it, until the recovery
+ * clocks it free
+ */
+void _Test_Register_Hook( volatile uint32_t *reg ) {
+	if ( ( reg == &Host_GPIO_PORTB_DIR_R ) && stuck ) {
+		TEST_PB3 = 0;
+		stuck = 0;
+		sdaHeld = 1;
+	}
+}
+
+/*
+ * A byte to the device addressed - the first sets its register
+ * Returns 0 if the device NACKs it
+ */
+uint8_t _Test_Device_Write( uint8_t data ) {
+	if ( ! busPointerSet ) {
+		busPointer = data;
+		busPointerSet = 1;
+		busLowByte = 0;
+		return 1;
+	}
+	if ( TEST_RADIO == busAddress ) {
+		if ( busLowByte ) {
+			radioRegisters[busPointer & 0x7F] = ( busHigh << 8 ) | data;
+			busPointer++;
+		} else {
+			busHigh = data;
+		}
+		busLowByte = ! busLowByte;
+		return 1;
+	}
+	if ( busPointer >= TEST_SENSOR_DATA ) {
+		return 0;
+	}
+	sensorRegisters[busPointer++] = data;
+	return 1;
+}
+
+uint8_t _Test_Device_Read() {
+	if ( TEST_RADIO == busAddress ) {
+		uint16_t value = radioRegisters[busPointer & 0x7F];
+		busLowByte = ! busLowByte;
+		if ( busLowByte ) {
+			return value >> 8;
+		}
+		busPointer++;
+		return value & 0xFF;
+	}
+	return sensorRegisters[busPointer++];
+}
+
+void _Test_Started( uint8_t address ) {
+	if ( TEST_RADIO == address ) {
+		radioStarts++;
+		if ( sensorsWaiting ) {
+			radioRun++;
+			if ( radioRun > longestRadioRun ) {
+				longestRadioRun = radioRun;
+			}
+		}
+	} else {
+		sensorStarts++;
+		radioRun = 0;
+		if ( sensorsWaiting ) {
+			sensorsWaiting--;
+		}
+	}
+}
+
+void _Test_Violation( uint8_t ok ) {
+	HOST_CHECK( ok );
+	violations += ! ok;
+}
+
+/*
+ * What the engine just wrote to MCS
+ */
+void _Test_Command( uint32_t command ) {
+	uint32_t duration = 0;
+
+	_Test_Violation( ! busBusy );
+	busStatus = 0;
+	busRelease = 0;
+
+	if ( busStopNeeded ) {
+		// After an error, only a STOP
+		_Test_Violation( I2C_MCS_STOP == command );
+		busStopNeeded = 0;
+	}
+
+	if ( command & I2C_MCS_START ) {
+		_Test_Violation( command & I2C_MCS_RUN );
+		uint8_t address = Host_I2C0_MSA_R >> 1;
+		if ( busOwned ) {
+			// A repeated start turns the bus round for the read
+			_Test_Violation( address == busAddress );
+			_Test_Violation( Host_I2C0_MSA_R & 0x01 );
+		} else {
+			busPointerSet = 0;
+			_Test_Started( address );
+		}
+		busOwned = 1;
+		busAddress = address;
+		busRead = Host_I2C0_MSA_R & 0x01;
+		busLowByte = 0;
+		duration += TEST_EDGE_US + TEST_BYTE_US;
+
+		if ( TEST_STUCK == address ) {
+			// Holds SCL low - no interrupt, ever
+			stuck = 1;
+			busBusy = 1;
+			busDoneAt = UINT64_MAX;
+			return;
+		}
+		if ( ( TEST_RADIO != address ) && ( TEST_SENSOR != address ) ) {
+			busStatus = I2C_MCS_ERROR | I2C_MCS_ADRACK;
+		}
+	}
+
+	if ( ( command & I2C_MCS_RUN ) && ! busStatus ) {
+		_Test_Violation( busOwned );
+		duration += TEST_BYTE_US;
+		if ( busArbitrationLost ) {
+			// Someone else's START won - we're off the bus
+			busArbitrationLost = 0;
+			busStatus = I2C_MCS_ERROR | I2C_MCS_ARBLST;
+			busOwned = 0;
+		} else if ( busRead ) {
+			// ACK every byte but the last, which has the STOP
+			_Test_Violation( ! ( command & I2C_MCS_ACK ) == !! ( command & I2C_MCS_STOP ) );
+			Host_I2C0_MDR_R = _Test_Device_Read();
+			busBytes++;
+		} else if ( _Test_Device_Write( Host_I2C0_MDR_R ) ) {
+			busBytes++;
+		} else {
+			busStatus = I2C_MCS_ERROR | I2C_MCS_DATACK;
+		}
+	}
+
+	if ( busStatus & I2C_MCS_ARBLST ) {
+		// Nothing more to send
+	} else if ( busStatus & I2C_MCS_ERROR ) {
+		// The master holds the bus until told to STOP
+		busStopNeeded = 1;
+	} else if ( command & I2C_MCS_STOP ) {
+		_Test_Violation( busOwned );
+		duration += TEST_EDGE_US;
+		busRelease = 1;
+	}
+	if ( ! ( command & ( I2C_MCS_RUN | I2C_MCS_STOP ) ) ) {
+		_Test_Violation( 0 );
+	}
+
+	busBusy = 1;
+	busDoneAt = now + duration;
+	busyUs += duration;
+}
+
+/*
+ * Picks up what a handler, or a queueing call, left behind:
+ * a recovered bus, a command, a one-shot started
+ */
+void _Test_After() {
+	uint32_t recoveries;
+	PWM_I2C_Get_Stats( 0, 0, 0, &recoveries );
+	if ( recoveries != recoveriesSeen ) {
+		recoveriesSeen = recoveries;
+		busBusy = 0;
+		busOwned = 0;
+		busStopNeeded = 0;
+	}
+
+	if ( TEST_NO_COMMAND != Host_I2C0_MCS_R ) {
+		_Test_Command( Host_I2C0_MCS_R );
+		Host_I2C0_MCS_R = TEST_NO_COMMAND;
+	}
+
+	if ( Host_TIMER2_CTL_R & TIMER_CTL_TAEN ) {
+		_Test_Violation( ! timerArmed );
+		timerArmed = 1;
+		timerAt = now + Host_TIMER2_TAILR_R / Clock_Get_MHz();
+		Host_TIMER2_CTL_R &= ~TIMER_CTL_TAEN;
+	}
+}
+
+/*
+ * Takes the I2C0 interrupt when it's been pended
+ */
+void _Test_Service() {
+	_Test_After();
+	while ( Host_NVIC_PEND0_R & ( 1 << 8 ) ) {
+		Host_NVIC_PEND0_R = 0;
+		PWM_I2C_I2C0_Handler();
+		_Test_After();
+	}
+}
+
+/*
+ * Runs the bus, the one-shot and the seconds tick to time
+ */
+void _Test_Run_Until( uint64_t time ) {
+	_Test_Service();
+	for ( ;; ) {
+		uint64_t next = time;
+		if ( busBusy && ( busDoneAt < next ) ) {
+			next = busDoneAt;
+		}
+		if ( timerArmed && ( timerAt < next ) ) {
+			next = timerAt;
+		}
+		if ( nextSecond < next ) {
+			next = nextSecond;
+		}
+		now = next;
+
+		if ( busBusy && ( busDoneAt == now ) ) {
+			busBusy = 0;
+			if ( busRelease ) {
+				busOwned = 0;
+			}
+			Host_I2C0_MCS_R = busStatus;
+			Host_I2C0_MMIS_R = I2C_MMIS_MIS;
+			PWM_I2C_I2C0_Handler();
+			Host_I2C0_MMIS_R = 0;
+			// No command is ever a status, so an unchanged MCS means
+			// nothing more was asked for
+			if ( busStatus == Host_I2C0_MCS_R ) {
+				Host_I2C0_MCS_R = TEST_NO_COMMAND;
+			}
+		} else if ( timerArmed && ( timerAt == now ) ) {
+			timerArmed = 0;
+			PWM_I2C_Timer2A_Handler();
+		} else if ( nextSecond == now ) {
+			nextSecond += 1000000;
+			PWM_I2C_Tick_Second();
+		} else {
+			return;
+		}
+		_Test_Service();
+	}
+}
+
+/*
+ * Bus time used since busyBefore, less what's still to come of
+ * the command on it
+ */
+double _Test_Utilization( uint64_t busyBefore, uint64_t start ) {
+	uint64_t busy = busyUs - busyBefore;
+	if ( busBusy && ( busDoneAt != UINT64_MAX ) ) {
+		busy -= busDoneAt - now;
+	}
+	return 100.0 * busy / ( now - start );
+}
+
+uint8_t _Test_Idle() {
+	return ! busBusy && ! busOwned && ! timerArmed;
+}
+
+void _Test_Dry() {
+	dryCallbacks++;
+}
+
+// Masked writes and reads of the radio's words
+static uint16_t radioModel[128];
+static uint32_t wordReads;
+static uint32_t wordReadErrors;
+
+void _Test_Word_Read( uint16_t data ) {
+	wordReads++;
+	wordReadErrors += ( data != radioModel[0x0A] );
+}
+
+void _Test_Radio() {
+	for ( uint8_t reg=0; reg < 128; reg++ ) {
+		radioRegisters[reg] = radioModel[reg] = rand() & 0xFFFF;
+	}
+
+	// A set up burst, some writes keeping bits, a few with a
+	// settling wait after
+	for ( uint8_t i=0; i < 60; i++ ) {
+		uint8_t reg = 0x30 + rand() % 16;
+		uint16_t mask = ( rand() % 3 ) ? 0xFFFF : rand() & 0xFFFF;
+		uint16_t data = rand() & ~mask & 0xFFFF;
+		uint16_t wait = ( 19 == i % 20 ) ? 50 : 0;
+		if ( 0xFFFF == mask ) {
+			data = rand() & 0xFFFF;
+			radioModel[reg] = data;
+		} else {
+			radioModel[reg] = ( radioModel[reg] & mask ) | data;
+		}
+		PWM_I2C_Queue_Command( reg, data, mask, wait );
+	}
+	radioModel[0x0A] = radioRegisters[0x0A];
+	PWM_I2C_Queue_Read( 0x0A, _Test_Word_Read, 0 );
+	_Test_Service();
+
+	_Test_Run_Until( now + 1000000 );
+	HOST_CHECK( _Test_Idle() );
+	HOST_CHECK( 0 == memcmp( radioModel, radioRegisters, sizeof( radioModel ) ) );
+	HOST_CHECK( 1 == wordReads );
+	HOST_CHECK( 0 == wordReadErrors );
+	// Dry once, after the last wait and the read behind it
+	HOST_CHECK( 1 == dryCallbacks );
+}
+
+// Burst reads and writes of the sensor's registers
+static uint8_t sensorData[TEST_SENSOR_LENGTH];
+static uint8_t sensorExpected[TEST_SENSOR_LENGTH];
+static uint8_t lastStatus;
+static uint32_t sensorCompleted;
+static uint32_t sensorDataErrors;
+static uint64_t sensorQueuedAt[64];
+static uint64_t sensorLatency;
+static uint64_t sensorMaxLatency;
+static uint64_t statusAt;
+
+void _Test_Sensor_Read( uint8_t status, uint8_t *data, uint8_t length ) {
+	uint64_t latency = now - sensorQueuedAt[sensorCompleted % 64];
+
+	HOST_CHECK( PWM_I2C_OK == status );
+	HOST_CHECK( TEST_SENSOR_LENGTH == length );
+	HOST_CHECK( data == sensorData );
+	sensorDataErrors += ( 0 != memcmp( data, sensorExpected, TEST_SENSOR_LENGTH ) );
+	sensorCompleted++;
+	sensorLatency += latency;
+	if ( latency > sensorMaxLatency ) {
+		sensorMaxLatency = latency;
+	}
+}
+
+void _Test_Status( uint8_t status, uint8_t *data, uint8_t length ) {
+	lastStatus = status;
+	statusAt = now;
+}
+
+uint8_t _Test_Queue_Sensor_Read( uint32_t queued ) {
+	if ( ! PWM_I2C_Queue_Burst_Read( &sensorDevice, TEST_SENSOR_DATA, sensorData, TEST_SENSOR_LENGTH, _Test_Sensor_Read ) ) {
+		return 0;
+	}
+	sensorQueuedAt[queued % 64] = now;
+	sensorsWaiting++;
+	return 1;
+}
+
+void _Test_Sensor() {
+	static const uint8_t config[] = { 0x01, 0x27, 0xA0, 0x55 };
+
+	for ( uint8_t i=0; i < TEST_SENSOR_LENGTH; i++ ) {
+		sensorRegisters[TEST_SENSOR_DATA + i] = sensorExpected[i] = rand() & 0xFF;
+	}
+
+	// Four bytes, auto-incrementing
+	lastStatus = 0xFF;
+	HOST_CHECK( PWM_I2C_Queue_Write( &sensorDevice, 0xF2, config, sizeof( config ), _Test_Status ) );
+	_Test_Service();
+	_Test_Run_Until( now + 10000 );
+	HOST_CHECK( PWM_I2C_OK == lastStatus );
+	HOST_CHECK( 0 == memcmp( &sensorRegisters[0xF2], config, sizeof( config ) ) );
+
+	// One transaction for all of the measurements
+	uint32_t before = busBytes;
+	HOST_CHECK( _Test_Queue_Sensor_Read( sensorCompleted ) );
+	_Test_Service();
+	_Test_Run_Until( now + 10000 );
+	HOST_CHECK( 1 == sensorCompleted );
+	HOST_CHECK( 0 == sensorDataErrors );
+	// The register, then each byte read
+	HOST_CHECK( busBytes - before == 1 + TEST_SENSOR_LENGTH );
+	HOST_CHECK( _Test_Idle() );
+
+	// A single byte read has its STOP with it
+	uint8_t one;
+	lastStatus = 0xFF;
+	HOST_CHECK( PWM_I2C_Queue_Burst_Read( &sensorDevice, 0xF3, &one, 1, _Test_Status ) );
+	_Test_Run_Until( now + 10000 );
+	HOST_CHECK( PWM_I2C_OK == lastStatus );
+	HOST_CHECK( config[1] == one );
+
+	// Refused: too long, nowhere to put it, no such priority
+	static const PWM_I2C_Device nowhere = { TEST_SENSOR, PWM_I2C_PRIORITIES };
+	uint8_t big[PWM_I2C_MAX_WRITE + 1] = { 0 };
+	HOST_CHECK( ! PWM_I2C_Queue_Write( &sensorDevice, 0xF2, big, sizeof( big ), 0 ) );
+	HOST_CHECK( ! PWM_I2C_Queue_Write( 0, 0xF2, big, 1, 0 ) );
+	HOST_CHECK( ! PWM_I2C_Queue_Write( &nowhere, 0xF2, big, 1, 0 ) );
+	HOST_CHECK( ! PWM_I2C_Queue_Burst_Read( &sensorDevice, 0xF7, 0, 1, _Test_Status ) );
+	HOST_CHECK( ! PWM_I2C_Queue_Burst_Read( &sensorDevice, 0xF7, big, 0, _Test_Status ) );
+	HOST_CHECK( ! PWM_I2C_Queue_Burst_Read( &sensorDevice, 0xF7, big, 1, 0 ) );
+}
+
+void _Test_Errors() {
+	static const uint8_t one = 0x5A;
+	uint32_t errors, errorsAfter;
+
+	PWM_I2C_Get_Stats( 0, &errors, 0, 0 );
+
+	// Nobody answers the address - a STOP goes out, and only when
+	// it's done is the NACK handed over
+	lastStatus = 0xFF;
+	HOST_CHECK( PWM_I2C_Queue_Write( &missingDevice, 0x10, &one, 1, _Test_Status ) );
+	_Test_Service();
+	uint64_t queuedAt = now;
+	_Test_Run_Until( now + 10000 );
+	HOST_CHECK( PWM_I2C_NACK == lastStatus );
+	HOST_CHECK( statusAt == queuedAt + TEST_EDGE_US + TEST_BYTE_US + TEST_EDGE_US );
+	HOST_CHECK( _Test_Idle() );
+
+	// The sensor won't take a write to its measurements
+	lastStatus = 0xFF;
+	HOST_CHECK( PWM_I2C_Queue_Write( &sensorDevice, TEST_SENSOR_DATA, &one, 1, _Test_Status ) );
+	_Test_Run_Until( now + 10000 );
+	HOST_CHECK( PWM_I2C_NACK == lastStatus );
+	HOST_CHECK( sensorExpected[0] == sensorRegisters[TEST_SENSOR_DATA] );
+	HOST_CHECK( _Test_Idle() );
+
+	// Another master wins the bus part way through a read
+	lastStatus = 0xFF;
+	busArbitrationLost = 1;
+	HOST_CHECK( PWM_I2C_Queue_Burst_Read( &sensorDevice, TEST_SENSOR_DATA, sensorData, 2, _Test_Status ) );
+	_Test_Run_Until( now + 10000 );
+	HOST_CHECK( PWM_I2C_ARBITRATION_LOST == lastStatus );
+	HOST_CHECK( _Test_Idle() );
+
+	PWM_I2C_Get_Stats( 0, &errorsAfter, 0, 0 );
+	HOST_CHECK( errorsAfter == errors + 3 );
+
+	// And the bus works after all of that
+	uint32_t completed = sensorCompleted;
+	HOST_CHECK( _Test_Queue_Sensor_Read( sensorCompleted ) );
+	_Test_Run_Until( now + 10000 );
+	HOST_CHECK( sensorCompleted == completed + 1 );
+	HOST_CHECK( 0 == sensorDataErrors );
+}
+
+void _Test_Stuck() {
+	uint8_t data[2];
+
+	// A device holds the bus; the radio and a sensor queue behind it
+	lastStatus = 0xFF;
+	wordReads = 0;
+	HOST_CHECK( PWM_I2C_Queue_Burst_Read( &stuckDevice, 0x00, data, 2, _Test_Status ) );
+	_Test_Service();
+	uint64_t stuckAt = now;
+	radioModel[0x0A] = radioRegisters[0x0A];
+	PWM_I2C_Queue_Read( 0x0A, _Test_Word_Read, 0 );
+	uint32_t completed = sensorCompleted;
+	HOST_CHECK( _Test_Queue_Sensor_Read( sensorCompleted ) );
+
+	// Until the seconds tick gives up on it
+	_Test_Run_Until( now + ( TEST_TIMEOUT_SECONDS - 1 ) * 1000000ULL );
+	HOST_CHECK( 0xFF == lastStatus );
+	_Test_Run_Until( now + 2000000 );
+	HOST_CHECK( PWM_I2C_TIMEOUT == lastStatus );
+	HOST_CHECK( statusAt - stuckAt > ( TEST_TIMEOUT_SECONDS - 1 ) * 1000000ULL );
+	HOST_CHECK( statusAt - stuckAt <= ( TEST_TIMEOUT_SECONDS + 1 ) * 1000000ULL );
+
+	// Clocked free, and the pins back with the master
+	HOST_CHECK( sdaHeld );
+	HOST_CHECK( 1 == recoveriesSeen );
+	HOST_CHECK( 0x08 == TEST_PB3 );
+	HOST_CHECK( 0x04 == TEST_PB2 );
+	HOST_CHECK( 0x0C == ( Host_GPIO_PORTB_AFSEL_R & 0x0C ) );
+	HOST_CHECK( 0 == ( Host_GPIO_PORTB_DIR_R & 0x0C ) );
+	HOST_CHECK( 0x08 == ( Host_GPIO_PORTB_ODR_R & 0x0C ) );
+	HOST_CHECK( 0x0010 == Host_I2C0_MCR_R );
+
+	// What queued behind it went through
+	HOST_CHECK( 1 == wordReads );
+	HOST_CHECK( 0 == wordReadErrors );
+	HOST_CHECK( sensorCompleted == completed + 1 );
+	HOST_CHECK( _Test_Idle() );
+}
+
+void _Test_Full() {
+	uint8_t queued = 0;
+
+	// Nothing goes until the handler runs
+	while ( _Test_Queue_Sensor_Read( sensorCompleted + queued ) ) {
+		queued++;
+	}
+	HOST_CHECK( 7 == queued );
+
+	uint32_t completed = sensorCompleted;
+	_Test_Run_Until( now + 100000 );
+	HOST_CHECK( sensorCompleted == completed + queued );
+	HOST_CHECK( _Test_Idle() );
+}
+
+/*
+ * The radio's queue kept full, no waits, with the sensor reading
+ * as fast as it can queue - neither should starve
+ */
+void _Test_Saturated() {
+	uint64_t start = now;
+	uint64_t busyBefore = busyUs;
+	uint32_t radioBefore = radioStarts;
+	uint32_t sensorBefore = sensorStarts;
+	uint32_t completed = sensorCompleted;
+	uint32_t queued = sensorCompleted;
+	uint32_t radioQueued = radioStarts;
+
+	sensorLatency = 0;
+	sensorMaxLatency = 0;
+	longestRadioRun = 0;
+	for ( uint16_t i=0; i < 2000; i++ ) {
+		while ( radioQueued - radioStarts < 20 ) {
+			uint8_t reg = 0x40 + rand() % 16;
+			uint16_t data = rand() & 0xFFFF;
+			radioModel[reg] = data;
+			PWM_I2C_Queue_Command( reg, data, 0xFFFF, 0 );
+			radioQueued++;
+		}
+		while ( queued - sensorCompleted < 3 ) {
+			HOST_CHECK( _Test_Queue_Sensor_Read( queued ) );
+			queued++;
+		}
+		_Test_Service();
+		_Test_Run_Until( now + 1500 );
+	}
+	double utilization = _Test_Utilization( busyBefore, start );
+	uint32_t radio = radioStarts - radioBefore;
+	uint32_t sensor = sensorStarts - sensorBefore;
+	_Test_Run_Until( now + 1000000 );
+
+	printf( "saturated: %u radio, %u sensor transactions, %.2f radio per sensor, longest radio run %u, sensor latency %.0f us (max %u), bus %.1f%% busy\n",
+		radio, sensor, (double) radio / sensor, longestRadioRun,
+		(double) sensorLatency / ( sensorCompleted - completed ), (uint32_t) sensorMaxLatency, utilization );
+
+	HOST_CHECK( longestRadioRun <= TEST_RADIO_BURST );
+	// Nor does the radio get less than its burst
+	HOST_CHECK( 2 * radio >= ( 2 * TEST_RADIO_BURST - 1 ) * sensor );
+	HOST_CHECK( 2 * radio <= ( 2 * TEST_RADIO_BURST + 1 ) * sensor );
+	HOST_CHECK( utilization > 99.0 );
+	HOST_CHECK( sensorCompleted == queued );
+	HOST_CHECK( 0 == sensorDataErrors );
+	HOST_CHECK( 0 == memcmp( radioModel, radioRegisters, sizeof( radioModel ) ) );
+	HOST_CHECK( _Test_Idle() );
+}
+
+// The radio's RSSI poll, as rda1846.c runs it
+static uint8_t polling;
+static uint32_t polls;
+
+void _Test_Poll( uint16_t data ) {
+	polls++;
+	if ( polling ) {
+		PWM_I2C_Queue_Read( 0x1B, _Test_Poll, 10 );
+	}
+}
+
+void _Test_Polling() {
+	uint64_t start = now;
+	uint64_t busyBefore = busyUs;
+	uint32_t completed = sensorCompleted;
+
+	sensorLatency = 0;
+	sensorMaxLatency = 0;
+	polling = 1;
+	PWM_I2C_Queue_Read( 0x1B, _Test_Poll, 10 );
+	for ( uint16_t i=0; i < 120; i++ ) {
+		HOST_CHECK( _Test_Queue_Sensor_Read( sensorCompleted ) );
+		_Test_Service();
+		_Test_Run_Until( now + 500000 + rand() % 1000 );
+	}
+	polling = 0;
+	uint64_t elapsed = now - start;
+	double utilization = _Test_Utilization( busyBefore, start );
+	_Test_Run_Until( now + 100000 );
+
+	printf( "polling: %u polls in %.0f s, sensor latency %.0f us (max %u), bus %.1f%% busy\n",
+		polls, elapsed / 1e6, (double) sensorLatency / ( sensorCompleted - completed ), (uint32_t) sensorMaxLatency, utilization );
+
+	// A poll is its five bytes and the 10 ms wait, held up now and
+	// then by a sensor read - which itself waits out at most the
+	// one poll already on the bus
+	uint32_t pollUs = 3 * TEST_EDGE_US + 5 * TEST_BYTE_US;
+	uint32_t readUs = 3 * TEST_EDGE_US + ( TEST_SENSOR_LENGTH + 3 ) * TEST_BYTE_US;
+	HOST_CHECK( (uint64_t) ( polls + 1 ) * ( 10000 + pollUs ) + 120 * readUs >= elapsed );
+	HOST_CHECK( sensorCompleted == completed + 120 );
+	HOST_CHECK( sensorMaxLatency <= pollUs + readUs );
+	HOST_CHECK( 0 == sensorDataErrors );
+	HOST_CHECK( _Test_Idle() );
+}
+
+int main() {
+	Host_Init();
+	srand( 49 );
+
+	Clock_Init( CLOCK_80_MHZ );
+	Host_Set_Register_Hook( _Test_Register_Hook );
+	Host_I2C0_MCS_R = TEST_NO_COMMAND;
+	PWM_I2C_Init( TEST_RADIO );
+	PWM_I2C_Set_Callback( _Test_Dry );
+
+	_Test_Radio();
+	_Test_Sensor();
+	_Test_Errors();
+	_Test_Stuck();
+	_Test_Full();
+	_Test_Saturated();
+	_Test_Polling();
+
+	uint32_t transactions, errors, bytes, recoveries;
+	PWM_I2C_Get_Stats( &transactions, &errors, &bytes, &recoveries );
+	printf( "%u transactions, %u errors, %u bytes, %u recoveries in %.1f s\n",
+		transactions, errors, bytes, recoveries, now / 1e6 );
+	HOST_CHECK( bytes == busBytes );
+	HOST_CHECK( 4 == errors );
+	HOST_CHECK( 1 == recoveries );
+	HOST_CHECK( 0 == violations );
+
+	return Host_Report( "i2c-devices" );
+}
@@ -0,0 +1,323 @@
+// Host loopback test for the KISS TNC interface
+//
+// Plays the host end of UART0 through the register hook: KISS
+// frames go into the RX FIFO eight bytes per interrupt, and what
+// the driver writes to the TX FIFO is collected and decoded. The
+// CSMA queue is stood in for by a pool of buffers, and every frame
+// committed to it is handed straight back to KISS_Send_Frame as if
+// heard on the air. Checks the frames come back intact (FEND and
+// FESC in the data included), the TXDELAY / P / SlotTime commands,
+// other ports and short frames being ignored and a full transmit
+// queue dropping frames. Prints frames per second through the
+// driver and the bytes it copies per frame.
+
+#include "host.h"
+#include "kiss.h"
+#include "ax25.h"
+#include "csma.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TEST_FRAMES 20000
+#define TEST_BUFFERS 6
+// Bytes per RX interrupt, the FIFO's half full level
+#define TEST_RX_CHUNK 8
+#define TEST_TX_FIFO 16
+#define TEST_MAX_ENCODED ( 2 * AX25_MAX_FRAME_LENGTH + 4 )
+
+// Host to driver
+static uint8_t rxInput[TEST_BUFFERS * TEST_MAX_ENCODED * 2];
+static uint32_t rxInputLength;
+static uint32_t rxInputIndex;
+static uint32_t rxAvailable;
+
+// Driver to host
+static uint8_t txOutput[TEST_MAX_ENCODED * 8];
+static uint32_t txOutputLength;
+static uint8_t txFifoCount;
+static uint8_t txWritePending;
+static uint8_t sendingTX;
+
+// The CSMA pool
+static uint8_t buffers[TEST_BUFFERS][AX25_MAX_FRAME_LENGTH];
+static uint16_t bufferLengths[TEST_BUFFERS];
+static uint8_t bufferInUse[TEST_BUFFERS];
+static uint8_t committed[TEST_BUFFERS];
+static uint8_t committedCount;
+
+static uint16_t txDelayMS;
+static uint16_t slotTimeMS;
+static uint8_t persistence;
+
+/*
+ * UART0 as the host sees it. RX: reading FR puts the next byte
+ * in DR. TX: a DR access is a write, taken off on the FR read
+ * that always follows it.
+ */
+void _Test_Register_Hook( volatile uint32_t *reg ) {
+	if ( reg == &Host_UART0_FR_R ) {
+		if ( txWritePending ) {
+			txOutput[txOutputLength++] = Host_UART0_DR_R;
+			txFifoCount++;
+			txWritePending = 0;
+		}
+		if ( sendingTX ) {
+			Host_UART0_FR_R = UART_FR_RXFE | ( ( txFifoCount >= TEST_TX_FIFO ) ? UART_FR_TXFF : 0 );
+		} else if ( rxAvailable ) {
+			Host_UART0_DR_R = rxInput[rxInputIndex++];
+			rxAvailable--;
+			Host_UART0_FR_R = 0;
+		} else {
+			Host_UART0_FR_R = UART_FR_RXFE;
+		}
+	} else if ( ( reg == &Host_UART0_DR_R ) && sendingTX ) {
+		txWritePending = 1;
+	}
+}
+
+uint8_t CSMA_Reserve_Frame( uint8_t source, uint8_t **frame ) {
+	HOST_CHECK( CSMA_SOURCE_KISS == source );
+	for ( uint8_t i=0; i < TEST_BUFFERS; i++ ) {
+		if ( ! bufferInUse[i] ) {
+			bufferInUse[i] = 1;
+			*frame = buffers[i];
+			return i;
+		}
+	}
+	return CSMA_NO_BUFFER;
+}
+
+void CSMA_Release_Frame( uint8_t buffer ) {
+	bufferInUse[buffer] = 0;
+}
+
+void CSMA_Commit_Frame( uint8_t buffer, uint16_t length ) {
+	bufferLengths[buffer] = length;
+	committed[committedCount++] = buffer;
+}
+
+void CSMA_Set_Parameters( uint8_t source, uint16_t newSlotTimeMS, uint8_t newPersistence, uint16_t newMaxDeferMS ) {
+	HOST_CHECK( CSMA_SOURCE_KISS == source );
+	slotTimeMS = newSlotTimeMS;
+	persistence = newPersistence;
+}
+
+void RDA1846_Set_TX_Delay( uint16_t milliseconds ) {
+	txDelayMS = milliseconds;
+}
+
+uint32_t Clock_Get_UART_Divisor( uint32_t baud ) {
+	return ( 80000000UL * 4 + baud / 2 ) / baud;
+}
+
+uint8_t Clock_Register_Change_Callback( void (*callback)( uint32_t hz ) ) {
+	return 1;
+}
+
+/*
+ * Appends a KISS frame to what the host sends
+ */
+void _Test_Host_Send( uint8_t command, uint8_t *data, uint16_t length ) {
+	rxInput[rxInputLength++] = KISS_FEND;
+	rxInput[rxInputLength++] = command;
+	for ( uint16_t i=0; i < length; i++ ) {
+		if ( KISS_FEND == data[i] ) {
+			rxInput[rxInputLength++] = KISS_FESC;
+			rxInput[rxInputLength++] = KISS_TFEND;
+		} else if ( KISS_FESC == data[i] ) {
+			rxInput[rxInputLength++] = KISS_FESC;
+			rxInput[rxInputLength++] = KISS_TFESC;
+		} else {
+			rxInput[rxInputLength++] = data[i];
+		}
+	}
+	rxInput[rxInputLength++] = KISS_FEND;
+}
+
+/*
+ * Feeds what the host has sent through the RX interrupt
+ */
+void _Test_Run_RX() {
+	sendingTX = 0;
+	while ( rxInputIndex < rxInputLength ) {
+		rxAvailable = rxInputLength - rxInputIndex;
+		if ( rxAvailable > TEST_RX_CHUNK ) {
+			rxAvailable = TEST_RX_CHUNK;
+		}
+		Host_UART0_MIS_R = UART_MIS_RXMIS;
+		KISS_UART0_Handler();
+	}
+	rxInputLength = 0;
+	rxInputIndex = 0;
+}
+
+/*
+ * Hands a committed frame back as heard on the air and lets the
+ * TX interrupt drain it to the host
+ */
+void _Test_Loop_Back( uint8_t buffer ) {
+	sendingTX = 1;
+	txFifoCount = 0;
+	KISS_Send_Frame( buffers[buffer], bufferLengths[buffer] );
+	while ( Host_UART0_IM_R & UART_IM_TXIM ) {
+		// Down to the 1/8 full interrupt level
+		txFifoCount = TEST_TX_FIFO / 8;
+		Host_UART0_MIS_R = UART_MIS_TXMIS;
+		KISS_UART0_Handler();
+	}
+	CSMA_Release_Frame( buffer );
+	sendingTX = 0;
+}
+
+/*
+ * Decodes one KISS frame from what the driver sent
+ * Returns its length, or -1 if it isn't a port 0 data frame
+ */
+int _Test_Host_Receive( uint8_t *data ) {
+	uint32_t i = 0;
+	int length = 0;
+
+	if ( ( txOutputLength < 3 ) || ( KISS_FEND != txOutput[i++] ) || ( KISS_CMD_DATA != txOutput[i++] ) ) {
+		return -1;
+	}
+	while ( ( i < txOutputLength ) && ( KISS_FEND != txOutput[i] ) ) {
+		if ( KISS_FESC == txOutput[i] ) {
+			i++;
+			data[length++] = ( KISS_TFEND == txOutput[i] ) ? KISS_FEND : KISS_FESC;
+		} else {
+			data[length++] = txOutput[i];
+		}
+		i++;
+	}
+	if ( ( i + 1 ) != txOutputLength ) {
+		return -1;
+	}
+	txOutputLength = 0;
+	return length;
+}
+
+uint16_t _Test_Random_Frame( uint8_t *frame ) {
+	uint16_t length = 2 * AX25_ADDRESS_LENGTH + 1 + rand() % ( AX25_MAX_FRAME_LENGTH - 2 * AX25_ADDRESS_LENGTH );
+	for ( uint16_t i=0; i < length; i++ ) {
+		// Plenty of bytes that need escaping
+		frame[i] = ( rand() & 0x7 ) ? rand() : ( ( rand() & 1 ) ? KISS_FEND : KISS_FESC );
+	}
+	return length;
+}
+
+void _Test_Commands() {
+	uint8_t frame[AX25_MAX_FRAME_LENGTH];
+	uint8_t value;
+	uint32_t fromHost, dropped, fromHostBefore, droppedBefore;
+
+	// TXDELAY, P and SlotTime, in 10 ms units
+	value = 50;
+	_Test_Host_Send( KISS_CMD_TXDELAY, &value, 1 );
+	value = 127;
+	_Test_Host_Send( KISS_CMD_PERSISTENCE, &value, 1 );
+	value = 20;
+	_Test_Host_Send( KISS_CMD_SLOTTIME, &value, 1 );
+	_Test_Run_RX();
+	HOST_CHECK( 500 == txDelayMS );
+	HOST_CHECK( 127 == persistence );
+	HOST_CHECK( 200 == slotTimeMS );
+	HOST_CHECK( 0 == committedCount );
+
+	KISS_Get_Stats( &fromHostBefore, 0, &droppedBefore, 0 );
+
+	// Port 1 data, a frame too short to be AX.25, an empty frame
+	uint16_t length = _Test_Random_Frame( frame );
+	_Test_Host_Send( 0x10 | KISS_CMD_DATA, frame, length );
+	_Test_Host_Send( KISS_CMD_DATA, frame, 2 * AX25_ADDRESS_LENGTH );
+	_Test_Host_Send( KISS_CMD_DATA, frame, 0 );
+	_Test_Run_RX();
+	HOST_CHECK( 0 == committedCount );
+	for ( uint8_t i=0; i < TEST_BUFFERS; i++ ) {
+		HOST_CHECK( ! bufferInUse[i] );
+	}
+
+	// Back to back until the queue is full - the rest are dropped
+	for ( uint8_t i=0; i < TEST_BUFFERS + 2; i++ ) {
+		length = _Test_Random_Frame( frame );
+		_Test_Host_Send( KISS_CMD_DATA, frame, length );
+	}
+	_Test_Run_RX();
+	KISS_Get_Stats( &fromHost, 0, &dropped, 0 );
+	HOST_CHECK( TEST_BUFFERS == committedCount );
+	HOST_CHECK( TEST_BUFFERS == fromHost - fromHostBefore );
+	HOST_CHECK( 2 == dropped - droppedBefore );
+
+	for ( uint8_t i=0; i < committedCount; i++ ) {
+		_Test_Loop_Back( committed[i] );
+		HOST_CHECK( _Test_Host_Receive( frame ) == bufferLengths[committed[i]] );
+	}
+	committedCount = 0;
+}
+
+void _Test_Throughput() {
+	static uint8_t frames[TEST_BUFFERS][AX25_MAX_FRAME_LENGTH];
+	static uint16_t lengths[TEST_BUFFERS];
+	uint8_t received[AX25_MAX_FRAME_LENGTH];
+	uint32_t fromHostBefore, toHostBefore, droppedBefore, copiedBefore;
+	uint32_t fromHost, toHost, dropped, copied;
+	uint64_t bytes = 0, nanoseconds = 0;
+	uint32_t intact = 0;
+
+	KISS_Get_Stats( &fromHostBefore, &toHostBefore, &droppedBefore, &copiedBefore );
+
+	for ( uint32_t sent=0; sent < TEST_FRAMES; sent += TEST_BUFFERS ) {
+		// A burst of back to back frames from the host
+		for ( uint8_t i=0; i < TEST_BUFFERS; i++ ) {
+			lengths[i] = _Test_Random_Frame( frames[i] );
+			_Test_Host_Send( KISS_CMD_DATA, frames[i], lengths[i] );
+			bytes += lengths[i];
+		}
+
+		uint64_t start = Host_Nanoseconds();
+		_Test_Run_RX();
+		nanoseconds += Host_Nanoseconds() - start;
+		HOST_CHECK( TEST_BUFFERS == committedCount );
+
+		for ( uint8_t i=0; i < committedCount; i++ ) {
+			start = Host_Nanoseconds();
+			_Test_Loop_Back( committed[i] );
+			nanoseconds += Host_Nanoseconds() - start;
+
+			int length = _Test_Host_Receive( received );
+			if ( ( length == lengths[i] ) && ( 0 == memcmp( received, frames[i], length ) ) ) {
+				intact++;
+			}
+		}
+		committedCount = 0;
+	}
+
+	KISS_Get_Stats( &fromHost, &toHost, &dropped, &copied );
+	fromHost -= fromHostBefore;
+	toHost -= toHostBefore;
+	dropped -= droppedBefore;
+	copied -= copiedBefore;
+
+	printf( "loopback: %u frames, %u intact, %.0f frames/s through the driver, %.1f bytes copied per frame (%.1f per frame byte)\n",
+		fromHost, intact, fromHost * 1e9 / nanoseconds, (double) copied / fromHost, (double) copied / bytes );
+
+	HOST_CHECK( fromHost == intact );
+	HOST_CHECK( toHost == intact );
+	HOST_CHECK( 0 == dropped );
+	// Each byte copied once on the way in and once on the way out
+	HOST_CHECK( copied == 2 * bytes );
+}
+
+int main() {
+	Host_Init();
+	srand( 33 );
+
+	KISS_Init();
+	Host_Set_Register_Hook( _Test_Register_Hook );
+
+	_Test_Commands();
+	_Test_Throughput();
+
+	return Host_Report( "kiss-loopback" );
+}
@@ -0,0 +1,176 @@
+// Host test for the LCD diff renderer
+//
+// Plays lcd.c's output into a simulated OpenLCD and checks, after
+// every one of a few thousand random whole-line and field writes,
+// that the display shows what was written. Then counts the bytes
+// sent per update: an hour of the station's own display (every
+// 10 s, the clock and the 24 hour extremes in turn on the top
+// line), the clock alone, and the minute and temperature fields
+// written on their own - against 34 for clearing and resending
+// both lines, as every update used to.
+
+#include "host.h"
+#include "lcd.h"
+#include "openlcd.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TEST_RANDOM_WRITES 5000
+#define TEST_FULL_REDRAW_BYTES ( 2 + LCD_ROWS * LCD_COLUMNS )
+#define TEST_HOUR_UPDATES 360
+
+static char expected[LCD_ROWS][LCD_COLUMNS + 1];
+
+uint32_t Clock_Get_Hz() {
+	return 16000000;
+}
+
+uint8_t Clock_Register_Change_Callback( void (*callback)( uint32_t hz ) ) {
+	return 1;
+}
+
+/*
+ * Writes a field and keeps the test's own copy of the display
+ */
+void _Test_Write_Field( uint8_t row, uint8_t column, char *text, uint8_t width ) {
+	LCD_Write_Field( row, column, text, width );
+	OpenLCD_Run();
+
+	for ( uint8_t i=column; ( i < column + width ) && ( i < LCD_COLUMNS ); i++ ) {
+		expected[row][i] = *text ? *text++ : ' ';
+	}
+}
+
+void _Test_Write( char *line1, char *line2 ) {
+	LCD_Write( line1, line2 );
+	OpenLCD_Run();
+
+	for ( uint8_t i=0; i < LCD_COLUMNS; i++ ) {
+		expected[0][i] = *line1 ? *line1++ : ' ';
+		expected[1][i] = *line2 ? *line2++ : ' ';
+	}
+}
+
+uint8_t _Test_Display_Correct() {
+	return OpenLCD_Showing( 0, expected[0] ) && OpenLCD_Showing( 1, expected[1] );
+}
+
+void _Test_Clear() {
+	LCD_Clear();
+	OpenLCD_Run();
+	memset( expected, ' ', sizeof( expected ) );
+	expected[0][LCD_COLUMNS] = 0;
+	expected[1][LCD_COLUMNS] = 0;
+}
+
+void _Test_Random_Writes() {
+	// Few characters, so runs of matching ones are common
+	static const char alphabet[] = "0123 AB";
+	char text[LCD_COLUMNS + 1];
+	uint32_t wrong = 0;
+
+	_Test_Clear();
+
+	for ( uint32_t i=0; i < TEST_RANDOM_WRITES; i++ ) {
+		uint8_t length = rand() % ( LCD_COLUMNS + 1 );
+		for ( uint8_t j=0; j < length; j++ ) {
+			text[j] = alphabet[rand() % ( sizeof( alphabet ) - 1 )];
+		}
+		text[length] = 0;
+
+		if ( rand() & 1 ) {
+			uint8_t column = rand() % LCD_COLUMNS;
+			_Test_Write_Field( rand() % LCD_ROWS, column, text, 1 + rand() % ( LCD_COLUMNS - column ) );
+		} else {
+			_Test_Write( text, ( rand() & 1 ) ? text : "" );
+		}
+
+		if ( ! _Test_Display_Correct() ) {
+			wrong++;
+		}
+	}
+
+	HOST_CHECK( 0 == wrong );
+
+	// Fields that run off the end or start off the display
+	_Test_Write_Field( 0, 12, "ABCDEFGH", 8 );
+	_Test_Write_Field( 1, 15, "XY", 2 );
+	HOST_CHECK( _Test_Display_Correct() );
+	uint32_t before = OpenLCD_Get_Bytes();
+	LCD_Write_Field( 2, 0, "X", 1 );
+	LCD_Write_Field( 0, LCD_COLUMNS, "X", 1 );
+	OpenLCD_Run();
+	HOST_CHECK( before == OpenLCD_Get_Bytes() );
+	HOST_CHECK( _Test_Display_Correct() );
+}
+
+/*
+ * An hour of the station's display, starting at 06:00 - returns
+ * the bytes sent per update
+ */
+double _Test_Station_Hour( uint8_t extremes ) {
+	char line1[LCD_COLUMNS + 1];
+	char line2[LCD_COLUMNS + 1];
+	int temperature = 54;
+
+	_Test_Clear();
+	uint32_t before = OpenLCD_Get_Bytes();
+
+	for ( uint16_t i=0; i < TEST_HOUR_UPDATES; i++ ) {
+		uint16_t minute = i / 6;
+		if ( 0 == rand() % 30 ) {
+			temperature += ( rand() & 1 ) ? 1 : -1;
+		}
+
+		if ( extremes && ( i & 1 ) ) {
+			snprintf( line1, sizeof( line1 ), "Hi %3d  Lo %3d F", 71, 48 );
+		} else {
+			snprintf( line1, sizeof( line1 ), "10/19/2026 %02u:%02u", 6 + minute / 60, minute % 60 );
+		}
+		snprintf( line2, sizeof( line2 ), "47 N 122 W %3d F", temperature );
+		_Test_Write( line1, line2 );
+		HOST_CHECK( _Test_Display_Correct() );
+	}
+
+	return (double) ( OpenLCD_Get_Bytes() - before ) / TEST_HOUR_UPDATES;
+}
+
+void _Test_Typical_Updates() {
+	double station = _Test_Station_Hour( 1 );
+	double clock = _Test_Station_Hour( 0 );
+
+	// The minute alone, then the minute and temperature
+	_Test_Write( "10/19/2026 06:34", "47 N 122 W  54 F" );
+	uint32_t before = OpenLCD_Get_Bytes();
+	_Test_Write_Field( 0, 14, "35", 2 );
+	uint32_t minuteBytes = OpenLCD_Get_Bytes() - before;
+
+	before = OpenLCD_Get_Bytes();
+	_Test_Write_Field( 0, 14, "36", 2 );
+	_Test_Write_Field( 1, 11, " 55", 3 );
+	uint32_t bothBytes = OpenLCD_Get_Bytes() - before;
+	HOST_CHECK( _Test_Display_Correct() );
+
+	printf( "bytes per update: before %u, station display %.1f, clock only %.1f, minute field %u, minute and temperature %u\n",
+		TEST_FULL_REDRAW_BYTES, station, clock, minuteBytes, bothBytes );
+
+	HOST_CHECK( station < TEST_FULL_REDRAW_BYTES );
+	HOST_CHECK( clock < 4 );
+	HOST_CHECK( minuteBytes <= 3 );
+	HOST_CHECK( bothBytes <= 8 );
+}
+
+int main() {
+	Host_Init();
+	srand( 35 );
+
+	LCD_Init();
+	OpenLCD_Init();
+
+	_Test_Random_Writes();
+	_Test_Typical_Updates();
+
+	return Host_Report( "lcd-bytes" );
+}
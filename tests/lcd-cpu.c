@@ -0,0 +1,139 @@
+// Host model of the CPU time spent on LCD output
+//
+// Runs lcd.c against the timed OpenLCD model: the TX FIFO drains
+// at the bit rate lcd.c derives from the system clock, and the TX
+// interrupt is taken at half full. Checks that bit rate at each
+// system clock, including after a clock change. Then drives an
+// hour of the station's display (an update every 10 s) and prints
+// the CPU time per minute and the time the 2 Hz tick is held up
+// per update, against the old driver: clear and resend both lines
+// at CPSR 0xFF, spinning on TNF for every byte.
+//
+// CPU time is modelled in cycles at 80 MHz from the counts the
+// simulation gives - bytes queued and interrupts taken - with the
+// costs below, estimated from the code paths.
+
+#include "host.h"
+#include "lcd.h"
+#include "openlcd.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define TEST_HZ 80000000
+#define TEST_UPDATES_PER_MINUTE 6
+#define TEST_MINUTES 60
+
+// LCD_Out: ring store, interrupt state save / restore, IM check
+#define TEST_OUT_CYCLES 30
+// Exception entry and exit, the handler's checks and profile hooks
+#define TEST_INTERRUPT_CYCLES 50
+// One byte from the ring to the FIFO, SR read included
+#define TEST_BYTE_CYCLES 12
+
+// The old driver: 16 MHz / CPSR 0xFF, clear plus both lines
+#define TEST_OLD_BIT_RATE ( 16000000 / 255 )
+#define TEST_OLD_BYTES ( 2 + LCD_ROWS * LCD_COLUMNS )
+#define TEST_FIFO_DEPTH 8
+
+static const uint32_t testClocks[] = { 16000000, 40000000, 50000000, 80000000 };
+
+static uint32_t systemHz = TEST_HZ;
+static void (*clockCallback)( uint32_t hz );
+
+uint32_t Clock_Get_Hz() {
+	return systemHz;
+}
+
+uint8_t Clock_Register_Change_Callback( void (*callback)( uint32_t hz ) ) {
+	clockCallback = callback;
+	return 1;
+}
+
+void _Test_Bit_Rates() {
+	for ( uint8_t i=0; i < sizeof( testClocks ) / sizeof( testClocks[0] ); i++ ) {
+		systemHz = testClocks[i];
+		clockCallback( systemHz );
+		OpenLCD_Set_Timed( systemHz );
+
+		uint32_t rate = OpenLCD_Get_Bit_Rate();
+		printf( "%2u MHz: CPSR %3u SCR %3u, %u bit/s\n", systemHz / 1000000, Host_SSI0_CPSR_R,
+			( Host_SSI0_CR0_R >> 8 ) & 0xFF, rate );
+		HOST_CHECK( rate <= 100000 );
+		HOST_CHECK( rate >= 90000 );
+		HOST_CHECK( 0 == ( Host_SSI0_CPSR_R & 1 ) );
+		HOST_CHECK( 7 == ( Host_SSI0_CR0_R & 0x0F ) );
+	}
+
+	systemHz = TEST_HZ;
+	clockCallback( systemHz );
+	OpenLCD_Set_Timed( systemHz );
+}
+
+void _Test_Station_Hour() {
+	char line1[LCD_COLUMNS + 1];
+	char line2[LCD_COLUMNS + 1];
+	uint32_t interrupts = 0, maxBytes = 0;
+	int temperature = 54;
+
+	LCD_Clear();
+	OpenLCD_Run_Timed();
+	uint32_t bytesBefore = OpenLCD_Get_Bytes();
+
+	for ( uint16_t i=0; i < TEST_MINUTES * TEST_UPDATES_PER_MINUTE; i++ ) {
+		uint16_t minute = i / TEST_UPDATES_PER_MINUTE;
+		if ( 0 == rand() % 30 ) {
+			temperature += ( rand() & 1 ) ? 1 : -1;
+		}
+
+		if ( i & 1 ) {
+			snprintf( line1, sizeof( line1 ), "Hi %3d  Lo %3d F", 71, 48 );
+		} else {
+			snprintf( line1, sizeof( line1 ), "10/19/2026 %02u:%02u", 6 + minute / 60, minute % 60 );
+		}
+		snprintf( line2, sizeof( line2 ), "47 N 122 W %3d F", temperature );
+
+		uint32_t before = OpenLCD_Get_Bytes();
+		LCD_Write( line1, line2 );
+		interrupts += OpenLCD_Run_Timed();
+		HOST_CHECK( OpenLCD_Showing( 0, line1 ) && OpenLCD_Showing( 1, line2 ) );
+
+		if ( OpenLCD_Get_Bytes() - before > maxBytes ) {
+			maxBytes = OpenLCD_Get_Bytes() - before;
+		}
+	}
+
+	uint32_t bytes = OpenLCD_Get_Bytes() - bytesBefore;
+	uint64_t cycles = (uint64_t) bytes * ( TEST_OUT_CYCLES + TEST_BYTE_CYCLES ) +
+		(uint64_t) interrupts * TEST_INTERRUPT_CYCLES;
+	double cpuMSPerMinute = cycles * 1000.0 / TEST_HZ / TEST_MINUTES;
+	// LCD_Write only queues - the tick is held for the LCD_Out calls
+	double heldMS = maxBytes * ( TEST_OUT_CYCLES + TEST_BYTE_CYCLES ) * 1000.0 / TEST_HZ;
+
+	// Spinning on TNF for every byte past the FIFO's depth
+	double oldHeldMS = ( TEST_OLD_BYTES - TEST_FIFO_DEPTH ) * 8000.0 / TEST_OLD_BIT_RATE;
+	double oldMSPerMinute = oldHeldMS * TEST_UPDATES_PER_MINUTE;
+
+	printf( "per minute: %u bytes, %u interrupts, %.3f ms CPU (before %.1f ms)\n",
+		bytes / TEST_MINUTES, interrupts / TEST_MINUTES, cpuMSPerMinute, oldMSPerMinute );
+	printf( "tick held per update: %.3f ms at most (before %.2f ms)\n", heldMS, oldHeldMS );
+
+	// One interrupt per half FIFO, and one to find the ring empty
+	HOST_CHECK( interrupts <= bytes / ( TEST_FIFO_DEPTH / 2 ) + TEST_MINUTES * TEST_UPDATES_PER_MINUTE );
+	HOST_CHECK( cpuMSPerMinute * 10 < oldMSPerMinute );
+	HOST_CHECK( heldMS * 10 < oldHeldMS );
+}
+
+int main() {
+	Host_Init();
+	srand( 36 );
+
+	LCD_Init();
+	OpenLCD_Init();
+	OpenLCD_Set_Timed( systemHz );
+
+	_Test_Bit_Rates();
+	_Test_Station_Hour();
+
+	return Host_Report( "lcd-cpu" );
+}
@@ -0,0 +1,201 @@
+// Simulated SparkFun OpenLCD on SSI0 for the LCD tests
+
+#include "openlcd.h"
+#include "host.h"
+
+#include <string.h>
+
+#define OPENLCD_STATE_CHARACTER 0
+#define OPENLCD_STATE_COMMAND 1
+#define OPENLCD_STATE_SETTING 2
+
+#define OPENLCD_FIFO_DEPTH 8
+#define OPENLCD_SR_TNF 0x02
+#define OPENLCD_SR_BSY 0x10
+#define OPENLCD_IM_TXIM 0x08
+
+static char display[LCD_ROWS][LCD_COLUMNS];
+static uint8_t cursorRow;
+static uint8_t cursorColumn;
+static uint8_t state;
+static uint8_t writePending;
+static uint32_t bytes;
+
+// The SSI when timed
+static uint32_t timedHz;
+static uint8_t fifoCount;
+static uint64_t nowNS;
+static uint64_t shiftDoneNS;
+
+void _OpenLCD_Clear() {
+	memset( display, ' ', sizeof( display ) );
+	cursorRow = 0;
+	cursorColumn = 0;
+}
+
+void _OpenLCD_Receive( uint8_t data ) {
+	bytes++;
+
+	switch ( state ) {
+		case OPENLCD_STATE_COMMAND:
+			if ( data & 0x80 ) {
+				cursorRow = ( data & 0x40 ) ? 1 : 0;
+				cursorColumn = ( data & 0x3F ) % LCD_COLUMNS;
+			}
+			state = OPENLCD_STATE_CHARACTER;
+			return;
+
+		case OPENLCD_STATE_SETTING:
+			if ( 0x2D == data ) {
+				_OpenLCD_Clear();
+			}
+			state = OPENLCD_STATE_CHARACTER;
+			return;
+
+		default:
+			break;
+	}
+
+	if ( 0xFE == data ) {
+		state = OPENLCD_STATE_COMMAND;
+	} else if ( 0x7C == data ) {
+		state = OPENLCD_STATE_SETTING;
+	} else {
+		display[cursorRow][cursorColumn++] = data;
+		if ( cursorColumn == LCD_COLUMNS ) {
+			cursorColumn = 0;
+			cursorRow = ( cursorRow + 1 ) % LCD_ROWS;
+		}
+	}
+}
+
+uint32_t OpenLCD_Get_Bit_Rate() {
+	uint32_t scr = ( ( Host_SSI0_CR0_R >> 8 ) & 0xFF ) + 1;
+	return timedHz / ( Host_SSI0_CPSR_R * scr );
+}
+
+uint64_t _OpenLCD_Byte_NS() {
+	return 8000000000ULL / OpenLCD_Get_Bit_Rate();
+}
+
+/*
+ * Moves time on to ns, shifting bytes out of the FIFO
+ */
+void _OpenLCD_Advance( uint64_t ns ) {
+	while ( fifoCount && ( shiftDoneNS <= ns ) ) {
+		fifoCount--;
+		shiftDoneNS += _OpenLCD_Byte_NS();
+	}
+	nowNS = ns;
+}
+
+void _OpenLCD_Take_Write() {
+	_OpenLCD_Receive( Host_SSI0_DR_R );
+	writePending = 0;
+
+	if ( timedHz ) {
+		if ( 0 == fifoCount ) {
+			shiftDoneNS = nowNS + _OpenLCD_Byte_NS();
+		}
+		fifoCount++;
+		HOST_CHECK( fifoCount <= OPENLCD_FIFO_DEPTH );
+	}
+}
+
+/*
+ * lcd.c only ever writes the data register, and always touches
+ * another SSI0 register after - the byte is taken from there
+ */
+void _OpenLCD_Register_Hook( volatile uint32_t *reg ) {
+	if ( writePending ) {
+		_OpenLCD_Take_Write();
+	}
+
+	if ( reg == &Host_SSI0_DR_R ) {
+		writePending = 1;
+	} else if ( reg == &Host_SSI0_SR_R ) {
+		if ( timedHz ) {
+			Host_SSI0_SR_R = ( ( fifoCount < OPENLCD_FIFO_DEPTH ) ? OPENLCD_SR_TNF : 0 ) |
+				( fifoCount ? OPENLCD_SR_BSY : 0 );
+		} else {
+			// FIFO never full, never busy
+			Host_SSI0_SR_R = OPENLCD_SR_TNF;
+		}
+	}
+}
+
+void OpenLCD_Init() {
+	_OpenLCD_Clear();
+	state = OPENLCD_STATE_CHARACTER;
+	writePending = 0;
+	bytes = 0;
+	timedHz = 0;
+	fifoCount = 0;
+	Host_Set_Register_Hook( _OpenLCD_Register_Hook );
+}
+
+/*
+ * Runs the SSI0 interrupt until lcd.c has sent all it queued
+ */
+void OpenLCD_Run() {
+	while ( Host_SSI0_IM_R & OPENLCD_IM_TXIM ) {
+		LCD_SSI0_Handler();
+	}
+	if ( writePending ) {
+		_OpenLCD_Take_Write();
+	}
+}
+
+/*
+ * systemHz: the clock lcd.c's divisors run from, 0 for untimed
+ */
+void OpenLCD_Set_Timed( uint32_t systemHz ) {
+	timedHz = systemHz;
+	fifoCount = 0;
+}
+
+/*
+ * Lets the FIFO drain, taking the TX interrupt whenever it is
+ * enabled and the FIFO is down to half full, until all lcd.c
+ * queued is out. Returns the interrupts taken.
+ */
+uint32_t OpenLCD_Run_Timed() {
+	uint32_t interrupts = 0;
+
+	if ( writePending ) {
+		_OpenLCD_Take_Write();
+	}
+
+	while ( Host_SSI0_IM_R & OPENLCD_IM_TXIM ) {
+		if ( fifoCount > OPENLCD_FIFO_DEPTH / 2 ) {
+			_OpenLCD_Advance( shiftDoneNS + ( fifoCount - OPENLCD_FIFO_DEPTH / 2 - 1 ) * _OpenLCD_Byte_NS() );
+		}
+		LCD_SSI0_Handler();
+		interrupts++;
+		if ( writePending ) {
+			_OpenLCD_Take_Write();
+		}
+	}
+
+	if ( fifoCount ) {
+		_OpenLCD_Advance( shiftDoneNS + ( fifoCount - 1 ) * _OpenLCD_Byte_NS() );
+	}
+	return interrupts;
+}
+
+uint32_t OpenLCD_Get_Bytes() {
+	return bytes;
+}
+
+/*
+ * Whether row shows text, padded out with spaces
+ */
+uint8_t OpenLCD_Showing( uint8_t row, const char *text ) {
+	for ( uint8_t i=0; i < LCD_COLUMNS; i++ ) {
+		char expected = *text ? *text++ : ' ';
+		if ( display[row][i] != expected ) {
+			return 0;
+		}
+	}
+	return 1;
+}
@@ -0,0 +1,28 @@
+// Simulated SparkFun OpenLCD on SSI0 for the LCD tests
+//
+// Takes the bytes lcd.c writes to the SSI0 data register through
+// the register hook and plays them into a 2x16 display the way
+// OpenLCD does: 0xFE and a DDRAM address move the cursor, 0x7C
+// and 0x2D clear, other settings are taken and ignored, anything
+// else is a character at the cursor, which wraps to the next row.
+//
+// Untimed, the SSI sends as fast as lcd.c writes. Timed, the 8 byte
+// TX FIFO drains at the bit rate lcd.c set up for the system clock
+// and the TX interrupt is taken each time it falls to half full.
+
+#ifndef __OPENLCD_H
+#define __OPENLCD_H
+
+#include <stdint.h>
+
+#include "lcd.h"
+
+void OpenLCD_Init();
+void OpenLCD_Run();
+uint32_t OpenLCD_Get_Bytes();
+uint8_t OpenLCD_Showing( uint8_t row, const char *text );
+void OpenLCD_Set_Timed( uint32_t systemHz );
+uint32_t OpenLCD_Get_Bit_Rate();
+uint32_t OpenLCD_Run_Timed();
+
+#endif // __OPENLCD_H
@@ -0,0 +1,357 @@
+// Host test of the interrupt handler profiles
+//
+// Builds profile.c with PROFILE_ENABLED against the virtual cycle
+// counter. Checks the nested duration arithmetic with handlers
+// preempting each other three deep, a handler taken just after
+// each of the cycle counter reads in Profile_Enter and Profile_Exit
+// (held off until interrupts are unmasked, if they're masked), the
+// latency worked out from a one-shot's schedule, and the log2
+// bucket edges. Then runs the
+// real OneWire handler off its own Timer0 one-shots, each register
+// access costing a few cycles and each interrupt taken a random
+// few cycles late, and checks its profile against what the test
+// measured from outside. Prints the OneWire profile.
+
+#include "host.h"
+#include "profile.h"
+#include "clock.h"
+#include "onewire.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TEST_CYCLES_PER_ACCESS 2
+#define TEST_MAX_LATE 200
+#define TEST_BYTES 40
+#define TEST_OUTER_CYCLES 1000
+#define TEST_INNER_CYCLES 300
+#define TEST_PREEMPT_CYCLES 50
+#define TEST_COUNTER_READS 4
+
+static uint8_t hookCycles;
+static uint32_t armedAt;
+static uint8_t armed;
+
+static uint16_t expectedLatency[PROFILE_BUCKETS];
+static uint32_t maxLate;
+static uint64_t handlerCycles;
+static uint32_t interrupts;
+static uint32_t bytesRead;
+
+// The counter for the preemption case, and which read of it the
+// preempting handler comes in after
+static uint32_t preemptCycles;
+static uint8_t preemptReads;
+static uint8_t preemptAfter;
+static uint8_t preemptPending;
+
+void Telemetry_Send_Event( uint8_t event, uint32_t data ) {
+}
+
+/*
+ * Each register access costs a few cycles. The last Timer0 CTL
+ * access in _OneWire_Wait starts the countdown, so note when.
+ */
+void _Test_Register_Hook( volatile uint32_t *reg ) {
+	if ( ! hookCycles ) {
+		return;
+	}
+	if ( reg == &Host_TIMER0_CTL_R ) {
+		armed = 1;
+		armedAt = Profile_Get_Cycles();
+	}
+	Profile_Host_Advance( TEST_CYCLES_PER_ACCESS );
+}
+
+uint8_t _Test_Bucket( uint32_t value ) {
+	uint8_t bucket = 0;
+	while ( value ) {
+		bucket++;
+		value >>= 1;
+	}
+	return ( bucket < PROFILE_BUCKETS ) ? bucket : PROFILE_BUCKETS - 1;
+}
+
+void _Test_Byte_Read( uint8_t data ) {
+	bytesRead++;
+}
+
+void _Test_Nesting() {
+	Profile_ISR tick, gps, i2c;
+
+	Profile_Reset();
+
+	// The tick runs 1000 cycles, the GPS UART takes it over for
+	// 300 of them, and the I2C handler that for 50
+	Profile_Enter( PROFILE_TICK, 10 );
+	Profile_Host_Advance( 400 );
+	Profile_Enter( PROFILE_GPS_UART, PROFILE_NO_LATENCY );
+	Profile_Host_Advance( 100 );
+	Profile_Enter( PROFILE_I2C, PROFILE_NO_LATENCY );
+	Profile_Host_Advance( 50 );
+	Profile_Exit( PROFILE_I2C );
+	Profile_Host_Advance( 150 );
+	Profile_Exit( PROFILE_GPS_UART );
+	Profile_Host_Advance( 600 );
+	Profile_Exit( PROFILE_TICK );
+
+	// Back to back, nothing carried over
+	Profile_Enter( PROFILE_I2C, PROFILE_NO_LATENCY );
+	Profile_Host_Advance( 70 );
+	Profile_Exit( PROFILE_I2C );
+
+	HOST_CHECK( Profile_Get_ISR( PROFILE_TICK, &tick ) );
+	HOST_CHECK( Profile_Get_ISR( PROFILE_GPS_UART, &gps ) );
+	HOST_CHECK( Profile_Get_ISR( PROFILE_I2C, &i2c ) );
+
+	HOST_CHECK( 1 == tick.count );
+	HOST_CHECK( 1000 == tick.cycles );
+	HOST_CHECK( 1000 == tick.maxDuration );
+	HOST_CHECK( 1 == tick.duration[_Test_Bucket( 1000 )] );
+	HOST_CHECK( 10 == tick.maxLatency );
+	HOST_CHECK( 1 == tick.latency[_Test_Bucket( 10 )] );
+
+	HOST_CHECK( 1 == gps.count );
+	HOST_CHECK( 250 == gps.cycles );
+	// No schedule and no latency given, so none counted
+	HOST_CHECK( 0 == gps.maxLatency );
+	for ( uint8_t bucket=0; bucket < PROFILE_BUCKETS; bucket++ ) {
+		HOST_CHECK( 0 == gps.latency[bucket] );
+	}
+
+	HOST_CHECK( 2 == i2c.count );
+	HOST_CHECK( 120 == i2c.cycles );
+	HOST_CHECK( 70 == i2c.maxDuration );
+
+	// A stray exit with nothing in progress is ignored
+	Profile_Exit( PROFILE_TICK );
+	HOST_CHECK( Profile_Get_ISR( PROFILE_TICK, &tick ) );
+	HOST_CHECK( 1 == tick.count );
+}
+
+void _Test_Preempting_Handler() {
+	Profile_Enter( PROFILE_I2C, PROFILE_NO_LATENCY );
+	preemptCycles += TEST_PREEMPT_CYCLES;
+	Profile_Exit( PROFILE_I2C );
+}
+
+/*
+ * The cycle counter, with an interrupt landing just after the read
+ * it's armed for - straight away if interrupts are unmasked, or
+ * held pending until they are
+ */
+uint32_t _Test_Preempt_Counter() {
+	uint32_t now = preemptCycles;
+
+	if ( ++preemptReads == preemptAfter ) {
+		if ( Host_PRIMASK ) {
+			preemptPending = 1;
+		} else {
+			_Test_Preempting_Handler();
+		}
+	}
+	return now;
+}
+
+/*
+ * Takes an interrupt held off by the mask, now it's been put back
+ */
+void _Test_Unmasked() {
+	HOST_CHECK( ! Host_PRIMASK );
+	if ( preemptPending ) {
+		preemptPending = 0;
+		_Test_Preempting_Handler();
+	}
+}
+
+void _Test_Preemption() {
+	Profile_ISR tick, gps, i2c;
+
+	Profile_Host_Set_Counter( _Test_Preempt_Counter );
+	for ( preemptAfter=1; preemptAfter <= TEST_COUNTER_READS; preemptAfter++ ) {
+		Profile_Reset();
+		preemptReads = 0;
+
+		// The GPS UART preempting the tick, and the I2C handler
+		// coming in after one of their four counter reads
+		Profile_Enter( PROFILE_TICK, PROFILE_NO_LATENCY );
+		_Test_Unmasked();
+		preemptCycles += TEST_OUTER_CYCLES / 2;
+		Profile_Enter( PROFILE_GPS_UART, PROFILE_NO_LATENCY );
+		_Test_Unmasked();
+		preemptCycles += TEST_INNER_CYCLES;
+		Profile_Exit( PROFILE_GPS_UART );
+		_Test_Unmasked();
+		preemptCycles += TEST_OUTER_CYCLES / 2;
+		Profile_Exit( PROFILE_TICK );
+		_Test_Unmasked();
+
+		// Its own two as well
+		HOST_CHECK( TEST_COUNTER_READS + 2 == preemptReads );
+		HOST_CHECK( Profile_Get_ISR( PROFILE_TICK, &tick ) );
+		HOST_CHECK( Profile_Get_ISR( PROFILE_GPS_UART, &gps ) );
+		HOST_CHECK( Profile_Get_ISR( PROFILE_I2C, &i2c ) );
+
+		// Each billed for its own cycles only, wherever it came in
+		HOST_CHECK( TEST_OUTER_CYCLES == tick.cycles );
+		HOST_CHECK( TEST_INNER_CYCLES == gps.cycles );
+		HOST_CHECK( ( 1 == i2c.count ) && ( TEST_PREEMPT_CYCLES == i2c.cycles ) );
+		if ( ( TEST_OUTER_CYCLES != tick.cycles ) || ( TEST_INNER_CYCLES != gps.cycles ) ) {
+			printf( "  preempted after read %u: tick %u cycles, GPS %u\n", preemptAfter, (uint32_t) tick.cycles,
+				(uint32_t) gps.cycles );
+		}
+	}
+	Profile_Host_Set_Counter( 0 );
+}
+
+void _Test_Schedule() {
+	Profile_ISR i2c;
+
+	Profile_Reset();
+
+	// Taken 37 cycles after it was due
+	Profile_Schedule( PROFILE_I2C, 5000 );
+	Profile_Host_Advance( 5037 );
+	Profile_Enter( PROFILE_I2C, PROFILE_NO_LATENCY );
+	Profile_Exit( PROFILE_I2C );
+
+	// Early (the counter doesn't run backwards, but say it did)
+	Profile_Schedule( PROFILE_I2C, 5000 );
+	Profile_Host_Advance( 4000 );
+	Profile_Enter( PROFILE_I2C, PROFILE_NO_LATENCY );
+	Profile_Exit( PROFILE_I2C );
+
+	// The schedule is used up by the first entry
+	Profile_Host_Advance( 100000 );
+	Profile_Enter( PROFILE_I2C, PROFILE_NO_LATENCY );
+	Profile_Exit( PROFILE_I2C );
+
+	HOST_CHECK( Profile_Get_ISR( PROFILE_I2C, &i2c ) );
+	HOST_CHECK( 3 == i2c.count );
+	HOST_CHECK( 37 == i2c.maxLatency );
+	HOST_CHECK( 1 == i2c.latency[_Test_Bucket( 37 )] );
+	HOST_CHECK( 1 == i2c.latency[0] );
+	HOST_CHECK( 0 == i2c.duration[1] );
+	HOST_CHECK( 3 == i2c.duration[0] );
+
+	// Out of range handlers are refused
+	Profile_Schedule( PROFILE_ISRS, 10 );
+	Profile_Enter( PROFILE_ISRS, 10 );
+	Profile_Exit( PROFILE_ISRS );
+	HOST_CHECK( ! Profile_Get_ISR( PROFILE_ISRS, &i2c ) );
+	HOST_CHECK( ! Profile_Get_ISR( PROFILE_I2C, 0 ) );
+}
+
+void _Test_Buckets() {
+	static const uint32_t durations[] = { 0, 1, 2, 3, 4, 7, 8, 1023, 1024, 0x3FFFFF, 0x400000, 0x7FFFFF, 0x800000, 0xFFFFFFFF };
+	static const uint8_t buckets[] = { 0, 1, 2, 2, 3, 3, 4, 10, 11, 22, 23, 23, 23, 23 };
+	uint16_t expected[PROFILE_BUCKETS] = { 0 };
+	Profile_ISR lcd;
+
+	Profile_Reset();
+	for ( uint8_t i=0; i < sizeof( durations ) / sizeof( durations[0] ); i++ ) {
+		Profile_Enter( PROFILE_LCD, durations[i] );
+		Profile_Host_Advance( durations[i] );
+		Profile_Exit( PROFILE_LCD );
+		expected[buckets[i]]++;
+	}
+
+	HOST_CHECK( Profile_Get_ISR( PROFILE_LCD, &lcd ) );
+	HOST_CHECK( 0 == memcmp( expected, lcd.duration, sizeof( expected ) ) );
+	// Latency 0xFFFFFFFF means none, so that one isn't counted
+	expected[PROFILE_BUCKETS - 1]--;
+	HOST_CHECK( 0 == memcmp( expected, lcd.latency, sizeof( expected ) ) );
+	HOST_CHECK( 0xFFFFFFFF == lcd.maxDuration );
+
+	// Reset clears it all
+	Profile_Reset();
+	HOST_CHECK( Profile_Get_ISR( PROFILE_LCD, &lcd ) );
+	HOST_CHECK( 0 == lcd.count );
+	HOST_CHECK( 0 == lcd.cycles );
+	HOST_CHECK( 0 == lcd.duration[PROFILE_BUCKETS - 1] );
+
+	// Reading a profile inside a critical section leaves it closed
+	__disable_interrupt();
+	Profile_Get_ISR( PROFILE_LCD, &lcd );
+	HOST_CHECK( 1 == Host_PRIMASK );
+	__enable_interrupt();
+	Profile_Reset();
+	HOST_CHECK( 0 == Host_PRIMASK );
+}
+
+/*
+ * Takes the Timer0 interrupt a little late until OneWire finds
+ * its queue empty and doesn't rearm
+ */
+void _Test_Run_OneWire() {
+	while ( armed ) {
+		uint32_t late = rand() % ( TEST_MAX_LATE + 1 );
+		int32_t wait = (int32_t) ( armedAt + Host_TIMER0_TAILR_R + late - Profile_Get_Cycles() );
+		HOST_CHECK( wait >= 0 );
+		Profile_Host_Advance( wait );
+
+		expectedLatency[_Test_Bucket( late )]++;
+		if ( late > maxLate ) {
+			maxLate = late;
+		}
+
+		armed = 0;
+		uint32_t start = Profile_Get_Cycles();
+		OneWire_Timer0A_Handler();
+		handlerCycles += Profile_Get_Cycles() - start;
+		interrupts++;
+	}
+}
+
+void _Test_OneWire() {
+	Profile_ISR oneWire;
+
+	Profile_Reset();
+	hookCycles = 1;
+
+	for ( uint8_t i=0; i < TEST_BYTES; i++ ) {
+		OneWire_Reset( 0 );
+		OneWire_WriteByte( 0xCC );
+		OneWire_ReadByte( _Test_Byte_Read );
+		_Test_Run_OneWire();
+	}
+	hookCycles = 0;
+
+	HOST_CHECK( Profile_Get_ISR( PROFILE_ONEWIRE, &oneWire ) );
+	printf( "onewire: %u interrupts, %.1f cycles each, max %u; latency up to %u cycles\n  latency ",
+		oneWire.count, (double) oneWire.cycles / oneWire.count, oneWire.maxDuration, oneWire.maxLatency );
+	for ( uint8_t bucket=0; bucket < 10; bucket++ ) {
+		printf( "%u ", oneWire.latency[bucket] );
+	}
+	printf( "\n  duration " );
+	for ( uint8_t bucket=0; bucket < 10; bucket++ ) {
+		printf( "%u ", oneWire.duration[bucket] );
+	}
+	printf( "\n" );
+
+	HOST_CHECK( TEST_BYTES == bytesRead );
+	HOST_CHECK( interrupts == oneWire.count );
+	HOST_CHECK( handlerCycles == oneWire.cycles );
+	HOST_CHECK( maxLate == oneWire.maxLatency );
+	HOST_CHECK( 0 == memcmp( expectedLatency, oneWire.latency, sizeof( expectedLatency ) ) );
+	HOST_CHECK( oneWire.maxDuration > 0 );
+}
+
+int main() {
+	Host_Init();
+	srand( 44 );
+
+	Clock_Init( CLOCK_80_MHZ );
+	Profile_Init();
+	OneWire_Init();
+	Host_Set_Register_Hook( _Test_Register_Hook );
+
+	_Test_Nesting();
+	_Test_Preemption();
+	_Test_Schedule();
+	_Test_Buckets();
+	_Test_OneWire();
+
+	return Host_Report( "profile-isrs" );
+}
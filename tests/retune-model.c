@@ -0,0 +1,291 @@
+// Host model of RDA1846 retuning and scanning
+//
+// Stands in for PWM_I2C with a queue that runs the radio's
+// transactions in simulated time - bus time at 100 kHz plus each
+// transaction's wait - against a register file, so the scan is
+// paced by the same RSSI / squelch polls as on the station.
+// Measures the latency of a full retune (first tune, or after TX)
+// and of a fast one, and the time to cycle the scan list against
+// the dwell times asked for. Checks the writes a retune leaves out,
+// that activity stops the scan on the right channel, and that a
+// frame sent while scanning goes out on the home channel.
+
+#include "host.h"
+#include "rda1846.h"
+#include "pwm-i2c.h"
+#include "afsk.h"
+
+#include <stdio.h>
+#include <string.h>
+
+// Bus time at 100 kHz: start, address, register, two bytes, stop
+#define TEST_WRITE_US 380
+// Plus a repeated start and the address again
+#define TEST_READ_US 470
+
+#define TEST_CTL_R 0x30
+#define TEST_FREQ_HI_R 0x29
+#define TEST_FREQ_LO_R 0x2A
+#define TEST_RSSI_R 0x1B
+#define TEST_FLAG_R 0x1C
+#define TEST_CTL_TX 0x0040
+
+#define TEST_HOME_KHZ 144390
+#define TEST_NO_CHANNEL 0xFF
+
+typedef struct Test_Transactions {
+	uint8_t reg;
+	uint16_t data;
+	uint16_t mask;
+	uint16_t waitMS;
+	void (*callback)( uint16_t data );
+} Test_Transaction;
+
+static const uint32_t testScanKHz[] = { 144390, 144990, 145010, 145030, 145050, 145070, 145090, 145110 };
+static const uint16_t testScanDwellMS[] = { 50, 50, 50, 50, 100, 50, 50, 50 };
+#define TEST_SCAN_CHANNELS ( sizeof( testScanKHz ) / sizeof( testScanKHz[0] ) )
+
+static Test_Transaction queue[256];
+static uint8_t queueHead;
+static uint8_t queueTail;
+static uint64_t nowUS;
+static uint16_t registers[256];
+static uint64_t fullRetuneUS;
+static uint64_t fastRetuneUS;
+
+// Activity on one channel: a signal, with or without the squelch open
+static uint32_t activeKHz;
+static int16_t activeDBm;
+static uint8_t activeSquelch;
+
+static uint8_t stoppedChannel;
+static uint32_t txKHz;
+
+void PWM_I2C_Init( uint8_t address ) {
+}
+
+void PWM_I2C_Set_Callback( void (*callback)() ) {
+}
+
+void PWM_I2C_Queue_Command( uint8_t address, uint16_t data, uint16_t mask, uint16_t waitMS ) {
+	Test_Transaction transaction = { address, data, mask, waitMS, 0 };
+	queue[queueTail++] = transaction;
+}
+
+void PWM_I2C_Queue_Read( uint8_t address, void (*callback)( uint16_t data ), uint16_t waitMS ) {
+	Test_Transaction transaction = { address, 0, 0, waitMS, callback };
+	queue[queueTail++] = transaction;
+}
+
+void PWM_I2C_Start_PWM( uint32_t sampleRate, uint8_t (*source)( uint8_t *level ) ) {
+}
+
+void PWM_I2C_Stop_PWM() {
+}
+
+void AFSK_Start_Modulator( const uint8_t *line, uint16_t bits ) {
+}
+
+uint8_t AFSK_Modulate( uint8_t *level ) {
+	return 0;
+}
+
+uint8_t CSMA_Queue_Frame( uint8_t source, uint8_t *frame, uint16_t length ) {
+	return 1;
+}
+
+uint32_t _Test_Tuned_KHz() {
+	return ( ( (uint32_t) registers[TEST_FREQ_HI_R] << 16 ) | registers[TEST_FREQ_LO_R] ) >> 4;
+}
+
+/*
+ * Runs one transaction: bus time, the register access, then its wait
+ */
+void _Test_Step() {
+	Test_Transaction transaction = queue[queueHead++];
+
+	if ( transaction.callback ) {
+		nowUS += TEST_READ_US;
+		uint16_t value = registers[transaction.reg];
+		if ( _Test_Tuned_KHz() == activeKHz ) {
+			if ( TEST_RSSI_R == transaction.reg ) {
+				value = ( activeDBm + 135 ) << 3;
+			} else if ( ( TEST_FLAG_R == transaction.reg ) && activeSquelch ) {
+				value |= 0x0002;
+			}
+		} else if ( TEST_RSSI_R == transaction.reg ) {
+			value = ( -125 + 135 ) << 3;
+		}
+		transaction.callback( value );
+	} else {
+		// A masked write reads the register first
+		if ( 0xFFFF == transaction.mask ) {
+			registers[transaction.reg] = transaction.data;
+		} else {
+			nowUS += TEST_READ_US;
+			registers[transaction.reg] = ( registers[transaction.reg] & transaction.mask ) | transaction.data;
+		}
+		nowUS += TEST_WRITE_US;
+
+		if ( ( TEST_CTL_R == transaction.reg ) && ( registers[TEST_CTL_R] & TEST_CTL_TX ) ) {
+			txKHz = _Test_Tuned_KHz();
+		}
+	}
+
+	nowUS += transaction.waitMS * 1000;
+}
+
+/*
+ * Runs the queue empty, returns the time it took
+ */
+uint64_t _Test_Drain() {
+	uint64_t start = nowUS;
+	while ( queueHead != queueTail ) {
+		_Test_Step();
+	}
+	return nowUS - start;
+}
+
+void _Test_Run_For( uint64_t us ) {
+	uint64_t end = nowUS + us;
+	while ( ( nowUS < end ) && ( queueHead != queueTail ) ) {
+		_Test_Step();
+	}
+	if ( nowUS < end ) {
+		nowUS = end;
+	}
+}
+
+void _Test_Scan_Stopped( uint8_t channel ) {
+	stoppedChannel = channel;
+}
+
+void _Test_Retunes() {
+	uint32_t skippedBefore, skipped;
+
+	// First tune: RX off, band set up, both words, the RX sequence
+	RDA1846_Set_Frequency_KHz( TEST_HOME_KHZ );
+	uint32_t fullWrites = queueTail - queueHead;
+	fullRetuneUS = _Test_Drain();
+	HOST_CHECK( TEST_HOME_KHZ == _Test_Tuned_KHz() );
+
+	// Next channel up: the low word and the settle time only
+	RDA1846_Get_Scan_Stats( 0, &skippedBefore, 0 );
+	RDA1846_Set_Frequency_KHz( 144990 );
+	uint32_t fastWrites = queueTail - queueHead;
+	fastRetuneUS = _Test_Drain();
+	RDA1846_Get_Scan_Stats( 0, &skipped, 0 );
+	HOST_CHECK( 144990 == _Test_Tuned_KHz() );
+	HOST_CHECK( 1 == fastWrites );
+	HOST_CHECK( 1 == skipped - skippedBefore );
+
+	// Across a high word boundary (every 4096 kHz) both words go
+	RDA1846_Set_Frequency_KHz( 147000 );
+	_Test_Drain();
+	RDA1846_Set_Frequency_KHz( 147500 );
+	HOST_CHECK( 2 == queueTail - queueHead );
+	_Test_Drain();
+	HOST_CHECK( 147500 == _Test_Tuned_KHz() );
+
+	// Same channel, nothing at all
+	RDA1846_Get_Scan_Stats( 0, &skippedBefore, 0 );
+	RDA1846_Set_Frequency_KHz( 147500 );
+	HOST_CHECK( queueHead == queueTail );
+	RDA1846_Get_Scan_Stats( 0, &skipped, 0 );
+	HOST_CHECK( 2 == skipped - skippedBefore );
+
+	RDA1846_Set_Frequency_KHz( TEST_HOME_KHZ );
+	_Test_Drain();
+
+	printf( "retune: full %u writes %.2f ms, fast %u write %.2f ms\n",
+		fullWrites, fullRetuneUS / 1000.0, fastWrites, fastRetuneUS / 1000.0 );
+	HOST_CHECK( fastRetuneUS * 10 < fullRetuneUS );
+}
+
+void _Test_Scan() {
+	uint32_t dwellMS = 0;
+	uint32_t cyclesBefore, cycles;
+
+	for ( uint8_t i=0; i < TEST_SCAN_CHANNELS; i++ ) {
+		dwellMS += testScanDwellMS[i];
+	}
+
+	// Polling runs from the radio's init on the station
+	RDA1846_Set_RSSI_Poll_Rate( 10 );
+	RDA1846_Set_Scan_List( testScanKHz, testScanDwellMS, TEST_SCAN_CHANNELS );
+	RDA1846_Set_Scan_Threshold( -110 );
+	RDA1846_Get_Scan_Stats( 0, 0, &cyclesBefore );
+
+	activeKHz = 0;
+	stoppedChannel = TEST_NO_CHANNEL;
+	RDA1846_Start_Scan( _Test_Scan_Stopped );
+	_Test_Run_For( 60000000ULL );
+	RDA1846_Get_Scan_Stats( 0, 0, &cycles );
+	cycles -= cyclesBefore;
+
+	double cycleMS = 60000.0 / cycles;
+	printf( "scan: %u channels, %u ms of dwell, a cycle every %.1f ms (%.1f ms with full retunes)\n",
+		(unsigned) TEST_SCAN_CHANNELS, dwellMS, cycleMS,
+		cycleMS + TEST_SCAN_CHANNELS * ( fullRetuneUS - fastRetuneUS ) / 1000.0 );
+	HOST_CHECK( TEST_NO_CHANNEL == stoppedChannel );
+	HOST_CHECK( RDA1846_Scanning() );
+	// Polls take bus time on top of the dwell, retunes a little more
+	HOST_CHECK( cycleMS >= dwellMS );
+	HOST_CHECK( cycleMS < dwellMS * 1.25 );
+
+	// Squelch opening on one channel stops the scan there
+	activeKHz = testScanKHz[5];
+	activeDBm = -118;
+	activeSquelch = 1;
+	_Test_Run_For( 2000000ULL );
+	HOST_CHECK( 5 == stoppedChannel );
+	HOST_CHECK( ! RDA1846_Scanning() );
+	HOST_CHECK( testScanKHz[5] == _Test_Tuned_KHz() );
+
+	// So does a signal over the threshold with the squelch shut
+	activeKHz = testScanKHz[2];
+	activeDBm = -100;
+	activeSquelch = 0;
+	stoppedChannel = TEST_NO_CHANNEL;
+	RDA1846_Start_Scan( _Test_Scan_Stopped );
+	_Test_Run_For( 2000000ULL );
+	HOST_CHECK( 2 == stoppedChannel );
+
+	// And picks up again when started
+	activeKHz = 0;
+	RDA1846_Start_Scan( _Test_Scan_Stopped );
+	_Test_Run_For( 1000000ULL );
+	HOST_CHECK( RDA1846_Scanning() );
+}
+
+void _Test_Transmit_While_Scanning() {
+	uint8_t frame[40];
+	uint32_t cyclesBefore, cycles;
+
+	memset( frame, 0x55, sizeof( frame ) );
+
+	// Somewhere off the home channel
+	while ( _Test_Tuned_KHz() == TEST_HOME_KHZ ) {
+		_Test_Run_For( 10000 );
+	}
+
+	RDA1846_Get_Scan_Stats( 0, 0, &cyclesBefore );
+	txKHz = 0;
+	RDA1846_Transmit( frame, sizeof( frame ), 0 );
+	_Test_Run_For( 5000000ULL );
+	RDA1846_Get_Scan_Stats( 0, 0, &cycles );
+
+	HOST_CHECK( TEST_HOME_KHZ == txKHz );
+	HOST_CHECK( RDA1846_Scanning() );
+	HOST_CHECK( cycles > cyclesBefore );
+}
+
+int main() {
+	Host_Init();
+
+	_Test_Retunes();
+	_Test_Scan();
+	_Test_Transmit_While_Scanning();
+
+	return Host_Report( "retune-model" );
+}
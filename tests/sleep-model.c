@@ -0,0 +1,271 @@
+// Host model of the idle loop's sleep time and wakeups
+//
+// Runs main()'s loop - Power_Idle() over and over - with the WFI
+// hook standing in for the core: each WFI sleeps until the next
+// interrupt is due, then runs it and any that came due meanwhile
+// (tail-chained, so one wakeup). OneWire runs for real, so its
+// Timer0 one-shots come from its own task queue; the other sources
+// are modelled at the rates their drivers run at, with a cost per
+// interrupt estimated from the code paths. Prints the percentage of
+// time asleep and the wakeups per minute by source, and checks that
+// Timer0 is gated whenever the 1-Wire queue is empty and that
+// Power_Get_Wakeups_Per_Minute agrees with the model.
+//
+// Runs the thermometer schedule as main.c has it, and as it was:
+// a conversion started on every tick not a multiple of 6.
+
+#include "host.h"
+#include "power.h"
+#include "clock.h"
+#include "onewire.h"
+#include "ds18b20.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TEST_HZ CLOCK_80_MHZ
+#define TEST_MINUTES 10
+#define TEST_CYCLES_PER_MS ( TEST_HZ / 1000 )
+
+// Timer0A handler: one task, the one-shot rearmed
+#define TEST_ONEWIRE_CYCLES 150
+
+// Reset, then two bytes of two tasks a bit
+#define TEST_INITIATE_TASKS ( 3 + 2 * 8 * 2 )
+// Reset, two bytes, nine bytes of three tasks a bit and a transfer
+#define TEST_READ_TASKS ( 3 + 2 * 8 * 2 + 9 * ( 8 * 3 + 1 ) )
+
+typedef struct Test_Sources {
+	const char *name;
+	// Period, then a burst of interrupts that far apart
+	uint32_t periodMS;
+	uint8_t burst;
+	uint32_t gapUS;
+	uint32_t cycles;
+	void (*handler)();
+	uint64_t due;
+	uint8_t left;
+	uint32_t wakeups;
+} Test_Source;
+
+void _Test_Tick();
+
+static Test_Source sources[] = {
+	// Timer1A, formatting and the 2 Hz housekeeping in main.c
+	{ "tick", 500, 1, 0, 20000, _Test_Tick },
+	// 10 ms uDMA blocks of audio, AFSK_Process_Samples on each
+	{ "audio", 10, 1, 0, 15000, 0 },
+	// About 480 NMEA bytes a second, RX interrupt at 1/4 full
+	// (IFLS RXIFLSEL = 1) - 30 per 250 ms, plus a receive timeout
+	{ "gps", 250, 31, 8300, 400, 0 },
+	// Idle RSSI / squelch polls, two I2C reads with Timer2 between
+	{ "rssi", 100, 4, 500, 300, 0 },
+	// BME280 start and 8 byte burst read every 5 s
+	{ "bme280", 5000, 6, 1000, 300, 0 },
+	// The supply ADC sequence, once a second
+	{ "supply", 1000, 1, 0, 500, 0 },
+	// About 18 bytes per LCD update, the TX FIFO at half empty
+	{ "lcd", 10000, 5, 320, 200, 0 },
+};
+#define TEST_SOURCES ( sizeof( sources ) / sizeof( sources[0] ) )
+
+static uint64_t now;
+static uint64_t busy;
+static uint64_t oneWireDue;
+static uint8_t oneWireArmed;
+static uint32_t oneWireWakeups;
+static uint32_t wakeups;
+static uint32_t oneWireStops;
+static uint32_t oneWireBursts;
+static uint32_t oneWireTasks;
+
+static uint8_t cycleCount;
+static uint8_t oldSchedule;
+
+void Telemetry_Send_Event( uint8_t event, uint32_t data ) {
+}
+
+/*
+ * The thermometer part of main()'s Timer1A handler
+ */
+void _Test_Tick() {
+	if ( cycleCount & 0x01 ) {
+		Power_Tick_Second();
+	}
+
+	if ( oldSchedule ? ( cycleCount % 6 ) : ( 6 == cycleCount ) ) {
+		DS18B20_Initiate_Measurement();
+		oneWireTasks += TEST_INITIATE_TASKS;
+		oneWireBursts++;
+	}
+
+	if ( 12 == cycleCount ) {
+		DS18B20_Read_Scratchpad();
+		oneWireTasks += TEST_READ_TASKS;
+		oneWireBursts++;
+	}
+
+	cycleCount++;
+	if ( 29 < cycleCount ) {
+		cycleCount = 0;
+	}
+}
+
+/*
+ * Picks up a Timer0 one-shot OneWire armed
+ */
+void _Test_Check_Timer0() {
+	if ( ! oneWireArmed && ( Host_SYSCTL_RCGCTIMER_R & 0x01 ) ) {
+		oneWireArmed = 1;
+		oneWireDue = now + Host_TIMER0_TAILR_R + 1;
+	}
+}
+
+/*
+ * Runs whatever is due, until nothing is
+ */
+void _Test_Run_Due() {
+	uint8_t ran = 1;
+
+	while ( ran ) {
+		ran = 0;
+
+		if ( oneWireArmed && ( oneWireDue <= now ) ) {
+			oneWireArmed = 0;
+			OneWire_Timer0A_Handler();
+			now += TEST_ONEWIRE_CYCLES;
+			busy += TEST_ONEWIRE_CYCLES;
+			oneWireWakeups++;
+			if ( ! ( Host_SYSCTL_RCGCTIMER_R & 0x01 ) ) {
+				oneWireStops++;
+			}
+			_Test_Check_Timer0();
+			ran = 1;
+		}
+
+		for ( uint8_t i=0; i < TEST_SOURCES; i++ ) {
+			Test_Source *source = &sources[i];
+			if ( source->due > now ) {
+				continue;
+			}
+
+			if ( source->handler ) {
+				source->handler();
+			}
+			now += source->cycles;
+			busy += source->cycles;
+			source->wakeups++;
+			_Test_Check_Timer0();
+			ran = 1;
+
+			source->left--;
+			if ( source->left ) {
+				source->due += (uint64_t) source->gapUS * ( TEST_HZ / 1000000 );
+			} else {
+				source->left = source->burst;
+				source->due += (uint64_t) source->periodMS * TEST_CYCLES_PER_MS -
+					(uint64_t) ( source->burst - 1 ) * source->gapUS * ( TEST_HZ / 1000000 );
+			}
+		}
+	}
+}
+
+/*
+ * WFI: sleeps until the next interrupt and runs it
+ */
+void _Test_WFI() {
+	uint64_t next = oneWireArmed ? oneWireDue : UINT64_MAX;
+	for ( uint8_t i=0; i < TEST_SOURCES; i++ ) {
+		if ( sources[i].due < next ) {
+			next = sources[i].due;
+		}
+	}
+
+	if ( next > now ) {
+		now = next;
+	}
+	wakeups++;
+	_Test_Run_Due();
+}
+
+/*
+ * Runs the station from the idle loop - returns the fraction
+ * of time asleep
+ */
+double _Test_Run( uint8_t old ) {
+	oldSchedule = old;
+	cycleCount = 0;
+	now = 0;
+	busy = 0;
+	wakeups = 0;
+	oneWireWakeups = 0;
+	oneWireStops = 0;
+	oneWireBursts = 0;
+	oneWireTasks = 0;
+
+	for ( uint8_t i=0; i < TEST_SOURCES; i++ ) {
+		// Spread out, as the sources aren't in step
+		sources[i].due = (uint64_t) i * 1700 * ( TEST_HZ / 1000000 );
+		sources[i].left = sources[i].burst;
+		sources[i].wakeups = 0;
+	}
+
+	uint64_t end = (uint64_t) TEST_MINUTES * 60000 * TEST_CYCLES_PER_MS;
+	uint32_t lastMinuteWakeups = 0, wakeupsAtMinute = 0;
+	uint64_t minute = 60000ULL * TEST_CYCLES_PER_MS;
+	while ( now < end ) {
+		Power_Idle();
+
+		if ( now >= minute ) {
+			lastMinuteWakeups = wakeups - wakeupsAtMinute;
+			wakeupsAtMinute = wakeups;
+			minute += 60000ULL * TEST_CYCLES_PER_MS;
+		}
+	}
+
+	double asleep = 100.0 * ( now - busy ) / now;
+	printf( "%s thermometer schedule: %.2f%% asleep, %u wakeups a minute (",
+		old ? "old" : "new", asleep, wakeups / TEST_MINUTES );
+	for ( uint8_t i=0; i < TEST_SOURCES; i++ ) {
+		printf( "%s %u, ", sources[i].name, sources[i].wakeups / TEST_MINUTES );
+	}
+	printf( "1-wire %u)\n", oneWireWakeups / TEST_MINUTES );
+
+	// One Timer0 interrupt per task, and one to find the queue
+	// empty and gate the timer - none while idle
+	HOST_CHECK( oneWireWakeups == oneWireTasks + oneWireStops );
+	HOST_CHECK( oneWireStops == oneWireBursts );
+	HOST_CHECK( ! oneWireArmed );
+	HOST_CHECK( 0 == ( Host_SYSCTL_RCGCTIMER_R & 0x01 ) );
+
+	// Power counts by the second tick, the model by the cycle
+	HOST_CHECK( abs( (int32_t) Power_Get_Wakeups_Per_Minute() - (int32_t) lastMinuteWakeups ) < 100 );
+
+	return asleep;
+}
+
+int main() {
+	Host_Init();
+
+	Clock_Init( TEST_HZ );
+	Power_Init();
+	DS18B20_Init();
+	Host_Set_WFI_Hook( _Test_WFI );
+
+	double oldAsleep = _Test_Run( 1 );
+	uint32_t oldOneWire = oneWireWakeups;
+	double asleep = _Test_Run( 0 );
+
+	// Before: the loop spun, and OneWire polled every 1 ms regardless
+	printf( "before: 0%% asleep, the 1-wire poll alone woke it 60000 times a minute\n" );
+
+	HOST_CHECK( asleep > oldAsleep );
+	// A conversion and a read every 15 seconds, where there were
+	// 25 conversions
+	HOST_CHECK( oneWireWakeups * 3 < oldOneWire );
+	HOST_CHECK( asleep > 95.0 );
+	HOST_CHECK( wakeups / TEST_MINUTES < 60000 );
+
+	return Host_Report( "sleep-model" );
+}
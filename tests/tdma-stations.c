@@ -0,0 +1,151 @@
+// Host simulation of N stations sharing a channel through tdma.c
+//
+// Every station runs its own copy of the TDMA and CSMA schedulers,
+// owns slot ( station % TDMA_SLOTS ) and hands over one report a
+// minute at its own random second. Each station's GPS sentence for
+// a second turns up 150 to 300 ms after it and one in a hundred is
+// lost. Up to TDMA_SLOTS stations nothing may collide and every
+// report must go out. Past that, stations share slots, and two in
+// one slot key up on the same second - slotting then loses more
+// than plain CSMA, shown for comparison, would.
+
+#include "host.h"
+#include "channel.h"
+#include "tdma.h"
+#include "csma.h"
+#include "gps.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define TEST_SECONDS 3600
+#define TEST_REPORT_SECONDS 60
+
+static const uint8_t testStationCounts[] = { 1, 5, 10, 20, TDMA_SLOTS, 45, 60 };
+
+static uint8_t initializing;
+static void (*secondCallbacks[CHANNEL_MAX_STATIONS])();
+static uint32_t nextSentenceMS[CHANNEL_MAX_STATIONS];
+static uint32_t sentenceSecond[CHANNEL_MAX_STATIONS];
+static uint32_t reportOffsetMS[CHANNEL_MAX_STATIONS];
+static uint32_t reportSecond;
+
+void GPS_Register_Second_Callback( void (*callback)() ) {
+	secondCallbacks[initializing] = callback;
+}
+
+void GPS_Get_Time( uint8_t *hour, uint8_t *minute, uint8_t *seconds ) {
+	if ( hour ) {
+		*hour = ( reportSecond / 3600 ) % 24;
+	}
+	if ( minute ) {
+		*minute = ( reportSecond / 60 ) % 60;
+	}
+	if ( seconds ) {
+		*seconds = reportSecond % 60;
+	}
+}
+
+uint32_t _Test_Latency() {
+	return 150 + rand() % 151;
+}
+
+/*
+ * Runs the stations for TEST_SECONDS - slotted, or plain CSMA
+ * Returns the collision count
+ */
+uint32_t _Test_Stations( uint8_t stations, uint8_t slotted ) {
+	uint8_t frame[100];
+	uint32_t offered = 0, refused = 0;
+
+	Channel_Init( stations );
+	srand( 31 + stations );
+
+	for ( uint8_t i=0; i < stations; i++ ) {
+		Channel_Select( i );
+		initializing = i;
+		secondCallbacks[i] = 0;
+		CSMA_Init();
+		TDMA_Init( slotted ? i % TDMA_SLOTS : TDMA_SLOT_NONE );
+		nextSentenceMS[i] = _Test_Latency();
+		sentenceSecond[i] = 0;
+		reportOffsetMS[i] = rand() % ( TEST_REPORT_SECONDS * 1000 );
+	}
+
+	while ( Channel_Now() < TEST_SECONDS * 1000 ) {
+		uint32_t now = Channel_Now();
+
+		for ( uint8_t i=0; i < stations; i++ ) {
+			if ( now >= nextSentenceMS[i] ) {
+				if ( secondCallbacks[i] && ( rand() % 100 ) ) {
+					Channel_Select( i );
+					reportSecond = sentenceSecond[i];
+					secondCallbacks[i]();
+				}
+				sentenceSecond[i]++;
+				nextSentenceMS[i] = sentenceSecond[i] * 1000 + _Test_Latency();
+			}
+
+			if ( ( now % ( TEST_REPORT_SECONDS * 1000 ) ) == reportOffsetMS[i] / CHANNEL_TICK_MS * CHANNEL_TICK_MS ) {
+				uint16_t length = 60 + rand() % 41;
+				for ( uint16_t j=0; j < length; j++ ) {
+					frame[j] = rand();
+				}
+				Channel_Select( i );
+				offered++;
+				if ( ! TDMA_Send_Packet( frame, length ) ) {
+					refused++;
+				}
+			}
+		}
+		Channel_Tick();
+	}
+
+	uint32_t sent = 0, deferred = 0, tooLong = 0, dropped = 0;
+	for ( uint8_t i=0; i < stations; i++ ) {
+		uint32_t stationSent, stationDeferred, stationTooLong, stationDropped;
+		Channel_Select( i );
+		TDMA_Get_Stats( &stationSent, &stationDeferred, &stationTooLong );
+		CSMA_Get_Stats( 0, &stationDropped, 0 );
+		sent += stationSent;
+		deferred += stationDeferred;
+		tooLong += stationTooLong;
+		dropped += stationDropped;
+	}
+
+	Channel_Stat stats;
+	Channel_Get_Stats( &stats );
+
+	printf( "%3u stations %-7s  %5u reports  %5u sent  %4u collided  %3u deferred  %3u dropped  %3u refused\n",
+		stations, slotted ? "slotted" : "CSMA", offered, slotted ? sent : stats.transmissions, stats.collided,
+		deferred, dropped, refused );
+
+	if ( slotted && ( stations <= TDMA_SLOTS ) ) {
+		// A report goes out in its slot, or waits a frame if it came
+		// too late in the slot or the sentence was lost - and the next
+		// report is turned away while it waits. One can be left over.
+		HOST_CHECK( 0 == stats.collided );
+		HOST_CHECK( 0 == tooLong );
+		HOST_CHECK( 0 == dropped );
+		HOST_CHECK( refused <= deferred );
+		HOST_CHECK( sent + refused + stations >= offered );
+		HOST_CHECK( stats.transmissions == sent );
+	}
+
+	return stats.collided;
+}
+
+int main() {
+	Host_Init();
+
+	for ( uint8_t i=0; i < sizeof( testStationCounts ); i++ ) {
+		uint32_t slotted = _Test_Stations( testStationCounts[i], 1 );
+		uint32_t unslotted = _Test_Stations( testStationCounts[i], 0 );
+		if ( ( testStationCounts[i] >= 10 ) && ( testStationCounts[i] <= TDMA_SLOTS ) ) {
+			HOST_CHECK( slotted < unslotted );
+		}
+	}
+
+	Channel_Free();
+	return Host_Report( "tdma-stations" );
+}
@@ -0,0 +1,1053 @@
+// Host test of the telemetry stream's COBS framing
+//
+// First hands the encoder frames directly, in up to three pieces,
+// and decodes what _Telemetry_Next_TX_Byte produces with a reference
+// COBS decoder: runs of exactly 254 non-zero bytes (one code byte's
+// worth), a 254 byte run followed by a zero, frames ending in a zero,
+// runs across the pieces, and thousands of random frames.
+//
+// Then plays the host end of UART5 through the register hook, with
+// a 16 byte TX FIFO the test drains a few bytes at a time: random
+// records through _Telemetry_Queue, the ring filling up while the
+// FIFO is held full, a history dump from flash log pages (some never
+// written, some erased to 0xFF) requested over the RX decoder with
+// records queued in between, a profile report with its reset, a
+// minute of state and counter records, and a streamed event trace.
+// The trace's writers are preempted by the telemetry handler between
+// claiming a record and writing it, and one is cut short by a reset.
+// Every frame out is decoded and its CRC checked, the sequence
+// numbers must run on with none missing, and each record must be the
+// one expected. Finally runs the captured stream through
+// tools/telemetry-decode.py, which must count the same frames, none
+// bad or lost, and tools/trace-to-json.py, which must keep every
+// trace record and put its boots, ticks and I2C writes in the JSON.
+// Prints the totals.
+
+#include "host.h"
+#include "telemetry.h"
+#include "flash-log.h"
+#include "profile.h"
+#include "trace.h"
+#include "bench.h"
+#include "clock.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <setjmp.h>
+
+#define TEST_TX_FIFO 16
+#define TEST_TX_SLOTS 16
+#define TEST_MAX_PAYLOAD 27
+#define TEST_COBS_MAX_RUN 254
+
+#define TEST_RANDOM_FRAMES 3000
+#define TEST_MAX_FRAME 700
+#define TEST_RANDOM_RECORDS 5000
+#define TEST_RECORD_TYPE 0x7F
+
+#define TEST_STREAM_BYTES ( 1 << 20 )
+#define TEST_STREAM_FILE "telemetry-cobs.bin"
+#define TEST_DECODER "../../tools/telemetry-decode.py"
+
+#define TEST_TRACE_EVENTS 3000
+#define TEST_TRACE_TAIL 40
+#define TEST_TRACE_INDICES ( TEST_TRACE_EVENTS + TEST_TRACE_EVENTS / 10 + TEST_TRACE_TAIL + 4 )
+#define TEST_TRACE_FILE "telemetry-trace.json"
+#define TEST_TRACE_TOOL "../../tools/trace-to-json.py"
+
+typedef struct Test_Records {
+	uint8_t type;
+	uint8_t length;
+	uint8_t payload[TEST_MAX_PAYLOAD];
+} Test_Record;
+
+// The stream out of UART5, and how far it has been decoded
+static uint8_t stream[TEST_STREAM_BYTES];
+static uint32_t streamLength;
+static uint32_t streamDecoded;
+static uint8_t txFifoCount;
+static uint8_t txWritePending;
+
+// Queued records not yet seen in the stream
+static Test_Record expected[TEST_TX_SLOTS * 4];
+static uint16_t expectedHead;
+static uint16_t expectedTail;
+
+static uint32_t encodedFrames;
+static uint32_t frames;
+static uint16_t lastSequence;
+static uint8_t sequenceKnown;
+static uint32_t recordsSeen;
+static uint32_t recordsDropped;
+
+// Flash log pages for the dump
+static uint8_t pages[FLASH_LOG_PAGES][FLASH_LOG_PAGE_SIZE];
+static uint8_t pageWritten[FLASH_LOG_PAGES];
+static uint16_t pageHead;
+static uint16_t dumpNext;
+static uint16_t dumpLeft;
+static uint16_t dumpSeen;
+static uint8_t dumpEnded;
+
+static Profile_ISR profileSnapshot[PROFILE_ISRS];
+static uint8_t profileNext;
+
+static uint32_t stateSeen;
+static uint8_t counterGroup;
+
+// Each trace record as written, by its index
+static Trace_Record traceExpected[TEST_TRACE_INDICES];
+static uint32_t traceNextIndex;
+static uint8_t traceEnded;
+static uint32_t traceCycles;
+static uint8_t tracePreempt;
+static uint32_t tracePreempted;
+static uint8_t traceCut;
+static jmp_buf traceReset;
+
+static const uint8_t testTraceEvents[] = {
+	TRACE_TICK, TRACE_ONEWIRE_ADD, TRACE_ONEWIRE_TASK, TRACE_ONEWIRE_CALLBACK, TRACE_ONEWIRE_IDLE,
+	TRACE_I2C_QUEUE, TRACE_I2C_WRITE, TRACE_I2C_READ, TRACE_I2C_IDLE, TRACE_UART_RX, TRACE_UART_LINE,
+	TRACE_CSMA_TRANSMIT, TRACE_CSMA_DROP
+};
+
+void _Telemetry_Start_Frame( const uint8_t *header, uint16_t headerLength, const uint8_t *body, uint16_t bodyLength, const uint8_t *crc );
+uint8_t _Telemetry_Next_TX_Byte( uint8_t *data );
+uint8_t _Telemetry_Queue( uint8_t type, const uint8_t *payload, uint8_t length );
+void _Telemetry_Receive_Byte( uint8_t data );
+
+/*
+ * The AX.25 FCS a bit at a time, as the decoder has it
+ */
+uint16_t _Test_CRC( const uint8_t *data, uint16_t length ) {
+	uint16_t crc = 0xFFFF;
+	for ( uint16_t i=0; i < length; i++ ) {
+		crc ^= data[i];
+		for ( uint8_t bit=0; bit < 8; bit++ ) {
+			crc = ( crc & 1 ) ? ( crc >> 1 ) ^ 0x8408 : crc >> 1;
+		}
+	}
+	return crc ^ 0xFFFF;
+}
+
+/*
+ * Reference COBS decode of a frame without its zero
+ * Returns the decoded length, or -1 if it isn't valid COBS
+ */
+int32_t _Test_COBS_Decode( const uint8_t *encoded, uint32_t length, uint8_t *decoded ) {
+	uint32_t in = 0;
+	int32_t out = 0;
+
+	while ( in < length ) {
+		uint8_t code = encoded[in];
+		if ( ( 0 == code ) || ( in + code > length ) ) {
+			return -1;
+		}
+		memcpy( &decoded[out], &encoded[in + 1], code - 1 );
+		out += code - 1;
+		in += code;
+		if ( ( code < 0xFF ) && ( in < length ) ) {
+			decoded[out++] = 0;
+		}
+	}
+	return out;
+}
+
+/*
+ * Reference COBS encode, with the zero ahead and after as the
+ * decoder sends a request
+ */
+uint16_t _Test_COBS_Encode( const uint8_t *data, uint16_t length, uint8_t *encoded ) {
+	uint16_t out = 0;
+
+	encoded[out++] = 0;
+	uint16_t code = out++;
+	for ( uint16_t i=0; i < length; i++ ) {
+		if ( data[i] ) {
+			encoded[out++] = data[i];
+			if ( TEST_COBS_MAX_RUN + 1 == out - code ) {
+				encoded[code] = 0xFF;
+				code = out++;
+			}
+		} else {
+			encoded[code] = out - code;
+			code = out++;
+		}
+	}
+	encoded[code] = out - code;
+	encoded[out++] = 0;
+	return out;
+}
+
+/*
+ * Runs one frame through the encoder in its three pieces and
+ * checks the reference decoder gets it back, with the one zero at
+ * the end and no more code bytes than it needs
+ */
+void _Test_Encode( const uint8_t *header, uint16_t headerLength, const uint8_t *body, uint16_t bodyLength, const uint8_t *crc ) {
+	static uint8_t encoded[TEST_MAX_FRAME * 2];
+	static uint8_t decoded[TEST_MAX_FRAME * 2];
+	uint8_t frame[TEST_MAX_FRAME + 2];
+	uint16_t length = headerLength + bodyLength + ( crc ? 2 : 0 );
+	uint32_t encodedLength = 0;
+	uint8_t data;
+
+	memcpy( frame, header, headerLength );
+	memcpy( &frame[headerLength], body, bodyLength );
+	if ( crc ) {
+		memcpy( &frame[headerLength + bodyLength], crc, 2 );
+	}
+
+	_Telemetry_Start_Frame( header, headerLength, body, bodyLength, crc );
+	while ( ( encodedLength < sizeof( encoded ) ) && _Telemetry_Next_TX_Byte( &data ) ) {
+		encoded[encodedLength++] = data;
+	}
+
+	HOST_CHECK( encodedLength >= 2 );
+	HOST_CHECK( 0 == encoded[encodedLength - 1] );
+	HOST_CHECK( ! memchr( encoded, 0, encodedLength - 1 ) );
+	HOST_CHECK( encodedLength <= length + length / TEST_COBS_MAX_RUN + 2 );
+
+	encodedFrames++;
+	int32_t decodedLength = _Test_COBS_Decode( encoded, encodedLength - 1, decoded );
+	HOST_CHECK( decodedLength == length );
+	HOST_CHECK( ( decodedLength == length ) && ! memcmp( decoded, frame, length ) );
+}
+
+void _Test_Fill( uint8_t *dest, uint16_t length, uint8_t zeroOneIn ) {
+	for ( uint16_t i=0; i < length; i++ ) {
+		dest[i] = ( zeroOneIn && ( 0 == rand() % zeroOneIn ) ) ? 0 : 1 + rand() % 255;
+	}
+}
+
+void _Test_Encoder_Edges() {
+	uint8_t data[TEST_MAX_FRAME];
+	static const uint8_t zeros[2] = { 0, 0 };
+	static const uint8_t crc[2] = { 0x5A, 0xA5 };
+
+	// Exactly one code byte's worth, and either side of it
+	static const uint16_t runs[] = { 1, 253, 254, 255, 507, 508, 509, 600 };
+	for ( uint8_t i=0; i < sizeof( runs ) / sizeof( runs[0] ); i++ ) {
+		_Test_Fill( data, runs[i], 0 );
+		_Test_Encode( data, 0, data, runs[i], 0 );
+	}
+
+	// A 254 byte run then a zero, mid-frame and at the end
+	_Test_Fill( data, 258, 0 );
+	data[254] = 0;
+	_Test_Encode( data, 0, data, 258, 0 );
+	_Test_Encode( data, 0, data, 255, 0 );
+	_Test_Encode( data, 254, &data[254], 4, crc );
+
+	// Ending in a zero, and nothing but zeros
+	_Test_Fill( data, 3, 0 );
+	data[2] = 0;
+	_Test_Encode( data, 3, 0, 0, 0 );
+	_Test_Encode( data, 0, 0, 0, zeros );
+	_Test_Encode( zeros, 1, 0, 0, 0 );
+	_Test_Encode( data, 2, data, 0, zeros );
+	_Test_Encode( data, 0, 0, 0, 0 );
+
+	// A 254 byte run across all three pieces, then one over it
+	_Test_Fill( data, 300, 0 );
+	_Test_Encode( data, 100, &data[100], 152, crc );
+	_Test_Encode( data, 100, &data[100], 153, crc );
+
+	// Zeros at the joins
+	data[99] = 0;
+	data[100] = 0;
+	_Test_Encode( data, 100, &data[100], 50, zeros );
+
+	for ( uint16_t n=0; n < TEST_RANDOM_FRAMES; n++ ) {
+		uint16_t headerLength = rand() % 11;
+		uint16_t bodyLength = rand() % ( TEST_MAX_FRAME - 10 );
+		uint8_t *crcPiece = ( rand() & 1 ) ? &data[TEST_MAX_FRAME - 2] : 0;
+		_Test_Fill( data, TEST_MAX_FRAME, ( rand() & 1 ) ? 0 : 1 + rand() % 300 );
+		_Test_Encode( data, headerLength, &data[headerLength], bodyLength, crcPiece );
+	}
+}
+
+/*
+ * UART5 as the host sees it. A DR access is a write, taken off on
+ * the FR read that always follows it.
+ */
+void _Test_Register_Hook( volatile uint32_t *reg ) {
+	if ( reg == &Host_UART5_FR_R ) {
+		if ( txWritePending ) {
+			HOST_CHECK( streamLength < TEST_STREAM_BYTES );
+			if ( streamLength < TEST_STREAM_BYTES ) {
+				stream[streamLength++] = Host_UART5_DR_R;
+			}
+			txFifoCount++;
+			txWritePending = 0;
+		}
+		Host_UART5_FR_R = UART_FR_RXFE | ( ( txFifoCount >= TEST_TX_FIFO ) ? UART_FR_TXFF : 0 );
+	} else if ( reg == &Host_UART5_DR_R ) {
+		txWritePending = 1;
+	}
+}
+
+void _Test_Log_Page( const uint8_t *payload, uint16_t length ) {
+	while ( dumpLeft && ! pageWritten[dumpNext] ) {
+		dumpNext = ( dumpNext + 1 ) % FLASH_LOG_PAGES;
+		dumpLeft--;
+	}
+
+	HOST_CHECK( dumpLeft && ! dumpEnded );
+	HOST_CHECK( 2 + FLASH_LOG_PAGE_SIZE == length );
+	HOST_CHECK( ( payload[0] | ( payload[1] << 8 ) ) == dumpNext );
+	HOST_CHECK( ! memcmp( &payload[2], pages[dumpNext], FLASH_LOG_PAGE_SIZE ) );
+
+	dumpNext = ( dumpNext + 1 ) % FLASH_LOG_PAGES;
+	dumpLeft--;
+	dumpSeen++;
+}
+
+void _Test_Dump_End( const uint8_t *payload, uint16_t length ) {
+	while ( dumpLeft && ! pageWritten[dumpNext] ) {
+		dumpNext = ( dumpNext + 1 ) % FLASH_LOG_PAGES;
+		dumpLeft--;
+	}
+
+	HOST_CHECK( 0 == dumpLeft );
+	HOST_CHECK( 2 == length );
+	HOST_CHECK( ( payload[0] | ( payload[1] << 8 ) ) == dumpSeen );
+	dumpEnded = 1;
+}
+
+uint32_t _Test_U32( const uint8_t *p ) {
+	return p[0] | ( p[1] << 8 ) | ( p[2] << 16 ) | ( (uint32_t) p[3] << 24 );
+}
+
+void _Test_Profile( const uint8_t *payload, uint16_t length ) {
+	const Profile_ISR *profile = &profileSnapshot[profileNext];
+
+	HOST_CHECK( 2 + 20 + 4 * PROFILE_BUCKETS == length );
+	HOST_CHECK( profileNext == payload[0] );
+	HOST_CHECK( PROFILE_ISRS == payload[1] );
+
+	// The telemetry handler runs on through the report
+	if ( PROFILE_TELEMETRY != profileNext ) {
+		HOST_CHECK( _Test_U32( &payload[2] ) == profile->count );
+		HOST_CHECK( _Test_U32( &payload[6] ) == (uint32_t) profile->cycles );
+		HOST_CHECK( _Test_U32( &payload[10] ) == (uint32_t) ( profile->cycles >> 32 ) );
+		HOST_CHECK( _Test_U32( &payload[14] ) == profile->maxLatency );
+		HOST_CHECK( _Test_U32( &payload[18] ) == profile->maxDuration );
+		for ( uint8_t bucket=0; bucket < PROFILE_BUCKETS; bucket++ ) {
+			HOST_CHECK( ( payload[22 + 2 * bucket] | ( payload[23 + 2 * bucket] << 8 ) ) == profile->latency[bucket] );
+			HOST_CHECK( ( payload[22 + 2 * ( PROFILE_BUCKETS + bucket )] | ( payload[23 + 2 * ( PROFILE_BUCKETS + bucket )] << 8 ) ) ==
+				profile->duration[bucket] );
+		}
+	}
+	profileNext++;
+}
+
+// Counters in each group, in the order they go out
+static const uint8_t testCounterCounts[] = { 3, 4, 3, 3, 4, 3, 1, 4, 3, 3, 2, 4, 4, 3 };
+
+#define TEST_COUNTER( group, i ) ( ( group ) * 1000 + ( i ) )
+
+void _Test_Counters( const uint8_t *payload, uint16_t length ) {
+	uint8_t group = payload[0];
+	uint8_t count = payload[1];
+
+	HOST_CHECK( group == counterGroup + 1 );
+	HOST_CHECK( count == testCounterCounts[counterGroup] );
+	HOST_CHECK( 2 + 4 * count == length );
+
+	// Telemetry's own are still counting
+	if ( TELEMETRY_COUNTERS_TELEMETRY != group ) {
+		for ( uint8_t i=0; i < count; i++ ) {
+			HOST_CHECK( _Test_U32( &payload[2 + 4 * i] ) == TEST_COUNTER( group, i ) );
+		}
+	}
+	counterGroup = ( counterGroup + 1 ) % sizeof( testCounterCounts );
+}
+
+/*
+ * A batch of trace records, which must carry on from the last
+ * with each record as written
+ */
+void _Test_Trace( const uint8_t *payload, uint16_t length ) {
+	uint32_t index = _Test_U32( payload );
+	uint8_t count = payload[4];
+
+	HOST_CHECK( ! traceEnded );
+	HOST_CHECK( 5 + 8 * count == length );
+	HOST_CHECK( index == traceNextIndex );
+	for ( uint8_t i=0; ( i < count ) && ( index + i < TEST_TRACE_INDICES ); i++ ) {
+		const uint8_t *p = &payload[5 + 8 * i];
+		const Trace_Record *record = &traceExpected[index + i];
+		HOST_CHECK( _Test_U32( p ) == record->cycles );
+		HOST_CHECK( p[4] == record->event );
+		HOST_CHECK( p[5] == record->arg );
+		HOST_CHECK( ( p[6] | ( p[7] << 8 ) ) == record->value );
+	}
+	traceNextIndex = index + count;
+	traceEnded = ! count;
+}
+
+/*
+ * Checks one decoded frame against what should have been sent
+ */
+void _Test_Frame( const uint8_t *frame, int32_t length ) {
+	HOST_CHECK( length >= 5 );
+	if ( length < 5 ) {
+		return;
+	}
+	HOST_CHECK( _Test_CRC( frame, length - 2 ) == ( frame[length - 2] | ( frame[length - 1] << 8 ) ) );
+	HOST_CHECK( TELEMETRY_VERSION == frame[0] );
+
+	if ( sequenceKnown ) {
+		HOST_CHECK( frame[2] == (uint8_t) ( lastSequence + 1 ) );
+	}
+	lastSequence = frame[2];
+	sequenceKnown = 1;
+	frames++;
+
+	const uint8_t *payload = &frame[3];
+	uint16_t payloadLength = length - 5;
+	switch ( frame[1] ) {
+		case TELEMETRY_RECORD_LOG_PAGE:
+			_Test_Log_Page( payload, payloadLength );
+			break;
+		case TELEMETRY_RECORD_DUMP_END:
+			_Test_Dump_End( payload, payloadLength );
+			break;
+		case TELEMETRY_RECORD_PROFILE:
+			_Test_Profile( payload, payloadLength );
+			break;
+		case TELEMETRY_RECORD_COUNTERS:
+			_Test_Counters( payload, payloadLength );
+			break;
+		case TELEMETRY_RECORD_TRACE:
+			_Test_Trace( payload, payloadLength );
+			break;
+		case TELEMETRY_RECORD_STATE:
+			HOST_CHECK( TEST_MAX_PAYLOAD == payloadLength );
+			stateSeen++;
+			break;
+		default: {
+			// Queued by the test, and in the order queued
+			Test_Record *record = &expected[expectedHead];
+			HOST_CHECK( expectedHead != expectedTail );
+			HOST_CHECK( record->type == frame[1] );
+			HOST_CHECK( ( record->length == payloadLength ) && ! memcmp( record->payload, payload, payloadLength ) );
+			expectedHead = ( expectedHead + 1 ) % ( sizeof( expected ) / sizeof( expected[0] ) );
+			recordsSeen++;
+			break;
+		}
+	}
+}
+
+void _Test_Decode_Stream() {
+	static uint8_t decoded[TEST_MAX_FRAME];
+
+	while ( 1 ) {
+		uint8_t *end = memchr( &stream[streamDecoded], 0, streamLength - streamDecoded );
+		if ( ! end ) {
+			return;
+		}
+		uint32_t encodedLength = end - &stream[streamDecoded];
+		HOST_CHECK( encodedLength < TEST_MAX_FRAME );
+		if ( encodedLength < TEST_MAX_FRAME ) {
+			_Test_Frame( decoded, _Test_COBS_Decode( &stream[streamDecoded], encodedLength, decoded ) );
+		}
+		streamDecoded += encodedLength + 1;
+	}
+}
+
+/*
+ * The FIFO sends up to bytes, then the TX interrupt refills it
+ */
+void _Test_Drain( uint8_t bytes ) {
+	txFifoCount = ( txFifoCount > bytes ) ? txFifoCount - bytes : 0;
+	if ( Host_UART5_IM_R & UART_IM_TXIM ) {
+		Host_UART5_MIS_R = UART_MIS_TXMIS;
+		Telemetry_UART5_Handler();
+		Host_UART5_MIS_R = 0;
+	}
+	_Test_Decode_Stream();
+}
+
+void _Test_Drain_All() {
+	do {
+		_Test_Drain( TEST_TX_FIFO );
+	} while ( Host_UART5_IM_R & UART_IM_TXIM );
+}
+
+/*
+ * Queues a random record, expected out if it was taken
+ */
+uint8_t _Test_Queue_Record() {
+	Test_Record *record = &expected[expectedTail];
+
+	record->type = TEST_RECORD_TYPE;
+	record->length = rand() % ( TEST_MAX_PAYLOAD + 1 );
+	_Test_Fill( record->payload, record->length, 1 + rand() % 8 );
+
+	if ( ! _Telemetry_Queue( record->type, record->payload, record->length ) ) {
+		recordsDropped++;
+		return 0;
+	}
+	expectedTail = ( expectedTail + 1 ) % ( sizeof( expected ) / sizeof( expected[0] ) );
+	return 1;
+}
+
+void _Test_Records() {
+	for ( uint32_t n=0; n < TEST_RANDOM_RECORDS; n++ ) {
+		HOST_CHECK( _Test_Queue_Record() );
+		for ( uint8_t drains = rand() % 4; drains; drains-- ) {
+			_Test_Drain( rand() % ( TEST_TX_FIFO + 1 ) );
+		}
+
+		// Never more waiting than the ring holds
+		if ( 7 == n % 8 ) {
+			_Test_Drain_All();
+		}
+	}
+	_Test_Drain_All();
+
+	// Too long for a slot is refused outright
+	uint8_t payload[TEST_MAX_PAYLOAD + 1] = { 0 };
+	HOST_CHECK( ! _Telemetry_Queue( TEST_RECORD_TYPE, payload, sizeof( payload ) ) );
+
+	HOST_CHECK( expectedHead == expectedTail );
+}
+
+void _Test_Ring_Full() {
+	uint32_t sent, dropped, dumped;
+	Telemetry_Get_Stats( 0, &dropped, 0 );
+
+	// With the FIFO stuck full, the ring takes all but one slot
+	txFifoCount = TEST_TX_FIFO;
+	for ( uint8_t i=0; i < TEST_TX_SLOTS + 4; i++ ) {
+		HOST_CHECK( _Test_Queue_Record() == ( i < TEST_TX_SLOTS - 1 ) );
+	}
+	_Test_Decode_Stream();
+	HOST_CHECK( expectedHead != expectedTail );
+
+	_Test_Drain_All();
+	HOST_CHECK( expectedHead == expectedTail );
+
+	uint32_t droppedAfter;
+	Telemetry_Get_Stats( &sent, &droppedAfter, &dumped );
+	HOST_CHECK( droppedAfter == dropped + 5 );
+}
+
+void _Test_Request( uint8_t request, const uint8_t *flags, uint8_t flagsLength, uint8_t corrupt ) {
+	uint8_t frame[16];
+	uint8_t encoded[24];
+
+	frame[0] = TELEMETRY_VERSION;
+	frame[1] = request;
+	frame[2] = 0;
+	memcpy( &frame[3], flags, flagsLength );
+	uint16_t crc = _Test_CRC( frame, 3 + flagsLength ) ^ ( corrupt ? 0x0100 : 0 );
+	frame[3 + flagsLength] = crc & 0xFF;
+	frame[4 + flagsLength] = crc >> 8;
+
+	uint16_t length = _Test_COBS_Encode( frame, 5 + flagsLength, encoded );
+	for ( uint16_t i=0; i < length; i++ ) {
+		_Telemetry_Receive_Byte( encoded[i] );
+	}
+}
+
+void _Test_Dump() {
+	for ( uint16_t page=0; page < FLASH_LOG_PAGES; page++ ) {
+		pageWritten[page] = ( rand() % 10 ) ? 1 : 0;
+		switch ( rand() % 4 ) {
+			case 0:
+				// Erased - a run across the header, page and CRC
+				memset( pages[page], 0xFF, FLASH_LOG_PAGE_SIZE );
+				break;
+			case 1:
+				memset( pages[page], 0, FLASH_LOG_PAGE_SIZE );
+				break;
+			default:
+				_Test_Fill( pages[page], FLASH_LOG_PAGE_SIZE, 1 + rand() % 20 );
+				break;
+		}
+	}
+	pageHead = 300;
+	dumpNext = pageHead;
+	dumpLeft = FLASH_LOG_PAGES;
+
+	// A request with a bad CRC is ignored
+	_Test_Request( TELEMETRY_REQUEST_DUMP, 0, 0, 1 );
+	HOST_CHECK( ! ( Host_UART5_IM_R & UART_IM_TXIM ) );
+	HOST_CHECK( streamDecoded == streamLength );
+
+	_Test_Request( TELEMETRY_REQUEST_DUMP, 0, 0, 0 );
+	while ( Host_UART5_IM_R & UART_IM_TXIM ) {
+		if ( 0 == rand() % 20 ) {
+			_Test_Queue_Record();
+		}
+		_Test_Drain( rand() % ( TEST_TX_FIFO + 1 ) );
+	}
+
+	HOST_CHECK( dumpEnded );
+	HOST_CHECK( expectedHead == expectedTail );
+
+	uint32_t dumped;
+	Telemetry_Get_Stats( 0, 0, &dumped );
+	HOST_CHECK( dumped == dumpSeen );
+}
+
+void _Test_Profile_Report() {
+	Profile_Init();
+	for ( uint32_t n=0; n < 20000; n++ ) {
+		uint8_t isr = rand() % PROFILE_ISRS;
+		Profile_Schedule( isr, 100 );
+		Profile_Host_Advance( 100 + rand() % 50 );
+		Profile_Enter( isr, PROFILE_NO_LATENCY );
+		Profile_Host_Advance( rand() % 5000 );
+		Profile_Exit( isr );
+	}
+	for ( uint8_t isr=0; isr < PROFILE_ISRS; isr++ ) {
+		Profile_Get_ISR( isr, &profileSnapshot[isr] );
+	}
+
+	uint8_t flags = TELEMETRY_PROFILE_RESET;
+	_Test_Request( TELEMETRY_REQUEST_PROFILE, &flags, 1, 0 );
+	while ( Host_UART5_IM_R & UART_IM_TXIM ) {
+		_Test_Drain( rand() % ( TEST_TX_FIFO + 1 ) );
+	}
+
+	HOST_CHECK( PROFILE_ISRS == profileNext );
+	for ( uint8_t isr=0; isr < PROFILE_ISRS; isr++ ) {
+		Profile_ISR profile;
+		Profile_Get_ISR( isr, &profile );
+		HOST_CHECK( ( 0 == profile.count ) || ( PROFILE_TELEMETRY == isr ) );
+	}
+}
+
+void _Test_Ticks() {
+	for ( uint8_t second=0; second < 60; second++ ) {
+		Telemetry_Tick_Second();
+		_Test_Drain_All();
+	}
+	HOST_CHECK( 60 == stateSeen );
+	HOST_CHECK( 0 == counterGroup );
+}
+
+/*
+ * The trace's cycle counter, read once a record is claimed - which
+ * is where a handler can preempt the writer, or a reset cut it off
+ */
+uint32_t _Test_Trace_Cycles() {
+	if ( traceCut ) {
+		traceCut = 0;
+		longjmp( traceReset, 1 );
+	}
+	if ( tracePreempt ) {
+		// The telemetry handler, with the record claimed and not
+		// yet written
+		Trace_Record record;
+		tracePreempt = 0;
+		HOST_CHECK( ! Trace_Get_Record( Trace_Get_Head() - 1, &record ) );
+		_Test_Drain_All();
+		tracePreempted++;
+	}
+	return traceCycles;
+}
+
+void _Test_Trace_Expect( uint32_t index, uint32_t cycles, uint8_t event, uint8_t arg, uint16_t value ) {
+	HOST_CHECK( index < TEST_TRACE_INDICES );
+	if ( index < TEST_TRACE_INDICES ) {
+		traceExpected[index].cycles = cycles;
+		traceExpected[index].event = event;
+		traceExpected[index].arg = arg;
+		traceExpected[index].value = value;
+	}
+}
+
+void _Test_Trace_Event() {
+	uint8_t event = testTraceEvents[rand() % sizeof( testTraceEvents )];
+	uint8_t arg = rand();
+	uint16_t value = rand();
+
+	traceCycles += 1 + rand() % 20000;
+	_Test_Trace_Expect( Trace_Get_Head(), traceCycles, event, arg, value );
+	tracePreempt = ( 0 == rand() % 5 );
+	Trace_Event( event, arg, value );
+}
+
+/*
+ * Records events with the stream kicked along once a second, and
+ * read out to the last
+ */
+void _Test_Trace_Events( uint32_t events ) {
+	for ( uint32_t n=0; n < events; n++ ) {
+		_Test_Trace_Event();
+		if ( 0 == rand() % 8 ) {
+			Telemetry_Tick_Second();
+			_Test_Drain_All();
+		}
+	}
+	Telemetry_Tick_Second();
+	_Test_Drain_All();
+}
+
+void _Test_Trace_Boot( uint16_t kept ) {
+	traceCycles += 1 + rand() % 20000;
+	_Test_Trace_Expect( Trace_Get_Head(), traceCycles, TRACE_BOOT, 0, kept );
+	Trace_Init();
+}
+
+void _Test_Trace_Stream() {
+	uint8_t flags = TELEMETRY_TRACE_STREAM;
+
+	Profile_Host_Set_Counter( _Test_Trace_Cycles );
+	_Test_Trace_Boot( 0 );
+	_Test_Request( TELEMETRY_REQUEST_TRACE, &flags, 1, 0 );
+	_Test_Drain_All();
+
+	_Test_Trace_Events( TEST_TRACE_EVENTS );
+	HOST_CHECK( traceNextIndex == Trace_Get_Head() );
+
+	// A reset between claiming a record and writing it - the stream
+	// waits on it, and the next boot keeps it as an empty record
+	uint32_t cut = Trace_Get_Head();
+	traceCut = 1;
+	if ( ! setjmp( traceReset ) ) {
+		Trace_Event( TRACE_I2C_WRITE, 0x12, 0x3456 );
+	}
+	_Test_Trace_Expect( cut, 0, TRACE_NONE, 0, 0 );
+	Telemetry_Tick_Second();
+	_Test_Drain_All();
+	HOST_CHECK( traceNextIndex == cut );
+
+	_Test_Trace_Boot( TRACE_RECORDS );
+	_Test_Trace_Events( TEST_TRACE_EVENTS / 10 );
+
+	// Stopping the stream reads out the rest, then closes
+	for ( uint8_t n=0; n < TEST_TRACE_TAIL; n++ ) {
+		_Test_Trace_Event();
+	}
+	flags = 0;
+	_Test_Request( TELEMETRY_REQUEST_TRACE, &flags, 1, 0 );
+	_Test_Drain_All();
+	Profile_Host_Set_Counter( 0 );
+
+	HOST_CHECK( traceEnded );
+	HOST_CHECK( traceNextIndex == Trace_Get_Head() );
+	HOST_CHECK( tracePreempted > 0 );
+}
+
+/*
+ * Where the test binary is, for the files it writes and the tools
+ */
+void _Test_Directory( const char *program, char *directory, size_t size ) {
+	snprintf( directory, size, "%s", program );
+	char *slash = strrchr( directory, '/' );
+	if ( slash ) {
+		*slash = 0;
+	} else {
+		snprintf( directory, size, "." );
+	}
+}
+
+/*
+ * Runs the stream through the decoder, which should count the same
+ * frames with none bad or lost
+ */
+void _Test_Decoder( const char *directory ) {
+	char path[320];
+	char command[768];
+	char line[256];
+	unsigned decoded = 0, bad = 0, lost = 0;
+	uint8_t summary = 0;
+
+	snprintf( path, sizeof( path ), "%s/%s", directory, TEST_STREAM_FILE );
+	FILE *out = fopen( path, "wb" );
+	HOST_CHECK( out && ( fwrite( stream, 1, streamLength, out ) == streamLength ) );
+	if ( out ) {
+		fclose( out );
+	}
+
+	snprintf( command, sizeof( command ), "python3 %s/%s %s 2>&1 >/dev/null", directory, TEST_DECODER, path );
+	FILE *decoder = popen( command, "r" );
+	if ( decoder ) {
+		while ( fgets( line, sizeof( line ), decoder ) ) {
+			if ( 3 == sscanf( line, "%u frames, %u bad, %u lost", &decoded, &bad, &lost ) ) {
+				summary = 1;
+			}
+		}
+		pclose( decoder );
+	}
+	if ( ! summary ) {
+		printf( "decoder: not run, no python3 or %s\n", TEST_DECODER );
+		return;
+	}
+
+	HOST_CHECK( decoded == frames );
+	HOST_CHECK( 0 == bad );
+	HOST_CHECK( 0 == lost );
+	printf( "decoder: %u frames, %u bad, %u lost\n", decoded, bad, lost );
+}
+
+/*
+ * Occurrences of text in the file
+ */
+uint32_t _Test_Count( const char *path, const char *text ) {
+	static char contents[TEST_STREAM_BYTES * 4];
+	uint32_t count = 0;
+
+	FILE *in = fopen( path, "r" );
+	if ( ! in ) {
+		return 0;
+	}
+	size_t length = fread( contents, 1, sizeof( contents ) - 1, in );
+	fclose( in );
+	contents[length] = 0;
+
+	for ( char *p = strstr( contents, text ); p; p = strstr( p + 1, text ) ) {
+		count++;
+	}
+	return count;
+}
+
+/*
+ * Runs the same stream through the trace converter, which should
+ * keep every record, and puts an event in the JSON for each tick,
+ * I2C write and boot
+ */
+void _Test_Trace_JSON( const char *directory ) {
+	char path[320];
+	char json[320];
+	char command[1024];
+	char line[512];
+	unsigned records = 0, lost = 0, boots = 0;
+	uint8_t summary = 0;
+	uint32_t ticks = 0, writes = 0;
+
+	snprintf( path, sizeof( path ), "%s/%s", directory, TEST_STREAM_FILE );
+	snprintf( json, sizeof( json ), "%s/%s", directory, TEST_TRACE_FILE );
+	snprintf( command, sizeof( command ), "python3 %s/%s %s %s 2>&1 >/dev/null", directory, TEST_TRACE_TOOL, path, json );
+	FILE *converter = popen( command, "r" );
+	if ( converter ) {
+		while ( fgets( line, sizeof( line ), converter ) ) {
+			if ( 3 == sscanf( line, "%u records, %u lost, %u boots", &records, &lost, &boots ) ) {
+				summary = 1;
+			}
+		}
+		pclose( converter );
+	}
+	if ( ! summary ) {
+		printf( "trace: not run, no python3 or %s\n", TEST_TRACE_TOOL );
+		return;
+	}
+
+	for ( uint32_t index=0; index < traceNextIndex; index++ ) {
+		ticks += ( TRACE_TICK == traceExpected[index].event );
+		writes += ( TRACE_I2C_WRITE == traceExpected[index].event );
+	}
+
+	HOST_CHECK( records == traceNextIndex );
+	HOST_CHECK( 0 == lost );
+	HOST_CHECK( 2 == boots );
+	HOST_CHECK( _Test_Count( json, "\"name\": \"boot\"" ) == boots );
+	HOST_CHECK( _Test_Count( json, "\"name\": \"tick\"" ) == ticks );
+	HOST_CHECK( _Test_Count( json, "\"name\": \"write 0x" ) == writes );
+	printf( "trace: %u records, %u lost, %u boots, %u ticks, %u I2C writes\n", records, lost, boots, ticks, writes );
+}
+
+int main( int argc, char **argv ) {
+	Host_Init();
+	srand( 43 );
+
+	Clock_Init( CLOCK_80_MHZ );
+	Telemetry_Init();
+
+	_Test_Encoder_Edges();
+
+	Host_Set_Register_Hook( _Test_Register_Hook );
+	_Test_Records();
+	_Test_Ring_Full();
+	_Test_Dump();
+	_Test_Profile_Report();
+	_Test_Ticks();
+	_Test_Trace_Stream();
+
+	uint32_t sent, dropped, dumped;
+	Telemetry_Get_Stats( &sent, &dropped, &dumped );
+	HOST_CHECK( sent == frames + encodedFrames );
+	HOST_CHECK( dropped == recordsDropped );
+
+	printf( "%u bytes, %u frames: %u records, %u dropped, %u log pages, %u profiles, %u state, %u trace records, %u preempted\n",
+		streamLength, frames, recordsSeen, recordsDropped, dumpSeen, profileNext, stateSeen, traceNextIndex, tracePreempted );
+
+	char directory[256];
+	_Test_Directory( argv[0], directory, sizeof( directory ) );
+	_Test_Decoder( directory );
+	_Test_Trace_JSON( directory );
+
+	return Host_Report( "telemetry-cobs" );
+}
+
+// The rest of the station, as telemetry.c reads it
+
+uint16_t Flash_Log_Get_Head() {
+	return pageHead;
+}
+
+const uint8_t *Flash_Log_Get_Page( uint16_t page ) {
+	return pageWritten[page] ? pages[page] : 0;
+}
+
+void Flash_Log_Get_Stats( uint32_t *observations, uint32_t *pagesWritten, uint32_t *sectorsErased, uint32_t *pagesSkipped ) {
+	*observations = TEST_COUNTER( TELEMETRY_COUNTERS_FLASH_LOG, 0 );
+	*pagesWritten = TEST_COUNTER( TELEMETRY_COUNTERS_FLASH_LOG, 1 );
+	*sectorsErased = TEST_COUNTER( TELEMETRY_COUNTERS_FLASH_LOG, 2 );
+	*pagesSkipped = TEST_COUNTER( TELEMETRY_COUNTERS_FLASH_LOG, 3 );
+}
+
+void AFSK_Get_Stats( uint32_t *a, uint32_t *b, uint32_t *c ) {
+	*a = TEST_COUNTER( TELEMETRY_COUNTERS_AFSK, 0 );
+	*b = TEST_COUNTER( TELEMETRY_COUNTERS_AFSK, 1 );
+	*c = TEST_COUNTER( TELEMETRY_COUNTERS_AFSK, 2 );
+}
+
+void KISS_Get_Stats( uint32_t *a, uint32_t *b, uint32_t *c, uint32_t *d ) {
+	*a = TEST_COUNTER( TELEMETRY_COUNTERS_KISS, 0 );
+	*b = TEST_COUNTER( TELEMETRY_COUNTERS_KISS, 1 );
+	*c = TEST_COUNTER( TELEMETRY_COUNTERS_KISS, 2 );
+	*d = TEST_COUNTER( TELEMETRY_COUNTERS_KISS, 3 );
+}
+
+void CSMA_Get_Stats( uint32_t *a, uint32_t *b, uint32_t *c ) {
+	*a = TEST_COUNTER( TELEMETRY_COUNTERS_CSMA, 0 );
+	*b = TEST_COUNTER( TELEMETRY_COUNTERS_CSMA, 1 );
+	*c = TEST_COUNTER( TELEMETRY_COUNTERS_CSMA, 2 );
+}
+
+void TDMA_Get_Stats( uint32_t *a, uint32_t *b, uint32_t *c ) {
+	*a = TEST_COUNTER( TELEMETRY_COUNTERS_TDMA, 0 );
+	*b = TEST_COUNTER( TELEMETRY_COUNTERS_TDMA, 1 );
+	*c = TEST_COUNTER( TELEMETRY_COUNTERS_TDMA, 2 );
+}
+
+void Digi_Get_Stats( uint32_t *a, uint32_t *b, uint32_t *c, uint32_t *d ) {
+	*a = TEST_COUNTER( TELEMETRY_COUNTERS_DIGI, 0 );
+	*b = TEST_COUNTER( TELEMETRY_COUNTERS_DIGI, 1 );
+	*c = TEST_COUNTER( TELEMETRY_COUNTERS_DIGI, 2 );
+	*d = TEST_COUNTER( TELEMETRY_COUNTERS_DIGI, 3 );
+}
+
+void Calibration_Get_Stats( uint32_t *a, uint32_t *b, int32_t *c ) {
+	*a = TEST_COUNTER( TELEMETRY_COUNTERS_CALIBRATION, 0 );
+	*b = TEST_COUNTER( TELEMETRY_COUNTERS_CALIBRATION, 1 );
+	*c = TEST_COUNTER( TELEMETRY_COUNTERS_CALIBRATION, 2 );
+}
+
+uint32_t Power_Get_Wakeups_Per_Minute() {
+	return TEST_COUNTER( TELEMETRY_COUNTERS_POWER, 0 );
+}
+
+void RDA1846_Get_Scan_Stats( uint32_t *a, uint32_t *b, uint32_t *c ) {
+	*a = TEST_COUNTER( TELEMETRY_COUNTERS_RADIO_SCAN, 0 );
+	*b = TEST_COUNTER( TELEMETRY_COUNTERS_RADIO_SCAN, 1 );
+	*c = TEST_COUNTER( TELEMETRY_COUNTERS_RADIO_SCAN, 2 );
+}
+
+uint8_t RDA1846_Scanning() {
+	return 0;
+}
+
+void Capture_Get_Stats( uint32_t *a, uint32_t *b ) {
+	*a = TEST_COUNTER( TELEMETRY_COUNTERS_CAPTURE, 0 );
+	*b = TEST_COUNTER( TELEMETRY_COUNTERS_CAPTURE, 1 );
+}
+
+uint8_t Capture_Running() {
+	return 0;
+}
+
+uint16_t Capture_Read( uint8_t *dest, uint16_t length, uint32_t *offset ) {
+	*offset = 0;
+	return 0;
+}
+
+void Capture_Start() {
+}
+
+void Capture_Stop() {
+}
+
+void Wind_Rain_Get_Stats( uint32_t *a, uint32_t *b, uint32_t *c, uint32_t *d ) {
+	*a = TEST_COUNTER( TELEMETRY_COUNTERS_WIND_RAIN, 0 );
+	*b = TEST_COUNTER( TELEMETRY_COUNTERS_WIND_RAIN, 1 );
+	*c = TEST_COUNTER( TELEMETRY_COUNTERS_WIND_RAIN, 2 );
+	*d = TEST_COUNTER( TELEMETRY_COUNTERS_WIND_RAIN, 3 );
+}
+
+void PWM_I2C_Get_Stats( uint32_t *a, uint32_t *b, uint32_t *c, uint32_t *d ) {
+	*a = TEST_COUNTER( TELEMETRY_COUNTERS_I2C, 0 );
+	*b = TEST_COUNTER( TELEMETRY_COUNTERS_I2C, 1 );
+	*c = TEST_COUNTER( TELEMETRY_COUNTERS_I2C, 2 );
+	*d = TEST_COUNTER( TELEMETRY_COUNTERS_I2C, 3 );
+}
+
+void ADC_Supply_Get_Stats( uint32_t *a, uint32_t *b ) {
+	*a = TEST_COUNTER( TELEMETRY_COUNTERS_SUPPLY, 0 );
+	*b = TEST_COUNTER( TELEMETRY_COUNTERS_SUPPLY, 1 );
+}
+
+int16_t ADC_Supply_Get_Chip_Temperature() {
+	return TEST_COUNTER( TELEMETRY_COUNTERS_SUPPLY, 2 );
+}
+
+uint8_t ADC_Supply_Data_Valid() {
+	return 1;
+}
+
+uint16_t ADC_Supply_Get_Battery_MV() {
+	return 12800;
+}
+
+uint16_t ADC_Supply_Get_Solar_MV() {
+	return 18000;
+}
+
+uint8_t GPS_Device_Detected() {
+	return 1;
+}
+
+uint8_t GPS_Data_Valid() {
+	return 1;
+}
+
+void GPS_Get_Latitude( uint8_t *degrees, uint8_t *minutes, uint8_t *seconds, char *hemisphere ) {
+	*degrees = 47;
+	*minutes = 36;
+	*hemisphere = 'N';
+}
+
+void GPS_Get_Longitude( uint8_t *degrees, uint8_t *minutes, uint8_t *seconds, char *hemisphere ) {
+	*degrees = 122;
+	*minutes = 20;
+	*hemisphere = 'W';
+}
+
+void GPS_Get_Position_Hundredths( uint8_t *latHundredths, uint8_t *longHundredths ) {
+	*latHundredths = 12;
+	*longHundredths = 34;
+}
+
+uint32_t GPS_Get_Seconds() {
+	return 815000000 + stateSeen;
+}
+
+uint8_t DS18B20_Data_Valid() {
+	return 1;
+}
+
+int16_t DS18B20_Get_Temperature_F() {
+	return 540;
+}
+
+uint8_t Bench_Get_Result( uint8_t bench, Bench_Result *result ) {
+	return 0;
+}
@@ -0,0 +1,416 @@
+// Host test of the wind and rain inputs against pulse trains
+//
+// Plays a day and more of anemometer closures and rain gauge tips,
+// each followed by a few reed switch bounces, into Wide Timer 3A's
+// and 3B's captures and interrupts, with
+// the seconds tick from an 80 MHz clock (now and then late). First
+// holds the wind at steady rates up to 100 Hz and checks the speed
+// against 1.492 mph/Hz, then over the byte's range, then runs
+// gusty wind and showers. After every tick checks the speeds,
+// gusts and rain totals against a model of its own, and that every
+// closure and tip counted once and every bounce not at all - a
+// closure's bounces come up to 1.5 ms after it, which at the
+// fastest rate is under 2 ms before the next closure - including a
+// bounce just after a tick that closely follows its tip, and a tip
+// that comes a whole capture count wrap after the one before.
+// Prints the speeds at the steady rates and the totals.
+
+#include "host.h"
+#include "wind-rain.h"
+#include "clock.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define TEST_HZ 80000000ULL
+#define TEST_MS ( TEST_HZ / 1000 )
+
+#define TEST_SECONDS ( 26 * 3600 )
+#define TEST_STEADY_SECONDS 70
+#define TEST_OVER_HZ 300
+#define TEST_MAX_BYTE 255
+
+#define TEST_MAX_EDGES 16
+#define TEST_MAX_WIND_BOUNCES 3
+
+static const uint16_t testSteadyHz[] = { 0, 1, 2, 5, 10, 20, 30, 40, 50, 60, 70, 80, 90, 100 };
+#define TEST_STEADY_RATES ( sizeof( testSteadyHz ) / sizeof( testSteadyHz[0] ) )
+#define TEST_OVER_START ( TEST_STEADY_RATES * TEST_STEADY_SECONDS )
+#define TEST_RANDOM_START ( TEST_OVER_START + 10 )
+
+// Set pieces for the rain gauge, with no showers around them: a
+// bounce after the tick that follows its tip, a tip a capture wrap
+// after the last, and tips exactly the debounce time apart
+#define TEST_STRADDLE_TICK 5000
+#define TEST_WRAP_SECOND 20000
+#define TEST_EXACT_SECOND 30000
+
+typedef struct Test_Edges {
+	uint64_t time;
+	uint8_t tip;
+} Test_Edge;
+
+static Test_Edge edges[TEST_MAX_EDGES];
+static uint8_t edgeCount;
+
+// What each tick should have seen
+static uint32_t tickPulses[TEST_SECONDS + 1];
+static uint16_t minuteTips[TEST_SECONDS / 60 + 1];
+static uint16_t hourTips[TEST_SECONDS / 3600 + 1];
+static uint16_t minutePeaks[TEST_SECONDS / 60 + 1];
+
+static uint64_t nextPulse;
+static uint64_t windBounces[TEST_MAX_WIND_BOUNCES];
+static uint8_t windBounceCount;
+static uint8_t pulseProbe = 1;
+static uint32_t pulsesSinceTick;
+static uint32_t pendingTips;
+static uint64_t nextTip;
+
+static uint32_t totalPulses;
+static uint32_t totalTips;
+static uint32_t totalBounces;
+static uint32_t totalWindBounces;
+
+static double randomHz;
+static uint32_t randomUntil;
+
+static uint16_t steadySpeeds[TEST_STEADY_RATES];
+
+void Telemetry_Send_Event( uint8_t event, uint32_t data ) {
+}
+
+double _Test_Uniform( double low, double high ) {
+	return low + ( high - low ) * rand() / (double) RAND_MAX;
+}
+
+/*
+ * The anemometer's rate over this second: steady steps, then too
+ * fast for the byte, then gusty
+ */
+double _Test_Wind_Hz( uint32_t second ) {
+	if ( second < TEST_OVER_START ) {
+		return testSteadyHz[second / TEST_STEADY_SECONDS];
+	}
+	if ( second < TEST_RANDOM_START ) {
+		return TEST_OVER_HZ;
+	}
+	if ( second >= randomUntil ) {
+		if ( 0 == rand() % 20 ) {
+			// A gust, a few seconds of it
+			randomHz = _Test_Uniform( 60, 100 );
+			randomUntil = second + 2 + rand() % 4;
+		} else if ( 0 == rand() % 10 ) {
+			randomHz = 0;
+			randomUntil = second + 1 + rand() % 30;
+		} else {
+			randomHz = _Test_Uniform( 0.5, 40 );
+			randomUntil = second + 1 + rand() % 10;
+		}
+	}
+	return randomHz;
+}
+
+void _Test_Add_Edge( uint64_t time, uint8_t tip ) {
+	uint8_t i = edgeCount++;
+	HOST_CHECK( edgeCount <= TEST_MAX_EDGES );
+	while ( i && ( edges[i - 1].time > time ) ) {
+		edges[i] = edges[i - 1];
+		i--;
+	}
+	edges[i].time = time;
+	edges[i].tip = tip;
+}
+
+/*
+ * Next shower tip, with a few bounces after it, kept clear of the
+ * set pieces
+ */
+void _Test_Next_Tip( uint64_t after ) {
+	static const uint32_t quiet[] = { TEST_STRADDLE_TICK, TEST_WRAP_SECOND, TEST_EXACT_SECOND };
+
+	if ( 0 == rand() % 100 ) {
+		// Dry for a while
+		after += (uint64_t) ( _Test_Uniform( 600, 3 * 3600 ) * TEST_HZ );
+	} else {
+		after += (uint64_t) ( _Test_Uniform( 0.3, 20 ) * TEST_HZ );
+	}
+	for ( uint8_t i=0; i < sizeof( quiet ) / sizeof( quiet[0] ); i++ ) {
+		if ( ( after + 70 * TEST_HZ > quiet[i] * TEST_HZ ) && ( after < ( quiet[i] + 130 ) * TEST_HZ ) ) {
+			after = ( quiet[i] + 130 ) * TEST_HZ;
+		}
+	}
+
+	nextTip = after;
+	_Test_Add_Edge( after, 1 );
+	for ( uint8_t bounces = rand() % 4; bounces; bounces-- ) {
+		_Test_Add_Edge( after + (uint64_t) ( _Test_Uniform( 0.5, 30 ) * TEST_MS ), 0 );
+	}
+}
+
+void _Test_Rain_Edge( uint64_t now ) {
+	Test_Edge edge = edges[0];
+	for ( uint8_t i=1; i < edgeCount; i++ ) {
+		edges[i - 1] = edges[i];
+	}
+	edgeCount--;
+
+	uint32_t tips, bounces;
+	Wind_Rain_Get_Stats( 0, &tips, &bounces, 0 );
+
+	Host_WTIMER3_TBR_R = (uint32_t) now;
+	Wind_Rain_WTimer3B_Handler();
+
+	uint32_t tipsAfter, bouncesAfter;
+	Wind_Rain_Get_Stats( 0, &tipsAfter, &bouncesAfter, 0 );
+	HOST_CHECK( tipsAfter == tips + edge.tip );
+	HOST_CHECK( bouncesAfter == bounces + ! edge.tip );
+
+	if ( edge.tip ) {
+		pendingTips++;
+		totalTips++;
+	} else {
+		totalBounces++;
+	}
+	if ( edge.tip && ( now == nextTip ) ) {
+		_Test_Next_Tip( now );
+	}
+}
+
+/*
+ * An anemometer edge into Wide Timer 3A's capture, checking it
+ * counted as a closure or a bounce
+ */
+void _Test_Wind_Edge( uint64_t now, uint8_t closure ) {
+	uint32_t pulses, bounces;
+	Wind_Rain_Get_Stats( &pulses, 0, 0, &bounces );
+
+	Host_WTIMER3_TAR_R = (uint32_t) now;
+	Wind_Rain_WTimer3A_Handler();
+
+	uint32_t pulsesAfter, bouncesAfter;
+	Wind_Rain_Get_Stats( &pulsesAfter, 0, 0, &bouncesAfter );
+	HOST_CHECK( pulsesAfter == pulses + closure );
+	HOST_CHECK( bouncesAfter == bounces + ! closure );
+}
+
+void _Test_Wind_Bounce( uint64_t now ) {
+	for ( uint8_t i=1; i < windBounceCount; i++ ) {
+		windBounces[i - 1] = windBounces[i];
+	}
+	windBounceCount--;
+
+	_Test_Wind_Edge( now, 0 );
+	totalWindBounces++;
+}
+
+void _Test_Wind_Pulse( uint64_t now ) {
+	if ( ! pulseProbe ) {
+		_Test_Wind_Edge( now, 1 );
+		pulsesSinceTick++;
+		totalPulses++;
+
+		// Bounces, in order, well before the next closure
+		windBounceCount = rand() % ( TEST_MAX_WIND_BOUNCES + 1 );
+		uint64_t bounceAt = now;
+		for ( uint8_t i=0; i < windBounceCount; i++ ) {
+			bounceAt += (uint64_t) ( _Test_Uniform( 0.05, 1.5 / TEST_MAX_WIND_BOUNCES ) * TEST_MS );
+			windBounces[i] = bounceAt;
+		}
+	}
+
+	uint32_t second = now / TEST_HZ;
+	double hz = _Test_Wind_Hz( second );
+	if ( hz <= 0 ) {
+		// Look again next second
+		pulseProbe = 1;
+		nextPulse = ( second + 1 ) * TEST_HZ;
+		return;
+	}
+
+	// Steady is steady, otherwise a cup anemometer wobbles a little
+	double jitter = ( second < TEST_RANDOM_START ) ? 1.0 : _Test_Uniform( 0.9, 1.1 );
+	pulseProbe = 0;
+	nextPulse = now + (uint64_t) ( TEST_HZ / hz * jitter );
+}
+
+uint16_t _Test_Speed( uint32_t pulses, uint8_t seconds ) {
+	return seconds ? ( pulses * WIND_RAIN_MPH_PER_HZ_X1000 ) / ( 100 * (uint32_t) seconds ) : 0;
+}
+
+uint16_t _Test_Expected_Speed( uint32_t tick, uint8_t seconds ) {
+	if ( seconds > WIND_RAIN_SPEED_SECONDS ) {
+		seconds = WIND_RAIN_SPEED_SECONDS;
+	}
+	if ( seconds > tick ) {
+		seconds = tick;
+	}
+
+	uint32_t pulses = 0;
+	for ( uint8_t i=0; i < seconds; i++ ) {
+		uint32_t count = tickPulses[tick - i];
+		pulses += ( count > TEST_MAX_BYTE ) ? TEST_MAX_BYTE : count;
+	}
+	return _Test_Speed( pulses, seconds );
+}
+
+uint16_t _Test_Expected_Gust( uint32_t tick, uint8_t minutes ) {
+	uint32_t minute = tick / 60;
+	uint16_t gust = 0;
+
+	if ( minutes > WIND_RAIN_GUST_MINUTES ) {
+		minutes = WIND_RAIN_GUST_MINUTES;
+	}
+	for ( uint8_t i=0; ( i < minutes ) && ( i <= minute ); i++ ) {
+		if ( minutePeaks[minute - i] > gust ) {
+			gust = minutePeaks[minute - i];
+		}
+	}
+	return gust;
+}
+
+uint16_t _Test_Expected_Rain( uint32_t tick, uint8_t hours ) {
+	uint32_t tips = 0;
+
+	if ( hours <= 1 ) {
+		uint32_t minute = tick / 60;
+		for ( uint8_t i=0; ( i < 60 ) && ( i <= minute ); i++ ) {
+			tips += minuteTips[minute - i];
+		}
+	} else {
+		uint32_t hour = tick / 3600;
+		if ( hours > WIND_RAIN_HOURS ) {
+			hours = WIND_RAIN_HOURS;
+		}
+		for ( uint8_t i=0; ( i < hours ) && ( i <= hour ); i++ ) {
+			tips += hourTips[hour - i];
+		}
+	}
+	return ( tips * WIND_RAIN_INCHES_PER_TIP_X1000 + 5 ) / 10;
+}
+
+void _Test_Tick( uint32_t tick ) {
+	Wind_Rain_Tick_Second();
+
+	tickPulses[tick] = pulsesSinceTick;
+	pulsesSinceTick = 0;
+	minuteTips[tick / 60] += pendingTips;
+	hourTips[tick / 3600] += pendingTips;
+	pendingTips = 0;
+
+	uint16_t gust = _Test_Expected_Speed( tick, 3 );
+	if ( gust > minutePeaks[tick / 60] ) {
+		minutePeaks[tick / 60] = gust;
+	}
+
+	HOST_CHECK( Wind_Rain_Get_Speed( 1 ) == _Test_Expected_Speed( tick, 1 ) );
+	HOST_CHECK( Wind_Rain_Get_Speed( 3 ) == _Test_Expected_Speed( tick, 3 ) );
+	HOST_CHECK( Wind_Rain_Get_Speed( 10 ) == _Test_Expected_Speed( tick, 10 ) );
+	HOST_CHECK( Wind_Rain_Get_Speed( 60 ) == _Test_Expected_Speed( tick, 60 ) );
+	HOST_CHECK( Wind_Rain_Get_Speed( 200 ) == _Test_Expected_Speed( tick, 200 ) );
+	HOST_CHECK( Wind_Rain_Get_Gust( 1 ) == _Test_Expected_Gust( tick, 1 ) );
+	HOST_CHECK( Wind_Rain_Get_Gust( 10 ) == _Test_Expected_Gust( tick, 10 ) );
+	HOST_CHECK( Wind_Rain_Get_Gust( 60 ) == _Test_Expected_Gust( tick, 60 ) );
+
+	if ( 0 == tick % 10 ) {
+		HOST_CHECK( Wind_Rain_Get_Rain( 1 ) == _Test_Expected_Rain( tick, 1 ) );
+		HOST_CHECK( Wind_Rain_Get_Rain( 3 ) == _Test_Expected_Rain( tick, 3 ) );
+		HOST_CHECK( Wind_Rain_Get_Rain( 24 ) == _Test_Expected_Rain( tick, 24 ) );
+		HOST_CHECK( Wind_Rain_Get_Rain( 48 ) == _Test_Expected_Rain( tick, 48 ) );
+	}
+
+	// A steady rate has filled the minute, so the speed is the
+	// rate's to within a pulse
+	if ( ( tick <= TEST_OVER_START ) && ( 0 == tick % TEST_STEADY_SECONDS ) && tick ) {
+		uint8_t step = tick / TEST_STEADY_SECONDS - 1;
+		double tenths = testSteadyHz[step] * WIND_RAIN_MPH_PER_HZ_X1000 / 100.0;
+		steadySpeeds[step] = Wind_Rain_Get_Speed( 60 );
+		HOST_CHECK( steadySpeeds[step] <= tenths + WIND_RAIN_MPH_PER_HZ_X1000 / 6000.0 );
+		HOST_CHECK( steadySpeeds[step] + WIND_RAIN_MPH_PER_HZ_X1000 / 6000.0 + 1 >= tenths );
+	}
+
+	// Over the byte's range the speed holds at its top, but the
+	// pulses all count
+	if ( tick == TEST_RANDOM_START ) {
+		HOST_CHECK( tickPulses[tick] >= TEST_OVER_HZ - 1 );
+		HOST_CHECK( Wind_Rain_Get_Speed( 10 ) == _Test_Speed( TEST_MAX_BYTE, 1 ) );
+	}
+}
+
+void _Test_Set_Pieces() {
+	// A tick 10 ms after the tip and a bounce 20 ms after the tick
+	_Test_Add_Edge( TEST_STRADDLE_TICK * TEST_HZ - 10 * TEST_MS, 1 );
+	_Test_Add_Edge( TEST_STRADDLE_TICK * TEST_HZ + 20 * TEST_MS, 0 );
+
+	// The capture count comes round to 40 ms after the last tip,
+	// and a bounce 15 ms later
+	_Test_Add_Edge( TEST_WRAP_SECOND * TEST_HZ, 1 );
+	_Test_Add_Edge( TEST_WRAP_SECOND * TEST_HZ + 0x100000000ULL + 40 * TEST_MS, 1 );
+	_Test_Add_Edge( TEST_WRAP_SECOND * TEST_HZ + 0x100000000ULL + 55 * TEST_MS, 0 );
+
+	// Exactly the debounce apart is a tip, one count short a bounce
+	_Test_Add_Edge( TEST_EXACT_SECOND * TEST_HZ, 1 );
+	_Test_Add_Edge( TEST_EXACT_SECOND * TEST_HZ + 100 * TEST_MS, 1 );
+	_Test_Add_Edge( TEST_EXACT_SECOND * TEST_HZ + 200 * TEST_MS - 1, 0 );
+}
+
+int main() {
+	Host_Init();
+	srand( 48 );
+
+	Clock_Init( CLOCK_80_MHZ );
+	Wind_Rain_Init();
+
+	_Test_Set_Pieces();
+	_Test_Next_Tip( TEST_RANDOM_START * TEST_HZ );
+	nextPulse = 0;
+
+	uint32_t tick = 1;
+	uint64_t tickAt = TEST_HZ;
+	uint32_t lateTicks = 0;
+	uint64_t start = Host_Nanoseconds();
+
+	while ( tick <= TEST_SECONDS ) {
+		uint64_t edgeAt = edgeCount ? edges[0].time : UINT64_MAX;
+		uint64_t bounceAt = windBounceCount ? windBounces[0] : UINT64_MAX;
+
+		if ( ( bounceAt <= tickAt ) && ( bounceAt <= edgeAt ) && ( bounceAt <= nextPulse ) ) {
+			_Test_Wind_Bounce( bounceAt );
+		} else if ( ( nextPulse <= tickAt ) && ( nextPulse <= edgeAt ) ) {
+			_Test_Wind_Pulse( nextPulse );
+		} else if ( edgeAt < tickAt ) {
+			_Test_Rain_Edge( edgeAt );
+		} else {
+			_Test_Tick( tick );
+			tick++;
+
+			// Now and then the tick is held up, but never near the
+			// set pieces' or the steady rates' seconds
+			tickAt = tick * TEST_HZ;
+			if ( ( tick > TEST_RANDOM_START ) && ( tick % 1000 > 100 ) && ( 0 == rand() % 200 ) ) {
+				tickAt += rand() % ( 300 * TEST_MS );
+				lateTicks++;
+			}
+		}
+	}
+
+	uint32_t windPulses, rainTips, rainBounces, windBounced;
+	Wind_Rain_Get_Stats( &windPulses, &rainTips, &rainBounces, &windBounced );
+	HOST_CHECK( windPulses == totalPulses );
+	HOST_CHECK( windBounced == totalWindBounces );
+	HOST_CHECK( totalWindBounces > 1000000 );
+	HOST_CHECK( rainTips == totalTips );
+	HOST_CHECK( rainBounces == totalBounces );
+	HOST_CHECK( totalTips > 500 );
+	HOST_CHECK( totalBounces > 500 );
+
+	printf( "steady: " );
+	for ( uint8_t step=0; step < TEST_STEADY_RATES; step++ ) {
+		printf( "%u Hz %u.%u mph%s", testSteadyHz[step], steadySpeeds[step] / 10, steadySpeeds[step] % 10,
+			( step + 1 < TEST_STEADY_RATES ) ? ", " : "\n" );
+	}
+	printf( "%u s: %u pulses, %u wind bounces, %u tips, %u rain bounces, %u late ticks; %.0f ns per simulated second\n",
+		TEST_SECONDS, windPulses, windBounced, rainTips, rainBounces, lateTicks, (double) ( Host_Nanoseconds() - start ) / TEST_SECONDS );
+
+	return Host_Report( "wind-rain-pulses" );
+}
@@ -0,0 +1,124 @@
+#!/usr/bin/env python3
+# Collects the TM4C123-WX benchmark results (bench.h) as JSON
+#
+# Asks a BENCH_ENABLED build for the cycle counts it took at start
+# up, writes them with their ns/op at the station's clock, and with
+# --baseline compares them against an earlier run: any benchmark
+# whose minimum or mean cycles grew by more than --tolerance percent
+# is reported and the exit status is 1. The workloads are fixed, so
+# between builds with the same defines the counts only move when
+# the code under them does. --save-baseline records this run as the
+# new baseline. Reports are marked "platform": "target"; the host
+# runner's (tests/bench-runner.c) are host instructions or ns and
+# aren't taken as a baseline.
+#
+# Usage:
+#   bench.py /dev/ttyUSB0 results.json
+#   bench.py --baseline baseline.json /dev/ttyUSB0 results.json
+#   bench.py --baseline baseline.json --save-baseline /dev/ttyUSB0 results.json
+
+import argparse
+import importlib.util
+import json
+import os
+import sys
+
+# Framing and the record layout come from the decoder
+spec = importlib.util.spec_from_file_location(
+    'telemetry_decode', os.path.join(os.path.dirname(os.path.abspath(__file__)), 'telemetry-decode.py'))
+telemetry = importlib.util.module_from_spec(spec)
+spec.loader.exec_module(telemetry)
+
+GATED = ('minCycles', 'meanCycles')
+
+
+def read_results(fd):
+    results = {}
+    pending = bytearray()
+    while True:
+        data = os.read(fd, 4096)
+        if not data:
+            break
+        pending += data
+        while True:
+            end = pending.find(b'\x00')
+            if end < 0:
+                break
+            frame = telemetry.cobs_decode(bytes(pending[:end]))
+            del pending[:end + 1]
+            if (not frame or len(frame) < 5 or frame[1] != telemetry.RECORD_BENCH or
+                    telemetry.crc16(frame[:-2]) != frame[-2] | frame[-1] << 8):
+                continue
+            result = telemetry.decode_bench(frame[3:-2])
+            if not result:
+                sys.exit('benchmarks did not run (define BENCH_ENABLED)')
+            results[result['bench']] = result
+            if result['index'] + 1 >= result['benches']:
+                return results
+    return results
+
+
+def compare(results, baseline, tolerance):
+    regressions = 0
+    for name, result in sorted(results.items(), key=lambda item: item[1]['index']):
+        before = baseline.get('benchmarks', {}).get(name)
+        if not before:
+            print('%-22s %10d cycles  (new)' % (name, result['minCycles']))
+            continue
+        changes = []
+        for field in GATED:
+            change = 100.0 * (result[field] - before[field]) / before[field] if before[field] else 0
+            changes.append('%s %+.1f%%' % (field, change))
+            if change > tolerance:
+                regressions += 1
+        print('%-22s %10d cycles  %s' % (name, result['minCycles'], '  '.join(changes)))
+    return regressions
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Collect the TM4C123-WX benchmark results as JSON')
+    parser.add_argument('source', help='serial device or captured telemetry stream, - for stdin')
+    parser.add_argument('output', help='JSON file to write')
+    parser.add_argument('--baud', type=int, default=921600)
+    parser.add_argument('--baseline', metavar='JSON', help='earlier results to compare against')
+    parser.add_argument('--tolerance', type=float, default=1.0, help='percent growth allowed before failing')
+    parser.add_argument('--save-baseline', action='store_true', help='write these results to --baseline too')
+    args = parser.parse_args()
+
+    # A missing baseline would pass every run without comparing anything
+    if args.baseline and not args.save_baseline and not os.path.exists(args.baseline):
+        sys.exit('no baseline at %s (record one with --save-baseline)' % args.baseline)
+
+    fd = 0 if args.source == '-' else telemetry.open_port(args.source, args.baud)
+    if os.isatty(fd):
+        telemetry.send_request(fd, telemetry.REQUEST_BENCH)
+
+    results = read_results(fd)
+    if not results:
+        sys.exit('no benchmark results')
+
+    for result in results.values():
+        hz = result['hz']
+        result['minNs'] = result['minCycles'] * 1e9 / hz if hz else None
+        result['meanNs'] = result['meanCycles'] * 1e9 / hz if hz else None
+    report = {'platform': 'target', 'hz': next(iter(results.values()))['hz'], 'benchmarks': results}
+    with open(args.output, 'w') as out:
+        json.dump(report, out, indent=2, sort_keys=True)
+
+    regressions = 0
+    if args.baseline and os.path.exists(args.baseline):
+        with open(args.baseline) as baseline:
+            before = json.load(baseline)
+        if before.get('platform', 'target') != 'target':
+            sys.exit('%s is from a %s run, its numbers do not compare with the station\'s' % (args.baseline, before['platform']))
+        regressions = compare(results, before, args.tolerance)
+    if args.baseline and args.save_baseline:
+        with open(args.baseline, 'w') as out:
+            json.dump(report, out, indent=2, sort_keys=True)
+
+    print('%d benchmarks, %d regressions -> %s' % (len(results), regressions, args.output), file=sys.stderr)
+    sys.exit(1 if regressions and not args.save_baseline else 0)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,440 @@
+#!/usr/bin/env python3
+# Decoder for the TM4C123-WX binary telemetry stream (telemetry.h)
+#
+# Reads COBS framed records from the station's UART5, checks
+# their CRC and prints one line per record. With --dump it asks
+# the station for its stored history first and prints the logged
+# observations as CSV. With --profile it asks for the interrupt
+# handler profiles (profile.h, Debug builds only) and prints them.
+# Trace records (trace.h) print one line per event; use
+# trace-to-json.py to see them on a timeline. With --capture it
+# records the GPS, OneWire and I2C traffic the drivers see
+# (capture.h, Debug builds only) to a file until Ctrl-C. Benchmark
+# results (bench.h) print one line each; bench.py asks for them and
+# checks them against a baseline.
+#
+# Usage:
+#   telemetry-decode.py /dev/ttyUSB0
+#   telemetry-decode.py --dump history.csv /dev/ttyUSB0
+#   telemetry-decode.py --profile --reset /dev/ttyUSB0
+#   telemetry-decode.py --capture field.cap /dev/ttyUSB0
+#   telemetry-decode.py capture.bin
+
+import argparse
+import os
+import struct
+import sys
+import termios
+import tty
+
+TELEMETRY_VERSION = 1
+
+RECORD_STATE = 0x01
+RECORD_SAMPLE = 0x02
+RECORD_COUNTERS = 0x03
+RECORD_LOG_PAGE = 0x04
+RECORD_DUMP_END = 0x05
+RECORD_EVENT = 0x06
+RECORD_PROFILE = 0x07
+RECORD_TRACE = 0x08
+RECORD_CAPTURE = 0x09
+RECORD_BENCH = 0x0A
+REQUEST_DUMP = 0x81
+REQUEST_PROFILE = 0x82
+REQUEST_TRACE = 0x83
+REQUEST_CAPTURE = 0x84
+REQUEST_BENCH = 0x85
+
+PROFILE_RESET = 0x01
+TRACE_STREAM = 0x01
+CAPTURE_START = 0x01
+
+COUNTER_GROUPS = {
+    1: ('afsk', ['framesDecoded', 'fcsErrors', 'samplesProcessed']),
+    2: ('kiss', ['framesFromHost', 'framesToHost', 'framesDropped', 'bytesCopied']),
+    3: ('csma', ['framesSent', 'framesDropped', 'busySlots']),
+    4: ('tdma', ['framesSent', 'slotsDeferred', 'framesTooLong']),
+    5: ('digi', ['framesRelayed', 'duplicatesDropped', 'lookups', 'probes']),
+    6: ('calibration', ['windows', 'rejected', 'lastPPM']),
+    7: ('power', ['wakeupsPerMinute']),
+    8: ('flash-log', ['observations', 'pagesWritten', 'sectorsErased', 'pagesSkipped']),
+    9: ('radio-scan', ['retunes', 'writesSkipped', 'listCycles']),
+    10: ('telemetry', ['framesSent', 'framesDropped', 'pagesDumped']),
+    11: ('capture', ['bytesCaptured', 'recordsDropped']),
+    12: ('wind-rain', ['windPulses', 'rainTips', 'rainBounces', 'windBounces']),
+    13: ('i2c', ['transactions', 'errors', 'bytes', 'recoveries']),
+    14: ('supply', ['sequences', 'sequencesMissed', 'chipTenthsC']),
+}
+
+EVENTS = {
+    1: 'onewire-presence',
+}
+
+# Mirrors the PROFILE_ handler numbers in profile.h
+PROFILE_ISRS = ['onewire', 'gps-uart', 'i2c', 'tick', 'csma', 'kiss', 'lcd', 'audio', 'telemetry', 'rain', 'supply', 'pwm', 'wind']
+PROFILE_BUCKETS = 24
+
+# Mirrors the TRACE_ events in trace.h
+TRACE_EVENTS = {
+    0x00: 'none',
+    0x01: 'boot',
+    0x02: 'tick',
+    0x10: 'onewire-add',
+    0x11: 'onewire-task',
+    0x12: 'onewire-callback',
+    0x13: 'onewire-idle',
+    0x20: 'i2c-queue',
+    0x21: 'i2c-write',
+    0x22: 'i2c-read',
+    0x23: 'i2c-idle',
+    0x30: 'uart-rx',
+    0x31: 'uart-line',
+    0x40: 'csma-transmit',
+    0x41: 'csma-drop',
+}
+TRACE_RECORD = struct.Struct('<IBBH')
+
+# Mirrors the BENCH_ numbers in bench.h
+BENCHES = ['gps-process-line', 'gps-scratchpad-value', 'ds18b20-temperature', 'onewire-write-byte',
+           'onewire-read-byte', 'i2c-queue-command', 'lcd-write', 'lcd-format']
+
+NO_VALUE = -32768
+SECONDS_2000 = 946684800
+LOG_PAGE_SIZE = 128
+
+
+def crc16(data, crc=0xFFFF):
+    # AX.25 FCS, reflected polynomial 0x8408
+    for byte in data:
+        crc ^= byte
+        for _ in range(8):
+            crc = (crc >> 1) ^ 0x8408 if crc & 1 else crc >> 1
+    return crc ^ 0xFFFF
+
+
+def cobs_decode(data):
+    out = bytearray()
+    i = 0
+    while i < len(data):
+        code = data[i]
+        if code == 0 or i + code > len(data):
+            return None
+        out += data[i + 1:i + code]
+        i += code
+        if code < 0xFF and i < len(data):
+            out.append(0)
+    return bytes(out)
+
+
+def cobs_encode(data):
+    out = bytearray()
+    block = bytearray()
+    for byte in data:
+        if byte == 0:
+            out.append(len(block) + 1)
+            out += block
+            block = bytearray()
+        else:
+            block.append(byte)
+            if len(block) == 254:
+                out.append(0xFF)
+                out += block
+                block = bytearray()
+    out.append(len(block) + 1)
+    out += block
+    return bytes(out) + b'\x00'
+
+
+def format_time(seconds):
+    if seconds == 0:
+        return 'no-fix'
+    import time
+    return time.strftime('%Y-%m-%dT%H:%M:%SZ', time.gmtime(SECONDS_2000 + seconds))
+
+
+def format_value(value):
+    return '---' if value == NO_VALUE else str(value)
+
+
+def decode_log_page(page, values):
+    # Mirrors the page layout in flash-log.c
+    header = struct.Struct('<II%dhBB' % values)
+    sequence, seconds, *first, count, used = header.unpack_from(page)
+    deltas = page[header.size:LOG_PAGE_SIZE - 2]
+    current = list(first)
+    observations = []
+    for i in range(count):
+        if i:
+            record = deltas[(i - 1) * (1 + values):i * (1 + values)]
+            if len(record) < 1 + values:
+                break
+            seconds += record[0]
+            for v in range(values):
+                current[v] += struct.unpack('b', record[1 + v:2 + v])[0]
+        observations.append((seconds, list(current)))
+    return sequence, observations
+
+
+def decode_trace(payload):
+    # First record's index, count, then the records
+    index, count = struct.unpack('<IB', payload[:5])
+    records = []
+    for i in range(count):
+        cycles, event, arg, value = TRACE_RECORD.unpack_from(payload, 5 + i * TRACE_RECORD.size)
+        records.append((index + i, cycles, event, arg, value))
+    return records
+
+
+def decode_bench(payload):
+    # None for an empty report - the benchmarks didn't run
+    bench, benches = payload[0], payload[1]
+    if not benches:
+        return None
+    iterations, minimum, maximum, total, hz = struct.unpack('<HIIII', payload[2:20])
+    return {
+        'bench': BENCHES[bench] if bench < len(BENCHES) else 'bench%d' % bench,
+        'index': bench,
+        'benches': benches,
+        'iterations': iterations,
+        'minCycles': minimum,
+        'maxCycles': maximum,
+        'meanCycles': total / iterations if iterations else 0,
+        'hz': hz,
+    }
+
+
+def format_histogram(histogram):
+    # Bucket n holds values below 2^n, the last one everything above
+    buckets = []
+    for bucket, count in enumerate(histogram):
+        if not count:
+            continue
+        if bucket == 0:
+            label = '0'
+        elif bucket == len(histogram) - 1:
+            label = '>=%d' % (1 << (bucket - 1))
+        else:
+            label = '<%d' % (1 << bucket)
+        buckets.append('%s:%d' % (label, count))
+    return ' '.join(buckets) or '-'
+
+
+class Decoder:
+    def __init__(self, values, dump_file, profile=False, capture_file=None):
+        self.values = values
+        self.dump_file = dump_file
+        self.profile_only = profile
+        self.capture_file = capture_file
+        self.capture_offset = 0
+        self.dump_rows = []
+        self.last_sequence = None
+        self.frames = 0
+        self.bad_frames = 0
+        self.lost_frames = 0
+
+    def frame(self, encoded):
+        frame = cobs_decode(encoded)
+        if frame is None or len(frame) < 5 or crc16(frame[:-2]) != struct.unpack('<H', frame[-2:])[0]:
+            self.bad_frames += 1
+            print('bad frame (%d bytes)' % len(encoded), file=sys.stderr)
+            return
+
+        version, record, sequence = frame[0], frame[1], frame[2]
+        payload = frame[3:-2]
+        if version != TELEMETRY_VERSION:
+            print('unknown version %d' % version, file=sys.stderr)
+            return
+
+        if self.last_sequence is not None:
+            self.lost_frames += (sequence - self.last_sequence - 1) & 0xFF
+        self.last_sequence = sequence
+        self.frames += 1
+
+        handler = {
+            RECORD_STATE: self.state,
+            RECORD_SAMPLE: self.sample,
+            RECORD_COUNTERS: self.counters,
+            RECORD_LOG_PAGE: self.log_page,
+            RECORD_DUMP_END: self.dump_end,
+            RECORD_EVENT: self.event,
+            RECORD_PROFILE: self.profile,
+            RECORD_TRACE: self.trace,
+            RECORD_CAPTURE: self.capture,
+            RECORD_BENCH: self.bench,
+        }.get(record)
+        if handler:
+            handler(payload)
+        else:
+            print('record 0x%02x: %s' % (record, payload.hex()))
+
+    def state(self, payload):
+        seconds, flags, latitude, longitude, temperature, hz, ppm = struct.unpack('<IBiihIi', payload[:23])
+        supply = ''
+        if len(payload) >= 27 and flags & 0x10:
+            battery, solar = struct.unpack('<HH', payload[23:27])
+            supply = ' battery=%.3f solar=%.3f' % (battery / 1000.0, solar / 1000.0)
+        print('state %s gps=%s fix=%s therm=%s scan=%s lat=%.5f long=%.5f temp=%s clock=%d ppm=%d%s' % (
+            format_time(seconds),
+            flags & 1, (flags >> 1) & 1, (flags >> 2) & 1, (flags >> 3) & 1,
+            latitude / 6000.0, longitude / 6000.0,
+            format_value(temperature), hz, ppm, supply))
+
+    def sample(self, payload):
+        channel, seconds, value = struct.unpack('<BIh', payload[:7])
+        print('sample %s channel=%d value=%s' % (format_time(seconds), channel, format_value(value)))
+
+    def counters(self, payload):
+        group, count = payload[0], payload[1]
+        counters = struct.unpack('<%dI' % count, payload[2:2 + 4 * count])
+        name, fields = COUNTER_GROUPS.get(group, ('group%d' % group, []))
+        pairs = []
+        for i, value in enumerate(counters):
+            field = fields[i] if i < len(fields) else 'c%d' % i
+            if field in ('lastPPM', 'chipTenthsC'):
+                value = struct.unpack('<i', struct.pack('<I', value))[0]
+            pairs.append('%s=%d' % (field, value))
+        print('counters %s %s' % (name, ' '.join(pairs)))
+
+    def log_page(self, payload):
+        index = struct.unpack('<H', payload[:2])[0]
+        sequence, observations = decode_log_page(payload[2:2 + LOG_PAGE_SIZE], self.values)
+        print('log page %d sequence %d: %d observations' % (index, sequence, len(observations)))
+        for seconds, values in observations:
+            self.dump_rows.append((sequence, seconds, values))
+
+    def dump_end(self, payload):
+        pages = struct.unpack('<H', payload[:2])[0]
+        print('dump end: %d pages' % pages)
+        if self.dump_file:
+            self.dump_rows.sort()
+            with open(self.dump_file, 'w') as out:
+                out.write('time,seconds,' + ','.join('value%d' % v for v in range(self.values)) + '\n')
+                for _, seconds, values in self.dump_rows:
+                    out.write('%s,%d,%s\n' % (format_time(seconds), seconds, ','.join(format_value(v) for v in values)))
+            print('wrote %d observations to %s' % (len(self.dump_rows), self.dump_file))
+            sys.exit(0)
+
+    def event(self, payload):
+        event, value = struct.unpack('<BI', payload[:5])
+        print('event %s %d' % (EVENTS.get(event, 'event%d' % event), value))
+
+    def profile(self, payload):
+        isr, isrs = payload[0], payload[1]
+        if not isrs:
+            print('profile: not compiled in (define PROFILE_ENABLED)')
+        else:
+            count, cycles_low, cycles_high, max_latency, max_duration = struct.unpack('<IIIII', payload[2:22])
+            cycles = cycles_high << 32 | cycles_low
+            histograms = struct.unpack('<%dH' % (2 * PROFILE_BUCKETS), payload[22:22 + 4 * PROFILE_BUCKETS])
+            name = PROFILE_ISRS[isr] if isr < len(PROFILE_ISRS) else 'isr%d' % isr
+            print('profile %s count=%d cycles=%d mean=%d maxLatency=%d maxDuration=%d' % (
+                name, count, cycles, cycles // count if count else 0, max_latency, max_duration))
+            print('  latency  %s' % format_histogram(histograms[:PROFILE_BUCKETS]))
+            print('  duration %s' % format_histogram(histograms[PROFILE_BUCKETS:]))
+        if self.profile_only and isr + 1 >= isrs:
+            sys.exit(0)
+
+    def bench(self, payload):
+        result = decode_bench(payload)
+        if not result:
+            print('bench: not run (define BENCH_ENABLED)')
+            return
+        print('bench %s iterations=%d min=%d mean=%.1f max=%d cycles (%.1f ns at %d Hz)' % (
+            result['bench'], result['iterations'], result['minCycles'], result['meanCycles'],
+            result['maxCycles'], result['minCycles'] * 1e9 / result['hz'] if result['hz'] else 0, result['hz']))
+
+    def capture(self, payload):
+        offset = struct.unpack('<I', payload[:4])[0]
+        data = payload[4:]
+        if not data:
+            print('capture end: %d bytes' % self.capture_offset)
+            if self.capture_file:
+                self.capture_file.close()
+                sys.exit(0)
+            return
+        if offset != self.capture_offset:
+            # A lost frame leaves the records after it unusable
+            print('capture gap at %d (got %d)' % (self.capture_offset, offset), file=sys.stderr)
+        self.capture_offset = offset + len(data)
+        if self.capture_file:
+            self.capture_file.write(data)
+
+    def trace(self, payload):
+        records = decode_trace(payload)
+        if not records:
+            print('trace end')
+        for index, cycles, event, arg, value in records:
+            print('trace #%d cycles=%d %s arg=%d value=%d' % (
+                index, cycles, TRACE_EVENTS.get(event, 'event0x%02x' % event), arg, value))
+
+
+def open_port(path, baud):
+    fd = os.open(path, os.O_RDWR | os.O_NOCTTY if path.startswith('/dev/') else os.O_RDONLY)
+    if os.isatty(fd):
+        tty.setraw(fd)
+        attributes = termios.tcgetattr(fd)
+        speed = getattr(termios, 'B%d' % baud)
+        attributes[4] = attributes[5] = speed
+        termios.tcsetattr(fd, termios.TCSANOW, attributes)
+    return fd
+
+
+def send_request(fd, request, payload=b''):
+    frame = bytes([TELEMETRY_VERSION, request, 0]) + payload
+    frame += struct.pack('<H', crc16(frame))
+    os.write(fd, b'\x00' + cobs_encode(frame))
+
+
+def read_frames(fd, decoder, pending):
+    while True:
+        data = os.read(fd, 4096)
+        if not data:
+            break
+        pending += data
+        while True:
+            end = pending.find(b'\x00')
+            if end < 0:
+                break
+            if end:
+                decoder.frame(bytes(pending[:end]))
+            del pending[:end + 1]
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Decode the TM4C123-WX telemetry stream')
+    parser.add_argument('source', help='serial device or captured stream, - for stdin')
+    parser.add_argument('--baud', type=int, default=921600)
+    parser.add_argument('--dump', metavar='CSV', help='request the stored history and write it as CSV')
+    parser.add_argument('--values', type=int, default=1, help='values per logged observation (HISTORY_CHANNELS)')
+    parser.add_argument('--profile', action='store_true', help='request and print the interrupt handler profiles')
+    parser.add_argument('--reset', action='store_true', help='with --profile, start the profiles over afterwards')
+    parser.add_argument('--capture', metavar='FILE', help='record the driver traffic to FILE until Ctrl-C')
+    args = parser.parse_args()
+
+    fd = 0 if args.source == '-' else open_port(args.source, args.baud)
+    decoder = Decoder(args.values, args.dump, args.profile, open(args.capture, 'wb') if args.capture else None)
+
+    if args.dump and os.isatty(fd):
+        send_request(fd, REQUEST_DUMP)
+    if args.profile and os.isatty(fd):
+        send_request(fd, REQUEST_PROFILE, bytes([PROFILE_RESET if args.reset else 0]))
+    if args.capture and os.isatty(fd):
+        send_request(fd, REQUEST_CAPTURE, bytes([CAPTURE_START]))
+
+    pending = bytearray()
+    try:
+        read_frames(fd, decoder, pending)
+    except KeyboardInterrupt:
+        if args.capture and os.isatty(fd):
+            # Stop recording and take what's still buffered
+            send_request(fd, REQUEST_CAPTURE, bytes([0]))
+            try:
+                read_frames(fd, decoder, pending)
+            except KeyboardInterrupt:
+                pass
+
+    print('%d frames, %d bad, %d lost' % (decoder.frames, decoder.bad_frames, decoder.lost_frames), file=sys.stderr)
+
+
+if __name__ == '__main__':
+    main()
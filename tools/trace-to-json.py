@@ -0,0 +1,204 @@
+#!/usr/bin/env python3
+# Converts the TM4C123-WX event trace (trace.h) to Chrome trace JSON
+#
+# Reads trace records from the telemetry stream, asking the station
+# for them when the source is a serial port, and writes a file that
+# chrome://tracing or ui.perfetto.dev shows as a timeline: one track
+# per driver, OneWire tasks and I2C commands as slices, queue depths
+# as counters. Each boot gets its own process, so the events that
+# led up to a reset sit apart from the run after it.
+#
+# Usage:
+#   trace-to-json.py /dev/ttyUSB0 trace.json
+#   trace-to-json.py --stream /dev/ttyUSB0 trace.json   (Ctrl-C to stop)
+#   trace-to-json.py capture.bin trace.json
+
+import argparse
+import importlib.util
+import json
+import os
+import sys
+
+# Framing and the record layout come from the decoder
+spec = importlib.util.spec_from_file_location(
+    'telemetry_decode', os.path.join(os.path.dirname(os.path.abspath(__file__)), 'telemetry-decode.py'))
+telemetry = importlib.util.module_from_spec(spec)
+spec.loader.exec_module(telemetry)
+
+TRACKS = {
+    'scheduler': 1,
+    'onewire': 2,
+    'i2c': 3,
+    'gps-uart': 4,
+    'csma': 5,
+}
+
+# Mirrors the ONEWIRE_ task types in onewire.c
+ONEWIRE_TASKS = {
+    0: 'bus-low',
+    1: 'release-bus',
+    2: 'sample-bus',
+    3: 'transfer-byte',
+    4: 'wait-bus-high',
+}
+
+
+class Timeline:
+    def __init__(self, mhz):
+        self.mhz = mhz
+        self.events = []
+        self.boot = 0
+        self.last_cycles = None
+        self.time = 0
+        # Slices run until the next event on their track
+        self.open_slices = {}
+
+    def timestamp(self, cycles):
+        # The cycle counter wraps every 2^32 cycles; records can be a
+        # little out of order when a handler preempts a writer
+        if self.last_cycles is not None:
+            delta = (cycles - self.last_cycles) & 0xFFFFFFFF
+            if delta >= 0x80000000:
+                delta -= 0x100000000
+            self.time += delta
+        self.last_cycles = cycles
+        return self.time / self.mhz
+
+    def start_process(self):
+        self.close_slices(self.events[-1]['ts'] if self.events else 0)
+        self.boot += 1
+        self.last_cycles = None
+        self.time = 0
+        self.events.append({'ph': 'M', 'pid': self.boot, 'name': 'process_name',
+                            'args': {'name': 'boot %d' % self.boot}})
+        for name, tid in TRACKS.items():
+            self.events.append({'ph': 'M', 'pid': self.boot, 'tid': tid, 'name': 'thread_name',
+                                'args': {'name': name}})
+
+    def close_slice(self, track, ts):
+        begun = self.open_slices.pop(track, None)
+        if begun:
+            begun['dur'] = max(ts - begun['ts'], 0)
+            self.events.append(begun)
+
+    def close_slices(self, ts):
+        for track in list(self.open_slices):
+            self.close_slice(track, ts)
+
+    def slice(self, track, ts, name, args):
+        self.close_slice(track, ts)
+        self.open_slices[track] = {'ph': 'X', 'pid': self.boot, 'tid': TRACKS[track], 'ts': ts,
+                                   'name': name, 'args': args}
+
+    def instant(self, track, ts, name, args=None):
+        self.events.append({'ph': 'i', 's': 't', 'pid': self.boot, 'tid': TRACKS[track], 'ts': ts,
+                            'name': name, 'args': args or {}})
+
+    def counter(self, ts, name, value):
+        self.events.append({'ph': 'C', 'pid': self.boot, 'ts': ts, 'name': name, 'args': {'depth': value}})
+
+    def add(self, cycles, event, arg, value):
+        if event == 0x00:
+            # Cut short by a reset, nothing in it
+            return
+        if event == 0x01 or not self.boot:
+            self.start_process()
+        ts = self.timestamp(cycles)
+
+        if event == 0x01:
+            self.events.append({'ph': 'i', 's': 'g', 'pid': self.boot, 'ts': ts, 'name': 'boot',
+                                'args': {'recordsKept': value}})
+        elif event == 0x02:
+            self.instant('scheduler', ts, 'tick', {'cycle': arg})
+        elif event == 0x10:
+            self.counter(ts, 'onewire queue', value)
+        elif event == 0x11:
+            self.slice('onewire', ts, ONEWIRE_TASKS.get(arg, 'task %d' % arg), {'tasksLeft': value})
+        elif event == 0x12:
+            self.instant('onewire', ts, 'callback', {'task': ONEWIRE_TASKS.get(arg, arg), 'data': value})
+        elif event == 0x13:
+            self.close_slice('onewire', ts)
+            self.counter(ts, 'onewire queue', 0)
+        elif event == 0x20:
+            self.counter(ts, 'i2c queue', value)
+        elif event in (0x21, 0x22):
+            kind = 'write' if event == 0x21 else 'read'
+            self.slice('i2c', ts, '%s 0x%02x' % (kind, arg), {'register': arg, 'value': '0x%04x' % value})
+        elif event == 0x23:
+            self.close_slice('i2c', ts)
+            self.instant('i2c', ts, 'idle', {'radioHeld': arg})
+        elif event == 0x30:
+            self.instant('gps-uart', ts, 'rx', {'bytes': arg, 'lineLength': value})
+        elif event == 0x31:
+            self.instant('gps-uart', ts, 'line', {'length': value})
+        elif event in (0x40, 0x41):
+            self.instant('csma', ts, 'transmit' if event == 0x40 else 'drop', {'queued': value})
+            self.counter(ts, 'csma queue', value)
+        else:
+            self.instant('scheduler', ts, 'event 0x%02x' % event, {'arg': arg, 'value': value})
+
+    def write(self, path):
+        if self.events:
+            self.close_slices(max(e.get('ts', 0) for e in self.events))
+        with open(path, 'w') as out:
+            json.dump({'traceEvents': self.events, 'displayTimeUnit': 'ns'}, out)
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Convert the TM4C123-WX event trace to Chrome trace JSON')
+    parser.add_argument('source', help='serial device or captured telemetry stream, - for stdin')
+    parser.add_argument('output', help='JSON file to write')
+    parser.add_argument('--baud', type=int, default=921600)
+    parser.add_argument('--stream', action='store_true', help='keep recording until Ctrl-C')
+    parser.add_argument('--mhz', type=float, default=80.0, help='system clock, for the timestamps')
+    args = parser.parse_args()
+
+    fd = 0 if args.source == '-' else telemetry.open_port(args.source, args.baud)
+    if os.isatty(fd):
+        telemetry.send_request(fd, telemetry.REQUEST_TRACE, bytes([telemetry.TRACE_STREAM if args.stream else 0]))
+
+    records = {}
+    done = False
+    pending = bytearray()
+    try:
+        while not done:
+            data = os.read(fd, 4096)
+            if not data:
+                break
+            pending += data
+            while not done:
+                end = pending.find(b'\x00')
+                if end < 0:
+                    break
+                frame = telemetry.cobs_decode(bytes(pending[:end]))
+                del pending[:end + 1]
+                if (not frame or len(frame) < 5 or frame[1] != telemetry.RECORD_TRACE or
+                        telemetry.crc16(frame[:-2]) != frame[-2] | frame[-1] << 8):
+                    continue
+                batch = telemetry.decode_trace(frame[3:-2])
+                if not batch and not args.stream:
+                    done = True
+                for index, cycles, event, arg, value in batch:
+                    records[index] = (cycles, event, arg, value)
+    except KeyboardInterrupt:
+        pass
+
+    if os.isatty(fd) and args.stream:
+        # Let the station finish up and stop streaming
+        telemetry.send_request(fd, telemetry.REQUEST_TRACE, bytes([0]))
+
+    timeline = Timeline(args.mhz)
+    lost = 0
+    previous = None
+    for index in sorted(records):
+        if previous is not None:
+            lost += index - previous - 1
+        previous = index
+        timeline.add(*records[index])
+    timeline.write(args.output)
+
+    print('%d records, %d lost, %d boots -> %s' % (len(records), lost, timeline.boot, args.output), file=sys.stderr)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,134 @@
+// In-RAM event trace for the driver state machines
+//
+// Writers claim a record by bumping the free-running head with
+// LDREX/STREX - an interrupt between the two makes the STREX fail
+// and the claim is simply retried, so no writer ever waits or
+// masks interrupts. The record is filled in after the claim, so a
+// reader that preempts its writer could find last lap's record in
+// the slot: each slot's tag, written last, publishes which lap the
+// record in it is from, and a reader leaves a record alone until
+// the tag says it's there. A reader checks the head again after
+// copying a record out to catch one overwritten underneath it.
+
+#include "trace.h"
+#include "profile.h"
+#include "intrinsics.h"
+
+// Marks a ring that was running before the reset
+#define TRACE_MAGIC 0x54524143
+
+// The lap of the ring an index is on, as the tags keep it
+#define TRACE_LAP( index ) ( (uint8_t) ( ( index ) / TRACE_RECORDS ) )
+
+#ifdef TRACE_ENABLED
+
+#ifdef PROFILE_HOST
+#define __no_init
+#endif
+
+// Left alone by the startup code so a reset keeps the trace
+static __no_init volatile Trace_Record records[TRACE_RECORDS];
+static __no_init volatile uint8_t tags[TRACE_RECORDS];
+static __no_init volatile uint32_t head;
+static __no_init uint32_t magic;
+
+void Trace_Init() {
+	Profile_Enable_Cycle_Counter();
+
+	uint16_t kept = 0;
+	if ( TRACE_MAGIC == magic ) {
+		kept = ( head < TRACE_RECORDS ) ? head : TRACE_RECORDS;
+
+		// Nothing is being written across a reset, so a record
+		// still untagged was cut short - it keeps its place, empty
+		for ( uint32_t index=head - kept; index != head; index++ ) {
+			uint16_t slot = index & ( TRACE_RECORDS - 1 );
+			if ( tags[slot] != TRACE_LAP( index ) ) {
+				records[slot].cycles = 0;
+				records[slot].event = TRACE_NONE;
+				records[slot].arg = 0;
+				records[slot].value = 0;
+				tags[slot] = TRACE_LAP( index );
+			}
+		}
+	} else {
+		// A lap the first records aren't on
+		for ( uint16_t slot=0; slot < TRACE_RECORDS; slot++ ) {
+			tags[slot] = TRACE_LAP( (uint32_t) -1 );
+		}
+		head = 0;
+		magic = TRACE_MAGIC;
+	}
+
+	Trace_Event( TRACE_BOOT, 0, kept );
+}
+
+void Trace_Event( uint8_t event, uint8_t arg, uint16_t value ) {
+	uint32_t index;
+
+#ifdef PROFILE_HOST
+	index = head++;
+#else
+	do {
+		index = __LDREX( (unsigned long *) &head );
+	} while ( __STREX( index + 1, (unsigned long *) &head ) );
+#endif
+
+	uint16_t slot = index & ( TRACE_RECORDS - 1 );
+	records[slot].cycles = Profile_Get_Cycles();
+	records[slot].event = event;
+	records[slot].arg = arg;
+	records[slot].value = value;
+	tags[slot] = TRACE_LAP( index );
+}
+
+/*
+ * Number of records written since the trace started - the ring
+ * holds the last TRACE_RECORDS of them
+ */
+uint32_t Trace_Get_Head() {
+	return head;
+}
+
+/*
+ * Copies out a record by its index
+ * Returns 0 if it hasn't been written, is still being written or
+ * has been overwritten
+ */
+uint8_t Trace_Get_Record( uint32_t index, Trace_Record *record ) {
+	if ( ! record || ( head - index - 1 ) >= TRACE_RECORDS ) {
+		return 0;
+	}
+
+	uint16_t slot = index & ( TRACE_RECORDS - 1 );
+	if ( tags[slot] != TRACE_LAP( index ) ) {
+		return 0;
+	}
+	record->cycles = records[slot].cycles;
+	record->event = records[slot].event;
+	record->arg = records[slot].arg;
+	record->value = records[slot].value;
+
+	// Lapped while copying?
+	return ( head - index ) <= TRACE_RECORDS;
+}
+
+#else
+
+// Compiled out - nothing records, so there is nothing to read
+
+void Trace_Init() {
+}
+
+void Trace_Event( uint8_t event, uint8_t arg, uint16_t value ) {
+}
+
+uint32_t Trace_Get_Head() {
+	return 0;
+}
+
+uint8_t Trace_Get_Record( uint32_t index, Trace_Record *record ) {
+	return 0;
+}
+
+#endif // TRACE_ENABLED
@@ -0,0 +1,56 @@
+// In-RAM event trace for the driver state machines
+//
+// Built only when TRACE_ENABLED is defined (the Debug project
+// configuration defines it); otherwise the TRACE macro compiles
+// to nothing. Records carry the cycle counter (profile.h) as a
+// timestamp, so PROFILE_HOST gives host runs the same timeline.
+//
+// The ring survives a reset that doesn't lose power, so the
+// events leading up to a fault can be read out afterwards, over
+// telemetry (TELEMETRY_REQUEST_TRACE) or from C-SPY. A boot
+// record separates them from the new run.
+
+#ifndef __TRACE_H
+#define __TRACE_H
+
+#include "stdint.h"
+
+// Must be a power of two
+#define TRACE_RECORDS 256
+
+// Events - arg and value as noted
+#define TRACE_NONE 0x00				// -, - a record a reset cut short
+#define TRACE_BOOT 0x01				// -, records kept from before the reset
+#define TRACE_TICK 0x02				// cycle count, -
+#define TRACE_ONEWIRE_ADD 0x10		// task type, tasks queued
+#define TRACE_ONEWIRE_TASK 0x11		// task type, tasks left
+#define TRACE_ONEWIRE_CALLBACK 0x12	// task type, data handed over
+#define TRACE_ONEWIRE_IDLE 0x13		// -, -
+#define TRACE_I2C_QUEUE 0x20		// register, transactions queued at its priority
+#define TRACE_I2C_WRITE 0x21		// register, first two bytes
+#define TRACE_I2C_READ 0x22			// register, first two bytes
+#define TRACE_I2C_IDLE 0x23			// radio held, -
+#define TRACE_UART_RX 0x30			// bytes drained, line length so far
+#define TRACE_UART_LINE 0x31		// -, line length
+#define TRACE_CSMA_TRANSMIT 0x40	// -, frames queued
+#define TRACE_CSMA_DROP 0x41		// -, frames queued
+
+typedef struct Trace_Records {
+	uint32_t cycles;
+	uint8_t event;
+	uint8_t arg;
+	uint16_t value;
+} Trace_Record;
+
+#ifdef TRACE_ENABLED
+#define TRACE( event, arg, value ) Trace_Event( event, arg, value )
+#else
+#define TRACE( event, arg, value )
+#endif
+
+void Trace_Init();
+void Trace_Event( uint8_t event, uint8_t arg, uint16_t value );
+uint32_t Trace_Get_Head();
+uint8_t Trace_Get_Record( uint32_t index, Trace_Record *record );
+
+#endif // __TRACE_H
@@ -8,9 +8,15 @@
 
 
 #include "uart.h"
+#include "clock.h"
+#include "profile.h"
+#include "trace.h"
+#include "capture.h"
 #include "tm4c123gh6pm.h"
 
+#define UART_BAUD 9600
 #define UART_MAX_BUFFER 200
+#define UART_RX_FIFO_LENGTH 16
 static char buffer[UART_MAX_BUFFER];
 static uint16_t bytesReceived;
 
@@ -24,6 +30,7 @@ void _UART_Clear_Buffer() {
 void _UART_AddToBuffer( char data ) {
 	if ( ( 0x0A == data ) || ( 0x0D == data ) ) {
 		// end of line
+		TRACE( TRACE_UART_LINE, 0, bytesReceived );
 		if ( UART_Receive_Callback ) {
 			buffer[bytesReceived] = 0;
 			UART_Receive_Callback( &buffer[0] );
@@ -39,6 +46,21 @@ void _UART_AddToBuffer( char data ) {
 	}
 }
 
+// Divisor for UART_BAUD at the current system clock
+// The UART must be disabled, the LCRH write that follows latches it
+void _UART_Set_Baud() {
+	uint32_t divisor = Clock_Get_UART_Divisor( UART_BAUD );
+	UART1_IBRD_R = divisor >> 6;			// e.g. 16 MHz: int(16,000,000 / (16 * 9600)) = 104
+	UART1_FBRD_R = divisor & 0x3F;			// and int(0.1666 * 64 + 0.5) = 11
+}
+
+void _UART_Clock_Changed( uint32_t hz ) {
+	UART1_CTL_R &= ~UART_CTL_UARTEN;
+	_UART_Set_Baud();
+	UART1_LCRH_R = 0x70;
+	UART1_CTL_R |= UART_CTL_UARTEN;
+}
+
 // Initialize UART1
 // Follows the steps recommended in the Tiva Datasheet, pg. 902, sec. 14.4
 void UART_Init() {
@@ -55,10 +77,10 @@ void UART_Init() {
 
 	GPIO_PORTC_DEN_R |= 0x30;				// Enable digital on C4 and C5
 
-	// Set the baud rate (9600) (assumes system clock of 16 MHz)
+	// Set the baud rate (9600) from the system clock
 	UART1_CTL_R &= ~UART_CTL_UARTEN;		// Disable the UART
-	UART1_IBRD_R = 104;						// IBRD = int(16,000,000 / (16 * 9600)) = int(104.1666)
-	UART1_FBRD_R = 11;						// FBRD = int(0.1666 * 64 + 0.5) = 11
+	_UART_Set_Baud();
+	Clock_Register_Change_Callback( _UART_Clock_Changed );
 
 	UART1_LCRH_R = 0x70;					// 8N1 + FIFo (pg. 916)
 
@@ -93,10 +115,29 @@ void UART_OutString( char *data ) {
 
 // Handles UART interrupt events, IRQ6
 void UART1_Handler() {
+	PROFILE_ENTER( PROFILE_GPS_UART );
+
 	if ( UART1_RIS_R & UART_RIS_RXRIS ) {
 		UART1_ICR_R = UART_ICR_RXIC;	// Acknowledge the interrupt
+		uint8_t received[UART_RX_FIFO_LENGTH];
+		uint8_t count = 0;
+		uint8_t drained = 0;
 		while (( UART1_FR_R & UART_FR_RXFE) == 0 ) {
-			_UART_AddToBuffer( UART1_DR_R );
+			received[count] = UART1_DR_R;
+			_UART_AddToBuffer( received[count] );
+			count++;
+			drained++;
+			// More arrived while draining - record what we have so far
+			if ( UART_RX_FIFO_LENGTH == count ) {
+				CAPTURE_UART_BYTES( received, count );
+				count = 0;
+			}
+		}
+		if ( count ) {
+			CAPTURE_UART_BYTES( received, count );
 		}
+		TRACE( TRACE_UART_RX, drained, bytesReceived );
 	}
+
+	PROFILE_EXIT( PROFILE_GPS_UART );
 }
@@ -0,0 +1,297 @@
+// Anemometer and tipping bucket rain gauge inputs for TM4C123
+//
+// Uses Wide Timer 3A, PD2 (WT3CCP0): anemometer, edges timed
+// Uses Wide Timer 3B, PD3 (WT3CCP1): rain gauge, edges timed
+//
+// Both are reed switches, which bounce on every closure, so each
+// edge interrupts and the timer's free-running capture of when it
+// happened filters the bounces out: an edge too soon after the last
+// one is a bounce. The anemometer closes once a turn - over a
+// hundred times a second in a storm - so its window is only as long
+// as a switch's own bounce, where the rain gauge's covers the bucket
+// swinging. The tick takes each second's pulses and tips. Gusts
+// are the fastest three second average.
+//
+// Both halves keep capturing in sleep (power.c leaves run mode
+// clocks on) - the anemometer wakes the CPU for each closure, a
+// few microseconds of work - and the counts only go up, so a tick
+// that comes late loses nothing.
+
+#include "wind-rain.h"
+#include "clock.h"
+#include "profile.h"
+#include "tm4c123gh6pm.h"
+
+// The bucket settles well within this after a tip
+#define WIND_RAIN_TIP_DEBOUNCE_MILLISECONDS 100
+
+// A reed switch stops bouncing well within this of closing, and
+// closures at the top of the byte's range (255 a second) are 3.9 ms
+// apart
+#define WIND_RAIN_PULSE_DEBOUNCE_MILLISECONDS 2
+
+// Seconds ticks with no edge before the capture count isn't needed
+#define WIND_RAIN_QUIET_SECONDS 2
+
+// A second's count is kept in a byte - 171 mph at 1.492 mph/Hz
+#define WIND_RAIN_MAX_PULSES_PER_SECOND 0xFF
+
+#define WIND_RAIN_GUST_SECONDS 3
+
+// Per second anemometer counts, newest at windSecond
+static uint8_t windCounts[WIND_RAIN_SPEED_SECONDS];
+static uint8_t windSecond = 0;
+static uint8_t windSecondsSeen = 0;
+
+static volatile uint16_t windPending = 0;
+static uint32_t windLastCapture = 0;
+static uint8_t windQuietSeconds = WIND_RAIN_QUIET_SECONDS;
+
+// Fastest gust of each minute, newest at gustMinute
+static uint16_t gustPeaks[WIND_RAIN_GUST_MINUTES];
+static uint8_t gustMinute = 0;
+static uint8_t secondsIntoMinute = 0;
+
+// Tips per minute over the last hour, then per hour over the day
+static uint8_t rainMinutes[60];
+static uint16_t rainHours[WIND_RAIN_HOURS];
+static uint8_t rainHour = 0;
+static uint8_t minutesIntoHour = 0;
+
+static volatile uint8_t rainPending = 0;
+static uint32_t rainLastCapture = 0;
+static uint8_t rainQuietSeconds = WIND_RAIN_QUIET_SECONDS;
+
+static uint32_t windRainWindPulses = 0;
+static uint32_t windRainWindBounces = 0;
+static uint32_t windRainRainTips = 0;
+static uint32_t windRainRainBounces = 0;
+
+/*
+ * Tenths of a mph for pulses counted over seconds
+ */
+uint16_t _Wind_Rain_Speed( uint32_t pulses, uint8_t seconds ) {
+	if ( ! seconds ) {
+		return 0;
+	}
+	return ( pulses * WIND_RAIN_MPH_PER_HZ_X1000 ) / ( 100 * (uint32_t) seconds );
+}
+
+void Wind_Rain_Init() {
+	volatile unsigned long delay;
+
+	SYSCTL_RCGCWTIMER_R |= 0x08;			// Activate Wide Timer 3
+	SYSCTL_RCGCGPIO_R |= 0x08;				// Activate Port D
+
+	while ( ( SYSCTL_PRGPIO_R & 0x08 ) == 0 )
+	{
+	}
+	delay = SYSCTL_RCGCWTIMER_R;
+
+	GPIO_PORTD_DIR_R &= ~0x0C;				// PD2, PD3 in
+	GPIO_PORTD_AFSEL_R |= 0x0C;				// Alternate function on PD2, PD3
+	GPIO_PORTD_AMSEL_R &= ~0x0C;			// No analog (AIN5, AIN4)
+	GPIO_PORTD_PUR_R |= 0x0C;				// Pull up for the reed switches
+	GPIO_PORTD_DEN_R |= 0x0C;				// Digital I/O on PD2, PD3
+
+	// Configure PD2, PD3 as WT3CCP0, WT3CCP1 (7)
+	GPIO_PORTD_PCTL_R = (GPIO_PORTD_PCTL_R & 0xFFFF00FF) | 0x00007700;
+
+	// Disable both halves during setup
+	WTIMER3_CTL_R &= ~( TIMER_CTL_TAEN | TIMER_CTL_TBEN );
+
+	// Two 32-bit timers
+	WTIMER3_CFG_R = TIMER_CFG_16_BIT;
+
+	// A and B each capture the time of a closure (falling edge)
+	// from a free-running count
+	WTIMER3_TAMR_R = TIMER_TAMR_TAMR_CAP | TIMER_TAMR_TACMR | TIMER_TAMR_TACDIR;
+	WTIMER3_TAILR_R = 0xFFFFFFFF;
+	WTIMER3_TAPR_R = 0;
+
+	WTIMER3_TBMR_R = TIMER_TBMR_TBMR_CAP | TIMER_TBMR_TBCMR | TIMER_TBMR_TBCDIR;
+	WTIMER3_TBILR_R = 0xFFFFFFFF;
+	WTIMER3_TBPR_R = 0;
+
+	WTIMER3_CTL_R = ( WTIMER3_CTL_R & ~( TIMER_CTL_TAEVENT_M | TIMER_CTL_TBEVENT_M ) ) |
+		TIMER_CTL_TAEVENT_NEG | TIMER_CTL_TBEVENT_NEG;
+
+	WTIMER3_IMR_R = TIMER_IMR_CAEIM | TIMER_IMR_CBEIM;
+	WTIMER3_ICR_R = TIMER_ICR_CAECINT | TIMER_ICR_CBECINT;
+
+	WTIMER3_CTL_R |= TIMER_CTL_TAEN | TIMER_CTL_TBEN;
+
+	// Wide Timer 3A / IRQ100 / NVIC_PRI25_R / b7-5 and
+	// Wide Timer 3B / IRQ101 / NVIC_PRI25_R / b15-13 / Priority 3,
+	// the same as the tick that reads the counts
+	NVIC_PRI25_R = (NVIC_PRI25_R & 0xFFFF1F1F) | 0x00006060;
+	NVIC_EN3_R = ( 1 << ( 100 - 96 ) ) | ( 1 << ( 101 - 96 ) );
+}
+
+// Handles Wide Timer 3A capture events, IRQ100
+void Wind_Rain_WTimer3A_Handler() {
+	PROFILE_ENTER( PROFILE_WIND );
+
+	WTIMER3_ICR_R = TIMER_ICR_CAECINT;
+	uint32_t capture = WTIMER3_TAR_R;
+
+	// Filtered as the rain gauge's tips are, below, but timed from
+	// the last closure rather than the last edge, so a bounce late
+	// in one closure can't swallow the next in a strong wind
+	if ( ( windQuietSeconds >= WIND_RAIN_QUIET_SECONDS ) || ( capture - windLastCapture >= Clock_Milliseconds_To_Ticks( WIND_RAIN_PULSE_DEBOUNCE_MILLISECONDS ) ) ) {
+		windPending++;
+		windRainWindPulses++;
+		windQuietSeconds = 0;
+		windLastCapture = capture;
+	} else {
+		windRainWindBounces++;
+	}
+
+	PROFILE_EXIT( PROFILE_WIND );
+}
+
+// Handles Wide Timer 3B capture events, IRQ101
+void Wind_Rain_WTimer3B_Handler() {
+	PROFILE_ENTER( PROFILE_RAIN );
+
+	WTIMER3_ICR_R = TIMER_ICR_CBECINT;
+	uint32_t capture = WTIMER3_TBR_R;
+
+	// The capture count wraps every minute or so at 80 MHz - after
+	// a full quiet second there's no bounce left to filter. One tick
+	// of the seconds count can come moments after the last tip, so
+	// it takes two to be sure a whole second has passed.
+	if ( ( rainQuietSeconds >= WIND_RAIN_QUIET_SECONDS ) || ( capture - rainLastCapture >= Clock_Milliseconds_To_Ticks( WIND_RAIN_TIP_DEBOUNCE_MILLISECONDS ) ) ) {
+		rainPending++;
+		windRainRainTips++;
+		rainQuietSeconds = 0;
+	} else {
+		windRainRainBounces++;
+	}
+	rainLastCapture = capture;
+
+	PROFILE_EXIT( PROFILE_RAIN );
+}
+
+/*
+ * Call once a second, from an interrupt at the rain gauge's
+ * priority - takes the second's counts
+ */
+void Wind_Rain_Tick_Second() {
+	uint16_t pulses = windPending;
+	windPending = 0;
+
+	windSecond = ( windSecond + 1 ) % WIND_RAIN_SPEED_SECONDS;
+	windCounts[windSecond] = ( pulses > WIND_RAIN_MAX_PULSES_PER_SECOND ) ? WIND_RAIN_MAX_PULSES_PER_SECOND : pulses;
+	if ( windSecondsSeen < WIND_RAIN_SPEED_SECONDS ) {
+		windSecondsSeen++;
+	}
+
+	secondsIntoMinute++;
+	if ( secondsIntoMinute >= 60 ) {
+		secondsIntoMinute = 0;
+		gustMinute = ( gustMinute + 1 ) % WIND_RAIN_GUST_MINUTES;
+		gustPeaks[gustMinute] = 0;
+
+		minutesIntoHour++;
+		if ( minutesIntoHour >= 60 ) {
+			minutesIntoHour = 0;
+			rainHour = ( rainHour + 1 ) % WIND_RAIN_HOURS;
+			rainHours[rainHour] = 0;
+		}
+		rainMinutes[minutesIntoHour] = 0;
+	}
+
+	uint16_t gust = Wind_Rain_Get_Speed( WIND_RAIN_GUST_SECONDS );
+	if ( gust > gustPeaks[gustMinute] ) {
+		gustPeaks[gustMinute] = gust;
+	}
+
+	if ( rainPending ) {
+		rainMinutes[minutesIntoHour] += rainPending;
+		rainHours[rainHour] += rainPending;
+		rainPending = 0;
+	}
+	if ( rainQuietSeconds < 0xFF ) {
+		rainQuietSeconds++;
+	}
+	if ( windQuietSeconds < 0xFF ) {
+		windQuietSeconds++;
+	}
+}
+
+/*
+ * Mean wind speed over the last seconds (up to
+ * WIND_RAIN_SPEED_SECONDS), in tenths of a mph
+ */
+uint16_t Wind_Rain_Get_Speed( uint8_t seconds ) {
+	if ( seconds > windSecondsSeen ) {
+		seconds = windSecondsSeen;
+	}
+
+	uint32_t pulses = 0;
+	for ( uint8_t i=0; i < seconds; i++ ) {
+		pulses += windCounts[( windSecond + WIND_RAIN_SPEED_SECONDS - i ) % WIND_RAIN_SPEED_SECONDS];
+	}
+
+	return _Wind_Rain_Speed( pulses, seconds );
+}
+
+/*
+ * Fastest three second mean wind speed in this and the previous
+ * minutes (up to WIND_RAIN_GUST_MINUTES), in tenths of a mph
+ */
+uint16_t Wind_Rain_Get_Gust( uint8_t minutes ) {
+	if ( minutes > WIND_RAIN_GUST_MINUTES ) {
+		minutes = WIND_RAIN_GUST_MINUTES;
+	}
+
+	uint16_t gust = 0;
+	for ( uint8_t i=0; i < minutes; i++ ) {
+		uint16_t peak = gustPeaks[( gustMinute + WIND_RAIN_GUST_MINUTES - i ) % WIND_RAIN_GUST_MINUTES];
+		if ( peak > gust ) {
+			gust = peak;
+		}
+	}
+
+	return gust;
+}
+
+/*
+ * Rain in hundredths of an inch - over the last 60 minutes for
+ * one hour, otherwise over this and the previous hours (up to
+ * WIND_RAIN_HOURS)
+ */
+uint16_t Wind_Rain_Get_Rain( uint8_t hours ) {
+	uint32_t tips = 0;
+
+	if ( hours <= 1 ) {
+		for ( uint8_t i=0; i < 60; i++ ) {
+			tips += rainMinutes[i];
+		}
+	} else {
+		if ( hours > WIND_RAIN_HOURS ) {
+			hours = WIND_RAIN_HOURS;
+		}
+		for ( uint8_t i=0; i < hours; i++ ) {
+			tips += rainHours[( rainHour + WIND_RAIN_HOURS - i ) % WIND_RAIN_HOURS];
+		}
+	}
+
+	return ( tips * WIND_RAIN_INCHES_PER_TIP_X1000 + 5 ) / 10;
+}
+
+void Wind_Rain_Get_Stats( uint32_t *windPulses, uint32_t *rainTips, uint32_t *rainBounces, uint32_t *windBounces ) {
+	if ( windPulses ) {
+		*windPulses = windRainWindPulses;
+	}
+	if ( rainTips ) {
+		*rainTips = windRainRainTips;
+	}
+	if ( rainBounces ) {
+		*rainBounces = windRainRainBounces;
+	}
+	if ( windBounces ) {
+		*windBounces = windRainWindBounces;
+	}
+}
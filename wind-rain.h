@@ -0,0 +1,33 @@
+// Anemometer and tipping bucket rain gauge inputs for TM4C123
+//
+// Uses Wide Timer 3A, PD2 (WT3CCP0): anemometer, edges timed
+// Uses Wide Timer 3B, PD3 (WT3CCP1): rain gauge, edges timed
+//
+// Both are reed switches to ground, with the pins pulled up, and
+// both are debounced from the capture times - no RC filter needed
+
+#ifndef __WIND_RAIN_H
+#define __WIND_RAIN_H
+
+#include "stdint.h"
+
+// SparkFun SEN-15901 / Argent Data: one closure a second is
+// 1.492 mph, and the bucket tips every 0.011 inches
+#define WIND_RAIN_MPH_PER_HZ_X1000 1492
+#define WIND_RAIN_INCHES_PER_TIP_X1000 11
+
+// Averages and gusts reach back this far
+#define WIND_RAIN_SPEED_SECONDS 60
+#define WIND_RAIN_GUST_MINUTES 10
+#define WIND_RAIN_HOURS 24
+
+void Wind_Rain_Init();
+void Wind_Rain_Tick_Second();
+void Wind_Rain_WTimer3A_Handler();
+void Wind_Rain_WTimer3B_Handler();
+uint16_t Wind_Rain_Get_Speed( uint8_t seconds );
+uint16_t Wind_Rain_Get_Gust( uint8_t minutes );
+uint16_t Wind_Rain_Get_Rain( uint8_t hours );
+void Wind_Rain_Get_Stats( uint32_t *windPulses, uint32_t *rainTips, uint32_t *rainBounces, uint32_t *windBounces );
+
+#endif // __WIND_RAIN_H